@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Config.h"
+
+/* allow Visual Studio to compile ANSI C containing strcpy */
+#pragma warning(disable : 4996)
+
+/* work out configuration file name and check whether it exists */
+int	getCfgFileName(char *szProgName, char *szCfgFile)
+{
+	char	*pPtr;
+	FILE 	*fp;
+	char	szDir[_MAX_STR_LEN];
+
+	szCfgFile[0] = '\0';
+	{
+		if ((pPtr = strrchr(szProgName, C_DIR_DELIMITER)) != NULL)
+		{
+			strcpy(szCfgFile, pPtr + 1);
+		}
+		else
+		{
+			strcpy(szCfgFile, szProgName);
+		}
+		if ((pPtr = strstr(szCfgFile, ".exe")) != NULL)
+		{
+			*pPtr = '\0';
+		}
+		strcat(szCfgFile, ".cfg");
+	}
+	/* check file exists */
+	fp = fopen(szCfgFile, "rb");
+	if (fp)
+	{
+		fclose(fp);
+		return 1;
+	}
+	getcwd(szDir, _MAX_STR_LEN);
+	fprintf(stderr, "Did not find config file %s in %s\n", szCfgFile, szDir);
+	return 0;
+}
+
+/*
+	string hash (FNV-1a) used to find keys in the table
+*/
+static unsigned int hashKey(const char *szKey)
+{
+	unsigned int	h;
+
+	h = 2166136261U;
+	while (*szKey)
+	{
+		h ^= (unsigned char)*szKey++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static t_CfgEntry *findEntry(t_Config *pCfg, const char *szKey)
+{
+	int		i;
+
+	if (pCfg->nBuckets == 0)
+	{
+		return NULL;
+	}
+	i = pCfg->aBuckets[hashKey(szKey) & (pCfg->nBuckets - 1)];
+	while (i >= 0)
+	{
+		if (strcmp(pCfg->aEntries[i].szKey, szKey) == 0)
+		{
+			return &pCfg->aEntries[i];
+		}
+		i = pCfg->aEntries[i].nNext;
+	}
+	return NULL;
+}
+
+/*
+	add a key=value pair, unless the key is already there (first occurrence wins)
+*/
+static int addEntry(t_Config *pCfg, const char *szKey, int nKeyLen, const char *szValue, int bFromCmdLine)
+{
+	t_CfgEntry	*pEntry;
+	char		*szKeyCopy;
+	int			i, nBucket;
+
+	szKeyCopy = malloc(nKeyLen + 1);
+	if (!szKeyCopy)
+	{
+		return 0;
+	}
+	memcpy(szKeyCopy, szKey, nKeyLen);
+	szKeyCopy[nKeyLen] = '\0';
+	if (findEntry(pCfg, szKeyCopy))
+	{
+		free(szKeyCopy);
+		return 1;
+	}
+	/* grow the table (and rehash) as needed, keeping load factor below a half */
+	if (pCfg->nEntries == pCfg->nAlloc)
+	{
+		pEntry = realloc(pCfg->aEntries, sizeof(t_CfgEntry) * (pCfg->nAlloc ? 2 * pCfg->nAlloc : 32));
+		if (!pEntry)
+		{
+			free(szKeyCopy);
+			return 0;
+		}
+		pCfg->aEntries = pEntry;
+		pCfg->nAlloc = pCfg->nAlloc ? 2 * pCfg->nAlloc : 32;
+		free(pCfg->aBuckets);
+		pCfg->nBuckets = 2 * pCfg->nAlloc;
+		pCfg->aBuckets = malloc(sizeof(int) * pCfg->nBuckets);
+		if (!pCfg->aBuckets)
+		{
+			pCfg->nBuckets = 0;
+			free(szKeyCopy);
+			return 0;
+		}
+		for (i = 0; i < pCfg->nBuckets; i++)
+		{
+			pCfg->aBuckets[i] = -1;
+		}
+		for (i = 0; i < pCfg->nEntries; i++)
+		{
+			nBucket = hashKey(pCfg->aEntries[i].szKey) & (pCfg->nBuckets - 1);
+			pCfg->aEntries[i].nNext = pCfg->aBuckets[nBucket];
+			pCfg->aBuckets[nBucket] = i;
+		}
+	}
+	pEntry = &pCfg->aEntries[pCfg->nEntries];
+	pEntry->szKey = szKeyCopy;
+	pEntry->szValue = strdup(szValue);
+	if (!pEntry->szValue)
+	{
+		free(szKeyCopy);
+		return 0;
+	}
+	pEntry->bFromCmdLine = bFromCmdLine;
+	pEntry->bUsed = 0;
+	nBucket = hashKey(szKeyCopy) & (pCfg->nBuckets - 1);
+	pEntry->nNext = pCfg->aBuckets[nBucket];
+	pCfg->aBuckets[nBucket] = pCfg->nEntries;
+	pCfg->nEntries++;
+	return 1;
+}
+
+/*
+	read every key=value pair from the command line and then the cfg file
+	(szCfgFile may be NULL or empty) into the table in a single pass,
+	so that values on the command line override those in the file
+*/
+int loadConfig(t_Config *pCfg, int argc, char **argv, char *szCfgFile)
+{
+	char	szLine[_MAX_STR_LEN];
+	char	*pThisPair, *pVal, *szArgvCopy;
+	FILE	*fp;
+	int		i, retVal;
+
+	memset(pCfg, 0, sizeof(t_Config));
+	retVal = 1;
+	/* command line options (a single argument may hold several space separated pairs) */
+	for (i = 1; retVal && i < argc; i++)
+	{
+		szArgvCopy = strdup(argv[i]);
+		if (!szArgvCopy)
+		{
+			retVal = 0;
+			break;
+		}
+		pThisPair = strtok(szArgvCopy, " \t");
+		while (retVal && pThisPair)
+		{
+			pVal = strchr(pThisPair, '=');
+			if (pVal && pVal != pThisPair)
+			{
+				retVal = addEntry(pCfg, pThisPair, (int)(pVal - pThisPair), pVal + 1, 1);
+			}
+			else
+			{
+				fprintf(stderr, "loadConfig(): Ignoring command line argument '%s' (not key=value)\n", pThisPair);
+			}
+			pThisPair = strtok(NULL, " \t");
+		}
+		free(szArgvCopy);
+	}
+	/* then the cfg file */
+	if (retVal && szCfgFile && szCfgFile[0])
+	{
+		fp = fopen(szCfgFile, "rb");
+		if (fp)
+		{
+			while (retVal && fgets(szLine, _MAX_STR_LEN, fp))
+			{
+				/* strip off newline (if any) */
+				if ((pVal = strpbrk(szLine, "\r\n")) != NULL)
+				{
+					*pVal = '\0';
+				}
+				if (szLine[0] == '#')
+				{
+					continue;
+				}
+				if ((pVal = strchr(szLine, '=')) != NULL && pVal != szLine)
+				{
+					retVal = addEntry(pCfg, szLine, (int)(pVal - szLine), pVal + 1, 0);
+				}
+			}
+			fclose(fp);
+		}
+		else
+		{
+			fprintf(stderr, "loadConfig(): Could not open %s\n", szCfgFile);
+			retVal = 0;
+		}
+	}
+	if (!retVal)
+	{
+		fprintf(stderr, "loadConfig(): Out of memory\n");
+		freeConfig(pCfg);
+	}
+	return retVal;
+}
+
+void freeConfig(t_Config *pCfg)
+{
+	int		i;
+
+	for (i = 0; i < pCfg->nEntries; i++)
+	{
+		free(pCfg->aEntries[i].szKey);
+		free(pCfg->aEntries[i].szValue);
+	}
+	free(pCfg->aEntries);
+	free(pCfg->aBuckets);
+	memset(pCfg, 0, sizeof(t_Config));
+}
+
+/*
+	report keys that were given but never asked for (most likely typos),
+	returning how many were on the command line
+*/
+int cfgCheckUnused(t_Config *pCfg)
+{
+	int		i, nCmdLine;
+
+	nCmdLine = 0;
+	for (i = 0; i < pCfg->nEntries; i++)
+	{
+		if (!pCfg->aEntries[i].bUsed)
+		{
+			fprintf(stderr, "Unknown key '%s' %s\n", pCfg->aEntries[i].szKey,
+				pCfg->aEntries[i].bFromCmdLine ? "on command line" : "in cfg file (ignored)");
+			nCmdLine += pCfg->aEntries[i].bFromCmdLine;
+		}
+	}
+	return nCmdLine;
+}
+
+/*
+	typed accessors: each returns 1 if the key was found and its value is valid
+
+	a key given with a value that isn't valid is reported and counted (see cfgBadValues()),
+	so that an optional key isn't silently left at its default
+*/
+int cfgGetString(t_Config *pCfg, char *szKey, char *szValue)
+{
+	t_CfgEntry	*pEntry;
+
+	pEntry = findEntry(pCfg, szKey);
+	if (!pEntry)
+	{
+		return 0;
+	}
+	pEntry->bUsed = 1;
+	strncpy(szValue, pEntry->szValue, _MAX_STR_LEN - 1);
+	szValue[_MAX_STR_LEN - 1] = '\0';
+	if (pEntry->bFromCmdLine)
+	{
+		fprintf(stdout, "extracted %s->%s from command line\n", szKey, szValue);
+	}
+	return 1;
+}
+
+int cfgGetDouble(t_Config *pCfg, char *szKey, double *pdValue)
+{
+	char	szValue[_MAX_STR_LEN];
+	char	*pEnd;
+	double	dValue;
+
+	if (!cfgGetString(pCfg, szKey, szValue))
+	{
+		return 0;
+	}
+	dValue = strtod(szValue, &pEnd);
+	while (*pEnd == ' ' || *pEnd == '\t')
+	{
+		pEnd++;
+	}
+	if (pEnd == szValue || *pEnd != '\0')
+	{
+		fprintf(stderr, "cfgGetDouble(): Value '%s' for %s is not a number\n", szValue, szKey);
+		pCfg->nBadValues++;
+		return 0;
+	}
+	*pdValue = dValue;
+	return 1;
+}
+
+int cfgGetInt(t_Config *pCfg, char *szKey, int *pnValue)
+{
+	char	szValue[_MAX_STR_LEN];
+	char	*pEnd;
+	long	nValue;
+
+	if (!cfgGetString(pCfg, szKey, szValue))
+	{
+		return 0;
+	}
+	nValue = strtol(szValue, &pEnd, 10);
+	while (*pEnd == ' ' || *pEnd == '\t')
+	{
+		pEnd++;
+	}
+	if (pEnd == szValue || *pEnd != '\0' || nValue > INT_MAX || nValue < INT_MIN)
+	{
+		fprintf(stderr, "cfgGetInt(): Value '%s' for %s is not an integer\n", szValue, szKey);
+		pCfg->nBadValues++;
+		return 0;
+	}
+	*pnValue = (int)nValue;
+	return 1;
+}
+
+/*
+	how many of the keys asked for so far had values that weren't valid
+*/
+int cfgBadValues(t_Config *pCfg)
+{
+	return pCfg->nBadValues;
+}
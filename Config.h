@@ -0,0 +1,49 @@
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+/*
+	reading key=value pairs from the command line or, failing that, a cfg file
+	(shared by EpidemicSim.c and the other programs built alongside it)
+
+	everything is read once into a hash table by loadConfig(), and then
+	looked up with the typed cfgGet*() accessors
+*/
+
+#ifndef _MAX_STR_LEN
+#define	_MAX_STR_LEN		1024
+#endif
+
+#ifdef _WIN32
+#define 	C_DIR_DELIMITER '\\'
+#else
+#define 	C_DIR_DELIMITER '/'
+#endif
+
+typedef struct {
+	char	*szKey;
+	char	*szValue;
+	int		bFromCmdLine;
+	int		bUsed;			/* set once the key has been asked for */
+	int		nNext;			/* next entry in the same hash bucket (-1 at end) */
+} t_CfgEntry;
+
+/* every key=value pair from the command line and cfg file, read in one pass */
+typedef struct {
+	t_CfgEntry	*aEntries;
+	int			nEntries;
+	int			nAlloc;
+	int			*aBuckets;		/* first entry in each bucket (-1 if empty) */
+	int			nBuckets;		/* always a power of two */
+	int			nBadValues;		/* keys asked for whose value wasn't of the type wanted */
+} t_Config;
+
+int	getCfgFileName(char *szProgName, char *szCfgFile);
+int	loadConfig(t_Config *pCfg, int argc, char **argv, char *szCfgFile);
+void freeConfig(t_Config *pCfg);
+int	cfgCheckUnused(t_Config *pCfg);
+int	cfgGetString(t_Config *pCfg, char *szKey, char *szValue);
+int	cfgGetDouble(t_Config *pCfg, char *szKey, double *pdValue);
+int	cfgGetInt(t_Config *pCfg, char *szKey, int *pnValue);
+int	cfgBadValues(t_Config *pCfg);
+
+#endif /* _CONFIG_H_ */
@@ -0,0 +1,237 @@
+/*
+	Compiled replacement for the landscape generation in create_LS.R
+
+	Writes <outDir>/<lsStub>_<n>_xy.csv and _meta.csv for each landscape and,
+	optionally, the _ORing_<ij>.csv files needed by rZero_Function.R. Pictures
+	are not drawn; plot_LS.R will draw them for existing landscapes if wanted.
+
+	Each landscape has its own random number stream, seeded from (seed, n),
+	so the output doesn't depend on how many threads are used or on which
+	other landscapes are generated in the same run.
+
+	Compile CreateLS.exe from CreateLS.c, Landscape.c, Config.c, Threads.c and mt19937ar.c
+	(link with -lpthread -lm if not on Windows). Options are in CreateLS.cfg,
+	and can be overridden on the command line as key=value.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "mt19937ar.h"
+#include "Config.h"
+#include "Threads.h"
+#include "Landscape.h"
+
+/* allow Visual Studio to compile ANSI C containing strcpy */
+#pragma warning(disable : 4996)
+
+typedef struct {
+	int				nLS;			/* How many landscapes to build */
+	int				nFirstLS;		/* Number given to the first one */
+	int				nSpOne;			/* Hosts of each type per landscape */
+	int				nSpTwo;
+	double			dXMax;			/* Extent (before scaling) in which cluster centres are placed */
+	double			dYMax;
+	unsigned long	ulnSeed;
+	int				bORing;			/* Whether to also write the O-ring statistics */
+	int				nORingPoints;
+	double			dORingSmooth;
+	int				nThreads;
+	char			sOutDir[_MAX_STR_LEN];
+	char			sStub[_MAX_STR_LEN];
+	int				nFailed;		/* Number of landscapes that couldn't be written */
+	t_Mutex			sLock;
+} t_LSParams;
+
+int readLSParams(t_LSParams *pParams, int argc, char **argv)
+{
+	char		szCfgFile[_MAX_STR_LEN];
+	t_Config	sCfg;
+	int			nSeed, nUnknown, nBad;
+
+	memset(pParams, 0, sizeof(t_LSParams));
+	/* defaults are those hard coded in create_LS.R */
+	pParams->nLS = 2;
+	pParams->nFirstLS = 1;
+	pParams->nSpOne = 800;
+	pParams->nSpTwo = 1200;
+	pParams->dXMax = 1.0;
+	pParams->dYMax = 1.0;
+	pParams->bORing = 1;
+	pParams->nORingPoints = _LS_ORING_POINTS;
+	pParams->dORingSmooth = _LS_ORING_SMOOTH;
+	pParams->nThreads = numProcessors();
+	strcpy(pParams->sOutDir, "Inputs");
+	strcpy(pParams->sStub, "ls");
+	/* cfg file is optional, since every key has a default */
+	if (!getCfgFileName(argv[0], szCfgFile))
+	{
+		szCfgFile[0] = '\0';
+	}
+	if (!loadConfig(&sCfg, argc, argv, szCfgFile))
+	{
+		return 0;
+	}
+	cfgGetInt(&sCfg, "nLS", &pParams->nLS);
+	cfgGetInt(&sCfg, "firstLS", &pParams->nFirstLS);
+	cfgGetInt(&sCfg, "nSpOne", &pParams->nSpOne);
+	cfgGetInt(&sCfg, "nSpTwo", &pParams->nSpTwo);
+	cfgGetDouble(&sCfg, "xMax", &pParams->dXMax);
+	cfgGetDouble(&sCfg, "yMax", &pParams->dYMax);
+	cfgGetInt(&sCfg, "oRing", &pParams->bORing);
+	cfgGetInt(&sCfg, "oRingPoints", &pParams->nORingPoints);
+	cfgGetDouble(&sCfg, "oRingSmooth", &pParams->dORingSmooth);
+	cfgGetInt(&sCfg, "numThreads", &pParams->nThreads);
+	cfgGetString(&sCfg, "outDir", pParams->sOutDir);
+	cfgGetString(&sCfg, "lsStub", pParams->sStub);
+	nSeed = 0;
+	cfgGetInt(&sCfg, "seed", &nSeed);
+	nUnknown = cfgCheckUnused(&sCfg);
+	nBad = cfgBadValues(&sCfg);
+	freeConfig(&sCfg);
+	if (nUnknown > 0)
+	{
+		fprintf(stderr, "readLSParams(): Unknown key(s) on command line\n");
+		return 0;
+	}
+	if (nBad > 0)
+	{
+		fprintf(stderr, "readLSParams(): %d value(s) couldn't be read\n", nBad);
+		return 0;
+	}
+	if (nSeed > 0)
+	{
+		pParams->ulnSeed = (unsigned long)nSeed;
+	}
+	else
+	{
+		/* same fallback as EpidemicSim, but report it so the run can be repeated */
+#ifndef _WIN32
+		pParams->ulnSeed = (unsigned long)time(NULL) + (unsigned long)getpid();
+#else
+		pParams->ulnSeed = (unsigned long)time(NULL) + (unsigned long)_getpid();
+#endif
+		pParams->ulnSeed &= 0x7fffffffUL;
+	}
+	fprintf(stdout, "seed=%lu\n", pParams->ulnSeed);
+	if (pParams->nLS < 1 || pParams->nSpOne < 0 || pParams->nSpTwo < 0 || pParams->nSpOne + pParams->nSpTwo < 2)
+	{
+		fprintf(stderr, "readLSParams(): Need nLS > 0 and at least two hosts per landscape\n");
+		return 0;
+	}
+	if (pParams->nThreads < 1)
+	{
+		pParams->nThreads = numProcessors();
+	}
+	if (pParams->bORing && pParams->nORingPoints < 2)
+	{
+		fprintf(stderr, "readLSParams(): oRingPoints must be at least 2\n");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+	generate and write out landscape number pParams->nFirstLS + nItem
+*/
+void makeOneLandscape(void *pCtx, int nItem, int nThread)
+{
+	t_LSParams		*pParams;
+	t_LSSpec		sSpec;
+	t_Landscape		sLS;
+	mt_state		sRNG;
+	unsigned long	aKey[2];
+	char			sStub[_MAX_STR_LEN];
+	int				lsNum, nLen, retVal;
+
+	(void)nThread;	/* runInParallel()'s; the landscape is the same whichever thread makes it */
+	pParams = (t_LSParams*)pCtx;
+	lsNum = pParams->nFirstLS + nItem;
+	aKey[0] = pParams->ulnSeed;
+	aKey[1] = (unsigned long)lsNum;
+	init_by_array_r(&sRNG, aKey, 2);
+	drawLandscapeSpec(&sSpec, pParams->nSpOne, pParams->nSpTwo, &sRNG);
+	sSpec.dXMax = pParams->dXMax;
+	sSpec.dYMax = pParams->dYMax;
+	if (pParams->sOutDir[0])
+	{
+		nLen = snprintf(sStub, sizeof(sStub), "%s%c%s_%d", pParams->sOutDir, C_DIR_DELIMITER, pParams->sStub, lsNum);
+	}
+	else
+	{
+		nLen = snprintf(sStub, sizeof(sStub), "%s_%d", pParams->sStub, lsNum);
+	}
+	memset(&sLS, 0, sizeof(t_Landscape));
+	/* room is left for the _xy.csv etc. that the writers add */
+	retVal = (nLen >= 0 && nLen < _MAX_STR_LEN - 16);
+	if (!retVal)
+	{
+		mutexLock(&pParams->sLock);
+		fprintf(stderr, "makeOneLandscape(): Path for landscape %d in %s is too long\n", lsNum, pParams->sOutDir);
+		mutexUnlock(&pParams->sLock);
+	}
+	if (retVal)
+	{
+		retVal = makeLandscape(&sSpec, &sLS, &sRNG);
+	}
+	if (retVal)
+	{
+		retVal = writeLandscapeCSV(&sSpec, &sLS, sStub);
+	}
+	if (retVal && pParams->bORing)
+	{
+		retVal = writeORingCSV(&sLS, sStub, pParams->nORingPoints, pParams->dORingSmooth);
+	}
+	freeLandscape(&sLS);
+	mutexLock(&pParams->sLock);
+	if (retVal)
+	{
+		fprintf(stdout, "%s: %d Type 1 (c1=%d,w1=%.2f); %d Type 2 (c2=%d,w2=%.2f); scale=%.4f\n", sStub,
+			sSpec.nNumOne, sSpec.nClustersOne, sSpec.dWidthOne,
+			sSpec.nNumTwo, sSpec.nClustersTwo, sSpec.dWidthTwo, sSpec.dScale);
+	}
+	else
+	{
+		fprintf(stderr, "Failed to make landscape %s\n", sStub);
+		pParams->nFailed++;
+	}
+	mutexUnlock(&pParams->sLock);
+}
+
+/*
+	main routine
+*/
+int main(int argc, char **argv)
+{
+	t_LSParams	sParams;
+	int			retVal;
+
+	if (!(retVal = readLSParams(&sParams, argc, argv)))
+	{
+		fprintf(stderr, "Error in readLSParams()\nExiting\n");
+	}
+	if (retVal)
+	{
+		mutexInit(&sParams.sLock);
+		if (!(retVal = runInParallel(sParams.nThreads, sParams.nLS, makeOneLandscape, &sParams)))
+		{
+			fprintf(stderr, "Error in runInParallel()\nExiting\n");
+		}
+		mutexDestroy(&sParams.sLock);
+		if (retVal && sParams.nFailed)
+		{
+			fprintf(stderr, "%d of %d landscapes could not be made\n", sParams.nFailed, sParams.nLS);
+			retVal = 0;
+		}
+	}
+	if (retVal == 0)
+		return(EXIT_FAILURE);
+	return(EXIT_SUCCESS);
+}
@@ -0,0 +1,514 @@
+/*
+	Benchmark for EpidemicSim
+
+	Builds clustered landscapes in C (see Landscape.c) over a grid of host
+	counts and kernel parameters, then times the kernel build and a fixed
+	number of replicates. Everything is seeded explicitly, so the number of
+	events simulated for each configuration is identical from run to run and
+	timings can be compared between releases.
+
+	Compile EpidemicBench.exe from EpidemicBench.c, Config.c, Landscape.c,
+	Threads.c and mt19937ar.c (EpidemicSim.c is included directly, below).
+
+	Options are given on the command line as key=value, e.g.
+		EpidemicBench.exe benchHosts=1000,10000 numIts=50
+*/
+
+#define _EPIDEMICSIM_NO_MAIN
+#include "EpidemicSim.c"
+#include "Landscape.h"
+
+#ifdef _WIN32
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#define	_BENCH_MAX_LIST		32
+#define	_BENCH_SEED			20200101UL
+#define	_BENCH_DENSITY		2000.0		/* hosts per unit area before scaling (as in create_LS.R) */
+
+typedef struct {
+	int				aHostCounts[_BENCH_MAX_LIST];
+	int				nHostCounts;
+	double			aDispA[_BENCH_MAX_LIST];
+	int				nDispA;
+	double			aDispC[_BENCH_MAX_LIST];
+	int				nDispC;
+	int				nNumIts;
+	int				nMaxGen;
+	int				eModelType;
+	unsigned long	ulnSeed;
+	double			dMaxKernelMB;		/* skip configurations with a bigger kernel than this */
+	int				eKernelType;		/* as kernelType in EpidemicSim */
+	int				eSortHosts;			/* ...sortHosts */
+	int				nKernelGrid;		/* ...kernelGrid */
+	double			dKernelTol;			/* ...kernelTol */
+	int				eEngine;			/* ...engine */
+	int				nLanes;				/* ...lanes */
+	int				ePages;				/* ...hugePages */
+	int				bNumaPlacement;		/* ...numaPlacement */
+	int				eKernelStore;		/* ...kernelStore */
+	double			dMemoryBudgetMB;	/* ...memoryBudget */
+	int				nTileThreads;		/* ...tilePrefetchThreads */
+	int				aEventThreads[_BENCH_MAX_LIST];	/* ...eventThreads, every configuration run with each */
+	int				nEventThreads;
+	char			sResultsFile[_MAX_STR_LEN];
+	char			sScratchDir[_MAX_STR_LEN - 32];	/* temporary directory for the epidemics and kernel tiles (short enough to add their names) */
+} t_BenchParams;
+
+/*
+	peak resident memory of this process so far
+*/
+double	peakMemoryMB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS	sCounters;
+
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &sCounters, sizeof(sCounters)))
+	{
+		return (double)sCounters.PeakWorkingSetSize / (1024.0 * 1024.0);
+	}
+	return _NOT_SET;
+#else
+	struct rusage	sUsage;
+
+	if (getrusage(RUSAGE_SELF, &sUsage) == 0)
+	{
+		return (double)sUsage.ru_maxrss / 1024.0;	/* reported in kilobytes */
+	}
+	return _NOT_SET;
+#endif
+}
+
+/*
+	make a new directory under the system's temporary one for the files a run writes on the way
+*/
+int makeScratchDir(t_BenchParams *pBench)
+{
+#ifdef _WIN32
+	char	sTmp[MAX_PATH];
+	int		i, nLen;
+
+	if (GetTempPathA(MAX_PATH, sTmp) == 0)
+	{
+		fprintf(stderr, "makeScratchDir(): Couldn't find the temporary directory\n");
+		return 0;
+	}
+	for (i = 0; i < 100; i++)
+	{
+		nLen = snprintf(pBench->sScratchDir, sizeof(pBench->sScratchDir), "%sEpidemicBench_%lu_%d", sTmp, (unsigned long)GetCurrentProcessId(), i);
+		if (nLen > 0 && nLen < (int)sizeof(pBench->sScratchDir) && _mkdir(pBench->sScratchDir) == 0)
+		{
+			return 1;
+		}
+	}
+#else
+	char	*sTmp;
+	int		nLen;
+
+	sTmp = getenv("TMPDIR");
+	if (!sTmp || !sTmp[0])
+	{
+		sTmp = "/tmp";
+	}
+	nLen = snprintf(pBench->sScratchDir, sizeof(pBench->sScratchDir), "%s/EpidemicBench_XXXXXX", sTmp);
+	if (nLen > 0 && nLen < (int)sizeof(pBench->sScratchDir) && mkdtemp(pBench->sScratchDir))
+	{
+		return 1;
+	}
+#endif
+	fprintf(stderr, "makeScratchDir(): Couldn't make a temporary directory\n");
+	return 0;
+}
+
+/*
+	parse a comma separated list of numbers, leaving the default alone if the key isn't given
+*/
+int readListFromConfig(t_Config *pCfg, char *szKey, double *aValues, int *pnValues)
+{
+	char	szValue[_MAX_STR_LEN];
+	char	*p;
+	int		n;
+
+	if (cfgGetString(pCfg, szKey, szValue))
+	{
+		n = 0;
+		p = strtok(szValue, ",");
+		while (p)
+		{
+			if (n == _BENCH_MAX_LIST)
+			{
+				fprintf(stderr, "readListFromConfig(): More than %d values for %s\n", _BENCH_MAX_LIST, szKey);
+				return 0;
+			}
+			aValues[n++] = atof(p);
+			p = strtok(NULL, ",");
+		}
+		if (n == 0)
+		{
+			fprintf(stderr, "readListFromConfig(): Empty list for %s\n", szKey);
+			return 0;
+		}
+		*pnValues = n;
+	}
+	return 1;
+}
+
+int readBenchParams(t_BenchParams *pBench, int argc, char **argv)
+{
+	t_Config	sCfg;
+	double		aTmp[_BENCH_MAX_LIST];
+	int			i, nSeed, retVal;
+
+	memset(pBench, 0, sizeof(t_BenchParams));
+	pBench->nHostCounts = 4;
+	pBench->aHostCounts[0] = 1000;
+	pBench->aHostCounts[1] = 10000;
+	pBench->aHostCounts[2] = 50000;
+	pBench->aHostCounts[3] = 100000;
+	pBench->nDispA = 2;
+	pBench->aDispA[0] = 0.1;
+	pBench->aDispA[1] = 0.25;
+	pBench->nDispC = 3;
+	pBench->aDispC[0] = 0.5;
+	pBench->aDispC[1] = 1.0;
+	pBench->aDispC[2] = 2.0;
+	pBench->nNumIts = 20;
+	pBench->nMaxGen = 2;
+	pBench->eModelType = MODEL_SIS;
+	pBench->ulnSeed = _BENCH_SEED;
+	pBench->dMaxKernelMB = 4096.0;
+	pBench->nEventThreads = 1;
+	pBench->aEventThreads[0] = 0;
+	strcpy(pBench->sResultsFile, "EpidemicBench_results.csv");
+
+	for (i = 0; i < pBench->nHostCounts; i++)
+	{
+		aTmp[i] = pBench->aHostCounts[i];
+	}
+	/* command line only, there is no cfg file */
+	if (!loadConfig(&sCfg, argc, argv, NULL))
+	{
+		return 0;
+	}
+	retVal = readListFromConfig(&sCfg, "benchHosts", aTmp, &pBench->nHostCounts)
+		&& readListFromConfig(&sCfg, "benchDispA", pBench->aDispA, &pBench->nDispA)
+		&& readListFromConfig(&sCfg, "benchDispC", pBench->aDispC, &pBench->nDispC);
+	for (i = 0; i < pBench->nHostCounts; i++)
+	{
+		pBench->aHostCounts[i] = (int)aTmp[i];
+	}
+	cfgGetInt(&sCfg, "numIts", &pBench->nNumIts);
+	cfgGetInt(&sCfg, "maxGen", &pBench->nMaxGen);
+	cfgGetInt(&sCfg, "modelType", &pBench->eModelType);
+	pBench->eKernelType = KERNEL_I;
+	cfgGetInt(&sCfg, "kernelType", &pBench->eKernelType);
+	cfgGetInt(&sCfg, "sortHosts", &pBench->eSortHosts);
+	pBench->dKernelTol = 0.01;
+	cfgGetInt(&sCfg, "kernelGrid", &pBench->nKernelGrid);
+	cfgGetDouble(&sCfg, "kernelTol", &pBench->dKernelTol);
+	pBench->eEngine = ENGINE_HOSTS;
+	cfgGetInt(&sCfg, "engine", &pBench->eEngine);
+	pBench->nLanes = 1;
+	cfgGetInt(&sCfg, "lanes", &pBench->nLanes);
+	pBench->ePages = PAGES_TRANSPARENT;
+	cfgGetInt(&sCfg, "hugePages", &pBench->ePages);
+	pBench->bNumaPlacement = 1;
+	cfgGetInt(&sCfg, "numaPlacement", &pBench->bNumaPlacement);
+	/* the full dense kernel unless asked otherwise, so results compare with earlier releases */
+	pBench->eKernelStore = STORE_DENSE;
+	cfgGetInt(&sCfg, "kernelStore", &pBench->eKernelStore);
+	cfgGetDouble(&sCfg, "memoryBudget", &pBench->dMemoryBudgetMB);
+	pBench->nTileThreads = 2;
+	cfgGetInt(&sCfg, "tilePrefetchThreads", &pBench->nTileThreads);
+	aTmp[0] = 0.0;
+	if (retVal && (retVal = readListFromConfig(&sCfg, "benchEventThreads", aTmp, &pBench->nEventThreads)))
+	{
+		for (i = 0; i < pBench->nEventThreads; i++)
+		{
+			pBench->aEventThreads[i] = (int)aTmp[i];
+		}
+	}
+	cfgGetDouble(&sCfg, "benchMaxKernelMB", &pBench->dMaxKernelMB);
+	cfgGetString(&sCfg, "benchFile", pBench->sResultsFile);
+	nSeed = 0;
+	if (cfgGetInt(&sCfg, "seed", &nSeed) && nSeed > 0)
+	{
+		pBench->ulnSeed = (unsigned long)nSeed;
+	}
+	if (retVal && cfgCheckUnused(&sCfg) > 0)
+	{
+		fprintf(stderr, "readBenchParams(): Unknown key(s) on command line\n");
+		retVal = 0;
+	}
+	if (retVal && cfgBadValues(&sCfg) > 0)
+	{
+		fprintf(stderr, "readBenchParams(): %d value(s) couldn't be read\n", cfgBadValues(&sCfg));
+		retVal = 0;
+	}
+	freeConfig(&sCfg);
+	if (retVal && pBench->nNumIts < 1)
+	{
+		fprintf(stderr, "readBenchParams(): numIts must be positive\n");
+		retVal = 0;
+	}
+	if (retVal && !findKernelSpec(pBench->eKernelType))
+	{
+		fprintf(stderr, "readBenchParams(): Invalid kernelType\n");
+		retVal = 0;
+	}
+	if (retVal && (pBench->eSortHosts < SORT_NONE || pBench->eSortHosts > SORT_HILBERT))
+	{
+		fprintf(stderr, "readBenchParams(): Invalid sortHosts\n");
+		retVal = 0;
+	}
+	if (retVal && (pBench->nKernelGrid < 0 || pBench->nKernelGrid > _MAX_KERNEL_GRID || pBench->dKernelTol < 0.0))
+	{
+		fprintf(stderr, "readBenchParams(): Invalid kernelGrid or kernelTol\n");
+		retVal = 0;
+	}
+	if (retVal && (pBench->eEngine < ENGINE_HOSTS || pBench->eEngine > ENGINE_INFECTIVES
+		|| (pBench->eEngine == ENGINE_INFECTIVES && pBench->nKernelGrid > 0)))
+	{
+		fprintf(stderr, "readBenchParams(): Invalid engine (or engine=%d with kernelGrid)\n", ENGINE_INFECTIVES);
+		retVal = 0;
+	}
+	if (retVal && ((pBench->nLanes != 1 && pBench->nLanes != 2 && pBench->nLanes != 4 && pBench->nLanes != _MAX_LANES)
+		|| (pBench->nLanes > 1 && (pBench->eEngine != ENGINE_HOSTS || pBench->nKernelGrid > 0))))
+	{
+		fprintf(stderr, "readBenchParams(): Invalid lanes (or lanes > 1 without engine=%d and the full kernel)\n", ENGINE_HOSTS);
+		retVal = 0;
+	}
+	if (retVal && (pBench->eKernelStore < STORE_AUTO || pBench->eKernelStore > STORE_TILED || pBench->dMemoryBudgetMB < 0.0
+		|| (pBench->eKernelStore > STORE_DENSE && (pBench->eEngine != ENGINE_HOSTS || pBench->nKernelGrid > 0 || pBench->nLanes > 1))))
+	{
+		fprintf(stderr, "readBenchParams(): Invalid kernelStore or memoryBudget (or kernelStore > %d without engine=%d, or with kernelGrid or lanes)\n", STORE_DENSE, ENGINE_HOSTS);
+		retVal = 0;
+	}
+	if (retVal && (pBench->ePages < PAGES_NORMAL || pBench->ePages > PAGES_RESERVED))
+	{
+		fprintf(stderr, "readBenchParams(): Invalid hugePages\n");
+		retVal = 0;
+	}
+	if (retVal && (pBench->nTileThreads < 0 || pBench->nTileThreads > _MAX_TILE_THREADS))
+	{
+		fprintf(stderr, "readBenchParams(): Invalid tilePrefetchThreads\n");
+		retVal = 0;
+	}
+	for (i = 0; retVal && i < pBench->nEventThreads; i++)
+	{
+		if (pBench->aEventThreads[i] < 0)
+		{
+			fprintf(stderr, "readBenchParams(): Invalid benchEventThreads\n");
+			retVal = 0;
+		}
+	}
+	return retVal;
+}
+
+/*
+	epidemiological parameters are those in the shipped EpidemicSim.cfg
+*/
+void setBenchSimParams(t_BenchParams *pBench, t_Params *pParams, double dA, double dC)
+{
+	memset(pParams, 0, sizeof(t_Params));
+	pParams->dThetaOne = 0.1;
+	pParams->dThetaTwo = 0.1;
+	pParams->dRhoOne = 0.05;
+	pParams->dRhoTwo = 0.1;
+	pParams->dMuOne = 2.0;
+	pParams->dMuTwo = 4.0;
+	pParams->nInitOne = 1;
+	pParams->nInitTwo = 1;
+	pParams->bCacheKernel = 1;
+	pParams->eKernelType = pBench->eKernelType;
+	pParams->dA = dA;
+	pParams->dC = dC;
+	pParams->nNumIts = pBench->nNumIts;
+	pParams->nMaxGen = pBench->nMaxGen;
+	pParams->eModelType = pBench->eModelType;
+	pParams->eDumpType = DUMP_GENS;
+	pParams->dMaxTime = -1;
+	pParams->bDumpHostStatus = 0;
+	pParams->bQuiet = 1;
+	pParams->eSortHosts = pBench->eSortHosts;
+	pParams->nKernelGrid = pBench->nKernelGrid;
+	pParams->dKernelTol = pBench->dKernelTol;
+	pParams->eEngine = pBench->eEngine;
+	pParams->nLanes = pBench->nLanes;
+	pParams->ePages = pBench->ePages;
+	pParams->bNumaPlacement = pBench->bNumaPlacement;
+	pParams->eKernelStore = pBench->eKernelStore;
+	pParams->dMemoryBudgetMB = pBench->dMemoryBudgetMB;
+	pParams->nTileThreads = pBench->nTileThreads;
+	snprintf(pParams->sKernelTileFile, _MAX_STR_LEN, "%s%cEpidemicBench_tiles.bin", pBench->sScratchDir, C_DIR_DELIMITER);
+	pParams->nSeed = (int)pBench->ulnSeed;	/* so every configuration sees the same random numbers */
+	pParams->nShardIndex = 0;
+	pParams->nShardCount = 1;
+	strcpy(pParams->sXYFile, "<generated>");
+	snprintf(pParams->sOutFile, _MAX_STR_LEN, "%s%cEpidemicBench_epidemics.csv", pBench->sScratchDir, C_DIR_DELIMITER);
+}
+
+/*
+	generate a landscape with the same host density as those from create_LS.R
+*/
+int makeBenchHosts(t_BenchParams *pBench, int nHosts, t_Hosts *pHosts)
+{
+	t_LSSpec		sSpec;
+	t_Landscape		sLS;
+	mt_state		sRNG;
+	unsigned long	aKey[2];
+	int				i, nNumOne;
+
+	/* the landscape only depends on the seed and the number of hosts */
+	aKey[0] = pBench->ulnSeed;
+	aKey[1] = (unsigned long)nHosts;
+	init_by_array_r(&sRNG, aKey, 2);
+	nNumOne = (int)(0.4 * nHosts);		/* 800:1200 split as in create_LS.R */
+	drawLandscapeSpec(&sSpec, nNumOne, nHosts - nNumOne, &sRNG);
+	sSpec.dXMax = sSpec.dYMax = sqrt(nHosts / _BENCH_DENSITY);
+	memset(&sLS, 0, sizeof(t_Landscape));
+	if (!makeLandscape(&sSpec, &sLS, &sRNG))
+	{
+		return 0;
+	}
+	memset(pHosts, 0, sizeof(t_Hosts));
+	pHosts->aHosts = malloc(sizeof(t_SingleHost) * sLS.nPoints);
+	if (!pHosts->aHosts)
+	{
+		fprintf(stderr, "makeBenchHosts(): Out of memory\n");
+		freeLandscape(&sLS);
+		return 0;
+	}
+	for (i = 0; i < sLS.nPoints; i++)
+	{
+		pHosts->aHosts[i].dX = sLS.aPoints[i].dX;
+		pHosts->aHosts[i].dY = sLS.aPoints[i].dY;
+		pHosts->aHosts[i].eType = sLS.aPoints[i].eType;
+	}
+	pHosts->nHosts = pHosts->nAlloc = sLS.nPoints;
+	freeLandscape(&sLS);
+	if (pBench->eSortHosts != SORT_NONE && !sortHosts(pHosts, pBench->eSortHosts))
+	{
+		return 0;
+	}
+	return indexHostTypes(pHosts);
+}
+
+int main(int argc, char **argv)
+{
+	t_BenchParams	sBench;
+	t_Params		sParams;
+	t_Hosts			sHosts;
+	t_Kernel		sKernel;
+	t_RunStats		sStats;
+	const t_KernelSpec	*pSpec;
+	FILE			*fResults;
+	int				h, a, c, t, nHosts, nThreads, retVal;
+	double			dKernelMB, dStart, dKernelMs, dEventsPerSec, dMsPerRep;
+
+	if (!readBenchParams(&sBench, argc, argv))
+	{
+		fprintf(stderr, "Error in readBenchParams()\nExiting\n");
+		return(EXIT_FAILURE);
+	}
+	threadsPinWorkers(sBench.bNumaPlacement);
+	fResults = fopen(sBench.sResultsFile, "wb");
+	if (!fResults)
+	{
+		fprintf(stderr, "Could not open %s\nExiting\n", sBench.sResultsFile);
+		return(EXIT_FAILURE);
+	}
+	if (!makeScratchDir(&sBench))
+	{
+		fprintf(stderr, "Error in makeScratchDir()\nExiting\n");
+		fclose(fResults);
+		return(EXIT_FAILURE);
+	}
+	fprintf(fResults, "nHosts,dispA,dispC,kernelMB,kernelMs,numIts,events,eventsPerSec,msPerReplicate,peakRSSMB,eventThreads\n");
+	fprintf(stdout, "%8s %6s %6s %10s %10s %6s %10s %12s %10s %10s %8s\n",
+		"nHosts", "dispA", "dispC", "kernelMB", "kernelMs", "its", "events", "events/s", "ms/rep", "peakMB", "threads");
+	retVal = 1;
+	for (h = 0; retVal && h < sBench.nHostCounts; h++)
+	{
+		nHosts = sBench.aHostCounts[h];
+		dKernelMB = (double)sizeof(double) * nHosts * (double)nHosts / (1024.0 * 1024.0);
+		if (dKernelMB > sBench.dMaxKernelMB && sBench.nKernelGrid == 0 && sBench.eKernelStore == STORE_DENSE)
+		{
+			fprintf(stdout, "%8d skipped: kernel needs %.0f MB (benchMaxKernelMB=%.0f)\n", nHosts, dKernelMB, sBench.dMaxKernelMB);
+			fprintf(fResults, "%d,NA,NA,%.1f,NA,NA,NA,NA,NA,NA,NA\n", nHosts, dKernelMB);
+			continue;
+		}
+		if (!(retVal = makeBenchHosts(&sBench, nHosts, &sHosts)))
+		{
+			fprintf(stderr, "Error in makeBenchHosts()\nExiting\n");
+			break;
+		}
+		for (a = 0; retVal && a < sBench.nDispA; a++)
+		{
+			for (c = 0; retVal && c < sBench.nDispC; c++)
+			{
+				setBenchSimParams(&sBench, &sParams, sBench.aDispA[a], sBench.aDispC[c]);
+				pSpec = findKernelSpec(sParams.eKernelType);
+				if (!pSpec->pfValid(sParams.dA, sParams.dC))
+				{
+					fprintf(stdout, "%8d %6.3f %6.3f skipped: the %s kernel needs %s\n", nHosts, sParams.dA, sParams.dC, pSpec->sName, pSpec->sRule);
+					fprintf(fResults, "%d,%.4f,%.4f,NA,NA,NA,NA,NA,NA,NA,NA\n", nHosts, sParams.dA, sParams.dC);
+					continue;
+				}
+				memset(&sKernel, 0, sizeof(t_Kernel));
+				dStart = wallClockSeconds();
+				if (!(retVal = calcKernel(&sParams, &sHosts, &sKernel)))
+				{
+					fprintf(stderr, "Error in calcKernel()\nExiting\n");
+					break;
+				}
+				dKernelMs = 1000.0 * (wallClockSeconds() - dStart);
+				dKernelMB = kernelMB(&sKernel, &sHosts);
+				/* a scaling curve: the same epidemics with each number of threads */
+				for (t = 0; retVal && t < sBench.nEventThreads; t++)
+				{
+					sParams.nEventThreads = sBench.aEventThreads[t];
+					nThreads = 1;
+					if (sParams.eEngine == ENGINE_HOSTS && nHosts >= _EVENT_BLOCK_MIN_HOSTS && !sKernel.pTiles)
+					{
+						nThreads = (sParams.nEventThreads > 0) ? sParams.nEventThreads : numProcessors();
+					}
+					if (!(retVal = runEpidemics(&sParams, &sHosts, &sKernel, &sStats)))
+					{
+						fprintf(stderr, "Error in runEpidemics()\nExiting\n");
+					}
+					else
+					{
+						dEventsPerSec = sStats.dSeconds > 0.0 ? sStats.nEvents / sStats.dSeconds : 0.0;
+						dMsPerRep = 1000.0 * sStats.dSeconds / sStats.nReplicates;
+						fprintf(stdout, "%8d %6.3f %6.3f %10.1f %10.1f %6d %10lld %12.0f %10.3f %10.1f %8d\n",
+							nHosts, sParams.dA, sParams.dC, dKernelMB, dKernelMs, sStats.nReplicates,
+							sStats.nEvents, dEventsPerSec, dMsPerRep, peakMemoryMB(), nThreads);
+						fprintf(fResults, "%d,%.4f,%.4f,%.1f,%.3f,%d,%lld,%.1f,%.4f,%.1f,%d\n",
+							nHosts, sParams.dA, sParams.dC, dKernelMB, dKernelMs, sStats.nReplicates,
+							sStats.nEvents, dEventsPerSec, dMsPerRep, peakMemoryMB(), nThreads);
+						fflush(stdout);
+						fflush(fResults);
+					}
+				}
+				freeKernel(&sKernel);
+			}
+		}
+		freeMemory(&sHosts, &sKernel);
+	}
+	fclose(fResults);
+	setBenchSimParams(&sBench, &sParams, 0.0, 0.0);	/* just for the names of the files */
+	remove(sParams.sOutFile);
+	remove(sParams.sKernelTileFile);
+#ifdef _WIN32
+	_rmdir(sBench.sScratchDir);
+#else
+	rmdir(sBench.sScratchDir);
+#endif
+	if (retVal == 0)
+		return(EXIT_FAILURE);
+	return(EXIT_SUCCESS);
+}
@@ -1,1355 +1,7795 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <math.h>
-#include <string.h>
-#include <time.h>
-#include <direct.h>
-#include <process.h>
-
-/* MT19937 random number generation */
-#include "mt19937ar.h"
-
-/* allow Visual Studio to compile ANSI C containing strcpy */
-#pragma warning(disable : 4996)
-
-#define	_MAX_STR_LEN		1024
-#define	_STR_SEP			",\t "
-#define _BLOCK_SIZE			256
-#define	_PI					3.1415926535897932384626433
-#define	_NOT_SET			-1
-#define _NUMERIC_UNDERFLOW	1e-5
-#define N_DUMP_STEPS		100			/* used if dumping out time courses rather than generations */
-#define	_ONE_LINE_GEN_OUT	1			/* whether or not to put all information for a generation on a single line */
-
-#ifdef _WIN32
-#define 	C_DIR_DELIMITER '\\'
-#else
-#define 	C_DIR_DELIMITER '/'
-#endif
-
-enum
-{
-	SUSCEPTIBLE = 0,
-	INFECTED = 1,
-	REMOVED = 2
-} hostStatus;
-
-enum
-{
-	TYPE_I = 1,
-	TYPE_II = 2
-} hostType;
-
-enum
-{
-	KERNEL_I = 1,		/* exponential power */
-	KERNEL_II = 2		/* flat (for testing) */
-} kernelType;
-
-enum
-{
-	DUMP_GENS = 1,
-	DUMP_TIMES = 2
-} dumpType;
-
-enum
-{
-	MODEL_SIS = 1,
-	MODEL_SIR = 2
-} modelType;
-
-typedef struct {
-	double	dThetaOne;		/* Infectivity */
-	double	dThetaTwo;
-	double	dRhoOne;		/* Susceptibility */
-	double	dRhoTwo;
-	double	dMuOne;			/* Death rate */
-	double	dMuTwo;
-	int		nInitOne;		/* Numbers of initial infections */
-	int		nInitTwo;
-	int		bCacheKernel;	/* Whether or not to store the kernel in memory */
-	int		eKernelType;	/* What sort of kernel */
-	double	dA;				/* Exponential-power kernel */
-	double	dC;
-	int		nNumIts;		/* Number of iterations to run */
-	int		nMaxGen;		/* Make infection rate = 0 after this many generations */
-	int		eModelType;		/* Whether SIS or SIR model */
-	char	sXYFile[_MAX_STR_LEN];
-	char	sOutFile[_MAX_STR_LEN];
-	char	sParamDumpFile[_MAX_STR_LEN];
-	double	dMaxTime;
-	int		eDumpType;
-	int		bDumpHostStatus;
-} t_Params;
-
-typedef struct {
-	double	dX;
-	double	dY;
-	int		eType;
-} t_SingleHost;
-
-typedef struct {
-	t_SingleHost	*aHosts;
-	int				nHosts;
-	int				nAlloc;
-} t_Hosts;
-
-typedef struct {
-	int		eStatus;
-	double	dRate;
-	int		nGen;
-	int		nEntryPtr;	/*  only for infected hosts, store where the
-							relevant entry is in the epidemicEntryList */
-} t_HostStatus;
-
-typedef struct {
-	int		nGen;
-	double	dInfectTime;
-	double	dRemovalTime;
-	int		nHostID;
-	int		eType;
-} t_EpidemicEntry;
-
-typedef struct {
-	t_EpidemicEntry *aEntries;
-	int				nEntries;
-	int				nAlloc;
-} t_Epidemic;
-
-typedef struct {
-	double	*aKernel;	/* stored as a flattened array */
-} t_Kernel;
-
-/*
-	seed random number generator
-*/
-void	seedRandom(unsigned long ulnSeed)
-{
-	unsigned long		myPID;
-
-	if (ulnSeed <= 0)
-	{
-		ulnSeed = (unsigned long)time(NULL);
-#ifndef _WIN32	/* make sure different processes started at same time have different seeds */
-		myPID = (unsigned long)getpid();
-#else
-		myPID = (unsigned long)_getpid();
-#endif
-		ulnSeed += myPID;
-	}
-	init_genrand(ulnSeed);
-}
-
-/* work out configuration file name and check whether it exists */
-int	getCfgFileName(char *szProgName, char *szCfgFile)
-{
-	char	*pPtr;
-	FILE 	*fp;
-	char	szDir[_MAX_STR_LEN];
-
-	szCfgFile[0] = '\0';
-	{
-		if ((pPtr = strrchr(szProgName, C_DIR_DELIMITER)) != NULL)
-		{
-			strcpy(szCfgFile, pPtr + 1);
-		}
-		else
-		{
-			strcpy(szCfgFile, szProgName);
-		}
-		if ((pPtr = strstr(szCfgFile, ".exe")) != NULL)
-		{
-			*pPtr = '\0';
-		}
-		strcat(szCfgFile, ".cfg");
-	}
-	/* check file exists */
-	fp = fopen(szCfgFile, "rb");
-	if (fp)
-	{
-		fclose(fp);
-		return 1;
-	}
-	getcwd(szDir, _MAX_STR_LEN);
-	fprintf(stderr, "Did not find config file %s in %s\n", szCfgFile, szDir);
-	return 0;
-}
-
-/*
-(rather slow)
-
-routines to find values from the command line options,
-or, failing that, from the cfg file
-*/
-int findKey(int argc, char **argv, char*szCfgFile, char *szKey, char *szValue)
-{
-	char *pVal;
-	int	 bRet, i;
-	FILE *fp;
-	char *pThisPair;
-	char *szArgvCopy;
-
-	bRet = 0;
-	i = 0;
-	/* try to find the relevant key on the command line */
-	while (bRet == 0 && i<argc)
-	{
-		szArgvCopy = strdup(argv[i]);
-		if (szArgvCopy)
-		{
-			pThisPair = strtok(szArgvCopy, " \t");
-			while (pThisPair)
-			{
-				if (strncmp(pThisPair, szKey, strlen(szKey)) == 0)
-				{
-					pVal = strchr(pThisPair, '=');
-					if (pVal)
-					{
-						if (pThisPair[strlen(szKey)] == '=') /* check full string matches the key */
-						{
-							strcpy(szValue, pVal + 1);
-							fprintf(stdout, "extracted %s->%s from command line\n", szKey, szValue);
-							bRet = 1;
-						}
-					}
-				}
-				pThisPair = strtok(NULL, " \t");
-			}
-			free(szArgvCopy);
-		}
-		i++;
-	}
-	/* otherwise, look in the cfg file */
-	if (bRet == 0)
-	{
-		fp = fopen(szCfgFile, "rb");
-		if (fp)
-		{
-			char szLine[_MAX_STR_LEN];
-
-			while (!bRet && fgets(szLine, _MAX_STR_LEN, fp))
-			{
-				char *pPtr;
-				if ((pPtr = strchr(szLine, '=')) != NULL)
-				{
-					*pPtr = '\0';
-					if (strcmp(szKey, szLine) == 0)
-					{
-						strcpy(szValue, pPtr + 1);
-						/* strip off newline (if any) */
-						if ((pPtr = strpbrk(szValue, "\r\n")) != NULL)
-							*pPtr = '\0';
-						bRet = 1;
-					}
-				}
-			}
-			fclose(fp);
-		}
-	}
-	return bRet;
-}
-
-int readStringFromCfg(int argc, char **argv, char *szCfgFile, char *szKey, char *szValue)
-{
-	return(findKey(argc, argv, szCfgFile, szKey, szValue));
-}
-
-int readDoubleFromCfg(int argc, char **argv, char *szCfgFile, char *szKey, double *pdValue)
-{
-	char szValue[_MAX_STR_LEN];
-
-	if (findKey(argc, argv, szCfgFile, szKey, szValue))
-	{
-		*pdValue = atof(szValue);
-		return 1;
-	}
-	return 0;
-}
-
-int readIntFromCfg(int argc, char **argv, char *szCfgFile, char *szKey, int *pnValue)
-{
-	char szValue[_MAX_STR_LEN];
-
-	if (findKey(argc, argv, szCfgFile, szKey, szValue))
-	{
-		*pnValue = atoi(szValue);
-		return 1;
-	}
-	return 0;
-}
-
-/*
-	return uniform number on [0,1)
-*/
-double	uniformRandom()
-{
-	return genrand_real3();
-}
-
-/*
-	position in the flattened array for a pair of hosts
-*/
-int	posFromHostIDs(int idOne, int idTwo, int numHosts)
-{
-	return idOne + numHosts*idTwo;
-}
-
-/*
-	Logarithmic gamma function using the algorithm from Numerical Recipes
-*/ 
-double logGamma(double x) 
-{
-
-	int				i;
-	double			a, b, t, s;
-	static double	c[6] = { 76.18009172947146,
-							-86.50532032941677,
-							24.01409824083091,
-							-1.231739572450155,
-							0.1208650973866179e-2,
-							-0.5395239384953e-5};
-	
-	b = a = x;
-	t = a + 5.5;
-	t -= (a + 0.5) * log(t);
-	s = 1.000000000190015;
-	for (i = 0; i <= 5; i++)
-	{
-		s += c[i] / ++b;
-	}
-
-	return -t + log(2.5066282746310005 * s / a);
-}
-
-double simpleGammaFunction(double x)
-{
-	double retVal;
-	
-	retVal = exp(logGamma(x));
-	return retVal;
-}
-
-/*
-	dispersal kernel
-*/
-double dispKernel(double r, double alpha, double c, int eKernelType)
-{
-	double dK;
-	double dExp;
-
-	dK = 1.0;
-	if (eKernelType == KERNEL_I)
-	{
-		dExp = pow(r / alpha, c);
-		dK = c * exp(-dExp) / (2.0 * _PI * alpha * alpha * simpleGammaFunction(2.0 / c));
-	}
-	return dK;
-}
-
-/*
-	read in parameters (will alter to read in from cfg file)
-*/
-int setParams(t_Params *pParams)
-{
-	pParams->dThetaOne = 0.1;			/* infectivity of a type 1 host */
-	pParams->dThetaTwo = 0.05;			/* infectivity of a type 2 host */
-	pParams->dRhoOne = 0.05;			/* susceptibility of a type 1 host  */
-	pParams->dRhoTwo = 0.05;			/* susceptibility of a type 2 host  */
-	pParams->dMuOne = 2.5;				/* death rate of a type 1 host  */
-	pParams->dMuTwo = 1.0;				/* death rate of a type 2 host  */
-	pParams->nInitOne = 1;				/* initial number of type 1 infections */
-	pParams->nInitTwo = 1;				/* initial number of type 2 infections */
-	pParams->bCacheKernel = 1;			/* kernel parameters */
-	pParams->eKernelType = KERNEL_I;	/* exponential power kernel */
-	pParams->dA = 0.5;					/* scale */
-	pParams->dC = 1.0;					/* power */
-	pParams->nNumIts = 100;
-	/* in this generation the infection rate is artificially set to zero */
-	pParams->nMaxGen = 3;//5;
-	strcpy(pParams->sXYFile, "finalExampleLS_xy.csv");
-	strcpy(pParams->sOutFile, "finalExampleLS_Epidemics_Eg5_1.csv");
-	pParams->dMaxTime = 20.0;
-	pParams->eDumpType = DUMP_GENS;
-	return 1;
-}
-
-int dumpParametersToCSV(t_Params *pParams)
-{
-	FILE *fOut;
-
-	fOut = fopen(pParams->sParamDumpFile, "wb");
-	if (!fOut)
-	{
-		fprintf(stderr, "dumpParametersToCSV(): could not open file\n");
-		return 0;
-	}
-	fprintf(fOut, "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n",
-		"thetaOne",
-		"thetaTwo",
-		"rhoOne",
-		"rhoTwo",
-		"muOne",
-		"muTwo",
-		"initOne",
-		"initTwo",
-		"kernelType",
-		"dispA",
-		"dispC",
-		"numIts",
-		"maxGen",
-		"xyFile",
-		"modelType");
-	fprintf(fOut, "%.7f,%.7f,%.7f,%.7f,%.7f,%.7f,%d,%d,%d,%.7f,%.7f,%d,%d,%s,%d\n",
-		pParams->dThetaOne,
-		pParams->dThetaTwo,
-		pParams->dRhoOne,
-		pParams->dRhoTwo,
-		pParams->dMuOne,
-		pParams->dMuTwo,
-		pParams->nInitOne,
-		pParams->nInitTwo,
-		pParams->eKernelType,
-		pParams->dA,
-		pParams->dC,
-		pParams->nNumIts,
-		pParams->nMaxGen,
-		pParams->sXYFile,
-		pParams->eModelType);
-	fclose(fOut);
-	return 1;
-}
-
-int readParams(t_Params *pParams, int argc, char **argv)
-{
-	char szCfgFile[_MAX_STR_LEN];
-
-	fprintf(stdout, "readParams()\n");
-	memset(pParams, 0, sizeof(t_Params));
-	pParams->bCacheKernel = 1;			/* kernel parameters */
-	pParams->eDumpType = DUMP_GENS;		/* dump out generations only */
-	pParams->dMaxTime = -1;
-	if (!getCfgFileName(argv[0], szCfgFile))
-	{
-		fprintf(stderr, "readParams(): Couldn't find cfg file for program name '%s'\n", argv[0]);
-		return 0;
-	}
-	if (!readDoubleFromCfg(argc, argv, szCfgFile, "thetaOne", &pParams->dThetaOne))
-	{
-		fprintf(stderr, "readParams(): Couldn't read thetaOne\n");
-		return 0;
-	}
-	if (!readDoubleFromCfg(argc, argv, szCfgFile, "thetaTwo", &pParams->dThetaTwo))
-	{
-		fprintf(stderr, "readParams(): Couldn't read thetaTwo\n");
-		return 0;
-	}
-	if (!readDoubleFromCfg(argc, argv, szCfgFile, "rhoOne", &pParams->dRhoOne))
-	{
-		fprintf(stderr, "readParams(): Couldn't read rhoOne\n");
-		return 0;
-	}
-	if (!readDoubleFromCfg(argc, argv, szCfgFile, "rhoTwo", &pParams->dRhoTwo))
-	{
-		fprintf(stderr, "readParams(): Couldn't read rhoTwo\n");
-		return 0;
-	}
-	if (!readDoubleFromCfg(argc, argv, szCfgFile, "muOne", &pParams->dMuOne))
-	{
-		fprintf(stderr, "readParams(): Couldn't read muOne\n");
-		return 0;
-	}
-	if (!readDoubleFromCfg(argc, argv, szCfgFile, "muTwo", &pParams->dMuTwo))
-	{
-		fprintf(stderr, "readParams(): Couldn't read muTwo\n");
-		return 0;
-	}
-	if (!readIntFromCfg(argc, argv, szCfgFile, "initOne", &pParams->nInitOne))
-	{
-		fprintf(stderr, "readParams(): Couldn't read initOne\n");
-		return 0;
-	}
-	if (!readIntFromCfg(argc, argv, szCfgFile, "initTwo", &pParams->nInitTwo))
-	{
-		fprintf(stderr, "readParams(): Couldn't read initTwo\n");
-		return 0;
-	}
-	if (!readIntFromCfg(argc, argv, szCfgFile, "kernelType", &pParams->eKernelType))
-	{
-		fprintf(stderr, "readParams(): Couldn't read kernelType\n");
-		return 0;
-	}
-	if (!(pParams->eKernelType == KERNEL_I || pParams->eKernelType == KERNEL_II))
-	{
-		fprintf(stderr, "readParams(): Invalid kernelType (must be %d or %d)\n", KERNEL_I, KERNEL_II);
-		return 0;
-	}
-	if (!readDoubleFromCfg(argc, argv, szCfgFile, "dispA", &pParams->dA))
-	{
-		fprintf(stderr, "readParams(): Couldn't read dispA\n");
-		return 0;
-	}
-	if (!readDoubleFromCfg(argc, argv, szCfgFile, "dispC", &pParams->dC))
-	{
-		fprintf(stderr, "readParams(): Couldn't read dispC\n");
-		return 0;
-	}
-	if (!readIntFromCfg(argc, argv, szCfgFile, "numIts", &pParams->nNumIts))
-	{
-		fprintf(stderr, "readParams(): Couldn't read numIts\n");
-		return 0;
-	}
-	if (!readIntFromCfg(argc, argv, szCfgFile, "maxGen", &pParams->nMaxGen))
-	{
-		fprintf(stdout, "readParams(): Couldn't read maxGen\n");
-		return 0;
-	}
-	if (!readStringFromCfg(argc, argv, szCfgFile, "xyFile", pParams->sXYFile))
-	{
-		fprintf(stdout, "readParams(): Couldn't read xyFile\n");
-		return 0;
-	}
-	if (!readStringFromCfg(argc, argv, szCfgFile, "outFile", pParams->sOutFile))
-	{
-		fprintf(stderr, "readParams(): Couldn't read outFile\n");
-		return 0;
-	}
-	/* model type: SIS (default) or SIR: this field is not required in config file */
-	pParams->eModelType = MODEL_SIS;
-	readIntFromCfg(argc, argv, szCfgFile, "modelType", &pParams->eModelType);
-	if (!(pParams->eModelType == MODEL_SIS || pParams->eModelType == MODEL_SIR))
-	{
-		fprintf(stderr, "readParams(): Invalid modelType (must be %d or %d)\n", MODEL_SIS, MODEL_SIR);
-		return 0;
-	}
-	/* whether or not to dump information on host status...note is not required */
-	pParams->bDumpHostStatus = 0;
-	readIntFromCfg(argc, argv, szCfgFile, "dumpHostStatus", &pParams->bDumpHostStatus);
-	/* create filename for dump of all parameters and actually do the dump */
-	{
-		char *sTmp, *p;
-
-		sTmp = strdup(pParams->sOutFile);
-		if (!sTmp)
-		{
-			fprintf(stderr, "readParams(): Out of memory\n");
-			return 0;
-		}
-		/* strip any extension */
-		if (p = strrchr(sTmp, '.'))
-		{
-			*p = '\0';
-		}
-		sprintf(pParams->sParamDumpFile, "%s_param.csv", sTmp);
-		free(sTmp);
-	}
-	return dumpParametersToCSV(pParams);
-}
-
-/*
-	calculate and store the dispersal kernel
-*/
-int calcKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
-{
-	int		p,i,j,retVal;
-	double	d,k;
-
-	retVal = 1;
-	if (pParams->bCacheKernel)
-	{
-		retVal = 0;
-		pKernel->aKernel = malloc(sizeof(double)*pHosts->nHosts*pHosts->nHosts);
-		if (pKernel->aKernel)
-		{
-			/*
-				set kernel between pairs of hosts
-				note copies top triangle to the bottom rather than recalculating
-			*/
-			for (i = 0; i < pHosts->nHosts; i++)
-			{
-				for (j = 0; j < i; j++)
-				{
-					d = pow(pHosts->aHosts[i].dX - pHosts->aHosts[j].dX, 2);
-					d += pow(pHosts->aHosts[i].dY - pHosts->aHosts[j].dY, 2);
-					d = sqrt(d);
-					k = dispKernel(d, pParams->dA, pParams->dC, pParams->eKernelType);
-					p = posFromHostIDs(i, j, pHosts->nHosts);
-					pKernel->aKernel[p] = k;
-					p = posFromHostIDs(j, i, pHosts->nHosts);
-					pKernel->aKernel[p] = k;
-					//fprintf(stdout, "%d %d %d %.5f %.5f\n", i, j, p, d, k);
-				}
-			}
-			/* set kernel from a single host onto itself to be zero */
-			for (i = 0; i < pHosts->nHosts; i++)
-			{
-				p = posFromHostIDs(i, i, pHosts->nHosts);
-				pKernel->aKernel[p] = 0.0;
-			}
-			fprintf(stdout, "Set up kernel\n");
-			retVal = 1;
-		}
-	}
-	else
-	{
-		pKernel->aKernel = NULL;
-	}
-	return retVal;
-}
-
-/*
-	read in host locations and types
-*/
-int loadHosts(t_Params *pParams, t_Hosts *pHosts)
-{
-	int		retVal,tokNum;
-	FILE	*f;
-	char	sBuff[_MAX_STR_LEN];
-	char	*p;
-
-	retVal = 0;
-	pHosts->nHosts = 0;
-	f = fopen(pParams->sXYFile, "rb");
-	if (f)
-	{
-		/* discard the first line, which is just a header */
-		fgets(sBuff, _MAX_STR_LEN, f);
-		retVal = 1;
-		/* loop around reading and parsing the rest of the file */
-		while (retVal && fgets(sBuff, _MAX_STR_LEN, f))
-		{
-			if (pHosts->nAlloc == pHosts->nHosts)
-			{
-				pHosts->nAlloc += _BLOCK_SIZE;
-				pHosts->aHosts = realloc(pHosts->aHosts, sizeof(t_SingleHost)* pHosts->nAlloc);
-				if (!pHosts->aHosts)
-				{
-					retVal = 0;
-				}
-			}
-			if (retVal)
-			{
-				tokNum = 0;
-				p = strtok(sBuff, _STR_SEP);
-				while (p)
-				{
-					switch (tokNum)
-					{
-					case 0:
-						pHosts->aHosts[pHosts->nHosts].dX = atof(p);
-						break;
-					case 1:
-						pHosts->aHosts[pHosts->nHosts].dY = atof(p);
-						break;
-					case 2:
-						pHosts->aHosts[pHosts->nHosts].eType = atoi(p);
-						if (!(pHosts->aHosts[pHosts->nHosts].eType == TYPE_I
-								|| pHosts->aHosts[pHosts->nHosts].eType == TYPE_II))
-						{
-							/* invalid host type */
-							retVal = 0;
-						}
-						pHosts->nHosts++;
-						break;
-					default:
-						retVal = 0;
-						break;
-					}
-					tokNum++;
-					p = strtok(NULL, _STR_SEP);
-				}
-				if(tokNum != 3) /* after the while loop, tokNum should be one larger than the number of tokens per line */
-				{
-					retVal = 0;
-				}
-			}
-		}
-		fclose(f);
-	}
-	fprintf(stdout, "Read in %d hosts\n", pHosts->nHosts);
-	return (pHosts->nHosts > 0);
-}
-
-double getKernel(int hostOne, int hostTwo, t_Kernel *pKernel, t_Hosts *pHosts, t_Params *pParams)
-{
-	int		p;
-	double	dKernel;
-
-	if (pParams->bCacheKernel)
-	{
-		p = posFromHostIDs(hostOne, hostTwo, pHosts->nHosts);
-		dKernel = pKernel->aKernel[p];
-	}
-	else
-	{
-		fprintf(stderr, "Not yet implemented!\n");
-		dKernel = _NOT_SET;
-	}
-	return dKernel;
-}
-
-int recoverHost(int thisHost, double thisTime, t_Epidemic *pEpidemic, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_HostStatus *aHostStatus, double *pTotalRate)
-{
-	int		i, retVal;
-	double	thisTheta, thisRho, thisExtra;
-
-	retVal = 1;
-	if (pHosts->aHosts[thisHost].eType == TYPE_I)
-	{
-		*pTotalRate -= pParams->dMuOne;
-		thisTheta = pParams->dThetaOne;
-	}
-	else
-	{
-		*pTotalRate -= pParams->dMuTwo;
-		thisTheta = pParams->dThetaTwo;
-	}
-	/* update susceptible hosts to no longer feel the force of infection from this one */
-	/* note only need to do this when host isn't so old that not infecting anyway */
-	if (aHostStatus[thisHost].nGen < pParams->nMaxGen)
-	{
-		for (i = 0; i < pHosts->nHosts; i++)
-		{
-			if (aHostStatus[i].eStatus == SUSCEPTIBLE)
-			{
-				thisRho = pParams->dRhoOne;
-				if (pHosts->aHosts[i].eType == TYPE_II)
-				{
-					thisRho = pParams->dRhoTwo;
-				}
-				thisExtra = thisTheta * thisRho * getKernel(i, thisHost, pKernel, pHosts, pParams);
-				aHostStatus[i].dRate -= thisExtra;
-				if (aHostStatus[i].dRate < 0.0)
-				{
-					aHostStatus[i].dRate = 0.0;
-				}
-				*pTotalRate -= thisExtra;
-			}
-		}
-	}
-	pEpidemic->aEntries[aHostStatus[thisHost].nEntryPtr].dRemovalTime = thisTime;
-
-	if (pParams->eModelType == MODEL_SIS)
-	{
-		aHostStatus[thisHost].eStatus = SUSCEPTIBLE;
-		aHostStatus[thisHost].dRate = 0.0;
-
-		/* loop around and add force back onto this one from all infected hosts */
-		thisRho = pParams->dRhoOne;
-		if (pHosts->aHosts[thisHost].eType == TYPE_II)
-		{
-			thisRho = pParams->dRhoTwo;
-		}
-		for (i = 0; i < pHosts->nHosts; i++)
-		{
-			if (aHostStatus[i].eStatus == INFECTED && aHostStatus[i].nGen < pParams->nMaxGen)
-			{
-				thisTheta = pParams->dThetaOne;
-				if (pHosts->aHosts[i].eType == TYPE_II)
-				{
-					thisTheta = pParams->dThetaTwo;
-				}
-				thisExtra = thisTheta * thisRho * getKernel(i, thisHost, pKernel, pHosts, pParams);
-				aHostStatus[thisHost].dRate += thisExtra;
-				*pTotalRate += thisExtra;
-			}
-		}
-	}
-	else
-	{
-		aHostStatus[thisHost].eStatus = REMOVED;
-		aHostStatus[thisHost].dRate = 0.0;
-	}
-	if (*pTotalRate < 0.0)
-	{
-		*pTotalRate = 0.0;
-	}
-	return retVal;
-}
-
-int infectHost(int thisHost, double thisTime, int infectedBy, t_Epidemic *pEpidemic, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_HostStatus *aHostStatus, double *pTotalRate)
-{
-	int			retVal,i,thisGen;
-	double		thisTheta,thisRho,thisExtra;
-
-	retVal = 1;
-
-	/* update this host's status */
-	if (infectedBy >= 0)
-	{
-		thisGen = aHostStatus[infectedBy].nGen + 1;
-	}
-	else
-	{
-		thisGen = 0;
-	}
-	aHostStatus[thisHost].nGen = thisGen;
-	*pTotalRate -= aHostStatus[thisHost].dRate;
-	aHostStatus[thisHost].nGen = thisGen;
-	if (pHosts->aHosts[thisHost].eType == TYPE_I)
-	{
-		aHostStatus[thisHost].dRate = pParams->dMuOne;
-		thisTheta = pParams->dThetaOne;
-	}
-	else
-	{
-		aHostStatus[thisHost].dRate = pParams->dMuTwo;
-		thisTheta = pParams->dThetaTwo;
-	}
-	if (thisGen >= pParams->nMaxGen)
-	{
-		thisTheta = 0.0;	/* artificially stop infections once too many generations have passed */
-	}
-	*pTotalRate += aHostStatus[thisHost].dRate;
-	aHostStatus[thisHost].eStatus = INFECTED;
-	/* update susceptible hosts to feel the new force of infection from this one */
-	for (i = 0; i < pHosts->nHosts; i++)
-	{
-		if (aHostStatus[i].eStatus == SUSCEPTIBLE)
-		{
-			thisRho = pParams->dRhoOne;
-			if (pHosts->aHosts[i].eType == TYPE_II)
-			{
-				thisRho = pParams->dRhoTwo;
-			}
-			thisExtra = thisTheta * thisRho * getKernel(i, thisHost, pKernel, pHosts, pParams);
-			aHostStatus[i].dRate += thisExtra;
-			*pTotalRate += thisExtra;
-		}
-	}
-	/* update the epidemic information */
-	if (pEpidemic->nAlloc == pEpidemic->nEntries)
-	{
-		pEpidemic->nAlloc += _BLOCK_SIZE;
-		pEpidemic->aEntries = realloc(pEpidemic->aEntries, sizeof(t_EpidemicEntry)* pEpidemic->nAlloc);
-		if (!pEpidemic->aEntries)
-		{
-			retVal = 0;
-		}
-	}
-	if (retVal)
-	{
-		pEpidemic->aEntries[pEpidemic->nEntries].nGen = thisGen;
-		pEpidemic->aEntries[pEpidemic->nEntries].dInfectTime = thisTime;
-		pEpidemic->aEntries[pEpidemic->nEntries].eType = pHosts->aHosts[thisHost].eType;
-		pEpidemic->aEntries[pEpidemic->nEntries].nHostID = thisHost;
-		pEpidemic->aEntries[pEpidemic->nEntries].dRemovalTime = _NOT_SET;
-		aHostStatus[thisHost].nEntryPtr = pEpidemic->nEntries;
-		pEpidemic->nEntries++;
-	}
-	return retVal;
-}
-
-int initEpidemic(t_Epidemic *pEpidemic, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_HostStatus *aHostStatus, double *pTotalRate, int epiID)
-{
-	int retVal, i, t, numToDo, validHosts, thisHost, j;
-	int *aHosts;
-
-	fprintf(stdout, "Initialising epidemic %d\n", epiID);
-	memset(pEpidemic, 0, sizeof(t_Epidemic));
-	*pTotalRate = 0.0;
-	retVal = 1;
-	/* initialise all host status */
-	for (i = 0; i < pHosts->nHosts; i++)
-	{
-		aHostStatus[i].nGen = _NOT_SET;
-		aHostStatus[i].dRate = 0.0;
-		aHostStatus[i].eStatus = SUSCEPTIBLE;
-	}
-	/* do initial infections */
-	t = TYPE_I;
-	while (retVal && t <= TYPE_II)
-	{
-		numToDo = pParams->nInitOne;
-		if (t == TYPE_II)
-		{
-			numToDo = pParams->nInitTwo;
-		}
-		if(numToDo > 0)
-		{
-			validHosts = 0;
-			if (aHosts = malloc(sizeof(int)*pHosts->nHosts))
-			{
-				for (i = 0; i < pHosts->nHosts; i++)
-				{
-					if (pHosts->aHosts[i].eType == t)
-					{
-						aHosts[validHosts] = i;
-						validHosts++;
-					}
-				}
-				if (validHosts >= numToDo)
-				{
-					i = 0;
-					while(retVal && i < numToDo)
-					{
-						thisHost = (int) floor(validHosts*uniformRandom());
-						retVal = infectHost(aHosts[thisHost],0.0,_NOT_SET,pEpidemic, pParams, pHosts, pKernel, aHostStatus, pTotalRate);
-						if (retVal)
-						{
-							/* shift the other hosts down one in place to stop a single host being picked twice */
-							validHosts--;
-							for (j = thisHost; j < validHosts; j++)
-							{
-								aHosts[j] = aHosts[j + 1]; /* won't run off the end since have already decremented validHosts */
-							}
-						}
-						i++;
-					}
-				}
-				else
-				{
-					retVal = 0;
-				}
-			}
-			else
-			{
-				retVal = 0;
-			}
-		}
-		t++;
-	}
-	return retVal;
-}
-
-/*
-	debugging function: check all rates are correct given the state
-*/
-void	checkRates(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_HostStatus *aHostStatus)
-{
-	int			i, j;
-	double		cacheRate, recalcRate, thisTheta, thisRho;
-
-	for (i = 0; i < pHosts->nHosts; i++)
-	{
-		cacheRate = aHostStatus[i].dRate;
-		recalcRate = _NOT_SET;
-		if (aHostStatus[i].eStatus == INFECTED)
-		{
-			if (pHosts->aHosts[i].eType == TYPE_I)
-			{
-				recalcRate = pParams->dMuOne;
-			}
-			else
-			{
-				recalcRate = pParams->dMuTwo;
-			}
-		}
-		else
-		{
-			recalcRate = 0.0;
-			thisRho = pParams->dRhoOne;
-			if (pHosts->aHosts[i].eType == TYPE_II)
-			{
-				thisRho = pParams->dRhoTwo;
-			}
-			for (j = 0; j < pHosts->nHosts; j++)
-			{
-				if (aHostStatus[j].eStatus == INFECTED)
-				{
-					thisTheta = pParams->dThetaOne;
-					if (pHosts->aHosts[j].eType == TYPE_II)
-					{
-						thisTheta = pParams->dThetaTwo;
-					}
-					if (aHostStatus[j].nGen >= pParams->nMaxGen)
-					{
-						thisTheta = 0.0;	/* artificially stop infections once too many generations have passed */
-					}
-					recalcRate += thisTheta * thisRho * getKernel(i, j, pKernel, pHosts, pParams);
-				}
-			}
-		}
-		if (fabs(cacheRate - recalcRate) > 1e-5)
-		{
-			fprintf(stdout, "%d %f %f\n", i, cacheRate, recalcRate);
-		}
-	}
-}
-
-void dumpEpidemic(t_Params *pParams, t_Hosts *pHosts, t_Epidemic *pEpidemic, FILE *fOut, int itNum, double maxTime)
-{
-	int  i,j;
-	char sTmp[_MAX_STR_LEN];
-
-	/* information on a generation by generation basis */
-	if (pParams->eDumpType == DUMP_GENS)
-	{
-		int *aTypeOneByGen, *aTypeTwoByGen;
-		int g;
-
-		aTypeOneByGen = malloc(sizeof(int)*(pParams->nMaxGen + 1));
-		if (aTypeOneByGen)
-		{
-			aTypeTwoByGen = malloc(sizeof(int)*(pParams->nMaxGen + 1));
-			if (aTypeTwoByGen)
-			{
-#ifdef _ONE_LINE_GEN_OUT
-				if (itNum == 0)
-				{
-					fprintf(fOut, "<it>");
-				}
-				for (g = 0; g <= pParams->nMaxGen; g++)
-				{
-					if (itNum == 0)
-					{
-						sprintf(sTmp, ",I_1(%d),I_2(%d)", g, g);
-						fprintf(fOut, sTmp);
-					}
-					if (g > 0)
-					{
-						fprintf(stdout, "\t");
-					}
-					sprintf(sTmp, "I_1(%d)\tI_2(%d)", g, g);
-					fprintf(stdout, sTmp);
-				}
-				if (itNum == 0)
-				{
-					fprintf(fOut, "\n");
-				}
-				fprintf(stdout, "\n");
-				fprintf(fOut, "%d", itNum);
-#else
-				if (itNum == 0)
-				{
-					fprintf(fOut, "<it>,<gen>,<n1>,<n2>,<n1+n2>\n");
-				}
-				fprintf(stdout, "<gen>\t<n1>\t<n2>\t<n1+n2>\n");
-#endif
-				for (g = 0; g <= pParams->nMaxGen; g++)
-				{
-					aTypeOneByGen[g] = aTypeTwoByGen[g] = 0;
-					for (j = 0; j < pEpidemic->nEntries; j++)
-					{
-						if (pEpidemic->aEntries[j].nGen == g)
-						{
-							if (pEpidemic->aEntries[j].eType == TYPE_I)
-							{
-								aTypeOneByGen[g]++;
-							}
-							else
-							{
-								aTypeTwoByGen[g]++;
-							}
-						}
-					}
-#ifdef _ONE_LINE_GEN_OUT
-					if (g)
-					{
-						fprintf(stdout, "\t");
-					}
-					fprintf(stdout, "%d\t%d", aTypeOneByGen[g], aTypeTwoByGen[g]);
-					fprintf(fOut, ",%d,%d", aTypeOneByGen[g], aTypeTwoByGen[g]);
-#else
-					fprintf(stdout, "%d\t%d\t%d\t%d\n", g, aTypeOneByGen[g], aTypeTwoByGen[g], aTypeOneByGen[g] + aTypeTwoByGen[g]);
-					fprintf(fOut, "%d,%d,%d,%d,%d\n", itNum, g, aTypeOneByGen[g], aTypeTwoByGen[g], aTypeOneByGen[g] + aTypeTwoByGen[g]);
-#endif
-				}
-#ifdef _ONE_LINE_GEN_OUT
-				fprintf(stdout, "\n");
-				fprintf(fOut, "\n");
-#endif
-				free(aTypeTwoByGen);
-			}
-			free(aTypeOneByGen);
-		}
-	}
-	/* information on a generation by generation basis */
-	if (pParams->eDumpType == DUMP_TIMES && maxTime > 0.0)
-	{
-		double	dStep,thisTime;
-		double	aT[N_DUMP_STEPS + 1];
-		int		aTypeOneInf[N_DUMP_STEPS + 1];
-		int		aTypeTwoInf[N_DUMP_STEPS + 1];
-
-		if (itNum == 0)
-		{
-			fprintf(fOut, "<it>,<dT>,<n1>,<n2>,<n1+n2>\n");
-		}
-		fprintf(stdout, "<dT>\t<n1>\t<n2>\t<n1+n2>\n");
-		dStep = maxTime / N_DUMP_STEPS;
-		for (j = 0; j <= N_DUMP_STEPS; j++)
-		{
-			thisTime = j*dStep;
-			aT[j] = thisTime;
-			aTypeOneInf[j] = 0;
-			aTypeTwoInf[j] = 0;
-			for (i = 0; i < pEpidemic->nEntries; i++)
-			{
-				if (pEpidemic->aEntries[i].dInfectTime <= thisTime
-					&& (pEpidemic->aEntries[i].dRemovalTime < 0 || pEpidemic->aEntries[i].dRemovalTime > thisTime))
-				{
-					if (pEpidemic->aEntries[i].eType == TYPE_I)
-					{
-						aTypeOneInf[j]++;
-					}
-					else
-					{
-						aTypeTwoInf[j]++;
-					}
-				}
-			}
-			fprintf(stdout, "%f\t%d\t%d\t%d\n", aT[j], aTypeOneInf[j], aTypeTwoInf[j], aTypeOneInf[j]+aTypeTwoInf[j]);
-			fprintf(fOut, "%d,%f,%d,%d,%d\n", itNum, aT[j], aTypeOneInf[j], aTypeTwoInf[j], aTypeOneInf[j] + aTypeTwoInf[j]);
-		}
-	}
-	if (pParams->bDumpHostStatus)
-	{
-		char	sDummy[_MAX_STR_LEN],sOutFile[_MAX_STR_LEN];
-		char	*pPtr;
-		FILE	*fIt;
-		int		bInf,nGen;
-		double	tI, tR;
-
-		strcpy(sDummy, pParams->sOutFile);
-		pPtr = strrchr(sDummy, '.');
-		if (pPtr)
-		{
-			*pPtr = '\0';
-		}
-		sprintf(sOutFile, "%s_it=%d.csv", sDummy, itNum);
-		fIt = fopen(sOutFile, "wb");
-		if (fIt)
-		{
-			fprintf(fIt, "hostID,hostX,hostY,hostType,tI,tR,gen\n");
-			for (i = 0; i < pHosts->nHosts; i++)
-			{
-				bInf = 0;
-				j = 0;
-				while (bInf == 0 && (j < pEpidemic->nEntries))
-				{
-					if (pEpidemic->aEntries[j].nHostID == i)
-					{
-						bInf = 1;
-						nGen = pEpidemic->aEntries[j].nGen;
-						tI = pEpidemic->aEntries[j].dInfectTime;
-						tR = pEpidemic->aEntries[j].dRemovalTime;
-					}
-					j++;
-				}
-				if (bInf)
-				{
-					fprintf(fIt, "%d,%.4f,%.4f,%d,%.4f,%.4f,%d\n", i, pHosts->aHosts[i].dX, pHosts->aHosts[i].dY, pHosts->aHosts[i].eType, tI, tR, nGen);
-				}
-				else
-				{
-					fprintf(fIt, "%d,%.4f,%.4f,%d,NA,NA,NA\n", i, pHosts->aHosts[i].dX, pHosts->aHosts[i].dY, pHosts->aHosts[i].eType);
-				}
-			}
-			fclose(fIt);
-		}
-	}
-}
-
-/*
-	actually run the epidemics
-*/
-int runEpidemics(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
-{
-	FILE			*fOut;
-	int				*aInfectiveID;
-	double			*aInfectiveRate;
-	int				retVal, i, j, eventHost, infectingHost, numInfectives, nSteps;
-	double			thisExtra, thisTheta, thisRho, runningSum, randDbl, totalRate, timeNow, timeOffset, totalInfectiveRate;
-	t_HostStatus	*hostStatus;
-	t_Epidemic		sEpidemic;
-
-	retVal = 0;
-	fOut = fopen(pParams->sOutFile, "wb");
-	if (fOut)
-	{
-		hostStatus = malloc(sizeof(t_HostStatus) * pHosts->nHosts);
-		if (hostStatus)
-		{
-			aInfectiveID = malloc(sizeof(int) * pHosts->nHosts);
-			if (aInfectiveID)
-			{
-				aInfectiveRate = malloc(sizeof(double) * pHosts->nHosts);
-				if (aInfectiveRate)
-				{
-					retVal = 1;
-					i = 0;
-					while (retVal && i < pParams->nNumIts)
-					{
-						/* initialise epidemic */
-						timeNow = 0.0;
-						retVal = initEpidemic(&sEpidemic, pParams, pHosts, pKernel, hostStatus, &totalRate,i);
-						/* run epidemic */
-						nSteps = 0;
-						while (retVal
-								&& (totalRate > 0.0)
-								&& (pParams->dMaxTime < 0 || timeNow <= pParams->dMaxTime))
-						{
-#if 0
-							/* check rates every 50 steps (used in debugging) */
-							if (nSteps && (nSteps % 50 == 0))
-							{
-								checkRates(pParams, pHosts, pKernel, hostStatus);
-							}
-#endif
-							/* find time of next event and update current time*/
-							randDbl = uniformRandom();
-							while (randDbl <= 0.0)
-							{
-								randDbl = uniformRandom();
-							}
-							timeOffset = -log(randDbl) / totalRate;
-							timeNow = timeNow + timeOffset;
-
-							/* find host that is affected by the event */
-							randDbl = totalRate * uniformRandom();
-							runningSum = 0.0;
-							eventHost = 0;
-							do
-							{
-								runningSum += hostStatus[eventHost].dRate;
-								eventHost++;
-							} while ((runningSum <= randDbl) && (eventHost < pHosts->nHosts));
-							eventHost--;
-
-							/* what happens now depends on whether it is an infection or a recovery */
-							if (hostStatus[eventHost].eStatus == SUSCEPTIBLE)
-							{
-								/* to keep track of generations, need to find which host infected the newly infected one */
-								thisRho = pParams->dRhoOne;
-								if (pHosts->aHosts[eventHost].eType == TYPE_II)
-								{
-									thisRho = pParams->dRhoTwo;
-								}
-								totalInfectiveRate = 0.0;
-								numInfectives = 0;
-								for (j = 0; j < pHosts->nHosts; j++)
-								{
-									if (hostStatus[j].eStatus == INFECTED)
-									{
-										aInfectiveID[numInfectives] = j;
-										thisTheta = pParams->dThetaOne;
-										if (pHosts->aHosts[j].eType == TYPE_II)
-										{
-											thisTheta = pParams->dThetaTwo;
-										}
-										if (hostStatus[j].nGen >= pParams->nMaxGen)
-										{
-											thisTheta = 0.0;	/* artificially stop infections once too many generations have passed */
-										}
-										thisExtra = thisTheta * thisRho * getKernel(j, eventHost, pKernel, pHosts, pParams);
-										aInfectiveRate[numInfectives] = thisExtra;
-										totalInfectiveRate += thisExtra;
-										numInfectives++;
-									}
-								}
-								/* find which infected host caused this infection */
-								randDbl = totalInfectiveRate * uniformRandom();
-								runningSum = 0.0;
-								infectingHost = 0;
-								do
-								{
-									runningSum += aInfectiveRate[infectingHost];
-									infectingHost++;
-								} while ((runningSum <= randDbl) && (infectingHost < numInfectives));
-								infectingHost--;
-								retVal = infectHost(eventHost, timeNow, aInfectiveID[infectingHost], &sEpidemic, pParams, pHosts, pKernel, hostStatus, &totalRate);
-							}
-							else
-							{
-								if (hostStatus[eventHost].eStatus == INFECTED)
-								{
-									retVal = recoverHost(eventHost, timeNow, &sEpidemic, pParams, pHosts, pKernel, hostStatus, &totalRate);
-								}
-								else
-								{
-									fprintf(stderr, "Event triggered by removed host: error\n");
-								}
-							}
-							/*
-								since everything has to recover, which puts quite a high lower bound
-								on the set of admissible rates, this is a signal of numerical error
-								and means the totalRate is really just zero
-							*/
-							if (totalRate <= _NUMERIC_UNDERFLOW)
-							{
-								totalRate = 0.0;
-							}
-#if 0
-							{
-								double d;
-
-								d = 0;
-								for (j = 0; j < pHosts->numHosts; j++)
-								{
-									d += hostStatus[j].rate;
-								}
-								fprintf(stdout, "*** %f %f\n", totalRate, d);
-							}
-#endif
-							nSteps++;
-						}
-						dumpEpidemic(pParams, pHosts, &sEpidemic, fOut, i, pParams->dMaxTime);
-						/* add one to iteration number */
-						i++;
-					}
-					free(aInfectiveRate);
-				}
-				free(aInfectiveID);
-			}
-			free(hostStatus);
-		}
-		fclose(fOut);
-	}
-	return retVal;
-}
-
-void freeMemory(t_Hosts *pHosts, t_Kernel *pKernel)
-{
-	if(pKernel->aKernel)
-	{
-		free(pKernel->aKernel);
-	}
-	if (pHosts->nAlloc && pHosts->aHosts)
-	{
-		free(pHosts->aHosts);
-	}
-}
-
-/*
-	main routine
-*/
-int main(int argc, char **argv)
-{
-	t_Params	sParams;
-	t_Hosts		sHosts;
-	t_Kernel	sKernel;
-	int			retVal;
-
-	memset(&sParams, 0, sizeof(t_Params));
-	memset(&sHosts, 0, sizeof(t_Hosts));
-	memset(&sKernel, 0, sizeof(t_Kernel));
-	seedRandom(0); /* passing zero means it uses combination of time and procID as a seed */
-#if 0
-	if (!setParams(&sParams))
-	{
-		fprintf(stderr, "Error in setParams()\nExiting\n");
-	}
-#endif
-	if (!(retVal = readParams(&sParams, argc, argv)))
-	{
-		fprintf(stderr, "Error in readParams()\nExiting\n");
-	}
-	if (retVal && !(retVal = loadHosts(&sParams, &sHosts)))
-	{
-		fprintf(stderr, "Error in loadHosts()\nExiting\n");
-	}
-	if (retVal && !(retVal = calcKernel(&sParams, &sHosts, &sKernel)))
-	{
-		fprintf(stderr, "Error in calcKernel()\nExiting\n");
-	}
-	if (retVal && !(retVal = runEpidemics(&sParams, &sHosts, &sKernel)))
-	{
-		fprintf(stderr, "Error in runEpidemics()\nExiting\n");
-	}
-	/* free all memory from dynamically allocated structures */
-	freeMemory(&sHosts, &sKernel);
-
-	if (retVal == 0)
-		return(EXIT_FAILURE);
-	return(EXIT_SUCCESS);
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <float.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glob.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+/* MT19937 random number generation */
+#include "mt19937ar.h"
+
+/* reading key=value pairs from the command line and cfg file */
+#include "Config.h"
+
+/* thread pool for batch mode */
+#include "Threads.h"
+
+/* allow Visual Studio to compile ANSI C containing strcpy */
+#pragma warning(disable : 4996)
+
+#define	_MAX_STR_LEN		1024
+#define _BLOCK_SIZE			256
+#define	_PI					3.1415926535897932384626433
+#define	_NOT_SET			-1
+#define N_DUMP_STEPS		100			/* default number of steps if dumping out time courses rather than generations */
+#define	_ONE_LINE_GEN_OUT	1			/* whether or not to put all information for a generation on a single line */
+#define	_HOST_FILE_MAGIC	"EPIHOST1"	/* first eight bytes of a binary host file */
+#define	_KERNEL_FILE_MAGIC	"EPIKERN1"	/* ...of a cached kernel */
+#define	_CHECKPOINT_MAGIC	"EPICKPT2"	/* ...of a checkpoint */
+#define	_CONVERGE_Z			1.959964	/* confidence intervals on R0 are 95% */
+#define	_MAX_SPARSE_HOSTS	256			/* hosts touched before a replicate stops keeping a sorted list of them */
+#define	_MAX_KERNEL_GRID	4096		/* most cells along each side of a grid kernel */
+#define	_MAX_RATE_GROUPS	64			/* infective engine: groups of hosts whose attempt rates are within a factor of two */
+#define	_MAX_LANES			8			/* most replicates run in lockstep by one thread */
+#define	_LANE_WINDOW		16			/* finished replicates per lane held back waiting for an earlier one */
+#define	_EVENT_BLOCK_MIN_HOSTS	20000	/* landscapes this big split the work of each event into blocks... */
+#define	_EVENT_BLOCK_HOSTS	1024		/* ...of this many hosts (or candidate infectors)... */
+#define	_EVENT_BLOCK_CELLS	16			/* ...or, with a grid kernel, cells */
+#define	_HUGE_PAGE_BYTES	(2 * 1024 * 1024)	/* kernels at least this big go in huge pages, if they can */
+#define	_MPOL_INTERLEAVE	3			/* Linux memory policy spreading pages over NUMA nodes in turn */
+#define	_BUDGET_FRACTION	0.8			/* share of the memory available at startup the kernel may have, by default */
+#define	_PLAN_SAMPLE_HOSTS	256			/* hosts whose neighbours are counted to size a sparse kernel */
+#define	_PAIR_NS_DENSE		2.0			/* rough time (ns) per host in an event's pass, with a dense kernel... */
+#define	_PAIR_NS_PACKED		7.0			/* ...a packed one (half of each row is strided)... */
+#define	_PAIR_NS_SPARSE		0.9			/* ...times log2 of the neighbours per host, a sparse one... */
+#define	_PAIR_NS_ON_THE_FLY	13.0		/* ...worked out each time (the exponential power kernel)... */
+#define	_PAIR_NS_TILED		6.0			/* ...or read through the tile cache from a fast disk */
+#define	_TILE_HOSTS			256			/* hosts along each side of a tile of a tiled kernel */
+#define	_TILE_FILE_HEADER_BYTES	4096	/* tiles start this far into the tile file, so are page aligned */
+#define	_TILE_FILE_MAGIC	"EPITILE1"	/* first eight bytes of a tile file */
+#define	_TILE_QUEUE			1024		/* most tiles waiting to be prefetched */
+#define	_MAX_TILE_THREADS	16			/* most prefetch threads */
+#define	_MIN_TILE_SLOTS		4			/* fewest tiles held in memory, whatever the budget */
+
+/* 64 bit file offsets, so checkpoints work for output files over 2GB */
+#ifdef _WIN32
+#define	FTELL64(f)			_ftelli64(f)
+#define	FSEEK64(f,o,w)		_fseeki64(f,o,w)
+#define	FTRUNCATE64(f,o)	_chsize_s(_fileno(f),o)
+#else
+#define	FTELL64(f)			ftello(f)
+#define	FSEEK64(f,o,w)		fseeko(f,o,w)
+#define	FTRUNCATE64(f,o)	ftruncate(fileno(f),o)
+#endif
+
+enum
+{
+	SUSCEPTIBLE = 0,
+	INFECTED = 1,
+	REMOVED = 2
+} hostStatus;
+
+enum
+{
+	TYPE_I = 1,
+	TYPE_II = 2
+} hostType;
+
+enum
+{
+	KERNEL_I = 1,		/* exponential power */
+	KERNEL_II = 2,		/* flat (for testing) */
+	KERNEL_CAUCHY = 3,
+	KERNEL_POWER = 4,	/* power law */
+	KERNEL_GAUSSIAN = 5
+} kernelType;
+
+enum
+{
+	DUMP_GENS = 1,
+	DUMP_TIMES = 2,
+	DUMP_OFFSPRING = 3
+} dumpType;
+
+enum
+{
+	MODEL_SIS = 1,
+	MODEL_SIR = 2
+} modelType;
+
+enum
+{
+	SORT_NONE = 0,
+	SORT_MORTON = 1,	/* Z-order */
+	SORT_HILBERT = 2
+} sortType;
+
+enum
+{
+	ENGINE_HOSTS = 1,		/* rate of every host kept up to date */
+	ENGINE_INFECTIVES = 2	/* infectives fire infection attempts at their kernel rows */
+} engineType;
+
+enum
+{
+	PAGES_NORMAL = 0,		/* kernel in ordinary pages */
+	PAGES_TRANSPARENT = 1,	/* in transparent huge pages, if the system has them turned on */
+	PAGES_RESERVED = 2		/* in the huge pages the system has set aside, else as PAGES_TRANSPARENT */
+} pageType;
+
+enum
+{
+	STORE_AUTO = 0,			/* picked by planKernel() */
+	STORE_DENSE = 1,		/* every pair of hosts, in both orders */
+	STORE_PACKED = 2,		/* each pair once (the kernel is symmetric) */
+	STORE_SINGLE = 3,		/* each pair once, in single precision */
+	STORE_SPARSE = 4,		/* only pairs closer than the distance all but kernelTol of dispersal is within */
+	STORE_ON_THE_FLY = 5,	/* nothing stored, worked out every time */
+	STORE_TILED = 6,		/* dense, but on disk with the tiles in use cached in memory */
+	STORE_EDITED = 7		/* (not a kernelStore setting) an edited landscape's, from its base landscape's (see editKernel()) */
+} kernelStore;
+
+enum
+{
+	EDIT_ADD = 0,			/* a new host */
+	EDIT_REMOVE = 1,		/* a host taken out of the landscape */
+	EDIT_RETYPE = 2			/* a host changed to the other type */
+} hostEditType;
+
+enum
+{
+	LANE_IDLE = 0,			/* no replicate, or nothing happens this step */
+	LANE_DONE = 1,			/* replicate has just finished */
+	LANE_RECOVER = 2,
+	LANE_INFECT = 3
+} laneEventType;
+
+typedef struct {
+	double	dThetaOne;		/* Infectivity */
+	double	dThetaTwo;
+	double	dRhoOne;		/* Susceptibility */
+	double	dRhoTwo;
+	double	dMuOne;			/* Death rate */
+	double	dMuTwo;
+	int		nInitOne;		/* Numbers of initial infections */
+	int		nInitTwo;
+	int		bCacheKernel;	/* Whether or not to store the kernel in memory */
+	int		eKernelType;	/* What sort of kernel */
+	double	dA;				/* Exponential-power kernel */
+	double	dC;
+	int		nNumIts;		/* Number of iterations to run */
+	int		nMaxGen;		/* Make infection rate = 0 after this many generations */
+	int		eModelType;		/* Whether SIS or SIR model */
+	char	sXYFile[_MAX_STR_LEN];
+	char	sOutFile[_MAX_STR_LEN];
+	char	sParamDumpFile[_MAX_STR_LEN];
+	double	dMaxTime;
+	int		eDumpType;
+	int		nDumpSteps;		/* Time course output has this many steps in [0,dMaxTime] */
+	int		bDumpHostStatus;
+	int		bQuiet;			/* Suppress progress echo to stdout */
+	char	sHostsBinFile[_MAX_STR_LEN];	/* If set, write hosts here in binary format after loading */
+	int		eSortHosts;		/* Reorder hosts along a space-filling curve after loading */
+	int		nSeed;			/* Random number seed (0 means use time and process ID) */
+	int		nShardIndex;	/* This process does replicates nShardIndex*numIts/nShardCount onwards... */
+	int		nShardCount;	/* ...up to (nShardIndex+1)*numIts/nShardCount */
+	double	dConvergeTol;	/* Stop once the confidence interval on R0 is narrower than this (0 to always do numIts) */
+	int		nMinIts;		/* ...but not before this many replicates */
+	char	sBatchXYFiles[_MAX_STR_LEN];	/* If set, run all these host files instead of sXYFile */
+	char	sEditFiles[_MAX_STR_LEN];	/* If set, run sXYFile with each of these sets of edits to it instead... */
+	char	sEditFile[_MAX_STR_LEN];	/* ...this being the one being run */
+	int		nThreads;		/* Threads used in batch mode (0 for one per processor) */
+	double	dBatchMemoryMB;	/* Don't start loading another landscape while this much is in use */
+	char	sKernelFile[_MAX_STR_LEN];		/* If set, kernel is read from here (or saved here if not valid) */
+	int		nKernelGrid;	/* If positive, use a grid kernel with this many cells along each side... */
+	double	dKernelTol;		/* ...and cells near enough that using their centres is out by no more than this */
+	int		eEngine;		/* How events are simulated */
+	int		nLanes;			/* Replicates run in lockstep (full kernel and engine 1 only) */
+	int		nEventThreads;	/* Threads sharing the work of each event on a big landscape (0 for one per processor) */
+	int		ePages;			/* What sort of memory pages the kernel is in */
+	int		bNumaPlacement;	/* Spread the kernel over the NUMA nodes, and pin threads to them in turn */
+	int		eKernelStore;	/* How the full kernel is held (STORE_AUTO to fit it into dMemoryBudgetMB) */
+	double	dMemoryBudgetMB;	/* Most memory the kernel may take (0 for a share of what's available) */
+	char	sKernelTileFile[_MAX_STR_LEN];	/* STORE_TILED: the kernel is kept in here... */
+	int		nTileThreads;	/* ...and read ahead by this many threads */
+	double	dCullRadius;	/* When an infected host is removed, cull every host this close to it (0 for no culling) */
+	int		nCheckpointEvery;	/* Write a checkpoint after this many replicates (0 for never) */
+	int		bResume;		/* Carry on from the checkpoint, if there is one */
+	char	sCheckpointFile[_MAX_STR_LEN];
+} t_Params;
+
+typedef struct {
+	double	dX;
+	double	dY;
+	int		eType;
+} t_SingleHost;
+
+typedef struct {
+	t_SingleHost	*aHosts;
+	int				nHosts;
+	int				nAlloc;
+	int				*aByType;	/* host IDs, type I first then type II (see indexHostTypes()) */
+	int				nTypeOne;
+	int				nTypeTwo;
+	int				*aOrigID;	/* if the hosts were reordered, each one's ID in xyFile (otherwise NULL)... */
+	int				*aSortedID;	/* ...and where each host in xyFile ended up */
+} t_Hosts;
+
+/* one change to a landscape (see readHostEdits()) */
+typedef struct {
+	int		eEdit;
+	int		nHostID;	/* EDIT_REMOVE and EDIT_RETYPE: ID of the host in the base landscape's xyFile */
+	double	dX;			/* EDIT_ADD: where the new host is... */
+	double	dY;
+	int		eType;		/* ...and EDIT_ADD and EDIT_RETYPE: its type */
+} t_HostEdit;
+
+/*
+	binary host file: header then one record per host, in native byte order
+*/
+typedef struct {
+	char	sMagic[8];		/* _HOST_FILE_MAGIC */
+	int		nHosts;
+	int		nReserved;
+} t_HostFileHeader;
+
+typedef struct {
+	double	dX;
+	double	dY;
+	int		eType;
+	int		nReserved;
+} t_HostFileRecord;
+
+/* a read-only memory mapped file */
+typedef struct {
+	char	*pData;
+	size_t	nSize;
+#ifdef _WIN32
+	HANDLE	hFile;
+	HANDLE	hMapping;
+#endif
+} t_MappedFile;
+
+/* memory for a kernel (see allocKernelMemory()) */
+typedef struct {
+	char	*pData;
+	size_t	nSize;			/* bytes, or as mapped a whole number of huge pages */
+	int		bMapped;		/* otherwise from malloc() */
+} t_KernelMemory;
+
+typedef struct {
+	int				eStatus;
+	double			dRate;
+	int				nGen;
+	int				nEntryPtr;	/*  only for infected hosts, store where the
+									relevant entry is in the epidemicEntryList */
+	unsigned int	nEpoch;		/* replicate this was last set in; anything older is
+									susceptible with no force of infection (see touchHost()) */
+	int				nListPos;	/* only for infected hosts, where it is in aInfectives */
+} t_HostStatus;
+
+typedef struct {
+	int		nGen;
+	double	dInfectTime;
+	double	dRemovalTime;
+	int		nHostID;
+	int		eType;
+	int		nInfectedBy;	/* entry of the infection that caused this one (_NOT_SET for initial infections)... */
+	int		nOffspringOne;	/* ...and the infections of each type this one went on to cause */
+	int		nOffspringTwo;
+} t_EpidemicEntry;
+
+typedef struct {
+	t_EpidemicEntry *aEntries;
+	int				nEntries;
+	int				nAlloc;
+} t_Epidemic;
+
+/*
+	one change in the number of infected hosts, in the order they happen
+*/
+typedef struct {
+	double	dTime;
+	int		eType;
+	int		nChange;	/* +1 for an infection, -1 for a recovery */
+} t_TimeLogEntry;
+
+/*
+	growable text, used to build up the output for a replicate before it is written
+*/
+typedef struct {
+	char	*pText;
+	size_t	nLen;
+	size_t	nAlloc;
+} t_TextBuf;
+
+/*
+	everything needed to run a single replicate
+
+	allocated once per run (the fixed size arrays as a single block sized from
+	nHosts) and reset, not freed, between replicates; the list of epidemic
+	entries and the time log only grow (geometrically), and keep their size from
+	one replicate to the next
+
+	the counts by generation and the time log are updated as each event
+	happens, so dumping out a replicate never has to rescan the entries
+
+	host status is stamped with the replicate (epoch) it was set in, so starting
+	a replicate resets nothing; until force of infection is first spread over
+	the whole landscape (bAllTouched) the few hosts set so far are kept in a
+	sorted list, and picking the next event only looks at those
+
+	dRate is the force of infection on a susceptible host, and zero for all
+	the others; recoveries happen at the fixed rates nInfOne*muOne and
+	nInfTwo*muTwo, so the event is first picked from those two and dInfectRate,
+	and only an infection needs the search through dRate for its host
+
+	with a grid kernel dRate of a susceptible host only has force of infection
+	from near cells, and the rest comes from its cell's far force
+
+	the infective engine (engine=2) keeps no rates for susceptible hosts at all;
+	instead each infective that can still infect is in the rate group for its
+	attempt rate, and host status is only brought up to date as it is looked at
+
+	a workspace in a lockstep batch (pLanes set) keeps dRate in the batch instead
+
+	on a landscape of _EVENT_BLOCK_MIN_HOSTS or more (engine 1), each pass over the
+	hosts (or cells) for an event is split into fixed blocks, each adding up its
+	own share of any total, and the shares are then added in block order; the
+	blocks can then be shared between a team of threads without changing the
+	result, which is the same however many threads there are
+
+	with culling (cullRadius > 0) the hosts are also put in a grid of cells
+	about cullRadius across, so those near a removed host are found by looking
+	in a few cells rather than over the whole landscape
+*/
+typedef struct t_Lanes t_Lanes;
+
+/*
+	uniform grid over the hosts, for finding those within some distance of a point
+*/
+typedef struct {
+	double	dMinX;
+	double	dMinY;
+	double	dCellSize;
+	int		nCellsX;
+	int		nCellsY;
+	int		*aCellStart;	/* hosts in cell c are aCellHosts[aCellStart[c]] up to aCellStart[c + 1], in ID order */
+	int		*aCellHosts;
+} t_HostGrid;
+
+typedef struct {
+	char			*pBlock;		/* single allocation holding all the arrays below */
+	t_HostStatus	*aHostStatus;
+	int				*aInfectiveID;	/* scratch for finding who caused an infection */
+	double			*aInfectiveRate;
+	int				*aHostList;		/* copy of aByType, shuffled in place to choose initial infections */
+	int				*aTypeOneByGen;	/* infections so far in each generation, by type */
+	int				*aTypeTwoByGen;
+	t_Epidemic		sEpidemic;
+	double			dInfectRate;	/* total dRate: infected hosts have none, as recoveries are picked by type */
+	unsigned int	nEpoch;			/* the current replicate's stamp */
+	int				bAllTouched;	/* every host's status is from this epoch */
+	int				*aTouched;		/* otherwise, these are (in order of host ID) */
+	int				nTouched;
+	double			*aCellRate;		/* grid kernel only: total of dRate over the hosts in each cell... */
+	double			*aFarForce;		/* ...force of infection per unit susceptibility from far cells... */
+	double			*aRhoSus;		/* ...total susceptibility of the susceptible hosts in the cell... */
+	double			*aCellRho;		/* ...and of all of them */
+	int				*aInfectives;	/* infected hosts, type I from the start and type II from nTypeOne */
+	int				nInfOne;
+	int				nInfTwo;
+	double			*aAttemptRate;	/* infective engine only: rate each host fires infection attempts when infected... */
+	int				*aRateGroup;	/* ...the group it is in for that (_NOT_SET if it never infects anything)... */
+	int				*aGroupPos;		/* ...and where it is in its group, while it is in it */
+	int				*aGroupHosts;	/* hosts in group g are aGroupHosts[aGroupStart[g]] onwards... */
+	int				aGroupStart[_MAX_RATE_GROUPS];
+	int				aGroupCount[_MAX_RATE_GROUPS];	/* ...the first aGroupCount[g] of which are infective */
+	double			aGroupTotal[_MAX_RATE_GROUPS];	/* total attempt rate of those */
+	double			aGroupMax[_MAX_RATE_GROUPS];	/* highest attempt rate of any host in the group */
+	int				nRateGroups;
+	double			dRhoMax;		/* attempts succeed on a susceptible host with probability rho/dRhoMax */
+	t_TimeLogEntry	*aTimeLog;		/* only kept when dumping out time courses */
+	int				nTimeLog;
+	int				nTimeLogAlloc;
+	mt_state		sRNG;			/* random number stream for the current replicate */
+	t_TextBuf		sOut;			/* what dumpEpidemic() produced for it */
+	t_Lanes			*pLanes;		/* lockstep batch this is lane nLane of, or NULL */
+	int				nLane;
+	int				nBlocks;		/* blocks each pass for an event is split into (0 for none)... */
+	double			*aBlockSum;		/* ...the share of the total from each... */
+	int				nBlockAlloc;
+	t_Team			*pTeam;			/* ...and the threads sharing them (NULL for just this one) */
+	t_HostGrid		sCullGrid;		/* culling only: the hosts by where they are... */
+	int				nDetections;	/* ...and in this replicate, the removals that set off a cull... */
+	int				nCulledSus;		/* ...and the susceptible and infected hosts culled */
+	int				nCulledInf;
+} t_Workspace;
+
+/*
+	lockstep batch (lanes > 1): nLanes replicates are run together by one thread,
+	each in its own workspace, except that the force of infection is kept in
+	arrays with the lanes interleaved (host i in lane l at [i * nLanes + l]); each
+	step then makes one pass over the hosts to find every lane's infected host,
+	and one to spread every lane's change in force of infection, rather than a
+	pass per replicate
+
+	each lane does exactly the arithmetic and takes exactly the random numbers
+	that runReplicate() would, so output is the same whatever lanes is; the
+	passes are generated for each number of lanes from LaneTemplate.h
+*/
+struct t_Lanes {
+	char			*pBlock;	/* single allocation holding the interleaved arrays */
+	int				nLanes;
+	double			*aRate;		/* dRate of each host in each lane */
+	double			*aRhoSus;	/* rho of the host while susceptible in that lane, otherwise zero... */
+	double			*aThetaInf;	/* ...and theta while infected and not too old to infect */
+	unsigned char	*aStatus;	/* eStatus */
+	t_Workspace		aWork[_MAX_LANES];
+	int				aIt[_MAX_LANES];		/* replicate in each lane (_NOT_SET if none) */
+	double			aTime[_MAX_LANES];
+	int				aSteps[_MAX_LANES];
+	int				aEvent[_MAX_LANES];		/* this step's event in each lane... */
+	int				aEventHost[_MAX_LANES];
+	double			aTarget[_MAX_LANES];	/* ...where an infection falls in dInfectRate... */
+	int				aSpreadHost[_MAX_LANES];	/* ...the host whose force of infection changes... */
+	double			aSpreadTheta[_MAX_LANES];	/* ...by this times the kernel (zero for no change) */
+	double			*aZeroRow;	/* kernel row for a lane with nothing to spread or gather */
+	void			(*pfScan)(t_Lanes *pLanes, int nHosts, double *aTarget, int *aHost);
+	void			(*pfSpread)(t_Lanes *pLanes, int nHosts, double *aTheta, double **aRow, double *aTotal);
+	void			(*pfGather)(t_Lanes *pLanes, int nHosts, double *aRho, double **aRow, double *aHostRate, double *aTotal);
+	void			(*pfScanInfectors)(t_Lanes *pLanes, int nHosts, double *aRho, double **aRow, double *aTarget, int *aHost);
+};
+
+/*
+	the kernel is either a dense nHosts*nHosts matrix, or (kernelGrid > 0) hosts are
+	binned into a grid of square cells: pairs of hosts in near cells get the exact
+	kernel, worked out when needed, and pairs in far cells the kernel between the
+	centres of their cells, which only depends on how far apart the cells are; the
+	infective engine replaces the dense matrix by an alias table for each host's row
+*/
+typedef struct t_KernelSpec t_KernelSpec;
+typedef struct t_TileCache t_TileCache;
+typedef struct t_KernelEdit t_KernelEdit;
+
+/* one entry in a row's alias table: pick this host with probability fProb, otherwise nAlias */
+typedef struct {
+	float	fProb;
+	int		nAlias;
+} t_AliasEntry;
+
+typedef struct {
+	int		eStore;		/* how the full kernel is held (see planKernel()) */
+	double	*aKernel;	/* stored as a flattened array, or with STORE_PACKED only pairs i > j (see packedPos()) */
+	float	*aKernelSingle;	/* STORE_SINGLE: as STORE_PACKED */
+	size_t	*aNbrStart;	/* STORE_SPARSE: hosts near host i are aNbrHost[aNbrStart[i]] to aNbrHost[aNbrStart[i+1]-1], in order... */
+	int		*aNbrHost;
+	double	*aNbrKernel;	/* ...with the kernel to each */
+	double	dCutoff;	/* STORE_SPARSE: hosts further apart than this don't infect each other */
+	t_TileCache	*pTiles;	/* STORE_TILED: the tiles of the kernel in memory (see tileKernel()) */
+	t_KernelEdit	*pEdit;	/* STORE_EDITED: how to get it from the base landscape's */
+	int		nGrid;		/* cells along each side of the grid (0 if the kernel is dense) */
+	int		nNear;		/* cells no more than this many apart in x and in y are near */
+	int		nCells;		/* number of cells with any hosts in */
+	int		*aHostCell;	/* which cell each host is in */
+	int		*aCellStart;	/* hosts in cell k are aCellHosts[aCellStart[k]] to aCellHosts[aCellStart[k+1]-1] */
+	int		*aCellHosts;
+	int		*aCellGX;	/* position of each cell in the grid */
+	int		*aCellGY;
+	double	*aFarKernel;	/* between cell centres, by offset: [(dx+nGrid-1)*(2*nGrid-1) + dy+nGrid-1] */
+	double	dMinX;		/* corner and size of the cells */
+	double	dMinY;
+	double	dCellSize;
+	const t_KernelSpec	*pSpec;	/* for pParams->eKernelType */
+	double	dNorm;		/* its normalising constant, so near values can be worked out quickly */
+	double	dMaxError;	/* bound on the relative error in force of infection from using cell centres */
+	t_AliasEntry	*aAlias;	/* infective engine: instead of aKernel, for sampling from each host's kernel row... */
+	double	*aRowSum;	/* ...which adds up to this */
+	t_KernelMemory	sMemory;	/* aKernel or aAlias is in this */
+} t_Kernel;
+
+/*
+	kernel of an edited landscape: hosts kept from the base landscape come first, in the
+	order they were in there, then the added ones
+*/
+struct t_KernelEdit {
+	t_Kernel	*pBase;			/* kernel of the base landscape... */
+	t_Hosts		*pBaseHosts;	/* ...and its hosts, which mustn't change while this is in use */
+	int			*aBaseHost;		/* host in the base landscape each host is (_NOT_SET if added) */
+	int			nKept;			/* hosts kept from the base landscape */
+	double		*aAddedKernel;	/* between each added host and every host: [(i - nKept) * nHosts + j] */
+};
+
+/*
+	kernel registry entry, one for each kernelType (see aKernelSpecs[])
+
+	the functions working on pairs of hosts are generated for each kernel from KernelTemplate.h
+*/
+struct t_KernelSpec {
+	int			eKernelType;
+	const char	*sName;
+	const char	*sRule;			/* what dispA and dispC must be, for error messages */
+	int			(*pfValid)(double dA, double dC);
+	double		(*pfNorm)(double dA, double dC);				/* KERNEL_EVAL()'s norm */
+	double		(*pfCutoff)(double dA, double dC, double dTol);	/* all but dTol of dispersal is closer than this */
+	double		(*pfEval)(double d2, double dA, double dC, double dNorm);
+	double		(*pfPair)(int hostOne, int hostTwo, t_Kernel *pKernel, t_Hosts *pHosts, t_Params *pParams);
+	void		(*pfBuild)(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel);
+	void		(*pfRow)(int thisHost, double *aRow, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel);
+	void		(*pfSpreadNear)(int nCell, int thisHost, double thisTheta, double *pTotal, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel);
+	void		(*pfGatherNear)(int nCell, int thisHost, double thisRho, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel);
+};
+
+/*
+	cached kernel file: header then the nHosts*nHosts flattened kernel, in native byte order
+*/
+typedef struct {
+	char				sMagic[8];		/* _KERNEL_FILE_MAGIC */
+	int					nHosts;
+	int					eKernelType;
+	double				dA;
+	double				dC;
+	unsigned long long	nHostsHash;		/* of the host positions, so a changed landscape isn't reused */
+} t_KernelFileHeader;
+
+/*
+	running sums for the generation ratio estimate of R0, i.e. all infections
+	in generations 1..maxGen divided by all those in generations 0..maxGen-1,
+	with each replicate treated as an independent observation
+*/
+typedef struct {
+	int		nReplicates;
+	double	dChildren;		/* sums over replicates of the per-replicate totals... */
+	double	dParents;
+	double	dChildrenSq;	/* ...and of their squares and products */
+	double	dParentsSq;
+	double	dCross;
+} t_R0Stats;
+
+/*
+	a replicate a lockstep batch has finished, waiting for the ones before it to be written out
+*/
+typedef struct {
+	t_TextBuf	sOut;
+	t_R0Stats	sR0Stats;		/* just this replicate */
+	int			nSteps;
+	int			bDone;
+} t_LaneSlot;
+
+/*
+	checkpoint file: everything needed to carry on after the last completed replicate
+*/
+typedef struct {
+	char				sMagic[8];		/* _CHECKPOINT_MAGIC */
+	int					nNextIt;		/* first replicate still to do */
+	int					nSeed;			/* replicate i always uses random number stream (nSeed,i) */
+	long long			nOutOffset;		/* length of sOutFile when the checkpoint was written */
+	long long			nCullOffset;	/* and of the _culls.csv file, if culling */
+	unsigned long long	nParamsHash;	/* of everything affecting output, apart from numIts and the seed */
+	t_R0Stats			sR0Stats;		/* so stopping on convergence carries on where it left off */
+} t_Checkpoint;
+
+typedef struct {
+	long long	nEvents;		/* infections + recoveries over all replicates */
+	int			nReplicates;
+	double		dSeconds;		/* wall clock time spent in runEpidemics() */
+} t_RunStats;
+
+/*
+	the seed to use: ulnSeed, or one from the time if that is 0
+
+	nothing draws from the global generator, as each replicate seeds its own
+	stream from this and its number (see seedReplicate())
+*/
+unsigned long	seedRandom(unsigned long ulnSeed)
+{
+	unsigned long		myPID;
+
+	if (ulnSeed <= 0)
+	{
+		ulnSeed = (unsigned long)time(NULL);
+#ifndef _WIN32	/* make sure different processes started at same time have different seeds */
+		myPID = (unsigned long)getpid();
+#else
+		myPID = (unsigned long)_getpid();
+#endif
+		ulnSeed += myPID;
+	}
+	return ulnSeed;
+}
+
+/*
+	start the random number stream for one replicate
+
+	each replicate has its own stream, so replicate i gives the same result
+	whichever process runs it, or whatever else that process has done first
+*/
+void	seedReplicate(mt_state *pRNG, int nSeed, int nIt)
+{
+	unsigned long	aKey[2];
+
+	aKey[0] = (unsigned long)nSeed;
+	aKey[1] = (unsigned long)nIt;
+	init_by_array_r(pRNG, aKey, 2);
+}
+
+/*
+	which replicates this shard runs: [*pFirstIt, *pEndIt)
+*/
+void	shardRange(t_Params *pParams, int *pFirstIt, int *pEndIt)
+{
+	*pFirstIt = (int)((long long)pParams->nNumIts * pParams->nShardIndex / pParams->nShardCount);
+	*pEndIt = (int)((long long)pParams->nNumIts * (pParams->nShardIndex + 1) / pParams->nShardCount);
+}
+
+/*
+	name of the file written by shard nShard instead of sFile (e.g. out.csv -> out_shard2.csv)
+*/
+void	shardFileName(char *sShardFile, const char *sFile, int nShard)
+{
+	const char	*pExt, *pDelim;
+
+	pExt = strrchr(sFile, '.');
+	pDelim = strrchr(sFile, C_DIR_DELIMITER);
+	if (pExt == NULL || (pDelim != NULL && pExt < pDelim))
+	{
+		pExt = sFile + strlen(sFile);
+	}
+	sprintf(sShardFile, "%.*s_shard%d%s", (int)(pExt - sFile), sFile, nShard, pExt);
+}
+
+/*
+	wall clock time in seconds (only differences are meaningful)
+*/
+double	wallClockSeconds()
+{
+#ifdef _WIN32
+	LARGE_INTEGER	liCount, liFreq;
+
+	QueryPerformanceCounter(&liCount);
+	QueryPerformanceFrequency(&liFreq);
+	return (double)liCount.QuadPart / (double)liFreq.QuadPart;
+#else
+	struct timespec	sNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &sNow);
+	return (double)sNow.tv_sec + 1e-9 * (double)sNow.tv_nsec;
+#endif
+}
+
+/*
+	echo progress to the screen, unless running quietly
+*/
+void	echoToScreen(t_Params *pParams, const char *szFormat, ...)
+{
+	va_list	args;
+
+	if (!pParams->bQuiet)
+	{
+		va_start(args, szFormat);
+		vfprintf(stdout, szFormat, args);
+		va_end(args);
+	}
+}
+
+/*
+	return uniform number on [0,1)
+*/
+double	uniformRandom(mt_state *pRNG)
+{
+	return genrand_real3_r(pRNG);
+}
+
+/*
+	printf() onto the end of a text buffer
+*/
+int		bufPrintf(t_TextBuf *pBuf, const char *szFormat, ...)
+{
+	va_list	args;
+	int		nLen;
+	size_t	nAlloc;
+	char	*pText;
+
+	va_start(args, szFormat);
+	nLen = vsnprintf(NULL, 0, szFormat, args);
+	va_end(args);
+	if (nLen < 0)
+	{
+		return 0;
+	}
+	if (pBuf->nLen + nLen + 1 > pBuf->nAlloc)
+	{
+		nAlloc = 2 * pBuf->nAlloc + nLen + _MAX_STR_LEN;
+		pText = realloc(pBuf->pText, nAlloc);
+		if (!pText)
+		{
+			fprintf(stderr, "bufPrintf(): Out of memory\n");
+			return 0;
+		}
+		pBuf->pText = pText;
+		pBuf->nAlloc = nAlloc;
+	}
+	va_start(args, szFormat);
+	vsnprintf(pBuf->pText + pBuf->nLen, nLen + 1, szFormat, args);
+	va_end(args);
+	pBuf->nLen += nLen;
+	return 1;
+}
+
+/*
+	64 bit FNV-1a hash, continuing from nHash (start with _FNV_OFFSET)
+*/
+#define	_FNV_OFFSET		14695981039346656037ULL
+unsigned long long hashBytes(unsigned long long nHash, const void *pData, size_t nBytes)
+{
+	const unsigned char	*p;
+	size_t				i;
+
+	p = pData;
+	for (i = 0; i < nBytes; i++)
+	{
+		nHash ^= p[i];
+		nHash *= 1099511628211ULL;
+	}
+	return nHash;
+}
+
+/*
+	position in the flattened array for a pair of hosts (as size_t, as past 46340 hosts
+	the dense kernel has more than INT_MAX entries)
+*/
+size_t	posFromHostIDs(int idOne, int idTwo, int numHosts)
+{
+	return (size_t)idOne + (size_t)numHosts * (size_t)idTwo;
+}
+
+/*
+	Logarithmic gamma function using the algorithm from Numerical Recipes
+*/ 
+double logGamma(double x) 
+{
+
+	int				i;
+	double			a, b, t, s;
+	static double	c[6] = { 76.18009172947146,
+							-86.50532032941677,
+							24.01409824083091,
+							-1.231739572450155,
+							0.1208650973866179e-2,
+							-0.5395239384953e-5};
+	
+	b = a = x;
+	t = a + 5.5;
+	t -= (a + 0.5) * log(t);
+	s = 1.000000000190015;
+	for (i = 0; i <= 5; i++)
+	{
+		s += c[i] / ++b;
+	}
+
+	return -t + log(2.5066282746310005 * s / a);
+}
+
+double simpleGammaFunction(double x)
+{
+	double retVal;
+	
+	retVal = exp(logGamma(x));
+	return retVal;
+}
+
+/*
+	regularised upper incomplete gamma function Q(s,x), using the series or continued
+	fraction from Numerical Recipes
+*/
+double upperGammaQ(double s, double x)
+{
+	int		n;
+	double	dSum, dDel, dAp, b, c, d, h, an;
+
+	if (x <= 0.0)
+	{
+		return 1.0;
+	}
+	if (x < s + 1.0)
+	{
+		dAp = s;
+		dSum = dDel = 1.0 / s;
+		for (n = 1; n <= 1000 && fabs(dDel) > 1e-15 * fabs(dSum); n++)
+		{
+			dAp += 1.0;
+			dDel *= x / dAp;
+			dSum += dDel;
+		}
+		return 1.0 - dSum * exp(-x + s * log(x) - logGamma(s));
+	}
+	b = x + 1.0 - s;
+	c = 1e300;
+	d = 1.0 / b;
+	h = d;
+	for (n = 1; n <= 1000; n++)
+	{
+		an = -n * (n - s);
+		b += 2.0;
+		d = an * d + b;
+		d = (fabs(d) < 1e-300) ? 1e300 : 1.0 / d;
+		c = b + an / c;
+		c = (fabs(c) < 1e-300) ? 1e-300 : c;
+		h *= d * c;
+		if (fabs(d * c - 1.0) < 1e-15)
+		{
+			break;
+		}
+	}
+	return exp(-x + s * log(x) - logGamma(s)) * h;
+}
+
+/*
+	smallest distance with no more than dTol of dispersal beyond it, given pfTail(), the
+	fraction of dispersal beyond a distance (found by bisection)
+*/
+double bisectCutoff(double (*pfTail)(double dR, double dA, double dC), double dA, double dC, double dTol)
+{
+	int		i;
+	double	dLow, dHigh, dMid;
+
+	dLow = 0.0;
+	dHigh = dA;
+	while (pfTail(dHigh, dA, dC) > dTol && dHigh < 1e300)
+	{
+		dLow = dHigh;
+		dHigh *= 2.0;
+	}
+	for (i = 0; i < 100 && dHigh - dLow > 1e-12 * dHigh; i++)
+	{
+		dMid = 0.5 * (dLow + dHigh);
+		if (pfTail(dMid, dA, dC) > dTol)
+		{
+			dLow = dMid;
+		}
+		else
+		{
+			dHigh = dMid;
+		}
+	}
+	return dHigh;
+}
+
+/*
+	dispersal kernels
+
+	each is a density over the plane (other than the flat one), so 2*pi*r*k(r) integrates to 1
+*/
+
+/* exponential power: c*exp(-(r/a)^c) / (2*pi*a^2*Gamma(2/c)) */
+int expPowerValid(double dA, double dC)
+{
+	return dA > 0.0 && dC > 0.0;
+}
+
+double expPowerNorm(double dA, double dC)
+{
+	return 2.0 * _PI * dA * dA * simpleGammaFunction(2.0 / dC);
+}
+
+double expPowerTail(double dR, double dA, double dC)
+{
+	return upperGammaQ(2.0 / dC, pow(dR / dA, dC));
+}
+
+double expPowerCutoff(double dA, double dC, double dTol)
+{
+	return bisectCutoff(expPowerTail, dA, dC, dTol);
+}
+
+/* flat: 1 everywhere, so not a density and has no cutoff */
+int flatValid(double dA, double dC)
+{
+	return 1;
+}
+
+double flatNorm(double dA, double dC)
+{
+	return 1.0;
+}
+
+double flatCutoff(double dA, double dC, double dTol)
+{
+	return HUGE_VAL;
+}
+
+/* Cauchy: a / (2*pi*(r^2+a^2)^1.5), dispC isn't used */
+int cauchyValid(double dA, double dC)
+{
+	return dA > 0.0;
+}
+
+double cauchyNorm(double dA, double dC)
+{
+	return 2.0 * _PI;
+}
+
+double cauchyCutoff(double dA, double dC, double dTol)
+{
+	/* a/sqrt(r^2+a^2) of dispersal is beyond r */
+	return (dTol < 1.0) ? dA * sqrt(1.0 / (dTol * dTol) - 1.0) : 0.0;
+}
+
+/* power law: (c-1)*(c-2)/(2*pi*a^2) * (1+r/a)^-c, which needs c > 2 */
+int powerValid(double dA, double dC)
+{
+	return dA > 0.0 && dC > 2.0;
+}
+
+double powerNorm(double dA, double dC)
+{
+	return 2.0 * _PI * dA * dA / ((dC - 1.0) * (dC - 2.0));
+}
+
+double powerTail(double dR, double dA, double dC)
+{
+	double	u;
+
+	u = 1.0 + dR / dA;
+	return (dC - 1.0) * pow(u, 2.0 - dC) - (dC - 2.0) * pow(u, 1.0 - dC);
+}
+
+double powerCutoff(double dA, double dC, double dTol)
+{
+	return bisectCutoff(powerTail, dA, dC, dTol);
+}
+
+/* Gaussian: exp(-(r/a)^2) / (pi*a^2), dispC isn't used */
+int gaussianValid(double dA, double dC)
+{
+	return dA > 0.0;
+}
+
+double gaussianNorm(double dA, double dC)
+{
+	return _PI * dA * dA;
+}
+
+double gaussianCutoff(double dA, double dC, double dTol)
+{
+	/* exp(-(r/a)^2) of dispersal is beyond r */
+	return (dTol < 1.0) ? dA * sqrt(-log(dTol)) : 0.0;
+}
+
+/* the loops over pairs of hosts for each kernel; KERNEL_EVAL() is given the squared distance */
+#define	KERNEL_NAME				expPower
+#define	KERNEL_EVAL(d2,a,c,n)	((c) * exp(-pow(sqrt(d2) / (a), (c))) / (n))
+#include "KernelTemplate.h"
+
+#define	KERNEL_NAME				flat
+#define	KERNEL_EVAL(d2,a,c,n)	((void)(d2), (void)(a), (void)(c), (void)(n), 1.0)
+#include "KernelTemplate.h"
+
+#define	KERNEL_NAME				cauchy
+#define	KERNEL_EVAL(d2,a,c,n)	((void)(c), (a) / ((n) * ((d2) + (a) * (a)) * sqrt((d2) + (a) * (a))))
+#include "KernelTemplate.h"
+
+#define	KERNEL_NAME				power
+#define	KERNEL_EVAL(d2,a,c,n)	(pow(1.0 + sqrt(d2) / (a), -(c)) / (n))
+#include "KernelTemplate.h"
+
+#define	KERNEL_NAME				gaussian
+#define	KERNEL_EVAL(d2,a,c,n)	((void)(c), exp(-(d2) / ((a) * (a))) / (n))
+#include "KernelTemplate.h"
+
+#define	KERNEL_SPEC(e,f,sName,sRule,pfCutoff)	{ e, sName, sRule, f##Valid, f##Norm, pfCutoff, evalKernel_##f, \
+	pairKernel_##f, buildKernel_##f, kernelRow_##f, spreadNearCell_##f, gatherNearCell_##f }
+
+const t_KernelSpec aKernelSpecs[] = {
+	KERNEL_SPEC(KERNEL_I, expPower, "exponential power", "dispA > 0 and dispC > 0", expPowerCutoff),
+	KERNEL_SPEC(KERNEL_II, flat, "flat", "any values", flatCutoff),
+	KERNEL_SPEC(KERNEL_CAUCHY, cauchy, "Cauchy", "dispA > 0", cauchyCutoff),
+	KERNEL_SPEC(KERNEL_POWER, power, "power law", "dispA > 0 and dispC > 2", powerCutoff),
+	KERNEL_SPEC(KERNEL_GAUSSIAN, gaussian, "Gaussian", "dispA > 0", gaussianCutoff)
+};
+
+#define	_NUM_KERNELS		((int)(sizeof(aKernelSpecs) / sizeof(aKernelSpecs[0])))
+
+/*
+	registry entry for a kernelType, or NULL if there isn't one
+*/
+const t_KernelSpec *findKernelSpec(int eKernelType)
+{
+	int		i;
+
+	for (i = 0; i < _NUM_KERNELS; i++)
+	{
+		if (aKernelSpecs[i].eKernelType == eKernelType)
+		{
+			return &aKernelSpecs[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+	dispersal kernel at distance r (for setting up; the loops over hosts use the registry directly)
+*/
+double dispKernel(double r, double alpha, double c, int eKernelType)
+{
+	const t_KernelSpec	*pSpec;
+
+	pSpec = findKernelSpec(eKernelType);
+	return pSpec->pfEval(r * r, alpha, c, pSpec->pfNorm(alpha, c));
+}
+
+/*
+	read in parameters (will alter to read in from cfg file)
+*/
+int setParams(t_Params *pParams)
+{
+	pParams->dThetaOne = 0.1;			/* infectivity of a type 1 host */
+	pParams->dThetaTwo = 0.05;			/* infectivity of a type 2 host */
+	pParams->dRhoOne = 0.05;			/* susceptibility of a type 1 host  */
+	pParams->dRhoTwo = 0.05;			/* susceptibility of a type 2 host  */
+	pParams->dMuOne = 2.5;				/* death rate of a type 1 host  */
+	pParams->dMuTwo = 1.0;				/* death rate of a type 2 host  */
+	pParams->nInitOne = 1;				/* initial number of type 1 infections */
+	pParams->nInitTwo = 1;				/* initial number of type 2 infections */
+	pParams->bCacheKernel = 1;			/* kernel parameters */
+	pParams->eKernelType = KERNEL_I;	/* exponential power kernel */
+	pParams->dA = 0.5;					/* scale */
+	pParams->dC = 1.0;					/* power */
+	pParams->nNumIts = 100;
+	/* in this generation the infection rate is artificially set to zero */
+	pParams->nMaxGen = 3;//5;
+	strcpy(pParams->sXYFile, "finalExampleLS_xy.csv");
+	strcpy(pParams->sOutFile, "finalExampleLS_Epidemics_Eg5_1.csv");
+	pParams->dMaxTime = 20.0;
+	pParams->eDumpType = DUMP_GENS;
+	pParams->nDumpSteps = N_DUMP_STEPS;
+	return 1;
+}
+
+int dumpParametersToCSV(t_Params *pParams)
+{
+	FILE *fOut;
+
+	fOut = fopen(pParams->sParamDumpFile, "wb");
+	if (!fOut)
+	{
+		fprintf(stderr, "dumpParametersToCSV(): could not open file\n");
+		return 0;
+	}
+	fprintf(fOut, "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s",
+		"thetaOne",
+		"thetaTwo",
+		"rhoOne",
+		"rhoTwo",
+		"muOne",
+		"muTwo",
+		"initOne",
+		"initTwo",
+		"kernelType",
+		"dispA",
+		"dispC",
+		"numIts",
+		"maxGen",
+		"xyFile",
+		"modelType");
+	/* so a scenario's parameters say what it was */
+	fprintf(fOut, pParams->sEditFile[0] ? ",editFile\n" : "\n");
+	fprintf(fOut, "%.7f,%.7f,%.7f,%.7f,%.7f,%.7f,%d,%d,%d,%.7f,%.7f,%d,%d,%s,%d",
+		pParams->dThetaOne,
+		pParams->dThetaTwo,
+		pParams->dRhoOne,
+		pParams->dRhoTwo,
+		pParams->dMuOne,
+		pParams->dMuTwo,
+		pParams->nInitOne,
+		pParams->nInitTwo,
+		pParams->eKernelType,
+		pParams->dA,
+		pParams->dC,
+		pParams->nNumIts,
+		pParams->nMaxGen,
+		pParams->sXYFile,
+		pParams->eModelType);
+	if (pParams->sEditFile[0])
+	{
+		fprintf(fOut, ",%s", pParams->sEditFile);
+	}
+	fprintf(fOut, "\n");
+	fclose(fOut);
+	return 1;
+}
+
+/*
+	set parameters from the values held in the configuration table
+*/
+int readParamsFromConfig(t_Params *pParams, t_Config *pCfg)
+{
+	const t_KernelSpec	*pSpec;
+
+	memset(pParams, 0, sizeof(t_Params));
+	pParams->bCacheKernel = 1;			/* kernel parameters */
+	if (!cfgGetDouble(pCfg, "thetaOne", &pParams->dThetaOne))
+	{
+		fprintf(stderr, "readParams(): Couldn't read thetaOne\n");
+		return 0;
+	}
+	if (!cfgGetDouble(pCfg, "thetaTwo", &pParams->dThetaTwo))
+	{
+		fprintf(stderr, "readParams(): Couldn't read thetaTwo\n");
+		return 0;
+	}
+	if (!cfgGetDouble(pCfg, "rhoOne", &pParams->dRhoOne))
+	{
+		fprintf(stderr, "readParams(): Couldn't read rhoOne\n");
+		return 0;
+	}
+	if (!cfgGetDouble(pCfg, "rhoTwo", &pParams->dRhoTwo))
+	{
+		fprintf(stderr, "readParams(): Couldn't read rhoTwo\n");
+		return 0;
+	}
+	if (!cfgGetDouble(pCfg, "muOne", &pParams->dMuOne))
+	{
+		fprintf(stderr, "readParams(): Couldn't read muOne\n");
+		return 0;
+	}
+	if (!cfgGetDouble(pCfg, "muTwo", &pParams->dMuTwo))
+	{
+		fprintf(stderr, "readParams(): Couldn't read muTwo\n");
+		return 0;
+	}
+	if (!cfgGetInt(pCfg, "initOne", &pParams->nInitOne))
+	{
+		fprintf(stderr, "readParams(): Couldn't read initOne\n");
+		return 0;
+	}
+	if (!cfgGetInt(pCfg, "initTwo", &pParams->nInitTwo))
+	{
+		fprintf(stderr, "readParams(): Couldn't read initTwo\n");
+		return 0;
+	}
+	if (!cfgGetInt(pCfg, "kernelType", &pParams->eKernelType))
+	{
+		fprintf(stderr, "readParams(): Couldn't read kernelType\n");
+		return 0;
+	}
+	pSpec = findKernelSpec(pParams->eKernelType);
+	if (!pSpec)
+	{
+		fprintf(stderr, "readParams(): Invalid kernelType (must be %d to %d)\n", KERNEL_I, KERNEL_GAUSSIAN);
+		return 0;
+	}
+	if (!cfgGetDouble(pCfg, "dispA", &pParams->dA))
+	{
+		fprintf(stderr, "readParams(): Couldn't read dispA\n");
+		return 0;
+	}
+	if (!cfgGetDouble(pCfg, "dispC", &pParams->dC))
+	{
+		fprintf(stderr, "readParams(): Couldn't read dispC\n");
+		return 0;
+	}
+	if (!pSpec->pfValid(pParams->dA, pParams->dC))
+	{
+		fprintf(stderr, "readParams(): Invalid dispA or dispC for the %s kernel (needs %s)\n", pSpec->sName, pSpec->sRule);
+		return 0;
+	}
+	if (!cfgGetInt(pCfg, "numIts", &pParams->nNumIts))
+	{
+		fprintf(stderr, "readParams(): Couldn't read numIts\n");
+		return 0;
+	}
+	if (!cfgGetInt(pCfg, "maxGen", &pParams->nMaxGen))
+	{
+		fprintf(stdout, "readParams(): Couldn't read maxGen\n");
+		return 0;
+	}
+	if (!cfgGetString(pCfg, "xyFile", pParams->sXYFile))
+	{
+		fprintf(stdout, "readParams(): Couldn't read xyFile\n");
+		return 0;
+	}
+	if (!cfgGetString(pCfg, "outFile", pParams->sOutFile))
+	{
+		fprintf(stderr, "readParams(): Couldn't read outFile\n");
+		return 0;
+	}
+	/* model type: SIS (default) or SIR: this field is not required in config file */
+	pParams->eModelType = MODEL_SIS;
+	cfgGetInt(pCfg, "modelType", &pParams->eModelType);
+	if (!(pParams->eModelType == MODEL_SIS || pParams->eModelType == MODEL_SIR))
+	{
+		fprintf(stderr, "readParams(): Invalid modelType (must be %d or %d)\n", MODEL_SIS, MODEL_SIR);
+		return 0;
+	}
+	/* what to dump out: generations (default), time courses up to maxTime or offspring...note is not required */
+	pParams->eDumpType = DUMP_GENS;
+	cfgGetInt(pCfg, "dumpType", &pParams->eDumpType);
+	if (!(pParams->eDumpType == DUMP_GENS || pParams->eDumpType == DUMP_TIMES || pParams->eDumpType == DUMP_OFFSPRING))
+	{
+		fprintf(stderr, "readParams(): Invalid dumpType (must be %d, %d or %d)\n", DUMP_GENS, DUMP_TIMES, DUMP_OFFSPRING);
+		return 0;
+	}
+	/* negative means epidemics run until they die out */
+	pParams->dMaxTime = -1;
+	cfgGetDouble(pCfg, "maxTime", &pParams->dMaxTime);
+	pParams->nDumpSteps = N_DUMP_STEPS;
+	cfgGetInt(pCfg, "dumpSteps", &pParams->nDumpSteps);
+	if (pParams->eDumpType == DUMP_TIMES && (pParams->dMaxTime <= 0.0 || pParams->nDumpSteps < 1))
+	{
+		fprintf(stderr, "readParams(): dumpType=%d needs maxTime > 0 and dumpSteps >= 1\n", DUMP_TIMES);
+		return 0;
+	}
+	/* whether or not to dump information on host status...note is not required */
+	pParams->bDumpHostStatus = 0;
+	cfgGetInt(pCfg, "dumpHostStatus", &pParams->bDumpHostStatus);
+	/* whether or not to echo every replicate to the screen...note is not required */
+	pParams->bQuiet = 0;
+	cfgGetInt(pCfg, "quiet", &pParams->bQuiet);
+	/* optionally reorder hosts so those close in space are close in memory...note is not required */
+	pParams->eSortHosts = SORT_NONE;
+	cfgGetInt(pCfg, "sortHosts", &pParams->eSortHosts);
+	if (pParams->eSortHosts < SORT_NONE || pParams->eSortHosts > SORT_HILBERT)
+	{
+		fprintf(stderr, "readParams(): Invalid sortHosts (must be %d, %d or %d)\n", SORT_NONE, SORT_MORTON, SORT_HILBERT);
+		return 0;
+	}
+	/* optionally save a binary copy of the hosts, which is much quicker to load next time */
+	pParams->sHostsBinFile[0] = '\0';
+	cfgGetString(pCfg, "writeHostsBin", pParams->sHostsBinFile);
+	/* fixed seed for reproducible runs...note is not required */
+	pParams->nSeed = 0;
+	cfgGetInt(pCfg, "seed", &pParams->nSeed);
+	/* splitting replicates between processes...note is not required */
+	pParams->nShardIndex = 0;
+	pParams->nShardCount = 1;
+	cfgGetInt(pCfg, "shardIndex", &pParams->nShardIndex);
+	cfgGetInt(pCfg, "shardCount", &pParams->nShardCount);
+	if (pParams->nShardCount < 1 || pParams->nShardIndex < 0 || pParams->nShardIndex >= pParams->nShardCount)
+	{
+		fprintf(stderr, "readParams(): Invalid shardIndex/shardCount (need 0 <= shardIndex < shardCount)\n");
+		return 0;
+	}
+	/* stopping once R0 is known well enough...note is not required */
+	pParams->dConvergeTol = 0.0;
+	cfgGetDouble(pCfg, "convergeTol", &pParams->dConvergeTol);
+	pParams->nMinIts = 20;
+	cfgGetInt(pCfg, "minIts", &pParams->nMinIts);
+	if (pParams->dConvergeTol < 0.0
+		|| (pParams->dConvergeTol > 0.0 && (pParams->nMinIts < 2 || pParams->nMinIts > pParams->nNumIts)))
+	{
+		fprintf(stderr, "readParams(): Invalid convergeTol or minIts (need convergeTol >= 0 and 2 <= minIts <= numIts)\n");
+		return 0;
+	}
+	if (pParams->dConvergeTol > 0.0 && (pParams->nShardCount > 1 || pParams->nMaxGen < 1))
+	{
+		fprintf(stderr, "readParams(): convergeTol needs maxGen >= 1 and can't be used with shardCount > 1\n");
+		return 0;
+	}
+	/* batch mode: several host files, one thread pool...note is not required */
+	pParams->sBatchXYFiles[0] = '\0';
+	cfgGetString(pCfg, "batchXYFiles", pParams->sBatchXYFiles);
+	pParams->nThreads = 0;
+	cfgGetInt(pCfg, "numThreads", &pParams->nThreads);
+	pParams->dBatchMemoryMB = 4096.0;
+	cfgGetDouble(pCfg, "batchMemoryMB", &pParams->dBatchMemoryMB);
+	/* scenarios, each a set of edits to the landscape in xyFile...note is not required */
+	pParams->sEditFiles[0] = '\0';
+	cfgGetString(pCfg, "editFiles", pParams->sEditFiles);
+	pParams->sEditFile[0] = '\0';
+	if (pParams->sEditFiles[0] && (pParams->sBatchXYFiles[0] || pParams->nShardCount > 1))
+	{
+		fprintf(stderr, "readParams(): editFiles can't be used with batchXYFiles or shardCount\n");
+		return 0;
+	}
+	if (pParams->nShardCount > 1)
+	{
+		char	sShardFile[_MAX_STR_LEN + 16];
+
+		/* otherwise the shards can't be merged into what a single run would give */
+		if (pParams->nSeed == 0)
+		{
+			fprintf(stderr, "readParams(): seed must be set when shardCount > 1\n");
+			return 0;
+		}
+		shardFileName(sShardFile, pParams->sOutFile, pParams->nShardIndex);
+		if (strlen(sShardFile) >= _MAX_STR_LEN)
+		{
+			fprintf(stderr, "readParams(): outFile name too long\n");
+			return 0;
+		}
+		strcpy(pParams->sOutFile, sShardFile);
+	}
+	/* optional file caching the kernel between runs */
+	pParams->sKernelFile[0] = '\0';
+	cfgGetString(pCfg, "kernelFile", pParams->sKernelFile);
+	/* grid kernel rather than the full matrix...note neither is required */
+	pParams->nKernelGrid = 0;
+	cfgGetInt(pCfg, "kernelGrid", &pParams->nKernelGrid);
+	pParams->dKernelTol = 0.01;
+	cfgGetDouble(pCfg, "kernelTol", &pParams->dKernelTol);
+	if (pParams->nKernelGrid < 0 || pParams->nKernelGrid > _MAX_KERNEL_GRID || pParams->dKernelTol < 0.0)
+	{
+		fprintf(stderr, "readParams(): Invalid kernelGrid or kernelTol (need 0 <= kernelGrid <= %d and kernelTol >= 0)\n", _MAX_KERNEL_GRID);
+		return 0;
+	}
+	if (pParams->nKernelGrid > 0 && pParams->sKernelFile[0])
+	{
+		fprintf(stderr, "readParams(): kernelFile can't be used with kernelGrid (only the full kernel is saved)\n");
+		return 0;
+	}
+	/* simulation engine...note is not required */
+	pParams->eEngine = ENGINE_HOSTS;
+	cfgGetInt(pCfg, "engine", &pParams->eEngine);
+	if (pParams->eEngine != ENGINE_HOSTS && pParams->eEngine != ENGINE_INFECTIVES)
+	{
+		fprintf(stderr, "readParams(): Invalid engine (must be %d or %d)\n", ENGINE_HOSTS, ENGINE_INFECTIVES);
+		return 0;
+	}
+	if (pParams->eEngine == ENGINE_INFECTIVES && (pParams->nKernelGrid > 0 || pParams->sKernelFile[0]))
+	{
+		fprintf(stderr, "readParams(): engine=%d can't be used with kernelGrid or kernelFile\n", ENGINE_INFECTIVES);
+		return 0;
+	}
+	/* how the full kernel is held, and how much memory it may take...note neither are required */
+	pParams->eKernelStore = STORE_AUTO;
+	cfgGetInt(pCfg, "kernelStore", &pParams->eKernelStore);
+	pParams->dMemoryBudgetMB = 0.0;
+	cfgGetDouble(pCfg, "memoryBudget", &pParams->dMemoryBudgetMB);
+	if (pParams->eKernelStore < STORE_AUTO || pParams->eKernelStore > STORE_TILED || pParams->dMemoryBudgetMB < 0.0)
+	{
+		fprintf(stderr, "readParams(): Invalid kernelStore or memoryBudget (need 0 <= kernelStore <= %d and memoryBudget >= 0)\n", STORE_TILED);
+		return 0;
+	}
+	if (pParams->eKernelStore > STORE_DENSE
+		&& (pParams->nKernelGrid > 0 || pParams->eEngine != ENGINE_HOSTS || pParams->sKernelFile[0]))
+	{
+		fprintf(stderr, "readParams(): kernelStore > %d needs engine=%d without kernelGrid, and can't be used with kernelFile\n", STORE_DENSE, ENGINE_HOSTS);
+		return 0;
+	}
+	/* where a tiled kernel is kept, and how many threads read ahead in it...note neither are required */
+	pParams->sKernelTileFile[0] = '\0';
+	cfgGetString(pCfg, "kernelTileFile", pParams->sKernelTileFile);
+	pParams->nTileThreads = 2;
+	cfgGetInt(pCfg, "tilePrefetchThreads", &pParams->nTileThreads);
+	if (pParams->nTileThreads < 0 || pParams->nTileThreads > _MAX_TILE_THREADS)
+	{
+		fprintf(stderr, "readParams(): Invalid tilePrefetchThreads (need 0 <= tilePrefetchThreads <= %d)\n", _MAX_TILE_THREADS);
+		return 0;
+	}
+	if (pParams->eKernelStore == STORE_TILED && pParams->sBatchXYFiles[0])
+	{
+		fprintf(stderr, "readParams(): kernelStore=%d can't be used with batchXYFiles\n", STORE_TILED);
+		return 0;
+	}
+	/* ring culling around each infected host when it is removed...note is not required */
+	pParams->dCullRadius = 0.0;
+	cfgGetDouble(pCfg, "cullRadius", &pParams->dCullRadius);
+	if (pParams->dCullRadius < 0.0)
+	{
+		fprintf(stderr, "readParams(): Invalid cullRadius (must be >= 0)\n");
+		return 0;
+	}
+	if (pParams->dCullRadius > 0.0 && pParams->sBatchXYFiles[0])
+	{
+		/* replicates of a landscape finish in any order, and the cull log is written as they do */
+		fprintf(stderr, "readParams(): cullRadius can't be used with batchXYFiles\n");
+		return 0;
+	}
+	/* replicates run in lockstep...note is not required */
+	pParams->nLanes = 1;
+	cfgGetInt(pCfg, "lanes", &pParams->nLanes);
+	if (pParams->nLanes != 1 && pParams->nLanes != 2 && pParams->nLanes != 4 && pParams->nLanes != _MAX_LANES)
+	{
+		fprintf(stderr, "readParams(): Invalid lanes (must be 1, 2, 4 or %d)\n", _MAX_LANES);
+		return 0;
+	}
+	if (pParams->nLanes > 1 && (pParams->eEngine != ENGINE_HOSTS || pParams->nKernelGrid > 0 || pParams->eKernelStore > STORE_DENSE
+		|| pParams->sBatchXYFiles[0] || pParams->dCullRadius > 0.0))
+	{
+		fprintf(stderr, "readParams(): lanes > 1 needs engine=%d and the full kernel (kernelStore 0 or %d), and can't be used with batchXYFiles or cullRadius\n", ENGINE_HOSTS, STORE_DENSE);
+		return 0;
+	}
+	/* threads sharing each event on a big landscape...note is not required */
+	pParams->nEventThreads = 0;
+	cfgGetInt(pCfg, "eventThreads", &pParams->nEventThreads);
+	if (pParams->nEventThreads < 0)
+	{
+		fprintf(stderr, "readParams(): Invalid eventThreads\n");
+		return 0;
+	}
+	/* placement of the kernel in memory...note neither are required */
+	pParams->ePages = PAGES_TRANSPARENT;
+	cfgGetInt(pCfg, "hugePages", &pParams->ePages);
+	pParams->bNumaPlacement = 1;
+	cfgGetInt(pCfg, "numaPlacement", &pParams->bNumaPlacement);
+	if (pParams->ePages < PAGES_NORMAL || pParams->ePages > PAGES_RESERVED)
+	{
+		fprintf(stderr, "readParams(): Invalid hugePages (must be %d, %d or %d)\n", PAGES_NORMAL, PAGES_TRANSPARENT, PAGES_RESERVED);
+		return 0;
+	}
+	if (pParams->nLanes > 1 && pParams->bDumpHostStatus && pParams->dConvergeTol > 0.0)
+	{
+		/* replicates after the one that converged may already have dumped their hosts */
+		fprintf(stderr, "readParams(): lanes > 1 can't be used with dumpHostStatus and convergeTol together\n");
+		return 0;
+	}
+	/* checkpointing, and whether to resume from an earlier checkpoint...note neither are required */
+	pParams->nCheckpointEvery = 0;
+	cfgGetInt(pCfg, "checkpointEvery", &pParams->nCheckpointEvery);
+	pParams->bResume = 0;
+	cfgGetInt(pCfg, "resume", &pParams->bResume);
+	if (pParams->nCheckpointEvery < 0)
+	{
+		fprintf(stderr, "readParams(): Invalid checkpointEvery (must be >= 0)\n");
+		return 0;
+	}
+	/* only now that everything it can't be used with has been read */
+	if (pParams->sBatchXYFiles[0]
+		&& (pParams->nShardCount > 1 || pParams->dConvergeTol > 0.0 || pParams->nCheckpointEvery > 0
+			|| pParams->bResume || pParams->sHostsBinFile[0] || pParams->sKernelFile[0]))
+	{
+		fprintf(stderr, "readParams(): batchXYFiles can't be used with shardCount, convergeTol, checkpointEvery, resume, writeHostsBin or kernelFile\n");
+		return 0;
+	}
+	/* an optional key with a value that couldn't be read would otherwise just keep its default */
+	if (cfgBadValues(pCfg) > 0)
+	{
+		fprintf(stderr, "readParams(): %d value(s) couldn't be read\n", cfgBadValues(pCfg));
+		return 0;
+	}
+	/* create filename for dump of all parameters and actually do the dump */
+	{
+		char *sTmp, *p;
+
+		sTmp = strdup(pParams->sOutFile);
+		if (!sTmp)
+		{
+			fprintf(stderr, "readParams(): Out of memory\n");
+			return 0;
+		}
+		/* strip any extension */
+		if (p = strrchr(sTmp, '.'))
+		{
+			*p = '\0';
+		}
+		sprintf(pParams->sParamDumpFile, "%s_param.csv", sTmp);
+		sprintf(pParams->sCheckpointFile, "%s_checkpoint.bin", sTmp);
+		if (!pParams->sKernelTileFile[0])
+		{
+			sprintf(pParams->sKernelTileFile, "%s_tiles.bin", sTmp);
+		}
+		free(sTmp);
+	}
+	return 1;
+}
+
+int readParams(t_Params *pParams, int argc, char **argv)
+{
+	char		szCfgFile[_MAX_STR_LEN];
+	t_Config	sCfg;
+	int			retVal;
+
+	fprintf(stdout, "readParams()\n");
+	if (!getCfgFileName(argv[0], szCfgFile))
+	{
+		fprintf(stderr, "readParams(): Couldn't find cfg file for program name '%s'\n", argv[0]);
+		return 0;
+	}
+	/* one pass over the command line and cfg file */
+	if (!loadConfig(&sCfg, argc, argv, szCfgFile))
+	{
+		fprintf(stderr, "readParams(): Couldn't read configuration\n");
+		return 0;
+	}
+	retVal = readParamsFromConfig(pParams, &sCfg);
+	/* anything left over is a typo, which is fatal if on the command line */
+	if (retVal && cfgCheckUnused(&sCfg) > 0)
+	{
+		fprintf(stderr, "readParams(): Unknown key(s) on command line\n");
+		retVal = 0;
+	}
+	freeConfig(&sCfg);
+	/* in batch mode, or with editFiles, each landscape has its own */
+	if (retVal && !pParams->sBatchXYFiles[0] && !pParams->sEditFiles[0])
+	{
+		retVal = dumpParametersToCSV(pParams);
+	}
+	return retVal;
+}
+
+/*
+	whether the system puts memory asked for with MADV_HUGEPAGE in transparent huge pages
+*/
+int transparentHugePages()
+{
+#ifdef __linux__
+	FILE	*fIn;
+	char	sLine[256];
+	int		retVal;
+
+	retVal = 0;
+	fIn = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if (fIn)
+	{
+		retVal = fgets(sLine, sizeof(sLine), fIn) && !strstr(sLine, "[never]");
+		fclose(fIn);
+	}
+	return retVal;
+#else
+	return 0;
+#endif
+}
+
+/*
+	memory the system could give this process now without swapping, or 0 if it won't say
+*/
+double availableMemoryMB()
+{
+#ifdef _WIN32
+	MEMORYSTATUSEX	sStatus;
+
+	sStatus.dwLength = sizeof(sStatus);
+	if (GlobalMemoryStatusEx(&sStatus))
+	{
+		return (double)sStatus.ullAvailPhys / (1024.0 * 1024.0);
+	}
+	return 0.0;
+#else
+	FILE	*fIn;
+	char	sLine[256];
+	double	dKB;
+
+	/* counts memory the system would free from its caches, which the free pages don't */
+	fIn = fopen("/proc/meminfo", "r");
+	if (fIn)
+	{
+		while (fgets(sLine, sizeof(sLine), fIn))
+		{
+			if (sscanf(sLine, "MemAvailable: %lf", &dKB) == 1)
+			{
+				fclose(fIn);
+				return dKB / 1024.0;
+			}
+		}
+		fclose(fIn);
+	}
+#ifdef _SC_AVPHYS_PAGES
+	return (double)sysconf(_SC_AVPHYS_PAGES) * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#else
+	return 0.0;
+#endif
+#endif
+}
+
+/*
+	allocate nBytes for a kernel, in the pages asked for by hugePages and spread over the
+	NUMA nodes if numaPlacement is set, falling back on malloc(); reports what it got
+
+	every event reads a whole row of the kernel, from all over it, so in ordinary pages a
+	big kernel misses the TLB all the time; left to the first thread to touch it, it would
+	all be on one node, and threads on the others would be held up reading it
+*/
+char *allocKernelMemory(t_Params *pParams, size_t nBytes, t_KernelMemory *pMem)
+{
+	const char	*sPages;
+	int			nNodes;
+
+	memset(pMem, 0, sizeof(t_KernelMemory));
+	sPages = "ordinary pages";
+	nNodes = 1;
+#ifdef __linux__
+	if (pParams->ePages != PAGES_NORMAL && nBytes >= _HUGE_PAGE_BYTES)
+	{
+		unsigned long long	nNodeMask;
+		unsigned long		nPolicyMask;
+		size_t				nSize, nLead;
+		char				*pBase;
+
+		nSize = (nBytes + _HUGE_PAGE_BYTES - 1) / _HUGE_PAGE_BYTES * _HUGE_PAGE_BYTES;
+#ifdef MAP_HUGETLB
+		if (pParams->ePages == PAGES_RESERVED)
+		{
+			pBase = mmap(NULL, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (pBase != MAP_FAILED)
+			{
+				pMem->pData = pBase;
+				sPages = "reserved huge pages";
+			}
+		}
+#endif
+		if (!pMem->pData)
+		{
+			/* map a huge page more than needed, and give back what's either side of the first boundary */
+			pBase = mmap(NULL, nSize + _HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (pBase != MAP_FAILED)
+			{
+				nLead = (_HUGE_PAGE_BYTES - (size_t)pBase % _HUGE_PAGE_BYTES) % _HUGE_PAGE_BYTES;
+				if (nLead > 0)
+				{
+					munmap(pBase, nLead);
+				}
+				munmap(pBase + nLead + nSize, _HUGE_PAGE_BYTES - nLead);
+				pMem->pData = pBase + nLead;
+#ifdef MADV_HUGEPAGE
+				if (madvise(pMem->pData, nSize, MADV_HUGEPAGE) == 0 && transparentHugePages())
+				{
+					sPages = "transparent huge pages";
+				}
+#endif
+			}
+		}
+		if (pMem->pData)
+		{
+			pMem->nSize = nSize;
+			pMem->bMapped = 1;
+		}
+		/* nothing has been written yet, so no page has been placed */
+#ifdef SYS_mbind
+		if (pMem->pData && pParams->bNumaPlacement && (nNodes = numaNodes(&nNodeMask)) > 1)
+		{
+			nPolicyMask = (unsigned long)nNodeMask;
+			if (syscall(SYS_mbind, pMem->pData, nSize, _MPOL_INTERLEAVE, &nPolicyMask, 8 * sizeof(unsigned long) + 1, 0) != 0)
+			{
+				nNodes = 1;
+			}
+		}
+#endif
+	}
+#endif
+	if (!pMem->pData)
+	{
+		pMem->pData = malloc(nBytes);
+		pMem->nSize = nBytes;
+	}
+	if (pMem->pData)
+	{
+		echoToScreen(pParams, "Kernel is %.1f MB in %s", nBytes / (1024.0 * 1024.0), sPages);
+		if (nNodes > 1)
+		{
+			echoToScreen(pParams, ", spread over %d NUMA nodes with worker threads pinned to them in turn", nNodes);
+		}
+		echoToScreen(pParams, "\n");
+	}
+	return pMem->pData;
+}
+
+void freeKernelMemory(t_KernelMemory *pMem)
+{
+	if (pMem->bMapped)
+	{
+#ifndef _WIN32
+		munmap(pMem->pData, pMem->nSize);
+#endif
+	}
+	else
+	{
+		free(pMem->pData);
+	}
+	memset(pMem, 0, sizeof(t_KernelMemory));
+}
+
+/*
+	fill in the header identifying a cached kernel for these hosts and parameters
+*/
+void makeKernelFileHeader(t_KernelFileHeader *pHeader, t_Params *pParams, t_Hosts *pHosts)
+{
+	int		i;
+
+	memset(pHeader, 0, sizeof(t_KernelFileHeader));
+	memcpy(pHeader->sMagic, _KERNEL_FILE_MAGIC, sizeof(pHeader->sMagic));
+	pHeader->nHosts = pHosts->nHosts;
+	pHeader->eKernelType = pParams->eKernelType;
+	pHeader->dA = pParams->dA;
+	pHeader->dC = pParams->dC;
+	pHeader->nHostsHash = _FNV_OFFSET;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		pHeader->nHostsHash = hashBytes(pHeader->nHostsHash, &pHosts->aHosts[i].dX, sizeof(double));
+		pHeader->nHostsHash = hashBytes(pHeader->nHostsHash, &pHosts->aHosts[i].dY, sizeof(double));
+	}
+}
+
+/*
+	read the kernel from pParams->sKernelFile, if it was saved for these hosts and parameters
+*/
+int loadKernelFile(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	FILE				*fIn;
+	t_KernelFileHeader	sWant, sHeader;
+	size_t				nCells;
+	int					retVal;
+
+	retVal = 0;
+	fIn = fopen(pParams->sKernelFile, "rb");
+	if (fIn)
+	{
+		makeKernelFileHeader(&sWant, pParams, pHosts);
+		if (fread(&sHeader, sizeof(t_KernelFileHeader), 1, fIn) == 1
+			&& memcmp(&sHeader, &sWant, sizeof(t_KernelFileHeader)) == 0)
+		{
+			nCells = (size_t)pHosts->nHosts * pHosts->nHosts;
+			pKernel->aKernel = (double*)allocKernelMemory(pParams, sizeof(double) * nCells, &pKernel->sMemory);
+			if (pKernel->aKernel && fread(pKernel->aKernel, sizeof(double), nCells, fIn) == nCells)
+			{
+				echoToScreen(pParams, "Read kernel from %s\n", pParams->sKernelFile);
+				retVal = 1;
+			}
+			else if (pKernel->aKernel)
+			{
+				freeKernelMemory(&pKernel->sMemory);
+				pKernel->aKernel = NULL;
+			}
+		}
+		fclose(fIn);
+		if (!retVal)
+		{
+			fprintf(stderr, "loadKernelFile(): %s does not match these hosts and kernel, recalculating\n", pParams->sKernelFile);
+		}
+	}
+	return retVal;
+}
+
+int saveKernelFile(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	FILE				*fOut;
+	t_KernelFileHeader	sHeader;
+	size_t				nCells;
+	int					retVal;
+
+	retVal = 0;
+	fOut = fopen(pParams->sKernelFile, "wb");
+	if (fOut)
+	{
+		makeKernelFileHeader(&sHeader, pParams, pHosts);
+		nCells = (size_t)pHosts->nHosts * pHosts->nHosts;
+		if (fwrite(&sHeader, sizeof(t_KernelFileHeader), 1, fOut) == 1
+			&& fwrite(pKernel->aKernel, sizeof(double), nCells, fOut) == nCells)
+		{
+			retVal = 1;
+		}
+		if (fclose(fOut) != 0)
+		{
+			retVal = 0;
+		}
+	}
+	if (!retVal)
+	{
+		fprintf(stderr, "saveKernelFile(): Couldn't write %s\n", pParams->sKernelFile);
+		remove(pParams->sKernelFile);
+	}
+	return retVal;
+}
+
+int cellsAreNear(int cellOne, int cellTwo, t_Kernel *pKernel)
+{
+	return abs(pKernel->aCellGX[cellOne] - pKernel->aCellGX[cellTwo]) <= pKernel->nNear
+		&& abs(pKernel->aCellGY[cellOne] - pKernel->aCellGY[cellTwo]) <= pKernel->nNear;
+}
+
+double farKernel(int cellOne, int cellTwo, t_Kernel *pKernel)
+{
+	int		dx, dy;
+
+	dx = pKernel->aCellGX[cellOne] - pKernel->aCellGX[cellTwo] + pKernel->nGrid - 1;
+	dy = pKernel->aCellGY[cellOne] - pKernel->aCellGY[cellTwo] + pKernel->nGrid - 1;
+	return pKernel->aFarKernel[dx * (2 * pKernel->nGrid - 1) + dy];
+}
+
+double gridKernel(int hostOne, int hostTwo, t_Kernel *pKernel, t_Hosts *pHosts, t_Params *pParams)
+{
+	int		cellOne, cellTwo;
+
+	cellOne = pKernel->aHostCell[hostOne];
+	cellTwo = pKernel->aHostCell[hostTwo];
+	if (cellsAreNear(cellOne, cellTwo, pKernel))
+	{
+		return pKernel->pSpec->pfPair(hostOne, hostTwo, pKernel, pHosts, pParams);
+	}
+	return farKernel(cellOne, cellTwo, pKernel);
+}
+
+/*
+	pick how many cells either side are near, so using cell centres for the rest is within kernelTol
+
+	hosts in cells whose centres are dc apart are between dc-sqrt(2)*size and dc+sqrt(2)*size
+	apart, so the error per pair is bounded by the kernel at those distances. For each cell this
+	is added up over every host in a far cell, relative to a lower bound on the force of infection
+	there if every other host were infected, and the worst cell is what has to be within kernelTol
+*/
+int chooseNearCells(t_Params *pParams, t_Kernel *pKernel)
+{
+	int		nGrid, i, j, g, dx, dy, nHostsTwo;
+	double	dc, dSlack, dK, dMin, dMax, dDenom, dSum;
+	double	*aErr, *aLow, *aErrByG, *aWorst;
+
+	nGrid = pKernel->nGrid;
+	aErr = malloc(sizeof(double) * nGrid * nGrid);
+	aLow = malloc(sizeof(double) * nGrid * nGrid);
+	aErrByG = malloc(sizeof(double) * nGrid);
+	aWorst = calloc(nGrid, sizeof(double));
+	if (!aErr || !aLow || !aErrByG || !aWorst)
+	{
+		fprintf(stderr, "chooseNearCells(): Out of memory\n");
+		free(aErr);
+		free(aLow);
+		free(aErrByG);
+		free(aWorst);
+		return 0;
+	}
+	/* per pair error, and lower bound on the kernel, by offset between cells */
+	dSlack = sqrt(2.0) * pKernel->dCellSize;
+	for (dx = 0; dx < nGrid; dx++)
+	{
+		for (dy = 0; dy < nGrid; dy++)
+		{
+			dc = pKernel->dCellSize * sqrt((double)(dx * dx + dy * dy));
+			dK = dispKernel(dc, pParams->dA, pParams->dC, pParams->eKernelType);
+			dMin = dispKernel(dc > dSlack ? dc - dSlack : 0.0, pParams->dA, pParams->dC, pParams->eKernelType);
+			dMax = dispKernel(dc + dSlack, pParams->dA, pParams->dC, pParams->eKernelType);
+			aErr[dx * nGrid + dy] = (dMin - dK > dK - dMax) ? dMin - dK : dK - dMax;
+			aLow[dx * nGrid + dy] = dMax;
+		}
+	}
+	for (i = 0; i < pKernel->nCells; i++)
+	{
+		memset(aErrByG, 0, sizeof(double) * nGrid);
+		dDenom = 0.0;
+		for (j = 0; j < pKernel->nCells; j++)
+		{
+			dx = abs(pKernel->aCellGX[i] - pKernel->aCellGX[j]);
+			dy = abs(pKernel->aCellGY[i] - pKernel->aCellGY[j]);
+			g = dx > dy ? dx : dy;
+			nHostsTwo = pKernel->aCellStart[j + 1] - pKernel->aCellStart[j] - (i == j);
+			aErrByG[g] += nHostsTwo * aErr[dx * nGrid + dy];
+			dDenom += nHostsTwo * aLow[dx * nGrid + dy];
+		}
+		if (dDenom <= 0.0)
+		{
+			continue;
+		}
+		/* everything more than g cells away is far when nNear = g */
+		dSum = 0.0;
+		for (g = nGrid - 1; g >= 0; g--)
+		{
+			if (dSum / dDenom > aWorst[g])
+			{
+				aWorst[g] = dSum / dDenom;
+			}
+			dSum += aErrByG[g];
+		}
+	}
+	pKernel->nNear = 0;
+	while (pKernel->nNear < nGrid - 1 && aWorst[pKernel->nNear] > pParams->dKernelTol)
+	{
+		pKernel->nNear++;
+	}
+	pKernel->dMaxError = aWorst[pKernel->nNear];
+	free(aErr);
+	free(aLow);
+	free(aErrByG);
+	free(aWorst);
+	return 1;
+}
+
+/*
+	bin the hosts into a grid over their bounding box, and set up the far field kernel
+*/
+int calcGridKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		nGrid, nSide, i, k, gx, gy, dx, dy, *aFullCell;
+	double	dMaxX, dMaxY, dK;
+
+	nGrid = pParams->nKernelGrid;
+	nSide = 2 * nGrid - 1;
+	pKernel->nGrid = nGrid;
+	pKernel->aHostCell = malloc(sizeof(int) * pHosts->nHosts);
+	pKernel->aCellHosts = malloc(sizeof(int) * pHosts->nHosts);
+	pKernel->aCellStart = malloc(sizeof(int) * (pHosts->nHosts + 1));
+	pKernel->aCellGX = malloc(sizeof(int) * pHosts->nHosts);
+	pKernel->aCellGY = malloc(sizeof(int) * pHosts->nHosts);
+	pKernel->aFarKernel = malloc(sizeof(double) * nSide * nSide);
+	aFullCell = malloc(sizeof(int) * (nGrid * nGrid + 1));
+	if (!pKernel->aHostCell || !pKernel->aCellHosts || !pKernel->aCellStart || !pKernel->aCellGX
+		|| !pKernel->aCellGY || !pKernel->aFarKernel || !aFullCell)
+	{
+		fprintf(stderr, "calcGridKernel(): Out of memory\n");
+		free(aFullCell);
+		return 0;
+	}
+	/* square cells covering the bounding box */
+	pKernel->dMinX = dMaxX = pHosts->aHosts[0].dX;
+	pKernel->dMinY = dMaxY = pHosts->aHosts[0].dY;
+	for (i = 1; i < pHosts->nHosts; i++)
+	{
+		pKernel->dMinX = pHosts->aHosts[i].dX < pKernel->dMinX ? pHosts->aHosts[i].dX : pKernel->dMinX;
+		pKernel->dMinY = pHosts->aHosts[i].dY < pKernel->dMinY ? pHosts->aHosts[i].dY : pKernel->dMinY;
+		dMaxX = pHosts->aHosts[i].dX > dMaxX ? pHosts->aHosts[i].dX : dMaxX;
+		dMaxY = pHosts->aHosts[i].dY > dMaxY ? pHosts->aHosts[i].dY : dMaxY;
+	}
+	pKernel->dCellSize = ((dMaxX - pKernel->dMinX > dMaxY - pKernel->dMinY) ? dMaxX - pKernel->dMinX : dMaxY - pKernel->dMinY) / nGrid;
+	if (pKernel->dCellSize <= 0.0)
+	{
+		pKernel->dCellSize = 1.0;	/* all hosts in the same place */
+	}
+	/* count hosts in each cell of the full grid, then number the cells that have any */
+	memset(aFullCell, 0, sizeof(int) * (nGrid * nGrid + 1));
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		gx = (int)((pHosts->aHosts[i].dX - pKernel->dMinX) / pKernel->dCellSize);
+		gy = (int)((pHosts->aHosts[i].dY - pKernel->dMinY) / pKernel->dCellSize);
+		gx = gx < nGrid ? gx : nGrid - 1;
+		gy = gy < nGrid ? gy : nGrid - 1;
+		pKernel->aHostCell[i] = gx * nGrid + gy;
+		aFullCell[gx * nGrid + gy]++;
+	}
+	pKernel->nCells = 0;
+	pKernel->aCellStart[0] = 0;
+	for (k = 0; k < nGrid * nGrid; k++)
+	{
+		if (aFullCell[k] > 0)
+		{
+			pKernel->aCellGX[pKernel->nCells] = k / nGrid;
+			pKernel->aCellGY[pKernel->nCells] = k % nGrid;
+			pKernel->aCellStart[pKernel->nCells + 1] = pKernel->aCellStart[pKernel->nCells] + aFullCell[k];
+			aFullCell[k] = pKernel->nCells;
+			pKernel->nCells++;
+		}
+	}
+	/* hosts within a cell stay in the order they were loaded */
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		k = aFullCell[pKernel->aHostCell[i]];
+		pKernel->aHostCell[i] = k;
+		pKernel->aCellHosts[pKernel->aCellStart[k]++] = i;
+	}
+	for (k = pKernel->nCells; k > 0; k--)
+	{
+		pKernel->aCellStart[k] = pKernel->aCellStart[k - 1];
+	}
+	pKernel->aCellStart[0] = 0;
+	free(aFullCell);
+	/* kernel between cell centres only depends on their offset */
+	for (dx = 0; dx < nGrid; dx++)
+	{
+		for (dy = 0; dy < nGrid; dy++)
+		{
+			dK = dispKernel(pKernel->dCellSize * sqrt((double)(dx * dx + dy * dy)), pParams->dA, pParams->dC, pParams->eKernelType);
+			pKernel->aFarKernel[(nGrid - 1 + dx) * nSide + nGrid - 1 + dy] = dK;
+			pKernel->aFarKernel[(nGrid - 1 - dx) * nSide + nGrid - 1 + dy] = dK;
+			pKernel->aFarKernel[(nGrid - 1 + dx) * nSide + nGrid - 1 - dy] = dK;
+			pKernel->aFarKernel[(nGrid - 1 - dx) * nSide + nGrid - 1 - dy] = dK;
+		}
+	}
+	if (!chooseNearCells(pParams, pKernel))
+	{
+		return 0;
+	}
+	fprintf(stdout, "Grid kernel: %d cells with hosts, exact within %d cells, force of infection out by at most %.3g%%\n",
+		pKernel->nCells, pKernel->nNear, 100.0 * pKernel->dMaxError);
+	dK = pKernel->pSpec->pfCutoff(pParams->dA, pParams->dC, pParams->dKernelTol);
+	if (dK < HUGE_VAL)
+	{
+		fprintf(stdout, "Grid kernel: all but kernelTol of %s dispersal is within %.3g cells\n", pKernel->pSpec->sName, dK / pKernel->dCellSize);
+	}
+	return 1;
+}
+
+/*
+	alias table for picking j with probability aWeight[j]/dSum in O(1), using Vose's method
+
+	aWeight[] is overwritten; aSmall[] and aLarge[] are scratch, of n entries each
+*/
+void buildAliasTable(double *aWeight, int n, double dSum, t_AliasEntry *aAlias, int *aSmall, int *aLarge)
+{
+	int		j, nSmall, nLarge, nOne, nTwo;
+
+	nSmall = nLarge = 0;
+	for (j = 0; j < n; j++)
+	{
+		aWeight[j] = (dSum > 0.0) ? aWeight[j] * n / dSum : 1.0;
+		if (aWeight[j] < 1.0)
+		{
+			aSmall[nSmall++] = j;
+		}
+		else
+		{
+			aLarge[nLarge++] = j;
+		}
+	}
+	/* each small entry is topped up to 1 from a large one, which may then become small */
+	while (nSmall > 0 && nLarge > 0)
+	{
+		nOne = aSmall[--nSmall];
+		nTwo = aLarge[--nLarge];
+		aAlias[nOne].fProb = (float)aWeight[nOne];
+		aAlias[nOne].nAlias = nTwo;
+		aWeight[nTwo] = (aWeight[nTwo] + aWeight[nOne]) - 1.0;
+		if (aWeight[nTwo] < 1.0)
+		{
+			aSmall[nSmall++] = nTwo;
+		}
+		else
+		{
+			aLarge[nLarge++] = nTwo;
+		}
+	}
+	/* anything left is 1, up to rounding */
+	while (nLarge > 0)
+	{
+		nTwo = aLarge[--nLarge];
+		aAlias[nTwo].fProb = 1.0f;
+		aAlias[nTwo].nAlias = nTwo;
+	}
+	while (nSmall > 0)
+	{
+		nOne = aSmall[--nSmall];
+		aAlias[nOne].fProb = 1.0f;
+		aAlias[nOne].nAlias = nOne;
+	}
+}
+
+/*
+	infective engine: alias table for each host's kernel row, and the row totals
+*/
+int calcAliasKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		i, j, nHosts, *aSmall, *aLarge;
+	double	*aRow;
+
+	nHosts = pHosts->nHosts;
+	pKernel->aAlias = (t_AliasEntry*)allocKernelMemory(pParams, sizeof(t_AliasEntry) * (size_t)nHosts * nHosts, &pKernel->sMemory);
+	pKernel->aRowSum = malloc(sizeof(double) * nHosts);
+	aRow = malloc(sizeof(double) * nHosts);
+	aSmall = malloc(sizeof(int) * nHosts);
+	aLarge = malloc(sizeof(int) * nHosts);
+	if (!pKernel->aAlias || !pKernel->aRowSum || !aRow || !aSmall || !aLarge)
+	{
+		fprintf(stderr, "calcAliasKernel(): Out of memory for %d hosts\n", nHosts);
+		free(aRow);
+		free(aSmall);
+		free(aLarge);
+		return 0;
+	}
+	for (i = 0; i < nHosts; i++)
+	{
+		pKernel->pSpec->pfRow(i, aRow, pParams, pHosts, pKernel);
+		pKernel->aRowSum[i] = 0.0;
+		for (j = 0; j < nHosts; j++)
+		{
+			pKernel->aRowSum[i] += aRow[j];
+		}
+		buildAliasTable(aRow, nHosts, pKernel->aRowSum[i], pKernel->aAlias + (size_t)i * nHosts, aSmall, aLarge);
+	}
+	free(aRow);
+	free(aSmall);
+	free(aLarge);
+	echoToScreen(pParams, "Set up %s kernel alias tables\n", pKernel->pSpec->sName);
+	return 1;
+}
+
+/*
+	memory used by the kernel, as counted against batchMemoryMB
+*/
+double kernelMB(t_Kernel *pKernel, t_Hosts *pHosts)
+{
+	double	dBytes;
+
+	if (pKernel->nGrid > 0)
+	{
+		dBytes = sizeof(double) * (2.0 * pKernel->nGrid - 1) * (2.0 * pKernel->nGrid - 1)
+			+ sizeof(int) * (3.0 * pHosts->nHosts + 1);
+	}
+	else
+	{
+		/* the alias tables' row totals aren't in sMemory */
+		dBytes = (double)pKernel->sMemory.nSize + (pKernel->aRowSum ? sizeof(double) * (double)pHosts->nHosts : 0.0);
+	}
+	return dBytes / (1024.0 * 1024.0);
+}
+
+/*
+	where the kernel between two different hosts is in a packed kernel, which has the
+	pairs i > j row by row (the kernel is symmetric, and zero from a host onto itself)
+*/
+size_t packedPos(int hostOne, int hostTwo)
+{
+	size_t	i, j;
+
+	if (hostOne > hostTwo)
+	{
+		i = hostOne;
+		j = hostTwo;
+	}
+	else
+	{
+		i = hostTwo;
+		j = hostOne;
+	}
+	return i * (i - 1) / 2 + j;
+}
+
+/*
+	kernel from hostOne to hostTwo in a sparse kernel: found in hostTwo's list of near
+	hosts by bisection, and zero if it isn't there
+*/
+double sparseKernel(int hostOne, int hostTwo, t_Kernel *pKernel)
+{
+	size_t	nLow, nHigh, nMid;
+
+	nLow = pKernel->aNbrStart[hostTwo];
+	nHigh = pKernel->aNbrStart[hostTwo + 1];
+	while (nLow < nHigh)
+	{
+		nMid = nLow + (nHigh - nLow) / 2;
+		if (pKernel->aNbrHost[nMid] < hostOne)
+		{
+			nLow = nMid + 1;
+		}
+		else
+		{
+			nHigh = nMid;
+		}
+	}
+	return (nLow < pKernel->aNbrStart[hostTwo + 1] && pKernel->aNbrHost[nLow] == hostOne) ? pKernel->aNbrKernel[nLow] : 0.0;
+}
+
+/* hosts in order of x, for finding all the pairs closer than some distance */
+typedef struct {
+	double	dX;
+	int		nHost;
+} t_SweepKey;
+
+int compareSweepKeys(const void *pOne, const void *pTwo)
+{
+	const t_SweepKey	*pA, *pB;
+
+	pA = (const t_SweepKey *)pOne;
+	pB = (const t_SweepKey *)pTwo;
+	if (pA->dX != pB->dX)
+	{
+		return (pA->dX < pB->dX) ? -1 : 1;
+	}
+	return (pA->nHost > pB->nHost) - (pA->nHost < pB->nHost);
+}
+
+int compareInts(const void *pOne, const void *pTwo)
+{
+	int		nA, nB;
+
+	nA = *(const int *)pOne;
+	nB = *(const int *)pTwo;
+	return (nA > nB) - (nA < nB);
+}
+
+/*
+	sparse kernel: the pairs of hosts no more than pKernel->dCutoff apart, found by sweeping
+	along x (so only pairs that close in x are looked at), with each host's list in order
+*/
+int buildSparseKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	t_SweepKey		*aKeys;
+	t_SingleHost	*aHosts;
+	size_t			*aFill, nPairs, nBytes, k;
+	char			*pNext;
+	double			dR2, dx, dy;
+	int				nHosts, nPass, p, q, i, j;
+
+	nHosts = pHosts->nHosts;
+	aHosts = pHosts->aHosts;
+	dR2 = pKernel->dCutoff * pKernel->dCutoff;
+	aKeys = malloc(sizeof(t_SweepKey) * nHosts);
+	aFill = calloc(nHosts + 1, sizeof(size_t));
+	if (!aKeys || !aFill)
+	{
+		free(aKeys);
+		free(aFill);
+		return 0;
+	}
+	for (i = 0; i < nHosts; i++)
+	{
+		aKeys[i].dX = aHosts[i].dX;
+		aKeys[i].nHost = i;
+	}
+	qsort(aKeys, nHosts, sizeof(t_SweepKey), compareSweepKeys);
+	/* first pass counts each host's neighbours, the second fills them in */
+	for (nPass = 0; nPass < 2; nPass++)
+	{
+		for (p = 0; p < nHosts; p++)
+		{
+			i = aKeys[p].nHost;
+			for (q = p + 1; q < nHosts && aKeys[q].dX - aKeys[p].dX <= pKernel->dCutoff; q++)
+			{
+				j = aKeys[q].nHost;
+				dx = aHosts[i].dX - aHosts[j].dX;
+				dy = aHosts[i].dY - aHosts[j].dY;
+				if (dx * dx + dy * dy <= dR2)
+				{
+					if (nPass == 0)
+					{
+						aFill[i]++;
+						aFill[j]++;
+					}
+					else
+					{
+						pKernel->aNbrHost[aFill[i]++] = j;
+						pKernel->aNbrHost[aFill[j]++] = i;
+					}
+				}
+			}
+		}
+		if (nPass == 0)
+		{
+			nPairs = 0;
+			for (i = 0; i < nHosts; i++)
+			{
+				nPairs += aFill[i];
+			}
+			/* in one block, widest first so each part is aligned */
+			nBytes = sizeof(double) * nPairs + sizeof(size_t) * (nHosts + 1) + sizeof(int) * nPairs;
+			pNext = allocKernelMemory(pParams, nBytes, &pKernel->sMemory);
+			if (!pNext)
+			{
+				free(aKeys);
+				free(aFill);
+				return 0;
+			}
+			pKernel->aNbrKernel = (double*)pNext;
+			pKernel->aNbrStart = (size_t*)(pNext + sizeof(double) * nPairs);
+			pKernel->aNbrHost = (int*)(pNext + sizeof(double) * nPairs + sizeof(size_t) * (nHosts + 1));
+			pKernel->aNbrStart[0] = 0;
+			for (i = 0; i < nHosts; i++)
+			{
+				pKernel->aNbrStart[i + 1] = pKernel->aNbrStart[i] + aFill[i];
+				aFill[i] = pKernel->aNbrStart[i];
+			}
+		}
+	}
+	for (i = 0; i < nHosts; i++)
+	{
+		qsort(pKernel->aNbrHost + pKernel->aNbrStart[i], pKernel->aNbrStart[i + 1] - pKernel->aNbrStart[i], sizeof(int), compareInts);
+		for (k = pKernel->aNbrStart[i]; k < pKernel->aNbrStart[i + 1]; k++)
+		{
+			pKernel->aNbrKernel[k] = pKernel->pSpec->pfPair(i, pKernel->aNbrHost[k], pKernel, pHosts, pParams);
+		}
+	}
+	free(aKeys);
+	free(aFill);
+	echoToScreen(pParams, "Sparse kernel: %.1f neighbours per host within %.4g, leaving out all but kernelTol=%g of dispersal\n",
+		nHosts > 0 ? (double)nPairs / nHosts : 0.0, pKernel->dCutoff, pParams->dKernelTol);
+	return 1;
+}
+
+/*
+	packed kernel, in double or single precision: each row from the registry, of which
+	the part before the diagonal is kept
+*/
+int buildPackedKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	double	*aRow;
+	size_t	nPairs, nRowStart;
+	int		i, j, bSingle;
+
+	bSingle = (pKernel->eStore == STORE_SINGLE);
+	nPairs = (size_t)pHosts->nHosts * (pHosts->nHosts - 1) / 2;
+	aRow = malloc(sizeof(double) * pHosts->nHosts);
+	if (!aRow || !allocKernelMemory(pParams, (bSingle ? sizeof(float) : sizeof(double)) * (nPairs > 0 ? nPairs : 1), &pKernel->sMemory))
+	{
+		free(aRow);
+		return 0;
+	}
+	pKernel->aKernel = bSingle ? NULL : (double*)pKernel->sMemory.pData;
+	pKernel->aKernelSingle = bSingle ? (float*)pKernel->sMemory.pData : NULL;
+	for (i = 1; i < pHosts->nHosts; i++)
+	{
+		pKernel->pSpec->pfRow(i, aRow, pParams, pHosts, pKernel);
+		nRowStart = packedPos(i, 0);
+		for (j = 0; j < i; j++)
+		{
+			if (bSingle)
+			{
+				pKernel->aKernelSingle[nRowStart + j] = (float)aRow[j];
+			}
+			else
+			{
+				pKernel->aKernel[nRowStart + j] = aRow[j];
+			}
+		}
+	}
+	free(aRow);
+	return 1;
+}
+
+/*
+	tiled kernel: the dense kernel kept on disk in tiles of _TILE_HOSTS by _TILE_HOSTS pairs
+	of hosts, of which as many as memoryBudget allows are held in memory
+
+	tile (bi,bj) has the kernel from hosts in block bi onto those in block bj, at
+	[(j % _TILE_HOSTS) * _TILE_HOSTS + i % _TILE_HOSTS], and the tiles are in the file
+	column by column (bj * nTilesAcross + bi), so the pass over all hosts i in an event
+	on host j reads one run of tiles. Tiles for an event's host are asked for as soon as
+	it's picked (see prefetchTiles()), and the prefetch threads read them while the tiles
+	before them are being used. Only the simulating thread looks kernel values up, so it
+	keeps the tile it's in without locking; everything else is under sLock. Once a tile
+	can't be read, every lookup gives 0 and prefetchTiles() fails, which fails the replicate
+*/
+enum
+{
+	TILE_FREE = 0,
+	TILE_LOADING = 1,
+	TILE_READY = 2
+} tileState;
+
+struct t_TileCache {
+	int					nHosts;
+	int					nTilesAcross;
+	size_t				nTileBytes;
+#ifdef _WIN32
+	HANDLE				hFile;
+#else
+	int					fd;
+#endif
+	int					nSlots;			/* tiles held in memory, in pKernel->sMemory */
+	char				*pSlotData;
+	int					*aTileSlot;		/* slot each tile is in, or _NOT_SET */
+	int					*aSlotTile;		/* tile in each slot, or _NOT_SET */
+	int					*aSlotState;
+	int					*aPrev;			/* slots from most to least recently used */
+	int					*aNext;
+	int					nHead;
+	int					nTail;
+	int					nCurTile;		/* being read by the simulating thread, so not to be evicted */
+	int					nCurSlot;
+	double				*pCurData;
+	int					aQueue[_TILE_QUEUE];	/* tiles to prefetch, as a ring */
+	int					nQueueHead;
+	int					nQueued;
+	int					nThreads;
+	t_Thread			aThreads[_MAX_TILE_THREADS];
+	int					bQuit;
+	t_Mutex				sLock;
+	t_Cond				sChanged;		/* a tile has been loaded, or more are queued */
+	long long			nLookups;		/* tiles moved onto by the simulating thread... */
+	long long			nHits;			/* ...already there... */
+	long long			nWaits;			/* ...being prefetched, so waited for... */
+	long long			nMisses;		/* ...or read then and there */
+	long long			nPrefetched;	/* tiles read by the prefetch threads */
+	double				dBytesRead;
+	int					bFailed;		/* a tile couldn't be read */
+};
+
+/*
+	read nBytes at nOffset in the tile file (safe from several threads at once)
+*/
+int readTileFile(t_TileCache *pCache, char *pBuf, size_t nBytes, long long nOffset)
+{
+#ifdef _WIN32
+	OVERLAPPED	sAt;
+	DWORD		nRead;
+
+	memset(&sAt, 0, sizeof(OVERLAPPED));
+	sAt.Offset = (DWORD)(nOffset & 0xffffffff);
+	sAt.OffsetHigh = (DWORD)(nOffset >> 32);
+	return ReadFile(pCache->hFile, pBuf, (DWORD)nBytes, &nRead, &sAt) && nRead == nBytes;
+#else
+	ssize_t	nRead;
+
+	while (nBytes > 0)
+	{
+		nRead = pread(pCache->fd, pBuf, nBytes, (off_t)nOffset);
+		if (nRead <= 0)
+		{
+			return 0;
+		}
+		pBuf += nRead;
+		nBytes -= nRead;
+		nOffset += nRead;
+	}
+	return 1;
+#endif
+}
+
+/* move a slot to the front of the recently used list (under sLock) */
+void touchTileSlot(t_TileCache *pCache, int nSlot)
+{
+	if (pCache->nHead == nSlot)
+	{
+		return;
+	}
+	if (pCache->aPrev[nSlot] != _NOT_SET)
+	{
+		pCache->aNext[pCache->aPrev[nSlot]] = pCache->aNext[nSlot];
+	}
+	if (pCache->aNext[nSlot] != _NOT_SET)
+	{
+		pCache->aPrev[pCache->aNext[nSlot]] = pCache->aPrev[nSlot];
+	}
+	if (pCache->nTail == nSlot)
+	{
+		pCache->nTail = pCache->aPrev[nSlot];
+	}
+	pCache->aPrev[nSlot] = _NOT_SET;
+	pCache->aNext[nSlot] = pCache->nHead;
+	if (pCache->nHead != _NOT_SET)
+	{
+		pCache->aPrev[pCache->nHead] = nSlot;
+	}
+	pCache->nHead = nSlot;
+	if (pCache->nTail == _NOT_SET)
+	{
+		pCache->nTail = nSlot;
+	}
+}
+
+/*
+	take the least recently used slot that isn't being loaded or read, for nTile (under
+	sLock); returns _NOT_SET if there isn't one
+*/
+int claimTileSlot(t_TileCache *pCache, int nTile)
+{
+	int		nSlot;
+
+	for (nSlot = pCache->nTail; nSlot != _NOT_SET; nSlot = pCache->aPrev[nSlot])
+	{
+		if (pCache->aSlotState[nSlot] != TILE_LOADING && nSlot != pCache->nCurSlot)
+		{
+			break;
+		}
+	}
+	if (nSlot != _NOT_SET)
+	{
+		if (pCache->aSlotTile[nSlot] != _NOT_SET)
+		{
+			pCache->aTileSlot[pCache->aSlotTile[nSlot]] = _NOT_SET;
+		}
+		pCache->aSlotTile[nSlot] = nTile;
+		pCache->aSlotState[nSlot] = TILE_LOADING;
+		pCache->aTileSlot[nTile] = nSlot;
+		touchTileSlot(pCache, nSlot);
+	}
+	return nSlot;
+}
+
+/*
+	read nTile into nSlot, which has been claimed for it (with sLock held, which is let go
+	while reading)
+*/
+int loadTileSlot(t_TileCache *pCache, int nTile, int nSlot)
+{
+	int		bRead;
+
+	mutexUnlock(&pCache->sLock);
+	bRead = readTileFile(pCache, pCache->pSlotData + (size_t)nSlot * pCache->nTileBytes, pCache->nTileBytes,
+		_TILE_FILE_HEADER_BYTES + (long long)nTile * (long long)pCache->nTileBytes);
+	mutexLock(&pCache->sLock);
+	pCache->dBytesRead += (double)pCache->nTileBytes;
+	if (bRead)
+	{
+		pCache->aSlotState[nSlot] = TILE_READY;
+	}
+	else
+	{
+		/* so nothing reads what is in the slot */
+		pCache->aSlotState[nSlot] = TILE_FREE;
+		pCache->aSlotTile[nSlot] = _NOT_SET;
+		pCache->aTileSlot[nTile] = _NOT_SET;
+		pCache->bFailed = 1;
+	}
+	condBroadcast(&pCache->sChanged);
+	return bRead;
+}
+
+void tilePrefetchWorker(void *pArg)
+{
+	t_TileCache	*pCache;
+	int			nTile, nSlot;
+
+	pCache = (t_TileCache*)pArg;
+	mutexLock(&pCache->sLock);
+	while (!pCache->bQuit)
+	{
+		if (pCache->nQueued == 0)
+		{
+			condWait(&pCache->sChanged, &pCache->sLock);
+			continue;
+		}
+		nTile = pCache->aQueue[pCache->nQueueHead];
+		pCache->nQueueHead = (pCache->nQueueHead + 1) % _TILE_QUEUE;
+		pCache->nQueued--;
+		if (pCache->aTileSlot[nTile] == _NOT_SET && (nSlot = claimTileSlot(pCache, nTile)) != _NOT_SET)
+		{
+			if (!loadTileSlot(pCache, nTile, nSlot))
+			{
+				fprintf(stderr, "tilePrefetchWorker(): Couldn't read tile %d\n", nTile);
+			}
+			pCache->nPrefetched++;
+		}
+	}
+	mutexUnlock(&pCache->sLock);
+}
+
+/*
+	queue tiles nFirst to nLast - 1 for the prefetch threads, and keep those already in
+	memory there (under sLock)
+*/
+void queueTiles(t_TileCache *pCache, int nFirst, int nLast)
+{
+	int		nTile;
+
+	for (nTile = nFirst; nTile < nLast && pCache->nQueued < _TILE_QUEUE; nTile++)
+	{
+		if (pCache->aTileSlot[nTile] == _NOT_SET)
+		{
+			pCache->aQueue[(pCache->nQueueHead + pCache->nQueued) % _TILE_QUEUE] = nTile;
+			pCache->nQueued++;
+		}
+		else
+		{
+			touchTileSlot(pCache, pCache->aTileSlot[nTile]);
+		}
+	}
+	condBroadcast(&pCache->sChanged);
+}
+
+/* how many tiles ahead of the one being read the prefetch threads are kept */
+int tileReadAhead(t_TileCache *pCache)
+{
+	return (pCache->nSlots / 2 < pCache->nTilesAcross) ? pCache->nSlots / 2 : pCache->nTilesAcross;
+}
+
+/*
+	ask the prefetch threads for the first tiles an event on thisHost will read (the pass
+	over all hosts reads the tiles in its column in turn, and switchTile() keeps asking for
+	those further on as it goes); returns 0 if a tile has failed to be read
+*/
+int prefetchTiles(t_TileCache *pCache, int thisHost)
+{
+	int		nFirst, retVal;
+
+	nFirst = (thisHost / _TILE_HOSTS) * pCache->nTilesAcross;
+	mutexLock(&pCache->sLock);
+	if (pCache->nThreads > 0 && !pCache->bFailed)
+	{
+		pCache->nQueued = 0;	/* whatever the last event wanted that hasn't been read yet is too late now */
+		queueTiles(pCache, nFirst, nFirst + tileReadAhead(pCache));
+	}
+	retVal = !pCache->bFailed;
+	mutexUnlock(&pCache->sLock);
+	return retVal;
+}
+
+/*
+	make nTile the one the simulating thread is reading, waiting for it if it's being
+	prefetched and reading it if it isn't in memory; returns 0 if it (or an earlier
+	tile) couldn't be read
+*/
+int switchTile(t_TileCache *pCache, int nTile)
+{
+	int		nSlot, nAhead;
+
+	mutexLock(&pCache->sLock);
+	pCache->nLookups++;
+	pCache->nCurTile = _NOT_SET;
+	pCache->nCurSlot = _NOT_SET;
+	nSlot = pCache->aTileSlot[nTile];
+	if (nSlot != _NOT_SET && pCache->aSlotState[nSlot] == TILE_READY)
+	{
+		pCache->nHits++;
+	}
+	else if (nSlot != _NOT_SET)
+	{
+		pCache->nWaits++;
+		while (pCache->aTileSlot[nTile] == nSlot && pCache->aSlotState[nSlot] == TILE_LOADING)
+		{
+			condWait(&pCache->sChanged, &pCache->sLock);
+		}
+	}
+	/* not there, or gone again while waiting */
+	while (!pCache->bFailed && (nSlot = pCache->aTileSlot[nTile]) == _NOT_SET)
+	{
+		nSlot = claimTileSlot(pCache, nTile);
+		if (nSlot == _NOT_SET)
+		{
+			/* every slot is being loaded, which frees up soon */
+			condWait(&pCache->sChanged, &pCache->sLock);
+			continue;
+		}
+		pCache->nMisses++;
+		if (!loadTileSlot(pCache, nTile, nSlot))
+		{
+			fprintf(stderr, "switchTile(): Couldn't read tile %d\n", nTile);
+		}
+	}
+	if (pCache->bFailed)
+	{
+		mutexUnlock(&pCache->sLock);
+		return 0;
+	}
+	touchTileSlot(pCache, nSlot);
+	/* the next tile down the column not yet asked for */
+	nAhead = nTile + tileReadAhead(pCache);
+	if (pCache->nThreads > 0 && nAhead / pCache->nTilesAcross == nTile / pCache->nTilesAcross)
+	{
+		queueTiles(pCache, nAhead, nAhead + 1);
+	}
+	pCache->nCurTile = nTile;
+	pCache->nCurSlot = nSlot;
+	pCache->pCurData = (double*)(pCache->pSlotData + (size_t)nSlot * pCache->nTileBytes);
+	mutexUnlock(&pCache->sLock);
+	return 1;
+}
+
+/* 0 once a tile has failed to be read */
+int tilesReadable(t_TileCache *pCache)
+{
+	int		retVal;
+
+	mutexLock(&pCache->sLock);
+	retVal = !pCache->bFailed;
+	mutexUnlock(&pCache->sLock);
+	return retVal;
+}
+
+/*
+	kernel from hostOne to hostTwo in a tiled kernel
+*/
+double tileKernel(int hostOne, int hostTwo, t_TileCache *pCache)
+{
+	int		nTile;
+
+	nTile = (hostTwo / _TILE_HOSTS) * pCache->nTilesAcross + hostOne / _TILE_HOSTS;
+	if (nTile != pCache->nCurTile && !switchTile(pCache, nTile))
+	{
+		return 0.0;
+	}
+	return pCache->pCurData[(hostTwo % _TILE_HOSTS) * _TILE_HOSTS + hostOne % _TILE_HOSTS];
+}
+
+void reportTileCache(t_Params *pParams, t_TileCache *pCache)
+{
+	echoToScreen(pParams, "Tiled kernel: %lld tile lookups, %.1f%% in memory, %.1f%% waited for prefetching, %.1f%% read then; %lld prefetched, %.1f MB read\n",
+		pCache->nLookups, pCache->nLookups ? 100.0 * pCache->nHits / pCache->nLookups : 0.0,
+		pCache->nLookups ? 100.0 * pCache->nWaits / pCache->nLookups : 0.0,
+		pCache->nLookups ? 100.0 * pCache->nMisses / pCache->nLookups : 0.0,
+		pCache->nPrefetched, pCache->dBytesRead / (1024.0 * 1024.0));
+}
+
+void freeTileCache(t_TileCache *pCache)
+{
+	int		i;
+
+	if (!pCache)
+	{
+		return;
+	}
+	mutexLock(&pCache->sLock);
+	pCache->bQuit = 1;
+	condBroadcast(&pCache->sChanged);
+	mutexUnlock(&pCache->sLock);
+	for (i = 0; i < pCache->nThreads; i++)
+	{
+		threadJoin(&pCache->aThreads[i]);
+	}
+#ifdef _WIN32
+	if (pCache->hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(pCache->hFile);
+	}
+#else
+	if (pCache->fd >= 0)
+	{
+		close(pCache->fd);
+	}
+#endif
+	condDestroy(&pCache->sChanged);
+	mutexDestroy(&pCache->sLock);
+	free(pCache->aTileSlot);
+	free(pCache->aSlotTile);
+	free(pCache->aSlotState);
+	free(pCache->aPrev);
+	free(pCache->aNext);
+	free(pCache);
+}
+
+/*
+	write the tile file, unless it's already there, whole, for these hosts and kernel; the
+	header only goes in once every tile has, so a file left half written isn't used
+*/
+int writeTileFile(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, int nTilesAcross)
+{
+	t_KernelFileHeader	sWant, sHeader;
+	FILE				*fFile;
+	double				*aTile;
+	char				sZero[_TILE_FILE_HEADER_BYTES];
+	int					bi, bj, i, j, il, jl, retVal;
+
+	makeKernelFileHeader(&sWant, pParams, pHosts);
+	memcpy(sWant.sMagic, _TILE_FILE_MAGIC, sizeof(sWant.sMagic));
+	fFile = fopen(pParams->sKernelTileFile, "rb");
+	if (fFile)
+	{
+		retVal = (fread(&sHeader, sizeof(t_KernelFileHeader), 1, fFile) == 1 && memcmp(&sHeader, &sWant, sizeof(t_KernelFileHeader)) == 0
+			&& FSEEK64(fFile, 0, SEEK_END) == 0
+			&& FTELL64(fFile) == _TILE_FILE_HEADER_BYTES + (long long)nTilesAcross * nTilesAcross * _TILE_HOSTS * _TILE_HOSTS * (long long)sizeof(double));
+		fclose(fFile);
+		if (retVal)
+		{
+			echoToScreen(pParams, "Tiled kernel: using %s\n", pParams->sKernelTileFile);
+			return 1;
+		}
+	}
+	aTile = malloc(sizeof(double) * _TILE_HOSTS * _TILE_HOSTS);
+	fFile = fopen(pParams->sKernelTileFile, "wb");
+	retVal = (aTile && fFile);
+	memset(sZero, 0, sizeof(sZero));
+	if (retVal)
+	{
+		retVal = (fwrite(sZero, 1, sizeof(sZero), fFile) == sizeof(sZero));
+	}
+	for (bj = 0; retVal && bj < nTilesAcross; bj++)
+	{
+		for (bi = 0; retVal && bi < nTilesAcross; bi++)
+		{
+			for (jl = 0; jl < _TILE_HOSTS; jl++)
+			{
+				j = bj * _TILE_HOSTS + jl;
+				for (il = 0; il < _TILE_HOSTS; il++)
+				{
+					i = bi * _TILE_HOSTS + il;
+					aTile[jl * _TILE_HOSTS + il] = (i < pHosts->nHosts && j < pHosts->nHosts)
+						? pKernel->pSpec->pfPair(i, j, pKernel, pHosts, pParams) : 0.0;
+				}
+			}
+			retVal = (fwrite(aTile, sizeof(double) * _TILE_HOSTS * _TILE_HOSTS, 1, fFile) == 1);
+		}
+	}
+	if (retVal)
+	{
+		retVal = (fseek(fFile, 0, SEEK_SET) == 0 && fwrite(&sWant, sizeof(t_KernelFileHeader), 1, fFile) == 1);
+	}
+	if (fFile && fclose(fFile) != 0)
+	{
+		retVal = 0;
+	}
+	free(aTile);
+	if (!retVal)
+	{
+		fprintf(stderr, "writeTileFile(): Couldn't write %s\n", pParams->sKernelTileFile);
+		remove(pParams->sKernelTileFile);
+		return 0;
+	}
+	echoToScreen(pParams, "Tiled kernel: wrote %.1f MB to %s\n", (double)nTilesAcross * nTilesAcross * sizeof(double) * _TILE_HOSTS * _TILE_HOSTS / (1024.0 * 1024.0),
+		pParams->sKernelTileFile);
+	return 1;
+}
+
+/*
+	tiled kernel: write (or reuse) the tile file, open it, and set up the cache in memory,
+	taking dBudgetMB, and its prefetch threads
+*/
+int buildTiledKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, double dBudgetMB)
+{
+	t_TileCache	*pCache;
+	size_t		nTiles;
+	double		dSlots;
+	int			i, nTilesAcross, retVal;
+
+	nTilesAcross = (pHosts->nHosts + _TILE_HOSTS - 1) / _TILE_HOSTS;
+	nTiles = (size_t)nTilesAcross * nTilesAcross;
+	if (!writeTileFile(pParams, pHosts, pKernel, nTilesAcross))
+	{
+		return 0;
+	}
+	pCache = calloc(1, sizeof(t_TileCache));
+	if (!pCache)
+	{
+		return 0;
+	}
+	pCache->nHosts = pHosts->nHosts;
+	pCache->nTilesAcross = nTilesAcross;
+	pCache->nTileBytes = sizeof(double) * _TILE_HOSTS * _TILE_HOSTS;
+	/* as many as the budget has room for, enough for the prefetch threads to get ahead, and no more than there are */
+	dSlots = dBudgetMB * 1024.0 * 1024.0 / pCache->nTileBytes;
+	if (dSlots < _MIN_TILE_SLOTS)
+	{
+		dSlots = _MIN_TILE_SLOTS;
+	}
+	if (dSlots > (double)nTiles)
+	{
+		dSlots = (double)nTiles;
+	}
+	pCache->nSlots = (int)dSlots;
+	pCache->nCurTile = _NOT_SET;
+	pCache->nCurSlot = _NOT_SET;
+	pCache->nHead = pCache->nTail = _NOT_SET;
+	mutexInit(&pCache->sLock);
+	condInit(&pCache->sChanged);
+#ifdef _WIN32
+	pCache->hFile = CreateFileA(pParams->sKernelTileFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	retVal = (pCache->hFile != INVALID_HANDLE_VALUE);
+#else
+	pCache->fd = open(pParams->sKernelTileFile, O_RDONLY);
+	retVal = (pCache->fd >= 0);
+#endif
+	pCache->aTileSlot = malloc(sizeof(int) * nTiles);
+	pCache->aSlotTile = malloc(sizeof(int) * pCache->nSlots);
+	pCache->aSlotState = calloc(pCache->nSlots, sizeof(int));
+	pCache->aPrev = malloc(sizeof(int) * pCache->nSlots);
+	pCache->aNext = malloc(sizeof(int) * pCache->nSlots);
+	pCache->pSlotData = allocKernelMemory(pParams, pCache->nTileBytes * pCache->nSlots, &pKernel->sMemory);
+	pKernel->pTiles = pCache;
+	if (!retVal || !pCache->aTileSlot || !pCache->aSlotTile || !pCache->aSlotState || !pCache->aPrev || !pCache->aNext || !pCache->pSlotData)
+	{
+		fprintf(stderr, "buildTiledKernel(): Couldn't open %s, or out of memory\n", pParams->sKernelTileFile);
+		freeTileCache(pCache);
+		pKernel->pTiles = NULL;
+		freeKernelMemory(&pKernel->sMemory);
+		return 0;
+	}
+	for (i = 0; (size_t)i < nTiles; i++)
+	{
+		pCache->aTileSlot[i] = _NOT_SET;
+	}
+	for (i = 0; i < pCache->nSlots; i++)
+	{
+		pCache->aSlotTile[i] = _NOT_SET;
+		pCache->aPrev[i] = _NOT_SET;
+		pCache->aNext[i] = _NOT_SET;
+		touchTileSlot(pCache, i);
+	}
+	for (i = 0; i < pParams->nTileThreads && i < _MAX_TILE_THREADS; i++)
+	{
+		if (threadStart(&pCache->aThreads[pCache->nThreads], tilePrefetchWorker, pCache))
+		{
+			pCache->nThreads++;
+		}
+	}
+	echoToScreen(pParams, "Tiled kernel: %d of %lld tiles (%.1f MB each) held in memory, %d prefetch thread(s)\n",
+		pCache->nSlots, (long long)nTiles, pCache->nTileBytes / (1024.0 * 1024.0), pCache->nThreads);
+	return 1;
+}
+
+/* what planKernel() worked out for one way of holding the kernel */
+typedef struct {
+	int			eStore;
+	const char	*sName;
+	double		dMB;
+	double		dEventUs;	/* time for one event's pass over all the hosts */
+	double		dError;		/* relative error in the force of infection */
+	int			bAllowed;	/* by kernelStore, lanes and kernelTol */
+} t_KernelPlan;
+
+/*
+	most memory the kernel may take: memoryBudget, or a share of the memory available now
+	(HUGE_VAL if the system won't say), and no more than a batch may have
+*/
+double kernelBudgetMB(t_Params *pParams)
+{
+	double	dBudget;
+
+	dBudget = (pParams->dMemoryBudgetMB > 0.0) ? pParams->dMemoryBudgetMB : _BUDGET_FRACTION * availableMemoryMB();
+	if (dBudget <= 0.0)
+	{
+		dBudget = HUGE_VAL;		/* the system wouldn't say */
+	}
+	if (pParams->sBatchXYFiles[0] && pParams->dBatchMemoryMB < dBudget)
+	{
+		dBudget = pParams->dBatchMemoryMB;
+	}
+	return dBudget;
+}
+
+/*
+	work out the memory, time per event and error of each way of holding the full kernel,
+	and put in aOrder[] the ones to try, best first; returns how many there are
+
+	unless kernelStore says which, the ones fitting in the budget (memoryBudget, or a share
+	of the memory available now) are tried fastest first, and as working the kernel out on
+	the fly needs no memory there is always at least that one; the tiled kernel, which needs
+	the disk space for all of it, is only used if kernelStore asks for it
+*/
+int planKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_KernelPlan *aPlan, int *aOrder)
+{
+	double	dN, dBudget, dNear, dR2, dx, dy, dTiles;
+	int		nHosts, nSample, nOrder, i, j, k, s, bFits, bSparse;
+
+	nHosts = pHosts->nHosts;
+	dN = (double)nHosts;
+	dBudget = kernelBudgetMB(pParams);
+	/* sparse: how many hosts are within the cutoff of a sample of them */
+	pKernel->dCutoff = pKernel->pSpec->pfCutoff(pParams->dA, pParams->dC, pParams->dKernelTol);
+	bSparse = (pParams->dKernelTol > 0.0 && pKernel->dCutoff < HUGE_VAL);
+	dNear = 0.0;
+	if (bSparse)
+	{
+		dR2 = pKernel->dCutoff * pKernel->dCutoff;
+		nSample = (nHosts < _PLAN_SAMPLE_HOSTS) ? nHosts : _PLAN_SAMPLE_HOSTS;
+		for (s = 0; s < nSample; s++)
+		{
+			i = (int)((double)s * nHosts / nSample);
+			for (j = 0; j < nHosts; j++)
+			{
+				dx = pHosts->aHosts[i].dX - pHosts->aHosts[j].dX;
+				dy = pHosts->aHosts[i].dY - pHosts->aHosts[j].dY;
+				dNear += (j != i && dx * dx + dy * dy <= dR2);
+			}
+		}
+		dNear /= (nSample > 0) ? nSample : 1;
+	}
+	memset(aPlan, 0, sizeof(t_KernelPlan) * STORE_TILED);
+	for (k = 0; k < STORE_TILED; k++)
+	{
+		aPlan[k].eStore = k + 1;
+		aPlan[k].bAllowed = 1;
+	}
+	aPlan[0].sName = "dense";
+	aPlan[0].dMB = sizeof(double) * dN * dN;
+	aPlan[0].dEventUs = _PAIR_NS_DENSE * dN;
+	aPlan[1].sName = "packed symmetric";
+	aPlan[1].dMB = sizeof(double) * dN * (dN - 1.0) / 2.0;
+	aPlan[1].dEventUs = _PAIR_NS_PACKED * dN;
+	aPlan[2].sName = "packed single precision";
+	aPlan[2].dMB = sizeof(float) * dN * (dN - 1.0) / 2.0;
+	aPlan[2].dEventUs = _PAIR_NS_PACKED * dN;
+	aPlan[2].dError = FLT_EPSILON / 2.0;
+	aPlan[2].bAllowed = (aPlan[2].dError <= pParams->dKernelTol);
+	aPlan[3].sName = "sparse truncated";
+	aPlan[3].dMB = sizeof(size_t) * (dN + 1.0) + (sizeof(int) + sizeof(double)) * dNear * dN;
+	aPlan[3].dEventUs = _PAIR_NS_SPARSE * log(dNear + 2.0) / log(2.0) * dN;
+	aPlan[3].dError = pParams->dKernelTol;
+	aPlan[3].bAllowed = bSparse;
+	aPlan[4].sName = "on the fly";
+	aPlan[4].dMB = 0.0;
+	aPlan[4].dEventUs = _PAIR_NS_ON_THE_FLY * dN;
+	aPlan[5].sName = "tiled on disk";
+	dTiles = ceil(dN / _TILE_HOSTS) * _TILE_HOSTS;
+	aPlan[5].dMB = (sizeof(double) * dTiles * dTiles < dBudget * 1024.0 * 1024.0) ? sizeof(double) * dTiles * dTiles : dBudget * 1024.0 * 1024.0;
+	aPlan[5].dEventUs = _PAIR_NS_TILED * dN;
+	aPlan[5].bAllowed = 0;
+	for (k = 0; k < STORE_TILED; k++)
+	{
+		aPlan[k].dMB /= 1024.0 * 1024.0;
+		aPlan[k].dEventUs /= 1000.0;
+		if (pParams->eKernelStore != STORE_AUTO)
+		{
+			aPlan[k].bAllowed = (aPlan[k].eStore == pParams->eKernelStore);
+		}
+		else if (!pParams->bCacheKernel)
+		{
+			aPlan[k].bAllowed = (aPlan[k].eStore == STORE_ON_THE_FLY);
+		}
+		else if (pParams->nLanes > 1)
+		{
+			/* the lanes read rows of the dense kernel directly */
+			aPlan[k].bAllowed = (aPlan[k].eStore == STORE_DENSE);
+		}
+	}
+	/* fastest first, then most accurate (an insertion sort, as there are only a few) */
+	nOrder = 0;
+	for (k = 0; k < STORE_TILED; k++)
+	{
+		bFits = (aPlan[k].dMB <= dBudget) || pParams->eKernelStore != STORE_AUTO;
+		if (aPlan[k].bAllowed && bFits)
+		{
+			for (j = nOrder; j > 0 && (aPlan[aOrder[j - 1]].dEventUs > aPlan[k].dEventUs
+				|| (aPlan[aOrder[j - 1]].dEventUs == aPlan[k].dEventUs && aPlan[aOrder[j - 1]].dError > aPlan[k].dError)); j--)
+			{
+				aOrder[j] = aOrder[j - 1];
+			}
+			aOrder[j] = k;
+			nOrder++;
+		}
+	}
+	if (!pParams->bQuiet)
+	{
+		if (dBudget < HUGE_VAL)
+		{
+			fprintf(stdout, "Kernel plan for %d hosts, within %.0f MB:\n", nHosts, dBudget);
+		}
+		else
+		{
+			fprintf(stdout, "Kernel plan for %d hosts (memory available unknown):\n", nHosts);
+		}
+		for (k = 0; k < STORE_TILED; k++)
+		{
+			fprintf(stdout, "  %d %-24s %12.1f MB %12.1f us/event  error %-8.2g %s\n", aPlan[k].eStore, aPlan[k].sName,
+				aPlan[k].dMB, aPlan[k].dEventUs, aPlan[k].dError,
+				(nOrder > 0 && aOrder[0] == k) ? "<- first choice" : (!aPlan[k].bAllowed ? "(not allowed)" : (aPlan[k].dMB > dBudget ? "(too big)" : "")));
+		}
+	}
+	if (pParams->eKernelStore != STORE_AUTO && aPlan[pParams->eKernelStore - 1].dMB > dBudget)
+	{
+		fprintf(stderr, "planKernel(): kernelStore=%d needs %.0f MB, more than the %.0f MB budget, but trying anyway\n",
+			pParams->eKernelStore, aPlan[pParams->eKernelStore - 1].dMB, dBudget);
+	}
+	if (nOrder == 0)
+	{
+		/* only lanes > 1 leave nothing to try */
+		fprintf(stderr, "planKernel(): lanes > 1 needs the dense kernel, which takes %.0f MB, more than the %.0f MB budget (see memoryBudget)\n",
+			aPlan[0].dMB, dBudget);
+	}
+	return nOrder;
+}
+
+/*
+	set up the kernel held as eStore, returning 0 (with nothing left allocated) if there
+	isn't the memory for it
+*/
+int buildStoredKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, int eStore)
+{
+	size_t	p;
+	int		i;
+
+	pKernel->eStore = eStore;
+	if (eStore == STORE_DENSE)
+	{
+		if (pParams->sKernelFile[0] && loadKernelFile(pParams, pHosts, pKernel))
+		{
+			return 1;
+		}
+		pKernel->aKernel = (double*)allocKernelMemory(pParams, sizeof(double)*pHosts->nHosts*pHosts->nHosts, &pKernel->sMemory);
+		if (!pKernel->aKernel)
+		{
+			return 0;
+		}
+		/* set kernel between pairs of hosts */
+		pKernel->pSpec->pfBuild(pParams, pHosts, pKernel);
+		/* set kernel from a single host onto itself to be zero */
+		for (i = 0; i < pHosts->nHosts; i++)
+		{
+			p = posFromHostIDs(i, i, pHosts->nHosts);
+			pKernel->aKernel[p] = 0.0;
+		}
+		echoToScreen(pParams, "Set up %s kernel\n", pKernel->pSpec->sName);
+		/* failing to save the kernel only costs time next run, so isn't fatal */
+		if (pParams->sKernelFile[0])
+		{
+			saveKernelFile(pParams, pHosts, pKernel);
+		}
+		return 1;
+	}
+	if (eStore == STORE_PACKED || eStore == STORE_SINGLE)
+	{
+		return buildPackedKernel(pParams, pHosts, pKernel);
+	}
+	if (eStore == STORE_SPARSE)
+	{
+		return buildSparseKernel(pParams, pHosts, pKernel);
+	}
+	if (eStore == STORE_TILED)
+	{
+		return buildTiledKernel(pParams, pHosts, pKernel, kernelBudgetMB(pParams));
+	}
+	return 1;
+}
+
+int calcKernel(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	t_KernelPlan	aPlan[STORE_TILED];
+	int				aOrder[STORE_TILED];
+	int				nOrder, k;
+
+	pKernel->pSpec = findKernelSpec(pParams->eKernelType);
+	pKernel->dNorm = pKernel->pSpec->pfNorm(pParams->dA, pParams->dC);
+	if (pParams->nKernelGrid > 0)
+	{
+		return calcGridKernel(pParams, pHosts, pKernel);
+	}
+	if (pParams->eEngine == ENGINE_INFECTIVES)
+	{
+		return calcAliasKernel(pParams, pHosts, pKernel);
+	}
+	/* rather than running out of memory, fall back on the next best way of holding it */
+	nOrder = planKernel(pParams, pHosts, pKernel, aPlan, aOrder);
+	for (k = 0; k < nOrder; k++)
+	{
+		if (buildStoredKernel(pParams, pHosts, pKernel, aPlan[aOrder[k]].eStore))
+		{
+			echoToScreen(pParams, "Kernel held %s\n", aPlan[aOrder[k]].sName);
+			return 1;
+		}
+		fprintf(stderr, "calcKernel(): Not enough memory for the %s kernel (%.0f MB)%s\n", aPlan[aOrder[k]].sName,
+			aPlan[aOrder[k]].dMB, (k + 1 < nOrder) ? ", trying the next best" : "");
+	}
+	return 0;
+}
+
+/*
+	map an entire file into memory (read only)
+*/
+int mapFile(char *szFile, t_MappedFile *pMap)
+{
+	memset(pMap, 0, sizeof(t_MappedFile));
+#ifdef _WIN32
+	{
+		LARGE_INTEGER	liSize;
+
+		pMap->hFile = CreateFileA(szFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (pMap->hFile == INVALID_HANDLE_VALUE)
+		{
+			return 0;
+		}
+		if (!GetFileSizeEx(pMap->hFile, &liSize))
+		{
+			CloseHandle(pMap->hFile);
+			return 0;
+		}
+		pMap->nSize = (size_t)liSize.QuadPart;
+		if (pMap->nSize > 0)
+		{
+			pMap->hMapping = CreateFileMappingA(pMap->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (pMap->hMapping)
+			{
+				pMap->pData = (char*)MapViewOfFile(pMap->hMapping, FILE_MAP_READ, 0, 0, 0);
+			}
+			if (!pMap->pData)
+			{
+				if (pMap->hMapping)
+				{
+					CloseHandle(pMap->hMapping);
+				}
+				CloseHandle(pMap->hFile);
+				return 0;
+			}
+		}
+	}
+#else
+	{
+		struct stat	sInfo;
+		int			fd;
+
+		fd = open(szFile, O_RDONLY);
+		if (fd < 0)
+		{
+			return 0;
+		}
+		if (fstat(fd, &sInfo) != 0)
+		{
+			close(fd);
+			return 0;
+		}
+		pMap->nSize = (size_t)sInfo.st_size;
+		if (pMap->nSize > 0)
+		{
+			pMap->pData = mmap(NULL, pMap->nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (pMap->pData == MAP_FAILED)
+			{
+				pMap->pData = NULL;
+				close(fd);
+				return 0;
+			}
+			madvise(pMap->pData, pMap->nSize, MADV_SEQUENTIAL);
+		}
+		close(fd);	/* the mapping stays valid */
+	}
+#endif
+	return 1;
+}
+
+void unmapFile(t_MappedFile *pMap)
+{
+#ifdef _WIN32
+	if (pMap->pData)
+	{
+		UnmapViewOfFile(pMap->pData);
+		CloseHandle(pMap->hMapping);
+	}
+	if (pMap->hFile && pMap->hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(pMap->hFile);
+	}
+#else
+	if (pMap->pData)
+	{
+		munmap(pMap->pData, pMap->nSize);
+	}
+#endif
+	memset(pMap, 0, sizeof(t_MappedFile));
+}
+
+/*
+	locale-independent number parsing, advancing *pp past the number
+
+	up to 19 significant digits with a power of ten no bigger than 22 are
+	converted with a single correctly rounded multiply or divide, which gives
+	exactly the same answer as atof(); anything else falls back on strtod()
+*/
+int parseDouble(const char **pp, const char *pEnd, double *pdValue)
+{
+	static const double	aPow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+									1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const char			*p, *q, *pStart;
+	unsigned long long	ullMantissa;
+	int					bNeg, bExpNeg, bAnyDigits, bTruncated, nSigDigits, nExp, nExpVal, nExpDigits;
+	char				sTmp[64];
+
+	p = pStart = *pp;
+	bNeg = 0;
+	if (p < pEnd && (*p == '-' || *p == '+'))
+	{
+		bNeg = (*p == '-');
+		p++;
+	}
+	ullMantissa = 0;
+	nSigDigits = nExp = 0;
+	bAnyDigits = bTruncated = 0;
+	while (p < pEnd && *p >= '0' && *p <= '9')
+	{
+		bAnyDigits = 1;
+		if (nSigDigits < 19)
+		{
+			ullMantissa = 10 * ullMantissa + (*p - '0');
+			nSigDigits += (ullMantissa != 0);
+		}
+		else
+		{
+			nExp++;
+			bTruncated = 1;
+		}
+		p++;
+	}
+	if (p < pEnd && *p == '.')
+	{
+		p++;
+		while (p < pEnd && *p >= '0' && *p <= '9')
+		{
+			bAnyDigits = 1;
+			if (nSigDigits < 19)
+			{
+				ullMantissa = 10 * ullMantissa + (*p - '0');
+				nSigDigits += (ullMantissa != 0);
+				nExp--;
+			}
+			else
+			{
+				bTruncated = 1;
+			}
+			p++;
+		}
+	}
+	if (!bAnyDigits)
+	{
+		return 0;
+	}
+	if (p < pEnd && (*p == 'e' || *p == 'E'))
+	{
+		q = p + 1;
+		bExpNeg = 0;
+		if (q < pEnd && (*q == '-' || *q == '+'))
+		{
+			bExpNeg = (*q == '-');
+			q++;
+		}
+		nExpVal = nExpDigits = 0;
+		while (q < pEnd && *q >= '0' && *q <= '9')
+		{
+			if (nExpVal < 100000)
+			{
+				nExpVal = 10 * nExpVal + (*q - '0');
+			}
+			nExpDigits++;
+			q++;
+		}
+		if (nExpDigits)
+		{
+			nExp += bExpNeg ? -nExpVal : nExpVal;
+			p = q;
+		}
+	}
+	if (!bTruncated && ullMantissa < (1ULL << 53) && nExp >= -22 && nExp <= 22)
+	{
+		*pdValue = (nExp < 0) ? (double)ullMantissa / aPow10[-nExp] : (double)ullMantissa * aPow10[nExp];
+		if (bNeg)
+		{
+			*pdValue = -*pdValue;
+		}
+	}
+	else
+	{
+		if (p - pStart >= (int)sizeof(sTmp))
+		{
+			return 0;
+		}
+		memcpy(sTmp, pStart, p - pStart);
+		sTmp[p - pStart] = '\0';
+		*pdValue = strtod(sTmp, NULL);
+	}
+	*pp = p;
+	return 1;
+}
+
+/*
+	read in hosts from a file in the binary format written by saveHostsBinary()
+*/
+int loadHostsBinary(t_MappedFile *pMap, t_Hosts *pHosts)
+{
+	t_HostFileHeader	sHeader;
+	t_HostFileRecord	sRecord;
+	const char			*p;
+	int					i;
+
+	memcpy(&sHeader, pMap->pData, sizeof(t_HostFileHeader));
+	if (sHeader.nHosts < 0
+		|| pMap->nSize < sizeof(t_HostFileHeader) + (size_t)sHeader.nHosts * sizeof(t_HostFileRecord))
+	{
+		fprintf(stderr, "loadHostsBinary(): File is truncated\n");
+		return 0;
+	}
+	pHosts->aHosts = malloc(sizeof(t_SingleHost) * (sHeader.nHosts > 0 ? sHeader.nHosts : 1));
+	if (!pHosts->aHosts)
+	{
+		fprintf(stderr, "loadHostsBinary(): Out of memory\n");
+		return 0;
+	}
+	pHosts->nAlloc = sHeader.nHosts;
+	p = pMap->pData + sizeof(t_HostFileHeader);
+	for (i = 0; i < sHeader.nHosts; i++)
+	{
+		memcpy(&sRecord, p, sizeof(t_HostFileRecord));
+		p += sizeof(t_HostFileRecord);
+		if (!(sRecord.eType == TYPE_I || sRecord.eType == TYPE_II))
+		{
+			fprintf(stderr, "loadHostsBinary(): Invalid host type for host %d\n", i);
+			return 0;
+		}
+		pHosts->aHosts[i].dX = sRecord.dX;
+		pHosts->aHosts[i].dY = sRecord.dY;
+		pHosts->aHosts[i].eType = sRecord.eType;
+	}
+	pHosts->nHosts = sHeader.nHosts;
+	return 1;
+}
+
+/*
+	read in hosts from a csv file (header line, then x, y, type)
+*/
+int loadHostsCSV(t_MappedFile *pMap, t_Hosts *pHosts)
+{
+	const char	*p, *pEnd, *pLineEnd;
+	int			nLines, nLine, tokNum, nType;
+	double		aVals[2];
+
+	p = pMap->pData;
+	pEnd = p + pMap->nSize;
+	/* count lines, so only need to allocate once */
+	nLines = 0;
+	while (p < pEnd && (p = memchr(p, '\n', pEnd - p)) != NULL)
+	{
+		nLines++;
+		p++;
+	}
+	nLines++;	/* in case the last line has no newline */
+	pHosts->aHosts = malloc(sizeof(t_SingleHost) * nLines);
+	if (!pHosts->aHosts)
+	{
+		fprintf(stderr, "loadHostsCSV(): Out of memory\n");
+		return 0;
+	}
+	pHosts->nAlloc = nLines;
+	/* discard the first line, which is just a header */
+	p = memchr(pMap->pData, '\n', pMap->nSize);
+	p = p ? p + 1 : pEnd;
+	nLine = 1;
+	while (p < pEnd)
+	{
+		nLine++;
+		pLineEnd = memchr(p, '\n', pEnd - p);
+		if (!pLineEnd)
+		{
+			pLineEnd = pEnd;
+		}
+		tokNum = 0;
+		nType = 0;
+		while (p < pLineEnd)
+		{
+			/* skip separators */
+			while (p < pLineEnd && (*p == ',' || *p == '\t' || *p == ' ' || *p == '\r'))
+			{
+				p++;
+			}
+			if (p == pLineEnd)
+			{
+				break;
+			}
+			if (tokNum < 2)
+			{
+				if (!parseDouble(&p, pLineEnd, &aVals[tokNum]))
+				{
+					break;
+				}
+			}
+			else if (tokNum == 2)
+			{
+				nType = 0;
+				while (p < pLineEnd && *p >= '0' && *p <= '9')
+				{
+					nType = 10 * nType + (*p - '0');
+					p++;
+				}
+			}
+			else
+			{
+				break;
+			}
+			tokNum++;
+			if (p < pLineEnd && !(*p == ',' || *p == '\t' || *p == ' ' || *p == '\r'))
+			{
+				tokNum = -1;	/* junk after a number */
+				break;
+			}
+		}
+		if (tokNum != 0)	/* blank lines are ignored */
+		{
+			if (tokNum != 3 || !(nType == TYPE_I || nType == TYPE_II))
+			{
+				fprintf(stderr, "loadHostsCSV(): Could not parse line %d (need x, y and a type of %d or %d)\n", nLine, TYPE_I, TYPE_II);
+				return 0;
+			}
+			pHosts->aHosts[pHosts->nHosts].dX = aVals[0];
+			pHosts->aHosts[pHosts->nHosts].dY = aVals[1];
+			pHosts->aHosts[pHosts->nHosts].eType = nType;
+			pHosts->nHosts++;
+		}
+		p = pLineEnd + 1;
+	}
+	return 1;
+}
+
+/*
+	write hosts in the binary format, which loads without any parsing
+*/
+int saveHostsBinary(char *szFile, t_Hosts *pHosts)
+{
+	t_HostFileHeader	sHeader;
+	t_HostFileRecord	sRecord;
+	FILE				*fOut;
+	int					i, retVal;
+
+	fOut = fopen(szFile, "wb");
+	if (!fOut)
+	{
+		fprintf(stderr, "saveHostsBinary(): Could not open %s\n", szFile);
+		return 0;
+	}
+	memset(&sHeader, 0, sizeof(t_HostFileHeader));
+	memcpy(sHeader.sMagic, _HOST_FILE_MAGIC, sizeof(sHeader.sMagic));
+	sHeader.nHosts = pHosts->nHosts;
+	retVal = (fwrite(&sHeader, sizeof(t_HostFileHeader), 1, fOut) == 1);
+	memset(&sRecord, 0, sizeof(t_HostFileRecord));
+	for (i = 0; retVal && i < pHosts->nHosts; i++)
+	{
+		sRecord.dX = pHosts->aHosts[i].dX;
+		sRecord.dY = pHosts->aHosts[i].dY;
+		sRecord.eType = pHosts->aHosts[i].eType;
+		retVal = (fwrite(&sRecord, sizeof(t_HostFileRecord), 1, fOut) == 1);
+	}
+	if (fclose(fOut) != 0)
+	{
+		retVal = 0;
+	}
+	if (!retVal)
+	{
+		fprintf(stderr, "saveHostsBinary(): Could not write %s\n", szFile);
+	}
+	return retVal;
+}
+
+/*
+	position of a point on a 65536 x 65536 grid along a space-filling curve
+*/
+unsigned int mortonKey(unsigned int nX, unsigned int nY)
+{
+	unsigned int	nKey;
+	int				b;
+
+	nKey = 0;
+	for (b = 15; b >= 0; b--)
+	{
+		nKey = (nKey << 2) | (((nY >> b) & 1) << 1) | ((nX >> b) & 1);
+	}
+	return nKey;
+}
+
+unsigned int hilbertKey(unsigned int nX, unsigned int nY)
+{
+	unsigned int	nS, nRX, nRY, nKey, nTmp;
+
+	nKey = 0;
+	for (nS = 1u << 15; nS > 0; nS >>= 1)
+	{
+		nRX = (nX & nS) > 0;
+		nRY = (nY & nS) > 0;
+		nKey += nS * nS * ((3 * nRX) ^ nRY);
+		/* rotate the quadrant so the curve joins up */
+		if (nRY == 0)
+		{
+			if (nRX == 1)
+			{
+				nX = 0xffff - nX;
+				nY = 0xffff - nY;
+			}
+			nTmp = nX;
+			nX = nY;
+			nY = nTmp;
+		}
+	}
+	return nKey;
+}
+
+typedef struct {
+	unsigned int	nKey;
+	int				nHost;
+} t_HostKey;
+
+int compareHostKeys(const void *pOne, const void *pTwo)
+{
+	const t_HostKey	*pA, *pB;
+
+	pA = (const t_HostKey *)pOne;
+	pB = (const t_HostKey *)pTwo;
+	if (pA->nKey != pB->nKey)
+	{
+		return (pA->nKey < pB->nKey) ? -1 : 1;
+	}
+	return (pA->nHost > pB->nHost) - (pA->nHost < pB->nHost);	/* ties stay in file order */
+}
+
+/*
+	put hosts in order along a Morton or Hilbert curve over their bounding box, so that
+	hosts close in space are also close in aHosts, host status and rows of the kernel
+
+	the permutation is kept so output can still use the IDs from the host file
+*/
+int sortHosts(t_Hosts *pHosts, int eSortType)
+{
+	t_HostKey		*aKeys;
+	t_SingleHost	*aSorted;
+	double			dMinX, dMaxX, dMinY, dMaxY, dScaleX, dScaleY;
+	unsigned int	nX, nY;
+	int				i;
+
+	aKeys = malloc(sizeof(t_HostKey) * (pHosts->nHosts > 0 ? pHosts->nHosts : 1));
+	aSorted = malloc(sizeof(t_SingleHost) * (pHosts->nHosts > 0 ? pHosts->nHosts : 1));
+	pHosts->aOrigID = malloc(sizeof(int) * (pHosts->nHosts > 0 ? pHosts->nHosts : 1));
+	pHosts->aSortedID = malloc(sizeof(int) * (pHosts->nHosts > 0 ? pHosts->nHosts : 1));
+	if (!aKeys || !aSorted || !pHosts->aOrigID || !pHosts->aSortedID)
+	{
+		fprintf(stderr, "sortHosts(): Out of memory\n");
+		free(aKeys);
+		free(aSorted);
+		return 0;
+	}
+	dMinX = dMaxX = dMinY = dMaxY = 0.0;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		if (i == 0 || pHosts->aHosts[i].dX < dMinX)
+		{
+			dMinX = pHosts->aHosts[i].dX;
+		}
+		if (i == 0 || pHosts->aHosts[i].dX > dMaxX)
+		{
+			dMaxX = pHosts->aHosts[i].dX;
+		}
+		if (i == 0 || pHosts->aHosts[i].dY < dMinY)
+		{
+			dMinY = pHosts->aHosts[i].dY;
+		}
+		if (i == 0 || pHosts->aHosts[i].dY > dMaxY)
+		{
+			dMaxY = pHosts->aHosts[i].dY;
+		}
+	}
+	dScaleX = (dMaxX > dMinX) ? 65535.0 / (dMaxX - dMinX) : 0.0;
+	dScaleY = (dMaxY > dMinY) ? 65535.0 / (dMaxY - dMinY) : 0.0;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		nX = (unsigned int)((pHosts->aHosts[i].dX - dMinX) * dScaleX);
+		nY = (unsigned int)((pHosts->aHosts[i].dY - dMinY) * dScaleY);
+		aKeys[i].nKey = (eSortType == SORT_HILBERT) ? hilbertKey(nX, nY) : mortonKey(nX, nY);
+		aKeys[i].nHost = i;
+	}
+	qsort(aKeys, pHosts->nHosts, sizeof(t_HostKey), compareHostKeys);
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		aSorted[i] = pHosts->aHosts[aKeys[i].nHost];
+		pHosts->aOrigID[i] = aKeys[i].nHost;
+		pHosts->aSortedID[aKeys[i].nHost] = i;
+	}
+	memcpy(pHosts->aHosts, aSorted, sizeof(t_SingleHost) * pHosts->nHosts);
+	free(aKeys);
+	free(aSorted);
+	return 1;
+}
+
+/*
+	list the hosts of each type once, so initial infections can be chosen without scanning every host
+*/
+int indexHostTypes(t_Hosts *pHosts)
+{
+	int		i, nOne, nTwo;
+
+	pHosts->aByType = malloc(sizeof(int) * (pHosts->nHosts > 0 ? pHosts->nHosts : 1));
+	if (!pHosts->aByType)
+	{
+		fprintf(stderr, "indexHostTypes(): Out of memory\n");
+		return 0;
+	}
+	pHosts->nTypeOne = pHosts->nTypeTwo = 0;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		if (pHosts->aHosts[i].eType == TYPE_I)
+		{
+			pHosts->nTypeOne++;
+		}
+	}
+	nOne = 0;
+	nTwo = pHosts->nTypeOne;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		if (pHosts->aHosts[i].eType == TYPE_I)
+		{
+			pHosts->aByType[nOne++] = i;
+		}
+		else
+		{
+			pHosts->aByType[nTwo++] = i;
+		}
+	}
+	pHosts->nTypeTwo = nTwo - pHosts->nTypeOne;
+	return 1;
+}
+
+/*
+	read in host locations and types, from either a csv or a binary host file
+*/
+int loadHosts(t_Params *pParams, t_Hosts *pHosts)
+{
+	t_MappedFile	sMap;
+	int				retVal;
+
+	retVal = 0;
+	pHosts->nHosts = 0;
+	if (!mapFile(pParams->sXYFile, &sMap))
+	{
+		fprintf(stderr, "loadHosts(): Could not open %s\n", pParams->sXYFile);
+		return 0;
+	}
+	if (sMap.nSize >= sizeof(t_HostFileHeader) && memcmp(sMap.pData, _HOST_FILE_MAGIC, 8) == 0)
+	{
+		retVal = loadHostsBinary(&sMap, pHosts);
+	}
+	else
+	{
+		retVal = loadHostsCSV(&sMap, pHosts);
+	}
+	unmapFile(&sMap);
+	fprintf(stdout, "Read in %d hosts\n", pHosts->nHosts);
+	if (retVal && pParams->sHostsBinFile[0])
+	{
+		retVal = saveHostsBinary(pParams->sHostsBinFile, pHosts);
+	}
+	if (retVal && pParams->eSortHosts != SORT_NONE)
+	{
+		retVal = sortHosts(pHosts, pParams->eSortHosts);
+	}
+	if (retVal)
+	{
+		retVal = indexHostTypes(pHosts);
+	}
+	return (retVal && pHosts->nHosts > 0);
+}
+
+double getKernel(int hostOne, int hostTwo, t_Kernel *pKernel, t_Hosts *pHosts, t_Params *pParams)
+{
+	size_t			p;
+	double			dKernel;
+	t_KernelEdit	*pEdit;
+
+	if (pKernel->nGrid > 0)
+	{
+		dKernel = gridKernel(hostOne, hostTwo, pKernel, pHosts, pParams);
+	}
+	else if (pKernel->eStore == STORE_DENSE)
+	{
+		p = posFromHostIDs(hostOne, hostTwo, pHosts->nHosts);
+		dKernel = pKernel->aKernel[p];
+	}
+	else if (hostOne == hostTwo)
+	{
+		dKernel = 0.0;
+	}
+	else if (pKernel->eStore == STORE_PACKED)
+	{
+		dKernel = pKernel->aKernel[packedPos(hostOne, hostTwo)];
+	}
+	else if (pKernel->eStore == STORE_SINGLE)
+	{
+		dKernel = pKernel->aKernelSingle[packedPos(hostOne, hostTwo)];
+	}
+	else if (pKernel->eStore == STORE_SPARSE)
+	{
+		dKernel = sparseKernel(hostOne, hostTwo, pKernel);
+	}
+	else if (pKernel->eStore == STORE_TILED)
+	{
+		dKernel = tileKernel(hostOne, hostTwo, pKernel->pTiles);
+	}
+	else if (pKernel->eStore == STORE_EDITED)
+	{
+		/* from the base landscape's kernel, unless one of them was added */
+		pEdit = pKernel->pEdit;
+		if (pEdit->aBaseHost[hostOne] != _NOT_SET && pEdit->aBaseHost[hostTwo] != _NOT_SET)
+		{
+			dKernel = getKernel(pEdit->aBaseHost[hostOne], pEdit->aBaseHost[hostTwo], pEdit->pBase, pEdit->pBaseHosts, pParams);
+		}
+		else if (pEdit->aBaseHost[hostTwo] == _NOT_SET)
+		{
+			dKernel = pEdit->aAddedKernel[(size_t)(hostTwo - pEdit->nKept) * pHosts->nHosts + hostOne];
+		}
+		else
+		{
+			dKernel = pEdit->aAddedKernel[(size_t)(hostOne - pEdit->nKept) * pHosts->nHosts + hostTwo];
+		}
+	}
+	else
+	{
+		dKernel = pKernel->pSpec->pfPair(hostOne, hostTwo, pKernel, pHosts, pParams);
+	}
+	return dKernel;
+}
+
+/*
+	hand out the next 16-byte aligned chunk of a workspace block
+*/
+void *carveBlock(char **ppNext, size_t nBytes)
+{
+	void	*pRet;
+
+	pRet = *ppNext;
+	*ppNext += (nBytes + 15) & ~(size_t)15;
+	return pRet;
+}
+
+/*
+	cell a point is in (one on the far edge of the grid is in the last cell)
+*/
+int hostGridCell(t_HostGrid *pGrid, double dX, double dY)
+{
+	int		cx, cy;
+
+	cx = (int)((dX - pGrid->dMinX) / pGrid->dCellSize);
+	cy = (int)((dY - pGrid->dMinY) / pGrid->dCellSize);
+	cx = (cx < pGrid->nCellsX - 1) ? cx : pGrid->nCellsX - 1;
+	cy = (cy < pGrid->nCellsY - 1) ? cy : pGrid->nCellsY - 1;
+	return cy * pGrid->nCellsX + cx;
+}
+
+/*
+	put the hosts into a grid of square cells dCellSize across (bigger if that would
+	make many more cells than hosts)
+*/
+int buildHostGrid(t_HostGrid *pGrid, t_Hosts *pHosts, double dCellSize)
+{
+	double	dMaxX, dMaxY;
+	int		i, c, nCells;
+
+	memset(pGrid, 0, sizeof(t_HostGrid));
+	dMaxX = pGrid->dMinX = pHosts->aHosts[0].dX;
+	dMaxY = pGrid->dMinY = pHosts->aHosts[0].dY;
+	for (i = 1; i < pHosts->nHosts; i++)
+	{
+		pGrid->dMinX = (pHosts->aHosts[i].dX < pGrid->dMinX) ? pHosts->aHosts[i].dX : pGrid->dMinX;
+		pGrid->dMinY = (pHosts->aHosts[i].dY < pGrid->dMinY) ? pHosts->aHosts[i].dY : pGrid->dMinY;
+		dMaxX = (pHosts->aHosts[i].dX > dMaxX) ? pHosts->aHosts[i].dX : dMaxX;
+		dMaxY = (pHosts->aHosts[i].dY > dMaxY) ? pHosts->aHosts[i].dY : dMaxY;
+	}
+	pGrid->dCellSize = dCellSize;
+	while ((floor((dMaxX - pGrid->dMinX) / pGrid->dCellSize) + 1.0) * (floor((dMaxY - pGrid->dMinY) / pGrid->dCellSize) + 1.0)
+		> 4.0 * pHosts->nHosts + 16.0)
+	{
+		pGrid->dCellSize *= 2.0;
+	}
+	pGrid->nCellsX = (int)floor((dMaxX - pGrid->dMinX) / pGrid->dCellSize) + 1;
+	pGrid->nCellsY = (int)floor((dMaxY - pGrid->dMinY) / pGrid->dCellSize) + 1;
+	nCells = pGrid->nCellsX * pGrid->nCellsY;
+	pGrid->aCellStart = calloc(nCells + 1, sizeof(int));
+	pGrid->aCellHosts = malloc(sizeof(int) * pHosts->nHosts);
+	if (!pGrid->aCellStart || !pGrid->aCellHosts)
+	{
+		fprintf(stderr, "buildHostGrid(): Out of memory for %d cells\n", nCells);
+		return 0;
+	}
+	/* counting sort by cell, so each cell's hosts stay in ID order */
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		pGrid->aCellStart[hostGridCell(pGrid, pHosts->aHosts[i].dX, pHosts->aHosts[i].dY) + 1]++;
+	}
+	for (c = 0; c < nCells; c++)
+	{
+		pGrid->aCellStart[c + 1] += pGrid->aCellStart[c];
+	}
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		c = hostGridCell(pGrid, pHosts->aHosts[i].dX, pHosts->aHosts[i].dY);
+		pGrid->aCellHosts[pGrid->aCellStart[c]++] = i;
+	}
+	/* each start was moved on to the next cell's */
+	for (c = nCells; c > 0; c--)
+	{
+		pGrid->aCellStart[c] = pGrid->aCellStart[c - 1];
+	}
+	pGrid->aCellStart[0] = 0;
+	return 1;
+}
+
+/*
+	hosts no further than dR from (dX, dY), into aOut[], returning how many there are
+*/
+int hostsWithin(t_HostGrid *pGrid, t_Hosts *pHosts, double dX, double dY, double dR, int *aOut)
+{
+	int		cx, cy, cxFirst, cxLast, cyFirst, cyLast, c, k, i, n;
+	double	dx, dy;
+
+	cxFirst = (int)floor((dX - dR - pGrid->dMinX) / pGrid->dCellSize);
+	cxLast = (int)floor((dX + dR - pGrid->dMinX) / pGrid->dCellSize);
+	cyFirst = (int)floor((dY - dR - pGrid->dMinY) / pGrid->dCellSize);
+	cyLast = (int)floor((dY + dR - pGrid->dMinY) / pGrid->dCellSize);
+	cxFirst = (cxFirst > 0) ? cxFirst : 0;
+	cyFirst = (cyFirst > 0) ? cyFirst : 0;
+	cxLast = (cxLast < pGrid->nCellsX - 1) ? cxLast : pGrid->nCellsX - 1;
+	cyLast = (cyLast < pGrid->nCellsY - 1) ? cyLast : pGrid->nCellsY - 1;
+	n = 0;
+	for (cy = cyFirst; cy <= cyLast; cy++)
+	{
+		for (cx = cxFirst; cx <= cxLast; cx++)
+		{
+			c = cy * pGrid->nCellsX + cx;
+			for (k = pGrid->aCellStart[c]; k < pGrid->aCellStart[c + 1]; k++)
+			{
+				i = pGrid->aCellHosts[k];
+				dx = pHosts->aHosts[i].dX - dX;
+				dy = pHosts->aHosts[i].dY - dY;
+				if (dx * dx + dy * dy <= dR * dR)
+				{
+					aOut[n++] = i;
+				}
+			}
+		}
+	}
+	return n;
+}
+
+void freeHostGrid(t_HostGrid *pGrid)
+{
+	free(pGrid->aCellStart);
+	free(pGrid->aCellHosts);
+	memset(pGrid, 0, sizeof(t_HostGrid));
+}
+
+void freeWorkspace(t_Workspace *pWork)
+{
+	if (pWork->sEpidemic.aEntries)
+	{
+		free(pWork->sEpidemic.aEntries);
+	}
+	if (pWork->aTimeLog)
+	{
+		free(pWork->aTimeLog);
+	}
+	if (pWork->sOut.pText)
+	{
+		free(pWork->sOut.pText);
+	}
+	if (pWork->pBlock)
+	{
+		free(pWork->pBlock);
+	}
+	if (pWork->aBlockSum)
+	{
+		free(pWork->aBlockSum);
+	}
+	freeHostGrid(&pWork->sCullGrid);
+	memset(pWork, 0, sizeof(t_Workspace));
+}
+
+/*
+	infective engine: put each host in the group for the rate it fires infection attempts at
+	when infected, theta*dRhoMax times its kernel row total, so within a group attempt rates
+	are within a factor of two of each other (bar the last group, which takes everything lower)
+*/
+void initRateGroups(t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		i, g;
+	double	dTop, thisTheta;
+
+	pWork->dRhoMax = (pParams->dRhoOne > pParams->dRhoTwo) ? pParams->dRhoOne : pParams->dRhoTwo;
+	dTop = 0.0;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		thisTheta = pParams->dThetaOne;
+		if (pHosts->aHosts[i].eType == TYPE_II)
+		{
+			thisTheta = pParams->dThetaTwo;
+		}
+		pWork->aAttemptRate[i] = thisTheta * pWork->dRhoMax * pKernel->aRowSum[i];
+		dTop = (pWork->aAttemptRate[i] > dTop) ? pWork->aAttemptRate[i] : dTop;
+	}
+	memset(pWork->aGroupCount, 0, sizeof(pWork->aGroupCount));
+	memset(pWork->aGroupMax, 0, sizeof(pWork->aGroupMax));
+	pWork->nRateGroups = 0;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		pWork->aRateGroup[i] = _NOT_SET;
+		if (pWork->aAttemptRate[i] > 0.0)
+		{
+			g = (int)floor(log(dTop / pWork->aAttemptRate[i]) / log(2.0));
+			g = (g < _MAX_RATE_GROUPS - 1) ? g : _MAX_RATE_GROUPS - 1;
+			pWork->aRateGroup[i] = g;
+			pWork->aGroupCount[g]++;
+			pWork->aGroupMax[g] = (pWork->aAttemptRate[i] > pWork->aGroupMax[g]) ? pWork->aAttemptRate[i] : pWork->aGroupMax[g];
+			pWork->nRateGroups = (g + 1 > pWork->nRateGroups) ? g + 1 : pWork->nRateGroups;
+		}
+	}
+	/* each group gets room in aGroupHosts for every host that could join it */
+	g = 0;
+	for (i = 0; i < _MAX_RATE_GROUPS; i++)
+	{
+		pWork->aGroupStart[i] = g;
+		g += pWork->aGroupCount[i];
+		pWork->aGroupCount[i] = 0;
+		pWork->aGroupTotal[i] = 0.0;
+	}
+}
+
+/*
+	allocate everything a replicate needs in one go, so runEpidemics() can reuse it
+*/
+int initWorkspace(t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	size_t	nHosts, nGens, nCells, nAttempters, nBytes;
+	char	*pNext;
+	int		c, k;
+
+	memset(pWork, 0, sizeof(t_Workspace));
+	nHosts = pHosts->nHosts;
+	nGens = pParams->nMaxGen + 1;
+	nCells = pKernel->nCells;
+	nAttempters = (pParams->eEngine == ENGINE_INFECTIVES) ? nHosts : 0;
+	nBytes = 16 * 16
+		+ sizeof(t_HostStatus) * nHosts
+		+ (sizeof(int) + sizeof(double) + sizeof(int) + sizeof(int)) * nHosts
+		+ 2 * sizeof(int) * nGens
+		+ sizeof(int) * _MAX_SPARSE_HOSTS
+		+ 4 * sizeof(double) * nCells
+		+ (sizeof(double) + 3 * sizeof(int)) * nAttempters;
+	pWork->pBlock = malloc(nBytes);
+	pWork->sEpidemic.aEntries = malloc(sizeof(t_EpidemicEntry) * nHosts);
+	if (pWork->pBlock == NULL || pWork->sEpidemic.aEntries == NULL)
+	{
+		fprintf(stderr, "initWorkspace(): Out of memory for %d hosts\n", pHosts->nHosts);
+		freeWorkspace(pWork);
+		return 0;
+	}
+	/* in the SIR model every host is infected at most once, so this never needs to grow */
+	pWork->sEpidemic.nAlloc = pHosts->nHosts;
+	pNext = pWork->pBlock;
+	pWork->aHostStatus = carveBlock(&pNext, sizeof(t_HostStatus) * nHosts);
+	pWork->aInfectiveID = carveBlock(&pNext, sizeof(int) * nHosts);
+	pWork->aInfectiveRate = carveBlock(&pNext, sizeof(double) * nHosts);
+	pWork->aHostList = carveBlock(&pNext, sizeof(int) * nHosts);
+	pWork->aTypeOneByGen = carveBlock(&pNext, sizeof(int) * nGens);
+	pWork->aTypeTwoByGen = carveBlock(&pNext, sizeof(int) * nGens);
+	pWork->aTouched = carveBlock(&pNext, sizeof(int) * _MAX_SPARSE_HOSTS);
+	pWork->aCellRate = carveBlock(&pNext, sizeof(double) * nCells);
+	pWork->aFarForce = carveBlock(&pNext, sizeof(double) * nCells);
+	pWork->aRhoSus = carveBlock(&pNext, sizeof(double) * nCells);
+	pWork->aCellRho = carveBlock(&pNext, sizeof(double) * nCells);
+	pWork->aInfectives = carveBlock(&pNext, sizeof(int) * nHosts);
+	pWork->aAttemptRate = carveBlock(&pNext, sizeof(double) * nAttempters);
+	pWork->aRateGroup = carveBlock(&pNext, sizeof(int) * nAttempters);
+	pWork->aGroupPos = carveBlock(&pNext, sizeof(int) * nAttempters);
+	pWork->aGroupHosts = carveBlock(&pNext, sizeof(int) * nAttempters);
+	if (nAttempters > 0)
+	{
+		initRateGroups(pWork, pParams, pHosts, pKernel);
+	}
+	for (c = 0; c < pKernel->nCells; c++)
+	{
+		pWork->aCellRho[c] = 0.0;
+		for (k = pKernel->aCellStart[c]; k < pKernel->aCellStart[c + 1]; k++)
+		{
+			pWork->aCellRho[c] += (pHosts->aHosts[pKernel->aCellHosts[k]].eType == TYPE_II) ? pParams->dRhoTwo : pParams->dRhoOne;
+		}
+	}
+	memcpy(pWork->aHostList, pHosts->aByType, sizeof(int) * nHosts);
+	memset(pWork->aHostStatus, 0, sizeof(t_HostStatus) * nHosts);	/* epoch 0 is never used */
+	/* a big landscape splits the work of each event into blocks, of cells or hosts (and candidate infectors) */
+	if (pParams->eEngine == ENGINE_HOSTS && pHosts->nHosts >= _EVENT_BLOCK_MIN_HOSTS)
+	{
+		pWork->nBlocks = (pHosts->nHosts + _EVENT_BLOCK_HOSTS - 1) / _EVENT_BLOCK_HOSTS;
+		pWork->nBlockAlloc = pWork->nBlocks;
+		if (pKernel->nGrid > 0)
+		{
+			pWork->nBlocks = (pKernel->nCells + _EVENT_BLOCK_CELLS - 1) / _EVENT_BLOCK_CELLS;
+			pWork->nBlockAlloc = (pWork->nBlocks > pWork->nBlockAlloc) ? pWork->nBlocks : pWork->nBlockAlloc;
+		}
+		pWork->aBlockSum = malloc(sizeof(double) * pWork->nBlockAlloc);
+		if (!pWork->aBlockSum)
+		{
+			fprintf(stderr, "initWorkspace(): Out of memory for %d blocks\n", pWork->nBlockAlloc);
+			freeWorkspace(pWork);
+			return 0;
+		}
+	}
+	if (pParams->dCullRadius > 0.0 && pHosts->nHosts > 0 && !buildHostGrid(&pWork->sCullGrid, pHosts, pParams->dCullRadius))
+	{
+		freeWorkspace(pWork);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+	host status as it would be at the start of a replicate
+*/
+void resetHost(t_HostStatus *pStatus, unsigned int nEpoch)
+{
+	pStatus->nGen = _NOT_SET;
+	pStatus->dRate = 0.0;
+	pStatus->eStatus = SUSCEPTIBLE;
+	pStatus->nEpoch = nEpoch;
+}
+
+/*
+	bring every host's status up to date with this replicate, before anything looks at all of them
+*/
+void touchAllHosts(t_Workspace *pWork, t_Hosts *pHosts)
+{
+	int				i;
+	t_HostStatus	*aHostStatus;
+
+	if (pWork->bAllTouched)
+	{
+		return;
+	}
+	aHostStatus = pWork->aHostStatus;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		if (aHostStatus[i].nEpoch != pWork->nEpoch)
+		{
+			resetHost(&aHostStatus[i], pWork->nEpoch);
+		}
+	}
+	pWork->bAllTouched = 1;
+}
+
+/*
+	bring one host's status up to date before it is changed, keeping the touched list in order
+*/
+void touchHost(t_Workspace *pWork, t_Hosts *pHosts, int thisHost)
+{
+	int		i;
+
+	if (pWork->aHostStatus[thisHost].nEpoch == pWork->nEpoch)
+	{
+		return;
+	}
+	if (pWork->nTouched == _MAX_SPARSE_HOSTS)
+	{
+		touchAllHosts(pWork, pHosts);
+		return;
+	}
+	resetHost(&pWork->aHostStatus[thisHost], pWork->nEpoch);
+	for (i = pWork->nTouched; i > 0 && pWork->aTouched[i - 1] > thisHost; i--)
+	{
+		pWork->aTouched[i] = pWork->aTouched[i - 1];
+	}
+	pWork->aTouched[i] = thisHost;
+	pWork->nTouched++;
+}
+
+/*
+	start a new replicate: everything from the last one becomes out of date
+*/
+void newEpoch(t_Workspace *pWork, t_Hosts *pHosts)
+{
+	int		i;
+
+	pWork->nEpoch++;
+	if (pWork->nEpoch == 0)
+	{
+		/* wrapped around: old stamps could now look current */
+		for (i = 0; i < pHosts->nHosts; i++)
+		{
+			pWork->aHostStatus[i].nEpoch = 0;
+		}
+		pWork->nEpoch = 1;
+	}
+	pWork->bAllTouched = 0;
+	pWork->nTouched = 0;
+}
+
+/*
+	grid kernel: rate of the next event for a host, counting force of infection from far cells
+*/
+double gridHostRate(int thisHost, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	t_HostStatus	*pStatus;
+	double			thisRho;
+
+	pStatus = &pWork->aHostStatus[thisHost];
+	if (pStatus->nEpoch != pWork->nEpoch)
+	{
+		return 0.0;
+	}
+	if (pStatus->eStatus != SUSCEPTIBLE)
+	{
+		return pStatus->dRate;
+	}
+	thisRho = pParams->dRhoOne;
+	if (pHosts->aHosts[thisHost].eType == TYPE_II)
+	{
+		thisRho = pParams->dRhoTwo;
+	}
+	return pStatus->dRate + thisRho * pWork->aFarForce[pKernel->aHostCell[thisHost]];
+}
+
+/*
+	grid kernel: add force of infection from thisHost (or take it away, if thisTheta is negative),
+	host by host on the susceptible hosts in near cells, and through the far force of the others
+*/
+void spreadGridForce(int thisHost, double thisTheta, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		c, thisCell;
+	double	thisExtra;
+	void	(*pfSpreadNear)(int, int, double, double *, t_Workspace *, t_Params *, t_Hosts *, t_Kernel *);
+
+	pfSpreadNear = pKernel->pSpec->pfSpreadNear;
+	thisCell = pKernel->aHostCell[thisHost];
+	for (c = 0; c < pKernel->nCells; c++)
+	{
+		if (cellsAreNear(c, thisCell, pKernel))
+		{
+			pfSpreadNear(c, thisHost, thisTheta, &pWork->dInfectRate, pWork, pParams, pHosts, pKernel);
+		}
+		else
+		{
+			thisExtra = thisTheta * farKernel(c, thisCell, pKernel);
+			pWork->aFarForce[c] += thisExtra;
+			if (pWork->aFarForce[c] < 0.0)
+			{
+				pWork->aFarForce[c] = 0.0;
+			}
+			pWork->dInfectRate += thisExtra * pWork->aRhoSus[c];
+		}
+	}
+}
+
+/*
+	grid kernel: thisHost has just become susceptible again, so feels force of infection from
+	the infected hosts in near cells, and its cell's far force
+*/
+void gatherGridForce(int thisHost, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		c, thisCell;
+	double	thisRho;
+	void	(*pfGatherNear)(int, int, double, t_Workspace *, t_Params *, t_Hosts *, t_Kernel *);
+
+	pfGatherNear = pKernel->pSpec->pfGatherNear;
+	thisCell = pKernel->aHostCell[thisHost];
+	thisRho = pParams->dRhoOne;
+	if (pHosts->aHosts[thisHost].eType == TYPE_II)
+	{
+		thisRho = pParams->dRhoTwo;
+	}
+	pWork->aRhoSus[thisCell] += thisRho;
+	pWork->dInfectRate += thisRho * pWork->aFarForce[thisCell];
+	for (c = 0; c < pKernel->nCells; c++)
+	{
+		if (cellsAreNear(c, thisCell, pKernel))
+		{
+			pfGatherNear(c, thisHost, thisRho, pWork, pParams, pHosts, pKernel);
+		}
+	}
+}
+
+/*
+	grid kernel: choose the host for the next event, first the cell and then the host within it
+
+	randDbl is uniform on [0, dInfectRate); should rounding leave it past the end, the last host
+	with any rate is chosen
+*/
+int pickGridEvent(double randDbl, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		c, k, i, lastCell, lastHost;
+	double	runningSum, cellRate;
+
+	runningSum = 0.0;
+	lastCell = 0;
+	for (c = 0; c < pKernel->nCells; c++)
+	{
+		cellRate = pWork->aCellRate[c] + pWork->aRhoSus[c] * pWork->aFarForce[c];
+		if (cellRate > 0.0)
+		{
+			lastCell = c;
+			if (runningSum + cellRate > randDbl)
+			{
+				break;
+			}
+			runningSum += cellRate;
+		}
+	}
+	c = lastCell;
+	lastHost = pKernel->aCellHosts[pKernel->aCellStart[c]];
+	for (k = pKernel->aCellStart[c]; k < pKernel->aCellStart[c + 1]; k++)
+	{
+		i = pKernel->aCellHosts[k];
+		cellRate = gridHostRate(i, pWork, pParams, pHosts, pKernel);
+		if (cellRate > 0.0)
+		{
+			lastHost = i;
+			runningSum += cellRate;
+			if (runningSum > randDbl)
+			{
+				break;
+			}
+		}
+	}
+	return lastHost;
+}
+
+/*
+	record a change in the number infected, for time course output
+*/
+int logTimeEvent(t_Workspace *pWork, double thisTime, int eType, int nChange)
+{
+	int				nAlloc;
+	t_TimeLogEntry	*aTimeLog;
+
+	if (pWork->nTimeLog == pWork->nTimeLogAlloc)
+	{
+		nAlloc = 2 * pWork->nTimeLogAlloc + _BLOCK_SIZE;
+		aTimeLog = realloc(pWork->aTimeLog, sizeof(t_TimeLogEntry) * nAlloc);
+		if (!aTimeLog)
+		{
+			fprintf(stderr, "logTimeEvent(): Out of memory\n");
+			return 0;
+		}
+		pWork->aTimeLog = aTimeLog;
+		pWork->nTimeLogAlloc = nAlloc;
+	}
+	pWork->aTimeLog[pWork->nTimeLog].dTime = thisTime;
+	pWork->aTimeLog[pWork->nTimeLog].eType = eType;
+	pWork->aTimeLog[pWork->nTimeLog].nChange = nChange;
+	pWork->nTimeLog++;
+	return 1;
+}
+
+/*
+	add an infection of thisHost by infectedBy (_NOT_SET for an initial infection) to the
+	epidemic, and the running totals kept for dumpEpidemic()
+*/
+int recordInfection(int thisHost, double thisTime, int thisGen, int infectedBy, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts)
+{
+	int				retVal, nAlloc, nParent;
+	t_Epidemic		*pEpidemic;
+	t_EpidemicEntry	*aEntries;
+
+	retVal = 1;
+	pEpidemic = &pWork->sEpidemic;
+	/* only SIS can need more entries than there are hosts */
+	if (pEpidemic->nAlloc == pEpidemic->nEntries)
+	{
+		nAlloc = 2 * pEpidemic->nAlloc + _BLOCK_SIZE;
+		aEntries = realloc(pEpidemic->aEntries, sizeof(t_EpidemicEntry)* nAlloc);
+		if (aEntries)
+		{
+			pEpidemic->aEntries = aEntries;
+			pEpidemic->nAlloc = nAlloc;
+		}
+		else
+		{
+			fprintf(stderr, "recordInfection(): Out of memory\n");
+			retVal = 0;
+		}
+	}
+	if (retVal)
+	{
+		pEpidemic->aEntries[pEpidemic->nEntries].nGen = thisGen;
+		pEpidemic->aEntries[pEpidemic->nEntries].dInfectTime = thisTime;
+		pEpidemic->aEntries[pEpidemic->nEntries].eType = pHosts->aHosts[thisHost].eType;
+		pEpidemic->aEntries[pEpidemic->nEntries].nHostID = thisHost;
+		pEpidemic->aEntries[pEpidemic->nEntries].dRemovalTime = _NOT_SET;
+		pEpidemic->aEntries[pEpidemic->nEntries].nOffspringOne = 0;
+		pEpidemic->aEntries[pEpidemic->nEntries].nOffspringTwo = 0;
+		/* the infector's latest entry is the infection it is in the middle of */
+		nParent = (infectedBy >= 0) ? pWork->aHostStatus[infectedBy].nEntryPtr : _NOT_SET;
+		pEpidemic->aEntries[pEpidemic->nEntries].nInfectedBy = nParent;
+		if (nParent != _NOT_SET && pHosts->aHosts[thisHost].eType == TYPE_I)
+		{
+			pEpidemic->aEntries[nParent].nOffspringOne++;
+		}
+		else if (nParent != _NOT_SET)
+		{
+			pEpidemic->aEntries[nParent].nOffspringTwo++;
+		}
+		pWork->aHostStatus[thisHost].nEntryPtr = pEpidemic->nEntries;
+		pEpidemic->nEntries++;
+		if (thisGen <= pParams->nMaxGen)
+		{
+			if (pHosts->aHosts[thisHost].eType == TYPE_I)
+			{
+				pWork->aTypeOneByGen[thisGen]++;
+			}
+			else
+			{
+				pWork->aTypeTwoByGen[thisGen]++;
+			}
+		}
+		if (pParams->eDumpType == DUMP_TIMES)
+		{
+			retVal = logTimeEvent(pWork, thisTime, pHosts->aHosts[thisHost].eType, 1);
+		}
+	}
+	return retVal;
+}
+
+/*
+	...and the end of one
+*/
+int recordRecovery(int thisHost, double thisTime, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts)
+{
+	pWork->sEpidemic.aEntries[pWork->aHostStatus[thisHost].nEntryPtr].dRemovalTime = thisTime;
+	if (pParams->eDumpType == DUMP_TIMES)
+	{
+		return logTimeEvent(pWork, thisTime, pHosts->aHosts[thisHost].eType, -1);
+	}
+	return 1;
+}
+
+/*
+	infected hosts of each type are kept in aInfectives, so one can be picked uniformly in O(1)
+*/
+void addInfective(int thisHost, t_Workspace *pWork, t_Hosts *pHosts)
+{
+	int		nPos;
+
+	if (pHosts->aHosts[thisHost].eType == TYPE_I)
+	{
+		nPos = pWork->nInfOne++;
+	}
+	else
+	{
+		nPos = pHosts->nTypeOne + pWork->nInfTwo++;
+	}
+	pWork->aInfectives[nPos] = thisHost;
+	pWork->aHostStatus[thisHost].nListPos = nPos;
+}
+
+void removeInfective(int thisHost, t_Workspace *pWork, t_Hosts *pHosts)
+{
+	int		nPos, nLast, nOther;
+
+	if (pHosts->aHosts[thisHost].eType == TYPE_I)
+	{
+		nLast = --pWork->nInfOne;
+	}
+	else
+	{
+		nLast = pHosts->nTypeOne + --pWork->nInfTwo;
+	}
+	/* the last in the list takes its place */
+	nPos = pWork->aHostStatus[thisHost].nListPos;
+	nOther = pWork->aInfectives[nLast];
+	pWork->aInfectives[nPos] = nOther;
+	pWork->aHostStatus[nOther].nListPos = nPos;
+}
+
+/*
+	a pass over the hosts (or cells, or candidate infectors) for one event, split into
+	blocks on a big landscape; see t_Workspace
+*/
+enum
+{
+	BLOCK_SPREAD = 0,		/* force of infection from thisHost changes by dMult times the kernel */
+	BLOCK_GATHER = 1,		/* force of infection on thisHost (susceptibility dMult) from the infected hosts */
+	BLOCK_RATES = 2,		/* total dRate */
+	BLOCK_INFECTORS = 3,	/* force of infection on thisHost (susceptibility dMult) from the candidate infectors */
+	BLOCK_CULL = 4			/* force of infection from each of aList[] is taken away (full kernel only) */
+} blockJobType;
+
+typedef struct {
+	int			eJob;
+	int			thisHost;
+	double		dMult;
+	int			nItems;			/* hosts, cells or candidates... */
+	int			nPerBlock;		/* ...this many to a block */
+	int			nBlocks;
+	int			*aList;			/* BLOCK_CULL: the hosts culled while infected */
+	int			nList;
+	t_Workspace	*pWork;
+	t_Params	*pParams;
+	t_Hosts		*pHosts;
+	t_Kernel	*pKernel;
+} t_BlockJob;
+
+/*
+	room for the shares of nBlocks blocks (candidate infectors with a grid kernel can outgrow nHosts)
+*/
+int growBlockSums(t_Workspace *pWork, int nBlocks)
+{
+	double	*aNew;
+	int		nAlloc;
+
+	if (nBlocks <= pWork->nBlockAlloc)
+	{
+		return 1;
+	}
+	nAlloc = (nBlocks > 2 * pWork->nBlockAlloc) ? nBlocks : 2 * pWork->nBlockAlloc;
+	aNew = realloc(pWork->aBlockSum, sizeof(double) * nAlloc);
+	if (!aNew)
+	{
+		fprintf(stderr, "growBlockSums(): Out of memory for %d blocks\n", nAlloc);
+		return 0;
+	}
+	pWork->aBlockSum = aNew;
+	pWork->nBlockAlloc = nAlloc;
+	return 1;
+}
+
+/*
+	k-th candidate for having infected a host: host k with the full kernel, or the host of
+	entry k in the epidemic with a grid kernel (if that is its latest); _NOT_SET if not infected
+*/
+int infectorCandidate(int k, t_Workspace *pWork, t_Kernel *pKernel)
+{
+	int		j;
+
+	j = (pKernel->nGrid > 0) ? pWork->sEpidemic.aEntries[k].nHostID : k;
+	if (pWork->aHostStatus[j].eStatus == INFECTED && (pKernel->nGrid == 0 || pWork->aHostStatus[j].nEntryPtr == k))
+	{
+		return j;
+	}
+	return _NOT_SET;
+}
+
+/*
+	force of infection from infected host j on eventHost, whose susceptibility is thisRho
+*/
+double infectorRate(int j, int eventHost, double thisRho, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	double	thisTheta;
+
+	thisTheta = pParams->dThetaOne;
+	if (pHosts->aHosts[j].eType == TYPE_II)
+	{
+		thisTheta = pParams->dThetaTwo;
+	}
+	if (pWork->aHostStatus[j].nGen >= pParams->nMaxGen)
+	{
+		thisTheta = 0.0;	/* artificially stop infections once too many generations have passed */
+	}
+	return thisTheta * thisRho * getKernel(j, eventHost, pKernel, pHosts, pParams);
+}
+
+void setBlockJob(t_BlockJob *pJob, int eJob, int thisHost, double dMult, int nItems, int nPerBlock,
+	t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	pJob->eJob = eJob;
+	pJob->thisHost = thisHost;
+	pJob->dMult = dMult;
+	pJob->nItems = nItems;
+	pJob->nPerBlock = nPerBlock;
+	pJob->nBlocks = (nItems + nPerBlock - 1) / nPerBlock;
+	pJob->aList = NULL;
+	pJob->nList = 0;
+	pJob->pWork = pWork;
+	pJob->pParams = pParams;
+	pJob->pHosts = pHosts;
+	pJob->pKernel = pKernel;
+}
+
+/*
+	block b of a job, each exactly as the loop in infectHost(), recoverHost() or runReplicate()
+	it stands in for, except that totals start from zero in aBlockSum[b]
+*/
+void runBlock(t_BlockJob *pJob, int b)
+{
+	int				i, j, k, nFirst, nLast;
+	double			thisRho, thisTheta, thisExtra, dSum;
+	t_Workspace		*pWork;
+	t_Params		*pParams;
+	t_Hosts			*pHosts;
+	t_Kernel		*pKernel;
+	t_HostStatus	*aHostStatus;
+
+	pWork = pJob->pWork;
+	pParams = pJob->pParams;
+	pHosts = pJob->pHosts;
+	pKernel = pJob->pKernel;
+	aHostStatus = pWork->aHostStatus;
+	nFirst = b * pJob->nPerBlock;
+	nLast = (nFirst + pJob->nPerBlock < pJob->nItems) ? nFirst + pJob->nPerBlock : pJob->nItems;
+	dSum = 0.0;
+	if (pJob->eJob == BLOCK_SPREAD && pKernel->nGrid > 0)
+	{
+		/* cells nFirst to nLast - 1, as spreadGridForce() */
+		thisTheta = pJob->dMult;
+		for (k = nFirst; k < nLast; k++)
+		{
+			if (cellsAreNear(k, pKernel->aHostCell[pJob->thisHost], pKernel))
+			{
+				pKernel->pSpec->pfSpreadNear(k, pJob->thisHost, thisTheta, &dSum, pWork, pParams, pHosts, pKernel);
+			}
+			else
+			{
+				thisExtra = thisTheta * farKernel(k, pKernel->aHostCell[pJob->thisHost], pKernel);
+				pWork->aFarForce[k] += thisExtra;
+				if (pWork->aFarForce[k] < 0.0)
+				{
+					pWork->aFarForce[k] = 0.0;
+				}
+				dSum += thisExtra * pWork->aRhoSus[k];
+			}
+		}
+	}
+	else if (pJob->eJob == BLOCK_SPREAD)
+	{
+		thisTheta = pJob->dMult;
+		for (i = nFirst; i < nLast; i++)
+		{
+			if (aHostStatus[i].eStatus == SUSCEPTIBLE)
+			{
+				thisRho = pParams->dRhoOne;
+				if (pHosts->aHosts[i].eType == TYPE_II)
+				{
+					thisRho = pParams->dRhoTwo;
+				}
+				thisExtra = thisTheta * thisRho * getKernel(i, pJob->thisHost, pKernel, pHosts, pParams);
+				aHostStatus[i].dRate += thisExtra;
+				if (aHostStatus[i].dRate < 0.0)
+				{
+					aHostStatus[i].dRate = 0.0;
+				}
+				dSum += thisExtra;
+			}
+		}
+	}
+	else if (pJob->eJob == BLOCK_GATHER)
+	{
+		thisRho = pJob->dMult;
+		for (i = nFirst; i < nLast; i++)
+		{
+			if (aHostStatus[i].eStatus == INFECTED && aHostStatus[i].nGen < pParams->nMaxGen)
+			{
+				thisTheta = pParams->dThetaOne;
+				if (pHosts->aHosts[i].eType == TYPE_II)
+				{
+					thisTheta = pParams->dThetaTwo;
+				}
+				dSum += thisTheta * thisRho * getKernel(i, pJob->thisHost, pKernel, pHosts, pParams);
+			}
+		}
+	}
+	else if (pJob->eJob == BLOCK_RATES)
+	{
+		for (i = nFirst; i < nLast; i++)
+		{
+			dSum += aHostStatus[i].dRate;
+		}
+	}
+	else if (pJob->eJob == BLOCK_CULL)
+	{
+		/* as BLOCK_SPREAD for each host in aList[] with minus its theta, but in one pass */
+		for (i = nFirst; i < nLast; i++)
+		{
+			if (aHostStatus[i].eStatus == SUSCEPTIBLE)
+			{
+				thisExtra = 0.0;
+				for (k = 0; k < pJob->nList; k++)
+				{
+					j = pJob->aList[k];
+					thisTheta = pParams->dThetaOne;
+					if (pHosts->aHosts[j].eType == TYPE_II)
+					{
+						thisTheta = pParams->dThetaTwo;
+					}
+					thisExtra += thisTheta * getKernel(i, j, pKernel, pHosts, pParams);
+				}
+				thisRho = pParams->dRhoOne;
+				if (pHosts->aHosts[i].eType == TYPE_II)
+				{
+					thisRho = pParams->dRhoTwo;
+				}
+				thisExtra *= thisRho;
+				aHostStatus[i].dRate -= thisExtra;
+				if (aHostStatus[i].dRate < 0.0)
+				{
+					aHostStatus[i].dRate = 0.0;
+				}
+				dSum -= thisExtra;
+			}
+		}
+	}
+	else
+	{
+		for (k = nFirst; k < nLast; k++)
+		{
+			j = infectorCandidate(k, pWork, pKernel);
+			if (j != _NOT_SET)
+			{
+				dSum += infectorRate(j, pJob->thisHost, pJob->dMult, pWork, pParams, pHosts, pKernel);
+			}
+		}
+	}
+	pWork->aBlockSum[b] = dSum;
+}
+
+/*
+	thread nThread of nThreads takes every nThreads-th block, so the near cells of a grid
+	kernel, which are close together, are spread over the threads
+*/
+void blockWorker(void *pCtx, int nThread, int nThreads)
+{
+	t_BlockJob	*pJob;
+	int			b;
+
+	pJob = (t_BlockJob*)pCtx;
+	for (b = nThread; b < pJob->nBlocks; b += nThreads)
+	{
+		runBlock(pJob, b);
+	}
+}
+
+void runBlocks(t_BlockJob *pJob)
+{
+	if (pJob->pWork->pTeam && pJob->nBlocks > 1)
+	{
+		teamRun(pJob->pWork->pTeam, blockWorker, pJob);
+	}
+	else
+	{
+		blockWorker(pJob, 0, 1);
+	}
+}
+
+/*
+	force of infection from thisHost changes by thisTheta (negative to take it away) times the
+	kernel, block by block
+*/
+void spreadBlocks(int thisHost, double thisTheta, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	t_BlockJob	sJob;
+	int			b;
+
+	if (pKernel->nGrid > 0)
+	{
+		setBlockJob(&sJob, BLOCK_SPREAD, thisHost, thisTheta, pKernel->nCells, _EVENT_BLOCK_CELLS, pWork, pParams, pHosts, pKernel);
+	}
+	else
+	{
+		setBlockJob(&sJob, BLOCK_SPREAD, thisHost, thisTheta, pHosts->nHosts, _EVENT_BLOCK_HOSTS, pWork, pParams, pHosts, pKernel);
+	}
+	runBlocks(&sJob);
+	for (b = 0; b < sJob.nBlocks; b++)
+	{
+		pWork->dInfectRate += pWork->aBlockSum[b];
+	}
+}
+
+/*
+	full kernel: susceptible thisHost (with susceptibility thisRho) feels the force of infection
+	from the infected hosts, block by block
+*/
+void gatherBlocks(int thisHost, double thisRho, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	t_BlockJob	sJob;
+	int			b;
+
+	setBlockJob(&sJob, BLOCK_GATHER, thisHost, thisRho, pHosts->nHosts, _EVENT_BLOCK_HOSTS, pWork, pParams, pHosts, pKernel);
+	runBlocks(&sJob);
+	for (b = 0; b < sJob.nBlocks; b++)
+	{
+		pWork->aHostStatus[thisHost].dRate += pWork->aBlockSum[b];
+		pWork->dInfectRate += pWork->aBlockSum[b];
+	}
+}
+
+/*
+	full kernel: choose the host for the next infection, first the block and then the host
+	within it (as pickGridEvent() does with cells)
+*/
+int pickBlockEvent(double randDbl, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	t_BlockJob	sJob;
+	int			b, i, lastBlock, lastHost, nLast;
+	double		runningSum;
+
+	setBlockJob(&sJob, BLOCK_RATES, _NOT_SET, 0.0, pHosts->nHosts, _EVENT_BLOCK_HOSTS, pWork, pParams, pHosts, pKernel);
+	runBlocks(&sJob);
+	runningSum = 0.0;
+	lastBlock = 0;
+	for (b = 0; b < sJob.nBlocks; b++)
+	{
+		if (pWork->aBlockSum[b] > 0.0)
+		{
+			lastBlock = b;
+			if (runningSum + pWork->aBlockSum[b] > randDbl)
+			{
+				break;
+			}
+			runningSum += pWork->aBlockSum[b];
+		}
+	}
+	lastHost = lastBlock * _EVENT_BLOCK_HOSTS;
+	nLast = (lastHost + _EVENT_BLOCK_HOSTS < pHosts->nHosts) ? lastHost + _EVENT_BLOCK_HOSTS : pHosts->nHosts;
+	for (i = lastHost; i < nLast; i++)
+	{
+		if (pWork->aHostStatus[i].dRate > 0.0)
+		{
+			lastHost = i;
+			runningSum += pWork->aHostStatus[i].dRate;
+			if (runningSum > randDbl)
+			{
+				break;
+			}
+		}
+	}
+	return lastHost;
+}
+
+/*
+	choose which infected host caused eventHost's infection (eventHost has susceptibility thisRho),
+	first the block of candidates and then the host within it; _NOT_SET if out of memory
+*/
+int pickBlockInfector(int eventHost, double thisRho, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	t_BlockJob	sJob;
+	int			b, j, k, lastBlock, lastHost, nLast;
+	double		runningSum, randDbl, thisExtra;
+
+	setBlockJob(&sJob, BLOCK_INFECTORS, eventHost, thisRho, (pKernel->nGrid > 0) ? pWork->sEpidemic.nEntries : pHosts->nHosts,
+		_EVENT_BLOCK_HOSTS, pWork, pParams, pHosts, pKernel);
+	if (!growBlockSums(pWork, sJob.nBlocks))
+	{
+		return _NOT_SET;
+	}
+	runBlocks(&sJob);
+	runningSum = 0.0;
+	for (b = 0; b < sJob.nBlocks; b++)
+	{
+		runningSum += pWork->aBlockSum[b];
+	}
+	randDbl = runningSum * uniformRandom(&pWork->sRNG);
+	runningSum = 0.0;
+	lastBlock = 0;
+	for (b = 0; b < sJob.nBlocks; b++)
+	{
+		if (pWork->aBlockSum[b] > 0.0)
+		{
+			lastBlock = b;
+			if (runningSum + pWork->aBlockSum[b] > randDbl)
+			{
+				break;
+			}
+			runningSum += pWork->aBlockSum[b];
+		}
+	}
+	/* should nothing have any force of infection on it at all, any infected host will do */
+	lastHost = (pWork->nInfOne > 0) ? pWork->aInfectives[0] : pWork->aInfectives[pHosts->nTypeOne];
+	nLast = (lastBlock + 1) * _EVENT_BLOCK_HOSTS;
+	nLast = (nLast < sJob.nItems) ? nLast : sJob.nItems;
+	for (k = lastBlock * _EVENT_BLOCK_HOSTS; k < nLast; k++)
+	{
+		j = infectorCandidate(k, pWork, pKernel);
+		if (j == _NOT_SET)
+		{
+			continue;
+		}
+		thisExtra = infectorRate(j, eventHost, thisRho, pWork, pParams, pHosts, pKernel);
+		if (thisExtra > 0.0)
+		{
+			lastHost = j;
+			runningSum += thisExtra;
+			if (runningSum > randDbl)
+			{
+				break;
+			}
+		}
+	}
+	return lastHost;
+}
+
+int recoverHost(int thisHost, double thisTime, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int				i, retVal;
+	double			thisTheta, thisRho, thisExtra;
+	t_HostStatus	*aHostStatus;
+	double			*pInfectRate;
+
+	aHostStatus = pWork->aHostStatus;
+	pInfectRate = &pWork->dInfectRate;
+	removeInfective(thisHost, pWork, pHosts);
+	thisTheta = pParams->dThetaOne;
+	if (pHosts->aHosts[thisHost].eType == TYPE_II)
+	{
+		thisTheta = pParams->dThetaTwo;
+	}
+	if (pKernel->pTiles && ((aHostStatus[thisHost].nGen < pParams->nMaxGen && thisTheta > 0.0) || pParams->eModelType == MODEL_SIS)
+		&& !prefetchTiles(pKernel->pTiles, thisHost))
+	{
+		return 0;
+	}
+	/* update susceptible hosts to no longer feel the force of infection from this one */
+	/* note only need to do this when host isn't so old that not infecting anyway */
+	if (aHostStatus[thisHost].nGen < pParams->nMaxGen && thisTheta > 0.0 && pWork->nBlocks > 0)
+	{
+		touchAllHosts(pWork, pHosts);
+		spreadBlocks(thisHost, -thisTheta, pWork, pParams, pHosts, pKernel);
+	}
+	else if (aHostStatus[thisHost].nGen < pParams->nMaxGen && thisTheta > 0.0 && pKernel->nGrid > 0)
+	{
+		touchAllHosts(pWork, pHosts);
+		spreadGridForce(thisHost, -thisTheta, pWork, pParams, pHosts, pKernel);
+	}
+	else if (aHostStatus[thisHost].nGen < pParams->nMaxGen && thisTheta > 0.0)
+	{
+		touchAllHosts(pWork, pHosts);
+		for (i = 0; i < pHosts->nHosts; i++)
+		{
+			if (aHostStatus[i].eStatus == SUSCEPTIBLE)
+			{
+				thisRho = pParams->dRhoOne;
+				if (pHosts->aHosts[i].eType == TYPE_II)
+				{
+					thisRho = pParams->dRhoTwo;
+				}
+				thisExtra = thisTheta * thisRho * getKernel(i, thisHost, pKernel, pHosts, pParams);
+				aHostStatus[i].dRate -= thisExtra;
+				if (aHostStatus[i].dRate < 0.0)
+				{
+					aHostStatus[i].dRate = 0.0;
+				}
+				*pInfectRate -= thisExtra;
+			}
+		}
+	}
+	retVal = recordRecovery(thisHost, thisTime, pWork, pParams, pHosts);
+
+	if (pParams->eModelType == MODEL_SIS && pKernel->nGrid > 0)
+	{
+		aHostStatus[thisHost].eStatus = SUSCEPTIBLE;
+		aHostStatus[thisHost].dRate = 0.0;
+		touchAllHosts(pWork, pHosts);
+		gatherGridForce(thisHost, pWork, pParams, pHosts, pKernel);
+	}
+	else if (pParams->eModelType == MODEL_SIS)
+	{
+		aHostStatus[thisHost].eStatus = SUSCEPTIBLE;
+		aHostStatus[thisHost].dRate = 0.0;
+
+		/* loop around and add force back onto this one from all infected hosts */
+		touchAllHosts(pWork, pHosts);
+		thisRho = pParams->dRhoOne;
+		if (pHosts->aHosts[thisHost].eType == TYPE_II)
+		{
+			thisRho = pParams->dRhoTwo;
+		}
+		if (pWork->nBlocks > 0)
+		{
+			gatherBlocks(thisHost, thisRho, pWork, pParams, pHosts, pKernel);
+		}
+		for (i = 0; pWork->nBlocks == 0 && i < pHosts->nHosts; i++)
+		{
+			if (aHostStatus[i].eStatus == INFECTED && aHostStatus[i].nGen < pParams->nMaxGen)
+			{
+				thisTheta = pParams->dThetaOne;
+				if (pHosts->aHosts[i].eType == TYPE_II)
+				{
+					thisTheta = pParams->dThetaTwo;
+				}
+				thisExtra = thisTheta * thisRho * getKernel(i, thisHost, pKernel, pHosts, pParams);
+				aHostStatus[thisHost].dRate += thisExtra;
+				*pInfectRate += thisExtra;
+			}
+		}
+	}
+	else
+	{
+		aHostStatus[thisHost].eStatus = REMOVED;
+		aHostStatus[thisHost].dRate = 0.0;
+	}
+	/* with nobody infected, whatever is left of the total is rounding error */
+	if (*pInfectRate < 0.0 || pWork->nInfOne + pWork->nInfTwo == 0)
+	{
+		*pInfectRate = 0.0;
+	}
+	return retVal;
+}
+
+int infectHost(int thisHost, double thisTime, int infectedBy, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int				i,thisGen,thisCell;
+	double			thisTheta,thisRho,thisExtra;
+	t_HostStatus	*aHostStatus;
+	double			*pInfectRate;
+
+	aHostStatus = pWork->aHostStatus;
+	pInfectRate = &pWork->dInfectRate;
+
+	/* update this host's status */
+	if (infectedBy >= 0)
+	{
+		thisGen = aHostStatus[infectedBy].nGen + 1;
+	}
+	else
+	{
+		thisGen = 0;
+	}
+	aHostStatus[thisHost].nGen = thisGen;
+	touchHost(pWork, pHosts, thisHost);
+	thisCell = _NOT_SET;
+	if (pKernel->nGrid > 0)
+	{
+		/* no longer susceptible, so takes no part in its cell's far force */
+		thisCell = pKernel->aHostCell[thisHost];
+		*pInfectRate -= gridHostRate(thisHost, pWork, pParams, pHosts, pKernel);
+		pWork->aRhoSus[thisCell] -= (pHosts->aHosts[thisHost].eType == TYPE_II) ? pParams->dRhoTwo : pParams->dRhoOne;
+		pWork->aCellRate[thisCell] -= aHostStatus[thisHost].dRate;
+	}
+	else
+	{
+		*pInfectRate -= aHostStatus[thisHost].dRate;
+	}
+	aHostStatus[thisHost].nGen = thisGen;
+	/* recovery is picked from aInfectives, so an infected host has no rate of its own */
+	aHostStatus[thisHost].dRate = 0.0;
+	thisTheta = pParams->dThetaOne;
+	if (pHosts->aHosts[thisHost].eType == TYPE_II)
+	{
+		thisTheta = pParams->dThetaTwo;
+	}
+	if (thisGen >= pParams->nMaxGen)
+	{
+		thisTheta = 0.0;	/* artificially stop infections once too many generations have passed */
+	}
+	if (pKernel->pTiles && thisTheta > 0.0 && !prefetchTiles(pKernel->pTiles, thisHost))
+	{
+		return 0;
+	}
+	aHostStatus[thisHost].eStatus = INFECTED;
+	addInfective(thisHost, pWork, pHosts);
+	/* update susceptible hosts to feel the new force of infection from this one (if there is any) */
+	if (thisTheta > 0.0 && pWork->nBlocks > 0)
+	{
+		touchAllHosts(pWork, pHosts);
+		spreadBlocks(thisHost, thisTheta, pWork, pParams, pHosts, pKernel);
+	}
+	else if (thisTheta > 0.0 && pKernel->nGrid > 0)
+	{
+		touchAllHosts(pWork, pHosts);
+		spreadGridForce(thisHost, thisTheta, pWork, pParams, pHosts, pKernel);
+	}
+	else if (thisTheta > 0.0)
+	{
+		touchAllHosts(pWork, pHosts);
+		for (i = 0; i < pHosts->nHosts; i++)
+		{
+			if (aHostStatus[i].eStatus == SUSCEPTIBLE)
+			{
+				thisRho = pParams->dRhoOne;
+				if (pHosts->aHosts[i].eType == TYPE_II)
+				{
+					thisRho = pParams->dRhoTwo;
+				}
+				thisExtra = thisTheta * thisRho * getKernel(i, thisHost, pKernel, pHosts, pParams);
+				aHostStatus[i].dRate += thisExtra;
+				*pInfectRate += thisExtra;
+			}
+		}
+	}
+	return recordInfection(thisHost, thisTime, thisGen, infectedBy, pWork, pParams, pHosts);
+}
+
+/*
+	infective engine: an infective starts or stops firing infection attempts
+*/
+void joinRateGroup(int thisHost, t_Workspace *pWork)
+{
+	int		g, k;
+
+	g = pWork->aRateGroup[thisHost];
+	if (g == _NOT_SET)
+	{
+		return;
+	}
+	k = pWork->aGroupStart[g] + pWork->aGroupCount[g]++;
+	pWork->aGroupHosts[k] = thisHost;
+	pWork->aGroupPos[thisHost] = k;
+	pWork->aGroupTotal[g] += pWork->aAttemptRate[thisHost];
+}
+
+void leaveRateGroup(int thisHost, t_Workspace *pWork)
+{
+	int		g, nLast, nOther;
+
+	g = pWork->aRateGroup[thisHost];
+	if (g == _NOT_SET)
+	{
+		return;
+	}
+	nLast = pWork->aGroupStart[g] + --pWork->aGroupCount[g];
+	nOther = pWork->aGroupHosts[nLast];
+	pWork->aGroupHosts[pWork->aGroupPos[thisHost]] = nOther;
+	pWork->aGroupPos[nOther] = pWork->aGroupPos[thisHost];
+	/* an empty group is exactly zero, so rounding never leaves a rate with nobody to fire it */
+	pWork->aGroupTotal[g] = (pWork->aGroupCount[g] > 0) ? pWork->aGroupTotal[g] - pWork->aAttemptRate[thisHost] : 0.0;
+}
+
+/*
+	infective engine: pick the infective firing the next attempt, given randDbl uniform on
+	[0, total attempt rate)
+
+	the group is picked by its total, then a host in it uniformly, which is accepted in
+	proportion to its attempt rate (so, bar the last group, at least half the time)
+*/
+int pickAttempter(double randDbl, t_Workspace *pWork)
+{
+	int		g, nLastGroup, k, thisHost;
+
+	nLastGroup = _NOT_SET;
+	for (g = 0; g < pWork->nRateGroups; g++)
+	{
+		if (pWork->aGroupCount[g] > 0)
+		{
+			nLastGroup = g;
+			if (randDbl < pWork->aGroupTotal[g])
+			{
+				break;
+			}
+			randDbl -= pWork->aGroupTotal[g];
+		}
+	}
+	if (nLastGroup == _NOT_SET)
+	{
+		return _NOT_SET;
+	}
+	/* should rounding leave randDbl past the end, the last group with anyone in is chosen */
+	g = (g < pWork->nRateGroups) ? g : nLastGroup;
+	do
+	{
+		k = pWork->aGroupStart[g] + (int)(pWork->aGroupCount[g] * uniformRandom(&pWork->sRNG));
+		thisHost = pWork->aGroupHosts[k];
+	} while (pWork->aGroupMax[g] * uniformRandom(&pWork->sRNG) > pWork->aAttemptRate[thisHost]);
+	return thisHost;
+}
+
+/*
+	infective engine: host status is only brought up to date when a host is infected
+*/
+int hostIsSusceptible(int thisHost, t_Workspace *pWork)
+{
+	return pWork->aHostStatus[thisHost].nEpoch != pWork->nEpoch || pWork->aHostStatus[thisHost].eStatus == SUSCEPTIBLE;
+}
+
+int infectHostInfectives(int thisHost, double thisTime, int infectedBy, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts)
+{
+	t_HostStatus	*pStatus;
+
+	pStatus = &pWork->aHostStatus[thisHost];
+	if (pStatus->nEpoch != pWork->nEpoch)
+	{
+		resetHost(pStatus, pWork->nEpoch);
+	}
+	pStatus->nGen = (infectedBy >= 0) ? pWork->aHostStatus[infectedBy].nGen + 1 : 0;
+	pStatus->eStatus = INFECTED;
+	addInfective(thisHost, pWork, pHosts);
+	/* artificially stop infections once too many generations have passed */
+	if (pStatus->nGen < pParams->nMaxGen)
+	{
+		joinRateGroup(thisHost, pWork);
+	}
+	return recordInfection(thisHost, thisTime, pStatus->nGen, infectedBy, pWork, pParams, pHosts);
+}
+
+/*
+	lockstep batch: as infectHost() and recoverHost(), but with the force of infection in the
+	batch, and leaving the loop over the hosts to spreadLanes()
+*/
+int infectHostLane(int thisHost, double thisTime, int infectedBy, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts)
+{
+	t_Lanes			*pLanes;
+	t_HostStatus	*pStatus;
+	size_t			p;
+	double			thisTheta;
+
+	pLanes = pWork->pLanes;
+	p = (size_t)thisHost * pLanes->nLanes + pWork->nLane;
+	touchAllHosts(pWork, pHosts);
+	pStatus = &pWork->aHostStatus[thisHost];
+	pStatus->nGen = (infectedBy >= 0) ? pWork->aHostStatus[infectedBy].nGen + 1 : 0;
+	pWork->dInfectRate -= pLanes->aRate[p];
+	pLanes->aRate[p] = 0.0;
+	pLanes->aRhoSus[p] = 0.0;
+	thisTheta = pParams->dThetaOne;
+	if (pHosts->aHosts[thisHost].eType == TYPE_II)
+	{
+		thisTheta = pParams->dThetaTwo;
+	}
+	if (pStatus->nGen >= pParams->nMaxGen)
+	{
+		thisTheta = 0.0;	/* artificially stop infections once too many generations have passed */
+	}
+	pStatus->eStatus = INFECTED;
+	pLanes->aStatus[p] = INFECTED;
+	pLanes->aThetaInf[p] = thisTheta;
+	addInfective(thisHost, pWork, pHosts);
+	pLanes->aSpreadHost[pWork->nLane] = thisHost;
+	pLanes->aSpreadTheta[pWork->nLane] = thisTheta;
+	return recordInfection(thisHost, thisTime, pStatus->nGen, infectedBy, pWork, pParams, pHosts);
+}
+
+/*
+	in the SIS model the host feels force of infection again in gatherLanes(), after the spread
+*/
+int recoverHostLane(int thisHost, double thisTime, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts)
+{
+	t_Lanes			*pLanes;
+	t_HostStatus	*pStatus;
+	size_t			p;
+	double			thisTheta;
+
+	pLanes = pWork->pLanes;
+	p = (size_t)thisHost * pLanes->nLanes + pWork->nLane;
+	pStatus = &pWork->aHostStatus[thisHost];
+	removeInfective(thisHost, pWork, pHosts);
+	thisTheta = pParams->dThetaOne;
+	if (pHosts->aHosts[thisHost].eType == TYPE_II)
+	{
+		thisTheta = pParams->dThetaTwo;
+	}
+	if (pStatus->nGen < pParams->nMaxGen && thisTheta > 0.0)
+	{
+		pLanes->aSpreadHost[pWork->nLane] = thisHost;
+		pLanes->aSpreadTheta[pWork->nLane] = -thisTheta;
+	}
+	pLanes->aThetaInf[p] = 0.0;
+	pStatus->eStatus = (pParams->eModelType == MODEL_SIS) ? SUSCEPTIBLE : REMOVED;
+	pLanes->aStatus[p] = (unsigned char)pStatus->eStatus;
+	return recordRecovery(thisHost, thisTime, pWork, pParams, pHosts);
+}
+
+#define	LANE_WIDTH	2
+#include "LaneTemplate.h"
+#define	LANE_WIDTH	4
+#include "LaneTemplate.h"
+#define	LANE_WIDTH	8
+#include "LaneTemplate.h"
+
+/*
+	lockstep batch: one pass over the hosts makes every lane's change in force of infection,
+	each exactly as the loops in infectHost() and recoverHost() would
+*/
+void spreadLanes(t_Lanes *pLanes, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		l, nSpread;
+	double	aTheta[_MAX_LANES], aTotal[_MAX_LANES];
+	double	*aRow[_MAX_LANES];
+
+	nSpread = 0;
+	for (l = 0; l < pLanes->nLanes; l++)
+	{
+		aTheta[l] = pLanes->aSpreadTheta[l];
+		aRow[l] = pLanes->aZeroRow;
+		aTotal[l] = pLanes->aWork[l].dInfectRate;
+		if (aTheta[l] != 0.0)
+		{
+			aRow[l] = pKernel->aKernel + (size_t)pLanes->aSpreadHost[l] * pHosts->nHosts;
+			nSpread++;
+		}
+	}
+	if (nSpread == 0)
+	{
+		return;
+	}
+	pLanes->pfSpread(pLanes, pHosts->nHosts, aTheta, aRow, aTotal);
+	for (l = 0; l < pLanes->nLanes; l++)
+	{
+		if (pLanes->aSpreadTheta[l] != 0.0)
+		{
+			pLanes->aWork[l].dInfectRate = aTotal[l];
+			pLanes->aSpreadTheta[l] = 0.0;
+		}
+	}
+}
+
+int recoverHostInfectives(int thisHost, double thisTime, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts)
+{
+	t_HostStatus	*pStatus;
+
+	pStatus = &pWork->aHostStatus[thisHost];
+	removeInfective(thisHost, pWork, pHosts);
+	if (pStatus->nGen < pParams->nMaxGen)
+	{
+		leaveRateGroup(thisHost, pWork);
+	}
+	pStatus->eStatus = (pParams->eModelType == MODEL_SIS) ? SUSCEPTIBLE : REMOVED;
+	return recordRecovery(thisHost, thisTime, pWork, pParams, pHosts);
+}
+
+/*
+	ring culling: thisHost has just been removed, which is when it is found, so every
+	host within dCullRadius of it is culled, infected or not (with SIS, thisHost too);
+	culled hosts are removed for good, and those culled while infected don't set off
+	culls of their own
+
+	a susceptible host just stops being susceptible; the force of infection from all
+	those culled while infected is taken away in one pass over the hosts, or with a
+	grid or tiled kernel (whose lookups go by infected host) a pass for each
+*/
+int cullRing(int thisHost, double thisTime, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int				*aRing;
+	int				i, k, b, n, nList, nItems, nPerBlock, thisCell, retVal;
+	double			thisTheta;
+	t_HostStatus	*pStatus;
+	t_BlockJob		sJob;
+
+	aRing = pWork->aInfectiveID;	/* not otherwise in use between events */
+	n = hostsWithin(&pWork->sCullGrid, pHosts, pHosts->aHosts[thisHost].dX, pHosts->aHosts[thisHost].dY, pParams->dCullRadius, aRing);
+	pWork->nDetections++;
+	retVal = 1;
+	if (pParams->eEngine == ENGINE_INFECTIVES)
+	{
+		/* only infectives have any rate, so there is nothing else to take away */
+		for (k = 0; retVal && k < n; k++)
+		{
+			pStatus = &pWork->aHostStatus[aRing[k]];
+			if (hostIsSusceptible(aRing[k], pWork))
+			{
+				resetHost(pStatus, pWork->nEpoch);
+				pStatus->eStatus = REMOVED;
+				pWork->nCulledSus++;
+			}
+			else if (pStatus->eStatus == INFECTED)
+			{
+				removeInfective(aRing[k], pWork, pHosts);
+				if (pStatus->nGen < pParams->nMaxGen)
+				{
+					leaveRateGroup(aRing[k], pWork);
+				}
+				pStatus->eStatus = REMOVED;
+				pWork->nCulledInf++;
+				retVal = recordRecovery(aRing[k], thisTime, pWork, pParams, pHosts);
+			}
+		}
+		return retVal;
+	}
+	touchAllHosts(pWork, pHosts);
+	/* those culled while infected that still infect are kept at the start of aRing[] */
+	nList = 0;
+	for (k = 0; retVal && k < n; k++)
+	{
+		i = aRing[k];
+		pStatus = &pWork->aHostStatus[i];
+		if (pStatus->eStatus == SUSCEPTIBLE)
+		{
+			if (pKernel->nGrid > 0)
+			{
+				/* as infectHost(), no longer takes part in its cell's far force */
+				thisCell = pKernel->aHostCell[i];
+				pWork->dInfectRate -= gridHostRate(i, pWork, pParams, pHosts, pKernel);
+				pWork->aRhoSus[thisCell] -= (pHosts->aHosts[i].eType == TYPE_II) ? pParams->dRhoTwo : pParams->dRhoOne;
+				pWork->aCellRate[thisCell] -= pStatus->dRate;
+			}
+			else
+			{
+				pWork->dInfectRate -= pStatus->dRate;
+			}
+			pStatus->eStatus = REMOVED;
+			pStatus->dRate = 0.0;
+			pWork->nCulledSus++;
+		}
+		else if (pStatus->eStatus == INFECTED)
+		{
+			removeInfective(i, pWork, pHosts);
+			pStatus->eStatus = REMOVED;
+			pWork->nCulledInf++;
+			retVal = recordRecovery(i, thisTime, pWork, pParams, pHosts);
+			thisTheta = (pHosts->aHosts[i].eType == TYPE_II) ? pParams->dThetaTwo : pParams->dThetaOne;
+			if (pStatus->nGen < pParams->nMaxGen && thisTheta > 0.0)
+			{
+				aRing[nList++] = i;
+			}
+		}
+	}
+	retVal = retVal && growBlockSums(pWork, 1);
+	/* a single block unless the landscape is big enough to be split up */
+	nItems = (pKernel->nGrid > 0) ? pKernel->nCells : pHosts->nHosts;
+	nPerBlock = nItems;
+	if (pWork->nBlocks > 0)
+	{
+		nPerBlock = (pKernel->nGrid > 0) ? _EVENT_BLOCK_CELLS : _EVENT_BLOCK_HOSTS;
+	}
+	if (retVal && nList > 0 && pKernel->nGrid == 0 && !pKernel->pTiles)
+	{
+		setBlockJob(&sJob, BLOCK_CULL, thisHost, 0.0, nItems, nPerBlock, pWork, pParams, pHosts, pKernel);
+		sJob.aList = aRing;
+		sJob.nList = nList;
+		runBlocks(&sJob);
+		for (b = 0; b < sJob.nBlocks; b++)
+		{
+			pWork->dInfectRate += pWork->aBlockSum[b];
+		}
+	}
+	for (k = 0; retVal && k < nList && (pKernel->nGrid > 0 || pKernel->pTiles); k++)
+	{
+		i = aRing[k];
+		thisTheta = (pHosts->aHosts[i].eType == TYPE_II) ? pParams->dThetaTwo : pParams->dThetaOne;
+		if (pKernel->pTiles && !prefetchTiles(pKernel->pTiles, i))
+		{
+			retVal = 0;
+			break;
+		}
+		if (pKernel->nGrid > 0 && pWork->nBlocks == 0)
+		{
+			spreadGridForce(i, -thisTheta, pWork, pParams, pHosts, pKernel);
+		}
+		else
+		{
+			setBlockJob(&sJob, BLOCK_SPREAD, i, -thisTheta, nItems, nPerBlock, pWork, pParams, pHosts, pKernel);
+			runBlocks(&sJob);
+			for (b = 0; b < sJob.nBlocks; b++)
+			{
+				pWork->dInfectRate += pWork->aBlockSum[b];
+			}
+		}
+	}
+	/* with nobody infected, whatever is left of the total is rounding error */
+	if (pWork->dInfectRate < 0.0 || pWork->nInfOne + pWork->nInfTwo == 0)
+	{
+		pWork->dInfectRate = 0.0;
+	}
+	return retVal;
+}
+
+int initEpidemic(t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, int epiID)
+{
+	int				retVal, i, t, numToDo, validHosts, thisHost, j;
+	int				*aHosts, *aSwaps;
+
+	echoToScreen(pParams, "Initialising epidemic %d\n", epiID);
+	/* no host status is reset, it is just out of date */
+	newEpoch(pWork, pHosts);
+	/* entries from the last replicate are simply forgotten, keeping the memory */
+	pWork->sEpidemic.nEntries = 0;
+	pWork->nTimeLog = 0;
+	pWork->dInfectRate = 0.0;
+	pWork->nDetections = pWork->nCulledSus = pWork->nCulledInf = 0;
+	for (i = 0; i <= pParams->nMaxGen; i++)
+	{
+		pWork->aTypeOneByGen[i] = pWork->aTypeTwoByGen[i] = 0;
+	}
+	for (i = 0; i < pKernel->nCells; i++)
+	{
+		pWork->aCellRate[i] = 0.0;
+		pWork->aFarForce[i] = 0.0;
+		pWork->aRhoSus[i] = pWork->aCellRho[i];
+	}
+	pWork->nInfOne = pWork->nInfTwo = 0;
+	for (i = 0; i < pWork->nRateGroups; i++)
+	{
+		pWork->aGroupCount[i] = 0;
+		pWork->aGroupTotal[i] = 0.0;
+	}
+	aSwaps = pWork->aInfectiveID;	/* not otherwise in use until the epidemic starts */
+	retVal = 1;
+	/* do initial infections */
+	t = TYPE_I;
+	while (retVal && t <= TYPE_II)
+	{
+		numToDo = pParams->nInitOne;
+		aHosts = pWork->aHostList;
+		validHosts = pHosts->nTypeOne;
+		if (t == TYPE_II)
+		{
+			numToDo = pParams->nInitTwo;
+			aHosts = pWork->aHostList + pHosts->nTypeOne;
+			validHosts = pHosts->nTypeTwo;
+		}
+		if (numToDo > validHosts)
+		{
+			fprintf(stderr, "initEpidemic(): Can't infect %d hosts of type %d, there are only %d\n", numToDo, t, validHosts);
+			retVal = 0;
+		}
+		else if (numToDo > 0)
+		{
+			/* partial Fisher-Yates: the first i hosts in the list are the ones already picked */
+			for (i = 0; i < numToDo; i++)
+			{
+				j = i + (int) floor((validHosts - i)*uniformRandom(&pWork->sRNG));
+				aSwaps[i] = j;
+				thisHost = aHosts[j];
+				aHosts[j] = aHosts[i];
+				aHosts[i] = thisHost;
+			}
+			/* infect in the order picked, then undo the swaps, so every replicate starts from the same list */
+			for (i = 0; retVal && i < numToDo; i++)
+			{
+				if (pParams->eEngine == ENGINE_INFECTIVES)
+				{
+					retVal = infectHostInfectives(aHosts[i], 0.0, _NOT_SET, pWork, pParams, pHosts);
+				}
+				else if (pWork->pLanes)
+				{
+					retVal = infectHostLane(aHosts[i], 0.0, _NOT_SET, pWork, pParams, pHosts);
+					spreadLanes(pWork->pLanes, pParams, pHosts, pKernel);
+				}
+				else
+				{
+					retVal = infectHost(aHosts[i],0.0,_NOT_SET,pWork, pParams, pHosts, pKernel);
+				}
+			}
+			for (i = numToDo - 1; i >= 0; i--)
+			{
+				j = aSwaps[i];
+				thisHost = aHosts[j];
+				aHosts[j] = aHosts[i];
+				aHosts[i] = thisHost;
+			}
+		}
+		t++;
+	}
+	return retVal;
+}
+
+/*
+	debugging function: check all rates are correct given the state
+*/
+void	checkRates(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_Workspace *pWork)
+{
+	int				i, j, nInfOne, nInfTwo;
+	double			cacheRate, recalcRate, thisTheta, thisRho, totalRate;
+	t_HostStatus	*aHostStatus;
+
+	touchAllHosts(pWork, pHosts);
+	aHostStatus = pWork->aHostStatus;
+	totalRate = 0.0;
+	nInfOne = nInfTwo = 0;
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		cacheRate = aHostStatus[i].dRate;
+		if (pKernel->nGrid > 0)
+		{
+			cacheRate = gridHostRate(i, pWork, pParams, pHosts, pKernel);
+		}
+		totalRate += cacheRate;
+		recalcRate = _NOT_SET;
+		if (aHostStatus[i].eStatus == INFECTED)
+		{
+			/* no rate of its own, but must be in the right list */
+			recalcRate = 0.0;
+			if (pHosts->aHosts[i].eType == TYPE_I)
+			{
+				nInfOne++;
+			}
+			else
+			{
+				nInfTwo++;
+			}
+			if (pWork->aInfectives[aHostStatus[i].nListPos] != i)
+			{
+				fprintf(stdout, "%d not in infective list\n", i);
+			}
+		}
+		else if (aHostStatus[i].eStatus == REMOVED)
+		{
+			recalcRate = 0.0;
+		}
+		else
+		{
+			recalcRate = 0.0;
+			thisRho = pParams->dRhoOne;
+			if (pHosts->aHosts[i].eType == TYPE_II)
+			{
+				thisRho = pParams->dRhoTwo;
+			}
+			for (j = 0; j < pHosts->nHosts; j++)
+			{
+				if (aHostStatus[j].eStatus == INFECTED)
+				{
+					thisTheta = pParams->dThetaOne;
+					if (pHosts->aHosts[j].eType == TYPE_II)
+					{
+						thisTheta = pParams->dThetaTwo;
+					}
+					if (aHostStatus[j].nGen >= pParams->nMaxGen)
+					{
+						thisTheta = 0.0;	/* artificially stop infections once too many generations have passed */
+					}
+					recalcRate += thisTheta * thisRho * getKernel(i, j, pKernel, pHosts, pParams);
+				}
+			}
+		}
+		if (fabs(cacheRate - recalcRate) > 1e-5)
+		{
+			fprintf(stdout, "%d %f %f\n", i, cacheRate, recalcRate);
+		}
+	}
+	if (fabs(totalRate - pWork->dInfectRate) > 1e-5 || nInfOne != pWork->nInfOne || nInfTwo != pWork->nInfTwo)
+	{
+		fprintf(stdout, "total %f %f, infected %d %d, listed %d %d\n", totalRate, pWork->dInfectRate, nInfOne, nInfTwo, pWork->nInfOne, pWork->nInfTwo);
+	}
+}
+
+/*
+	name of the file the culls done in each replicate go in: outFile, ending _culls.csv
+*/
+void cullFileName(t_Params *pParams, char *sCullFile)
+{
+	char	sStem[_MAX_STR_LEN];
+	char	*pPtr;
+
+	strcpy(sStem, pParams->sOutFile);
+	pPtr = strrchr(sStem, '.');
+	if (pPtr)
+	{
+		*pPtr = '\0';
+	}
+	sprintf(sCullFile, "%s_culls.csv", sStem);
+}
+
+/*
+	add output for replicate itNum to pWork->sOut
+*/
+void dumpEpidemic(t_Params *pParams, t_Hosts *pHosts, t_Workspace *pWork, int itNum, double maxTime, int bHeader)
+{
+	int			i,j;
+	char		sTmp[_MAX_STR_LEN];
+	t_Epidemic	*pEpidemic;
+	t_TextBuf	*pOut;
+
+	pEpidemic = &pWork->sEpidemic;
+	pOut = &pWork->sOut;
+
+	/* information on a generation by generation basis */
+	if (pParams->eDumpType == DUMP_GENS)
+	{
+		int *aTypeOneByGen, *aTypeTwoByGen;
+		int g;
+
+		aTypeOneByGen = pWork->aTypeOneByGen;
+		aTypeTwoByGen = pWork->aTypeTwoByGen;
+#ifdef _ONE_LINE_GEN_OUT
+		if (bHeader)
+		{
+			bufPrintf(pOut, "<it>");
+		}
+		for (g = 0; g <= pParams->nMaxGen; g++)
+		{
+			if (bHeader)
+			{
+				sprintf(sTmp, ",I_1(%d),I_2(%d)", g, g);
+				bufPrintf(pOut, "%s", sTmp);
+			}
+			if (g > 0)
+			{
+				echoToScreen(pParams, "\t");
+			}
+			sprintf(sTmp, "I_1(%d)\tI_2(%d)", g, g);
+			echoToScreen(pParams, sTmp);
+		}
+		if (bHeader)
+		{
+			bufPrintf(pOut, "\n");
+		}
+		echoToScreen(pParams, "\n");
+		bufPrintf(pOut, "%d", itNum);
+#else
+		if (bHeader)
+		{
+			bufPrintf(pOut, "<it>,<gen>,<n1>,<n2>,<n1+n2>\n");
+		}
+		echoToScreen(pParams, "<gen>\t<n1>\t<n2>\t<n1+n2>\n");
+#endif
+		/* counts were accumulated by infectHost() as the epidemic ran */
+		for (g = 0; g <= pParams->nMaxGen; g++)
+		{
+#ifdef _ONE_LINE_GEN_OUT
+			if (g)
+			{
+				echoToScreen(pParams, "\t");
+			}
+			echoToScreen(pParams, "%d\t%d", aTypeOneByGen[g], aTypeTwoByGen[g]);
+			bufPrintf(pOut, ",%d,%d", aTypeOneByGen[g], aTypeTwoByGen[g]);
+#else
+			echoToScreen(pParams, "%d\t%d\t%d\t%d\n", g, aTypeOneByGen[g], aTypeTwoByGen[g], aTypeOneByGen[g] + aTypeTwoByGen[g]);
+			bufPrintf(pOut, "%d,%d,%d,%d,%d\n", itNum, g, aTypeOneByGen[g], aTypeTwoByGen[g], aTypeOneByGen[g] + aTypeTwoByGen[g]);
+#endif
+		}
+#ifdef _ONE_LINE_GEN_OUT
+		echoToScreen(pParams, "\n");
+		bufPrintf(pOut, "\n");
+#endif
+	}
+	/* information on a time course basis */
+	if (pParams->eDumpType == DUMP_TIMES && maxTime > 0.0)
+	{
+		double			dStep,thisTime;
+		int				nTypeOneInf, nTypeTwoInf;
+		t_TimeLogEntry	*pLog;
+
+		if (bHeader)
+		{
+			bufPrintf(pOut, "<it>,<dT>,<n1>,<n2>,<n1+n2>\n");
+		}
+		echoToScreen(pParams, "<dT>\t<n1>\t<n2>\t<n1+n2>\n");
+		/* the log is in time order, so a single sweep gives the numbers infected at each time */
+		dStep = maxTime / pParams->nDumpSteps;
+		nTypeOneInf = nTypeTwoInf = 0;
+		i = 0;
+		for (j = 0; j <= pParams->nDumpSteps; j++)
+		{
+			thisTime = j*dStep;
+			while (i < pWork->nTimeLog && pWork->aTimeLog[i].dTime <= thisTime)
+			{
+				pLog = &pWork->aTimeLog[i];
+				if (pLog->eType == TYPE_I)
+				{
+					nTypeOneInf += pLog->nChange;
+				}
+				else
+				{
+					nTypeTwoInf += pLog->nChange;
+				}
+				i++;
+			}
+			echoToScreen(pParams, "%f\t%d\t%d\t%d\n", thisTime, nTypeOneInf, nTypeTwoInf, nTypeOneInf + nTypeTwoInf);
+			bufPrintf(pOut, "%d,%f,%d,%d,%d\n", itNum, thisTime, nTypeOneInf, nTypeTwoInf, nTypeOneInf + nTypeTwoInf);
+		}
+	}
+	/* the transmission tree: each infection young enough to cause more, who caused it, and how many of each type it caused */
+	if (pParams->eDumpType == DUMP_OFFSPRING)
+	{
+		t_EpidemicEntry	*pEntry;
+		int				nHost, nInfector;
+		int				aParents[2], aOffspring[2][2];
+
+		if (bHeader)
+		{
+			bufPrintf(pOut, "<it>,<host>,<infector>,<type>,<gen>,<o1>,<o2>\n");
+		}
+		memset(aParents, 0, sizeof(aParents));
+		memset(aOffspring, 0, sizeof(aOffspring));
+		for (j = 0; j < pEpidemic->nEntries; j++)
+		{
+			pEntry = &pEpidemic->aEntries[j];
+			if (pEntry->nGen < pParams->nMaxGen)
+			{
+				/* IDs are those of the host file, as in dumpHostStatus output */
+				nHost = pHosts->aOrigID ? pHosts->aOrigID[pEntry->nHostID] : pEntry->nHostID;
+				bufPrintf(pOut, "%d,%d,", itNum, nHost);
+				if (pEntry->nInfectedBy == _NOT_SET)
+				{
+					bufPrintf(pOut, "NA,");
+				}
+				else
+				{
+					nInfector = pEpidemic->aEntries[pEntry->nInfectedBy].nHostID;
+					bufPrintf(pOut, "%d,", pHosts->aOrigID ? pHosts->aOrigID[nInfector] : nInfector);
+				}
+				bufPrintf(pOut, "%d,%d,%d,%d\n", pEntry->eType, pEntry->nGen, pEntry->nOffspringOne, pEntry->nOffspringTwo);
+				i = (pEntry->eType == TYPE_II) ? 1 : 0;
+				aParents[i]++;
+				aOffspring[i][0] += pEntry->nOffspringOne;
+				aOffspring[i][1] += pEntry->nOffspringTwo;
+			}
+		}
+		echoToScreen(pParams, "<from>\t<n>\t<o1>\t<o2>\n");
+		for (i = 0; i < 2; i++)
+		{
+			echoToScreen(pParams, "%d\t%d\t%d\t%d\n", i + 1, aParents[i], aOffspring[i][0], aOffspring[i][1]);
+		}
+	}
+	if (pParams->bDumpHostStatus)
+	{
+		char	sDummy[_MAX_STR_LEN],sOutFile[_MAX_STR_LEN];
+		char	*pPtr;
+		FILE	*fIt;
+		int		bInf,nGen,nID;
+		double	tI, tR;
+
+		strcpy(sDummy, pParams->sOutFile);
+		pPtr = strrchr(sDummy, '.');
+		if (pPtr)
+		{
+			*pPtr = '\0';
+		}
+		sprintf(sOutFile, "%s_it=%d.csv", sDummy, itNum);
+		fIt = fopen(sOutFile, "wb");
+		if (fIt)
+		{
+			fprintf(fIt, "hostID,hostX,hostY,hostType,tI,tR,gen\n");
+			/* in the order, and with the IDs, of the host file even if hosts were reordered (or edited, see editHosts()) */
+			for (nID = 0; nID < pHosts->nHosts; nID++)
+			{
+				i = pHosts->aSortedID ? pHosts->aSortedID[nID] : nID;
+				bInf = 0;
+				j = 0;
+				while (bInf == 0 && (j < pEpidemic->nEntries))
+				{
+					if (pEpidemic->aEntries[j].nHostID == i)
+					{
+						bInf = 1;
+						nGen = pEpidemic->aEntries[j].nGen;
+						tI = pEpidemic->aEntries[j].dInfectTime;
+						tR = pEpidemic->aEntries[j].dRemovalTime;
+					}
+					j++;
+				}
+				if (bInf)
+				{
+					fprintf(fIt, "%d,%.4f,%.4f,%d,%.4f,%.4f,%d\n", pHosts->aOrigID ? pHosts->aOrigID[i] : nID, pHosts->aHosts[i].dX, pHosts->aHosts[i].dY, pHosts->aHosts[i].eType, tI, tR, nGen);
+				}
+				else
+				{
+					fprintf(fIt, "%d,%.4f,%.4f,%d,NA,NA,NA\n", pHosts->aOrigID ? pHosts->aOrigID[i] : nID, pHosts->aHosts[i].dX, pHosts->aHosts[i].dY, pHosts->aHosts[i].eType);
+				}
+			}
+			fclose(fIt);
+		}
+	}
+	/* one line per replicate, added to as they finish */
+	if (pParams->dCullRadius > 0.0)
+	{
+		char	sCullFile[_MAX_STR_LEN + 16];
+		FILE	*fCull;
+
+		cullFileName(pParams, sCullFile);
+		echoToScreen(pParams, "%d detections culled %d susceptible and %d infected hosts\n", pWork->nDetections, pWork->nCulledSus, pWork->nCulledInf);
+		fCull = fopen(sCullFile, bHeader ? "wb" : "ab");
+		if (fCull)
+		{
+			if (bHeader)
+			{
+				fprintf(fCull, "<it>,<detections>,<culledSusceptible>,<culledInfected>\n");
+			}
+			fprintf(fCull, "%d,%d,%d,%d\n", itNum, pWork->nDetections, pWork->nCulledSus, pWork->nCulledInf);
+			fclose(fCull);
+		}
+		else
+		{
+			fprintf(stderr, "dumpEpidemic(): Couldn't write to %s\n", sCullFile);
+		}
+	}
+}
+
+/*
+	add a finished replicate to the running sums for R0
+*/
+void addR0Replicate(t_R0Stats *pR0Stats, t_Params *pParams, t_Workspace *pWork)
+{
+	double	dChildren, dParents, dThisGen;
+	int		g;
+
+	dChildren = dParents = 0.0;
+	for (g = 0; g <= pParams->nMaxGen; g++)
+	{
+		dThisGen = pWork->aTypeOneByGen[g] + pWork->aTypeTwoByGen[g];
+		if (g > 0)
+		{
+			dChildren += dThisGen;
+		}
+		if (g < pParams->nMaxGen)
+		{
+			dParents += dThisGen;
+		}
+	}
+	pR0Stats->nReplicates++;
+	pR0Stats->dChildren += dChildren;
+	pR0Stats->dParents += dParents;
+	pR0Stats->dChildrenSq += dChildren * dChildren;
+	pR0Stats->dParentsSq += dParents * dParents;
+	pR0Stats->dCross += dChildren * dParents;
+}
+
+/*
+	add the sums for some replicates (see runLanes()) to the running sums
+*/
+void mergeR0Stats(t_R0Stats *pR0Stats, t_R0Stats *pMore)
+{
+	pR0Stats->nReplicates += pMore->nReplicates;
+	pR0Stats->dChildren += pMore->dChildren;
+	pR0Stats->dParents += pMore->dParents;
+	pR0Stats->dChildrenSq += pMore->dChildrenSq;
+	pR0Stats->dParentsSq += pMore->dParentsSq;
+	pR0Stats->dCross += pMore->dCross;
+}
+
+/*
+	ratio estimate of R0, and the half width of its confidence interval by the
+	delta method (negative if there isn't enough data for one yet)
+*/
+double r0Estimate(t_R0Stats *pR0Stats, double *pHalfWidth)
+{
+	double	dR0, dResidualSq, dMeanParents;
+	int		n;
+
+	n = pR0Stats->nReplicates;
+	*pHalfWidth = _NOT_SET;
+	if (pR0Stats->dParents <= 0.0)
+	{
+		return _NOT_SET;
+	}
+	dR0 = pR0Stats->dChildren / pR0Stats->dParents;
+	if (n >= 2)
+	{
+		/* residuals children - R0*parents sum to zero, so this is (n-1) times their variance */
+		dResidualSq = pR0Stats->dChildrenSq - 2.0 * dR0 * pR0Stats->dCross + dR0 * dR0 * pR0Stats->dParentsSq;
+		if (dResidualSq < 0.0)
+		{
+			dResidualSq = 0.0;
+		}
+		dMeanParents = pR0Stats->dParents / n;
+		*pHalfWidth = _CONVERGE_Z * sqrt(dResidualSq / (n - 1) / n) / dMeanParents;
+	}
+	return dR0;
+}
+
+/*
+	whether enough replicates have been done to stop early
+*/
+int r0Converged(t_R0Stats *pR0Stats, t_Params *pParams)
+{
+	double	dHalfWidth;
+
+	if (pParams->dConvergeTol <= 0.0 || pR0Stats->nReplicates < pParams->nMinIts)
+	{
+		return 0;
+	}
+	r0Estimate(pR0Stats, &dHalfWidth);
+	return (dHalfWidth >= 0.0 && 2.0 * dHalfWidth < pParams->dConvergeTol);
+}
+
+/*
+	identifies the settings a checkpoint was written with; numIts can differ
+	(unless sharded, when it decides which replicates are run), so that a
+	finished run can be extended, as can settings only affecting how the run
+	was done rather than what it produces; the seed is kept in the checkpoint
+*/
+unsigned long long paramsHash(t_Params *pParams)
+{
+	t_Params	sCopy;
+
+	memcpy(&sCopy, pParams, sizeof(t_Params));
+	if (sCopy.nShardCount == 1)
+	{
+		sCopy.nNumIts = 0;
+	}
+	sCopy.bQuiet = 0;
+	sCopy.nSeed = 0;
+	sCopy.nCheckpointEvery = 0;
+	sCopy.bResume = 0;
+	sCopy.nLanes = 1;		/* output is the same whatever these are */
+	sCopy.nEventThreads = 0;
+	sCopy.ePages = 0;
+	sCopy.bNumaPlacement = 0;
+	memset(sCopy.sHostsBinFile, 0, sizeof(sCopy.sHostsBinFile));
+	memset(sCopy.sKernelFile, 0, sizeof(sCopy.sKernelFile));
+	memset(sCopy.sKernelTileFile, 0, sizeof(sCopy.sKernelTileFile));
+	memset(sCopy.sEditFiles, 0, sizeof(sCopy.sEditFiles));	/* sEditFile says which scenario this is */
+	sCopy.nTileThreads = 0;
+	return hashBytes(_FNV_OFFSET, &sCopy, sizeof(t_Params));
+}
+
+/*
+	save the state after nNextIt replicates have been written to fOut
+
+	written to a temporary file which is then renamed, so a job killed part way
+	through still leaves the previous checkpoint intact
+*/
+int writeCheckpoint(t_Params *pParams, FILE *fOut, int nNextIt, t_R0Stats *pR0Stats)
+{
+	FILE			*fCkpt;
+	t_Checkpoint	sCkpt;
+	char			sTmpFile[_MAX_STR_LEN + 8];
+	int				retVal;
+
+	retVal = 0;
+	memset(&sCkpt, 0, sizeof(t_Checkpoint));
+	memcpy(sCkpt.sMagic, _CHECKPOINT_MAGIC, sizeof(sCkpt.sMagic));
+	sCkpt.nNextIt = nNextIt;
+	sCkpt.nSeed = pParams->nSeed;
+	sCkpt.nParamsHash = paramsHash(pParams);
+	sCkpt.sR0Stats = *pR0Stats;
+	if (fflush(fOut) != 0 || (sCkpt.nOutOffset = FTELL64(fOut)) < 0)
+	{
+		fprintf(stderr, "writeCheckpoint(): Couldn't flush %s\n", pParams->sOutFile);
+		return 0;
+	}
+	/* the cull file is written a replicate at a time, so is complete up to nNextIt too */
+	if (pParams->dCullRadius > 0.0)
+	{
+		char	sCullFile[_MAX_STR_LEN + 16];
+		FILE	*fCull;
+
+		cullFileName(pParams, sCullFile);
+		fCull = fopen(sCullFile, "rb");
+		if (!fCull || FSEEK64(fCull, 0, SEEK_END) != 0 || (sCkpt.nCullOffset = FTELL64(fCull)) < 0)
+		{
+			fprintf(stderr, "writeCheckpoint(): Couldn't read %s\n", sCullFile);
+			if (fCull)
+			{
+				fclose(fCull);
+			}
+			return 0;
+		}
+		fclose(fCull);
+	}
+	sprintf(sTmpFile, "%s.tmp", pParams->sCheckpointFile);
+	fCkpt = fopen(sTmpFile, "wb");
+	if (fCkpt)
+	{
+		retVal = (fwrite(&sCkpt, sizeof(t_Checkpoint), 1, fCkpt) == 1);
+		if (fclose(fCkpt) != 0)
+		{
+			retVal = 0;
+		}
+	}
+	if (retVal)
+	{
+#ifdef _WIN32
+		remove(pParams->sCheckpointFile);	/* rename() won't replace an existing file */
+#endif
+		retVal = (rename(sTmpFile, pParams->sCheckpointFile) == 0);
+	}
+	if (!retVal)
+	{
+		fprintf(stderr, "writeCheckpoint(): Couldn't write %s\n", pParams->sCheckpointFile);
+	}
+	return retVal;
+}
+
+/*
+	open the output file, either from scratch or (if resuming and there is a
+	checkpoint) cut back to where the checkpoint was written, so carrying on
+	from replicate *pFirstIt gives exactly the same file as an uninterrupted run
+*/
+FILE *openOutputFile(t_Params *pParams, int *pFirstIt, t_R0Stats *pR0Stats)
+{
+	FILE			*fOut, *fCkpt;
+	t_Checkpoint	sCkpt;
+	int				nEndIt;
+
+	memset(pR0Stats, 0, sizeof(t_R0Stats));
+	shardRange(pParams, pFirstIt, &nEndIt);
+	fCkpt = NULL;
+	if (pParams->bResume)
+	{
+		fCkpt = fopen(pParams->sCheckpointFile, "rb");
+		if (!fCkpt)
+		{
+			fprintf(stdout, "openOutputFile(): No checkpoint %s, starting from the beginning\n", pParams->sCheckpointFile);
+		}
+	}
+	if (!fCkpt)
+	{
+		fOut = fopen(pParams->sOutFile, "wb");
+		if (!fOut)
+		{
+			fprintf(stderr, "openOutputFile(): Couldn't open %s\n", pParams->sOutFile);
+		}
+		return fOut;
+	}
+	if (fread(&sCkpt, sizeof(t_Checkpoint), 1, fCkpt) != 1
+		|| memcmp(sCkpt.sMagic, _CHECKPOINT_MAGIC, sizeof(sCkpt.sMagic)) != 0)
+	{
+		fprintf(stderr, "openOutputFile(): %s is not a checkpoint\n", pParams->sCheckpointFile);
+		fclose(fCkpt);
+		return NULL;
+	}
+	fclose(fCkpt);
+	if (sCkpt.nParamsHash != paramsHash(pParams))
+	{
+		fprintf(stderr, "openOutputFile(): %s was written with different parameters\n", pParams->sCheckpointFile);
+		return NULL;
+	}
+	fOut = fopen(pParams->sOutFile, "r+b");
+	if (!fOut)
+	{
+		fprintf(stderr, "openOutputFile(): Couldn't reopen %s\n", pParams->sOutFile);
+		return NULL;
+	}
+	/* anything written after the checkpoint is thrown away and done again */
+	if (FSEEK64(fOut, 0, SEEK_END) != 0
+		|| FTELL64(fOut) < sCkpt.nOutOffset
+		|| FTRUNCATE64(fOut, sCkpt.nOutOffset) != 0
+		|| FSEEK64(fOut, sCkpt.nOutOffset, SEEK_SET) != 0)
+	{
+		fprintf(stderr, "openOutputFile(): %s is shorter than the checkpoint says\n", pParams->sOutFile);
+		fclose(fOut);
+		return NULL;
+	}
+	if (pParams->dCullRadius > 0.0)
+	{
+		char	sCullFile[_MAX_STR_LEN + 16];
+		FILE	*fCull;
+		int		bCut;
+
+		cullFileName(pParams, sCullFile);
+		fCull = fopen(sCullFile, "r+b");
+		bCut = (fCull && FSEEK64(fCull, 0, SEEK_END) == 0
+				&& FTELL64(fCull) >= sCkpt.nCullOffset
+				&& FTRUNCATE64(fCull, sCkpt.nCullOffset) == 0);
+		if (fCull)
+		{
+			fclose(fCull);
+		}
+		if (!bCut)
+		{
+			fprintf(stderr, "openOutputFile(): %s is shorter than the checkpoint says\n", sCullFile);
+			fclose(fOut);
+			return NULL;
+		}
+	}
+	/* the seed may have come from the time, so must be the one used before */
+	pParams->nSeed = sCkpt.nSeed;
+	*pFirstIt = sCkpt.nNextIt;
+	*pR0Stats = sCkpt.sR0Stats;
+	fprintf(stdout, "openOutputFile(): Resuming from replicate %d\n", sCkpt.nNextIt);
+	return fOut;
+}
+
+/*
+	infective engine: run replicate nIt to completion in pWork
+
+	each infective that can still infect fires infection attempts at its attempt rate, at a
+	host picked from its kernel row by the alias table. An attempt on a susceptible host
+	succeeds with probability rho/dRhoMax, and otherwise nothing happens, so each infective
+	infects each susceptible host at rate theta*rho*kernel as in runReplicate(), but the
+	infector is known without looking for it and no susceptible host's rate is kept. Only
+	infections and recoveries are counted in *pSteps
+*/
+int runReplicateInfectives(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_Workspace *pWork, int nIt, int *pSteps)
+{
+	int				retVal, g, k, nSteps, eventHost, targetHost;
+	double			randDbl, timeNow, dRecoverOne, dRecoverTwo, dAttempt, dTotal, thisRho;
+	t_AliasEntry	*aRow;
+
+	seedReplicate(&pWork->sRNG, pParams->nSeed, nIt);
+	timeNow = 0.0;
+	retVal = initEpidemic(pWork, pParams, pHosts, pKernel, nIt);
+	nSteps = 0;
+	while (retVal && (pParams->dMaxTime < 0 || timeNow <= pParams->dMaxTime))
+	{
+		/* recovery rates only depend on how many of each type are infected */
+		dRecoverOne = pWork->nInfOne * pParams->dMuOne;
+		dRecoverTwo = pWork->nInfTwo * pParams->dMuTwo;
+		dAttempt = 0.0;
+		for (g = 0; g < pWork->nRateGroups; g++)
+		{
+			dAttempt += pWork->aGroupTotal[g];
+		}
+		dTotal = dRecoverOne + dRecoverTwo + dAttempt;
+		if (dTotal <= 0.0)
+		{
+			break;
+		}
+		/* find time of next event and update current time */
+		randDbl = uniformRandom(&pWork->sRNG);
+		while (randDbl <= 0.0)
+		{
+			randDbl = uniformRandom(&pWork->sRNG);
+		}
+		timeNow = timeNow - log(randDbl) / dTotal;
+		randDbl = dTotal * uniformRandom(&pWork->sRNG);
+		if (randDbl < dRecoverOne + dRecoverTwo)
+		{
+			if (randDbl < dRecoverOne)
+			{
+				eventHost = pWork->aInfectives[(int)(pWork->nInfOne * uniformRandom(&pWork->sRNG))];
+			}
+			else
+			{
+				eventHost = pWork->aInfectives[pHosts->nTypeOne + (int)(pWork->nInfTwo * uniformRandom(&pWork->sRNG))];
+			}
+			retVal = recoverHostInfectives(eventHost, timeNow, pWork, pParams, pHosts);
+			if (retVal && pParams->dCullRadius > 0.0)
+			{
+				retVal = cullRing(eventHost, timeNow, pWork, pParams, pHosts, pKernel);
+			}
+			nSteps++;
+		}
+		else
+		{
+			eventHost = pickAttempter(randDbl - dRecoverOne - dRecoverTwo, pWork);
+			if (eventHost == _NOT_SET)
+			{
+				continue;
+			}
+			aRow = pKernel->aAlias + (size_t)eventHost * pHosts->nHosts;
+			k = (int)(pHosts->nHosts * uniformRandom(&pWork->sRNG));
+			targetHost = (uniformRandom(&pWork->sRNG) < aRow[k].fProb) ? k : aRow[k].nAlias;
+			if (hostIsSusceptible(targetHost, pWork))
+			{
+				thisRho = pParams->dRhoOne;
+				if (pHosts->aHosts[targetHost].eType == TYPE_II)
+				{
+					thisRho = pParams->dRhoTwo;
+				}
+				if (thisRho >= pWork->dRhoMax || pWork->dRhoMax * uniformRandom(&pWork->sRNG) < thisRho)
+				{
+					retVal = infectHostInfectives(targetHost, timeNow, eventHost, pWork, pParams, pHosts);
+					nSteps++;
+				}
+			}
+		}
+	}
+	*pSteps = nSteps;
+	return retVal;
+}
+
+/*
+	host engine: the next event in a replicate, or 0 if it is over
+
+	moves *pTime on to the event, then either sets *pHost to the host recovering, or
+	sets it to _NOT_SET with *pTarget uniform on [0, dInfectRate) for the host infected
+*/
+int drawEvent(t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, double *pTime, int *pHost, double *pTarget)
+{
+	double	dRecoverOne, dRecoverTwo, dTotal, randDbl;
+
+	if (pParams->dMaxTime >= 0 && *pTime > pParams->dMaxTime)
+	{
+		return 0;
+	}
+	dRecoverOne = pWork->nInfOne * pParams->dMuOne;
+	dRecoverTwo = pWork->nInfTwo * pParams->dMuTwo;
+	dTotal = dRecoverOne + dRecoverTwo + pWork->dInfectRate;
+	if (dTotal <= 0.0)
+	{
+		return 0;
+	}
+	/* find time of next event and update current time*/
+	randDbl = uniformRandom(&pWork->sRNG);
+	while (randDbl <= 0.0)
+	{
+		randDbl = uniformRandom(&pWork->sRNG);
+	}
+	*pTime = *pTime + -log(randDbl) / dTotal;
+
+	/* first the kind of event: a recovery needs no search, as each infected host of a type is equally likely */
+	randDbl = dTotal * uniformRandom(&pWork->sRNG);
+	*pHost = _NOT_SET;
+	if (randDbl < dRecoverOne)
+	{
+		*pHost = pWork->aInfectives[(int)(pWork->nInfOne * uniformRandom(&pWork->sRNG))];
+	}
+	else if (randDbl < dRecoverOne + dRecoverTwo)
+	{
+		*pHost = pWork->aInfectives[pHosts->nTypeOne + (int)(pWork->nInfTwo * uniformRandom(&pWork->sRNG))];
+	}
+	else
+	{
+		*pTarget = randDbl - (dRecoverOne + dRecoverTwo);
+	}
+	return 1;
+}
+
+/*
+	pick one of n things in proportion to aRate[], which add up to dTotal
+*/
+int pickByRate(double *aRate, int n, double dTotal, mt_state *pRNG)
+{
+	int		k;
+	double	randDbl, runningSum;
+
+	randDbl = dTotal * uniformRandom(pRNG);
+	runningSum = 0.0;
+	k = 0;
+	do
+	{
+		runningSum += aRate[k];
+		k++;
+	} while ((runningSum <= randDbl) && (k < n));
+	return k - 1;
+}
+
+/*
+	run replicate nIt to completion in pWork, returning the number of events in *pSteps
+*/
+int runReplicate(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_Workspace *pWork, int nIt, int *pSteps)
+{
+	int				*aInfectiveID;
+	double			*aInfectiveRate;
+	int				retVal, j, k, eventHost, infectingHost, numInfectives, nCandidates, nSteps;
+	double			thisExtra, thisRho, runningSum, randDbl, timeNow, totalInfectiveRate;
+	t_HostStatus	*hostStatus;
+
+	if (pParams->eEngine == ENGINE_INFECTIVES)
+	{
+		return runReplicateInfectives(pParams, pHosts, pKernel, pWork, nIt, pSteps);
+	}
+	hostStatus = pWork->aHostStatus;
+	aInfectiveID = pWork->aInfectiveID;
+	aInfectiveRate = pWork->aInfectiveRate;
+	seedReplicate(&pWork->sRNG, pParams->nSeed, nIt);
+	/* initialise epidemic */
+	timeNow = 0.0;
+	retVal = initEpidemic(pWork, pParams, pHosts, pKernel, nIt);
+	/* run epidemic */
+	nSteps = 0;
+	while (retVal && drawEvent(pWork, pParams, pHosts, &timeNow, &eventHost, &randDbl))
+	{
+#if 0
+		/* check rates every 50 steps (used in debugging) */
+		if (nSteps && (nSteps % 50 == 0))
+		{
+			checkRates(pParams, pHosts, pKernel, pWork);
+		}
+#endif
+		if (eventHost != _NOT_SET)
+		{
+			retVal = recoverHost(eventHost, timeNow, pWork, pParams, pHosts, pKernel);
+			if (retVal && pParams->dCullRadius > 0.0)
+			{
+				retVal = cullRing(eventHost, timeNow, pWork, pParams, pHosts, pKernel);
+			}
+			nSteps++;
+			continue;
+		}
+
+		/* find host that is infected */
+		runningSum = 0.0;
+		if (pWork->bAllTouched && pKernel->nGrid > 0)
+		{
+			eventHost = pickGridEvent(randDbl, pWork, pParams, pHosts, pKernel);
+		}
+		else if (pWork->bAllTouched && pWork->nBlocks > 0)
+		{
+			eventHost = pickBlockEvent(randDbl, pWork, pParams, pHosts, pKernel);
+		}
+		else if (pWork->bAllTouched)
+		{
+			eventHost = 0;
+			do
+			{
+				runningSum += hostStatus[eventHost].dRate;
+				eventHost++;
+			} while ((runningSum <= randDbl) && (eventHost < pHosts->nHosts));
+			eventHost--;
+		}
+		else
+		{
+			/* any host not in the touched list has no rate */
+			j = 0;
+			do
+			{
+				runningSum += hostStatus[pWork->aTouched[j]].dRate;
+				j++;
+			} while ((runningSum <= randDbl) && (j < pWork->nTouched));
+			eventHost = pWork->aTouched[j - 1];
+		}
+
+		/* should rounding run the search off the end, onto a host with no rate, nothing happens */
+		if (hostStatus[eventHost].eStatus == SUSCEPTIBLE)
+		{
+			/* to keep track of generations, need to find which host infected the newly infected one */
+			if (pKernel->pTiles && !prefetchTiles(pKernel->pTiles, eventHost))
+			{
+				retVal = 0;
+				break;
+			}
+			thisRho = pParams->dRhoOne;
+			if (pHosts->aHosts[eventHost].eType == TYPE_II)
+			{
+				thisRho = pParams->dRhoTwo;
+			}
+			touchAllHosts(pWork, pHosts);
+			/* find which infected host caused this infection */
+			if (pWork->nBlocks > 0)
+			{
+				infectingHost = pickBlockInfector(eventHost, thisRho, pWork, pParams, pHosts, pKernel);
+			}
+			else
+			{
+				totalInfectiveRate = 0.0;
+				numInfectives = 0;
+				/* with a grid kernel only hosts in the epidemic are looked at (each infected one's latest entry) */
+				nCandidates = (pKernel->nGrid > 0) ? pWork->sEpidemic.nEntries : pHosts->nHosts;
+				for (k = 0; k < nCandidates; k++)
+				{
+					j = infectorCandidate(k, pWork, pKernel);
+					if (j != _NOT_SET)
+					{
+						aInfectiveID[numInfectives] = j;
+						thisExtra = infectorRate(j, eventHost, thisRho, pWork, pParams, pHosts, pKernel);
+						aInfectiveRate[numInfectives] = thisExtra;
+						totalInfectiveRate += thisExtra;
+						numInfectives++;
+					}
+				}
+				infectingHost = aInfectiveID[pickByRate(aInfectiveRate, numInfectives, totalInfectiveRate, &pWork->sRNG)];
+			}
+			retVal = (infectingHost != _NOT_SET) && infectHost(eventHost, timeNow, infectingHost, pWork, pParams, pHosts, pKernel);
+		}
+#if 0
+		{
+			double d;
+
+			d = 0;
+			for (j = 0; j < pHosts->numHosts; j++)
+			{
+				d += hostStatus[j].rate;
+			}
+			fprintf(stdout, "*** %f %f\n", pWork->dInfectRate, d);
+		}
+#endif
+		nSteps++;
+	}
+	/* a tile that couldn't be read in the last event */
+	if (retVal && pKernel->pTiles)
+	{
+		retVal = tilesReadable(pKernel->pTiles);
+	}
+	*pSteps = nSteps;
+	return retVal;
+}
+
+/*
+	lockstep batch: a lane's share of the interleaved arrays as at the start of a replicate,
+	then its initial infections
+*/
+int startLane(t_Lanes *pLanes, int l, int nIt, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		i;
+	size_t	p;
+
+	for (i = 0; i < pHosts->nHosts; i++)
+	{
+		p = (size_t)i * pLanes->nLanes + l;
+		pLanes->aRate[p] = 0.0;
+		pLanes->aRhoSus[p] = (pHosts->aHosts[i].eType == TYPE_II) ? pParams->dRhoTwo : pParams->dRhoOne;
+		pLanes->aThetaInf[p] = 0.0;
+		pLanes->aStatus[p] = SUSCEPTIBLE;
+	}
+	pLanes->aIt[l] = nIt;
+	pLanes->aTime[l] = 0.0;
+	pLanes->aSteps[l] = 0;
+	pLanes->aSpreadTheta[l] = 0.0;
+	seedReplicate(&pLanes->aWork[l].sRNG, pParams->nSeed, nIt);
+	return initEpidemic(&pLanes->aWork[l], pParams, pHosts, pKernel, nIt);
+}
+
+/*
+	lockstep batch: one event in every lane with a replicate (as one time around the loop in
+	runReplicate()); a lane whose replicate is over is left at LANE_DONE
+*/
+int stepLanes(t_Lanes *pLanes, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int				i, j, l, nLanes, nFind, retVal;
+	int				aHost[_MAX_LANES];
+	double			aSum[_MAX_LANES], aRho[_MAX_LANES], aHostRate[_MAX_LANES], aPick[_MAX_LANES];
+	double			*aRow[_MAX_LANES];
+	t_Workspace		*pWork;
+
+	nLanes = pLanes->nLanes;
+	retVal = 1;
+	nFind = 0;
+	for (l = 0; l < nLanes; l++)
+	{
+		pLanes->aEvent[l] = LANE_IDLE;
+		if (pLanes->aIt[l] == _NOT_SET)
+		{
+			continue;
+		}
+		pWork = &pLanes->aWork[l];
+		if (!drawEvent(pWork, pParams, pHosts, &pLanes->aTime[l], &pLanes->aEventHost[l], &pLanes->aTarget[l]))
+		{
+			pLanes->aEvent[l] = LANE_DONE;
+			continue;
+		}
+		pLanes->aSteps[l]++;
+		if (pLanes->aEventHost[l] != _NOT_SET)
+		{
+			pLanes->aEvent[l] = LANE_RECOVER;
+		}
+		else
+		{
+			pLanes->aEvent[l] = LANE_INFECT;
+			nFind++;
+		}
+	}
+
+	/* one pass finds the host infected in every lane with an infection */
+	if (nFind > 0)
+	{
+		for (l = 0; l < nLanes; l++)
+		{
+			aHost[l] = (pLanes->aEvent[l] == LANE_INFECT) ? _NOT_SET : 0;
+		}
+		pLanes->pfScan(pLanes, pHosts->nHosts, pLanes->aTarget, aHost);
+		for (l = 0; l < nLanes; l++)
+		{
+			if (pLanes->aEvent[l] == LANE_INFECT)
+			{
+				pLanes->aEventHost[l] = aHost[l];
+			}
+		}
+	}
+	nFind = 0;
+	for (l = 0; l < nLanes; l++)
+	{
+		aRho[l] = 0.0;
+		aRow[l] = pLanes->aZeroRow;
+		aHostRate[l] = 0.0;
+		aSum[l] = 0.0;
+		aHost[l] = 0;
+		if (pLanes->aEvent[l] == LANE_INFECT)
+		{
+			i = pLanes->aEventHost[l];
+			if (pLanes->aStatus[(size_t)i * nLanes + l] != SUSCEPTIBLE)
+			{
+				pLanes->aEvent[l] = LANE_IDLE;
+				continue;
+			}
+			aRho[l] = (pHosts->aHosts[i].eType == TYPE_II) ? pParams->dRhoTwo : pParams->dRhoOne;
+			aRow[l] = pKernel->aKernel + (size_t)i * pHosts->nHosts;
+			aHost[l] = _NOT_SET;
+			nFind++;
+		}
+	}
+
+	/*
+		and two more which infected host caused it: the first adds up the force of infection
+		on it, and the second finds where the random number falls, as pickByRate() would over
+		the infected hosts (the others add zero, which changes nothing)
+	*/
+	if (nFind > 0)
+	{
+		pLanes->pfGather(pLanes, pHosts->nHosts, aRho, aRow, aHostRate, aSum);
+		for (l = 0; l < nLanes; l++)
+		{
+			if (aHost[l] == _NOT_SET)
+			{
+				aPick[l] = aSum[l] * uniformRandom(&pLanes->aWork[l].sRNG);
+			}
+		}
+		pLanes->pfScanInfectors(pLanes, pHosts->nHosts, aRho, aRow, aPick, aHost);
+	}
+	for (l = 0; retVal && l < nLanes; l++)
+	{
+		if (pLanes->aEvent[l] != LANE_INFECT)
+		{
+			continue;
+		}
+		/* should rounding run the search off the end, it is the last infected host */
+		for (j = pHosts->nHosts - 1; aHost[l] == _NOT_SET; j--)
+		{
+			if (pLanes->aStatus[(size_t)j * nLanes + l] == INFECTED)
+			{
+				aHost[l] = j;
+			}
+		}
+		retVal = infectHostLane(pLanes->aEventHost[l], pLanes->aTime[l], aHost[l], &pLanes->aWork[l], pParams, pHosts);
+	}
+	for (l = 0; retVal && l < nLanes; l++)
+	{
+		if (pLanes->aEvent[l] == LANE_RECOVER)
+		{
+			retVal = recoverHostLane(pLanes->aEventHost[l], pLanes->aTime[l], &pLanes->aWork[l], pParams, pHosts);
+		}
+	}
+	spreadLanes(pLanes, pParams, pHosts, pKernel);
+
+	/* SIS: hosts which recovered feel the force of infection from all infected hosts again */
+	nFind = 0;
+	for (l = 0; l < nLanes; l++)
+	{
+		aRho[l] = 0.0;
+		aRow[l] = pLanes->aZeroRow;
+		aHostRate[l] = 0.0;
+		aSum[l] = pLanes->aWork[l].dInfectRate;
+		if (pLanes->aEvent[l] == LANE_RECOVER && pParams->eModelType == MODEL_SIS)
+		{
+			i = pLanes->aEventHost[l];
+			aRho[l] = (pHosts->aHosts[i].eType == TYPE_II) ? pParams->dRhoTwo : pParams->dRhoOne;
+			pLanes->aRhoSus[(size_t)i * nLanes + l] = aRho[l];
+			aRow[l] = pKernel->aKernel + (size_t)i * pHosts->nHosts;
+			aHostRate[l] = pLanes->aRate[(size_t)i * nLanes + l];
+			nFind++;
+		}
+	}
+	if (nFind > 0)
+	{
+		pLanes->pfGather(pLanes, pHosts->nHosts, aRho, aRow, aHostRate, aSum);
+		for (l = 0; l < nLanes; l++)
+		{
+			if (pLanes->aEvent[l] == LANE_RECOVER && pParams->eModelType == MODEL_SIS)
+			{
+				pLanes->aRate[(size_t)pLanes->aEventHost[l] * nLanes + l] = aHostRate[l];
+				pLanes->aWork[l].dInfectRate = aSum[l];
+			}
+		}
+	}
+	for (l = 0; l < nLanes; l++)
+	{
+		pWork = &pLanes->aWork[l];
+		/* with nobody infected, whatever is left of the total is rounding error */
+		if (pLanes->aEvent[l] == LANE_RECOVER && (pWork->dInfectRate < 0.0 || pWork->nInfOne + pWork->nInfTwo == 0))
+		{
+			pWork->dInfectRate = 0.0;
+		}
+	}
+	return retVal;
+}
+
+void freeLanes(t_Lanes *pLanes)
+{
+	int		l;
+
+	for (l = 0; l < _MAX_LANES; l++)
+	{
+		freeWorkspace(&pLanes->aWork[l]);
+	}
+	if (pLanes->pBlock)
+	{
+		free(pLanes->pBlock);
+	}
+	memset(pLanes, 0, sizeof(t_Lanes));
+}
+
+int initLanes(t_Lanes *pLanes, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		l;
+	size_t	nSlots;
+	char	*pNext;
+
+	memset(pLanes, 0, sizeof(t_Lanes));
+	if (pHosts->nHosts >= _EVENT_BLOCK_MIN_HOSTS)
+	{
+		/* otherwise output wouldn't be the same as with lanes=1, which splits each event into blocks */
+		fprintf(stderr, "initLanes(): lanes > 1 needs fewer than %d hosts\n", _EVENT_BLOCK_MIN_HOSTS);
+		return 0;
+	}
+	pLanes->nLanes = pParams->nLanes;
+	nSlots = (size_t)pHosts->nHosts * pLanes->nLanes;
+	pLanes->pBlock = malloc(16 * 5 + (3 * sizeof(double) + sizeof(unsigned char)) * nSlots + sizeof(double) * pHosts->nHosts);
+	if (!pLanes->pBlock)
+	{
+		fprintf(stderr, "initLanes(): Out of memory for %d lanes\n", pLanes->nLanes);
+		return 0;
+	}
+	pNext = pLanes->pBlock;
+	pLanes->aRate = carveBlock(&pNext, sizeof(double) * nSlots);
+	pLanes->aRhoSus = carveBlock(&pNext, sizeof(double) * nSlots);
+	pLanes->aThetaInf = carveBlock(&pNext, sizeof(double) * nSlots);
+	pLanes->aStatus = carveBlock(&pNext, sizeof(unsigned char) * nSlots);
+	pLanes->aZeroRow = carveBlock(&pNext, sizeof(double) * pHosts->nHosts);
+	/* lanes with no replicate are still worked on, so must hold zeros rather than garbage */
+	memset(pLanes->pBlock, 0, pNext - pLanes->pBlock);
+	if (pLanes->nLanes == 2)
+	{
+		pLanes->pfScan = scanLanes_2;
+		pLanes->pfSpread = spreadPass_2;
+		pLanes->pfGather = gatherPass_2;
+		pLanes->pfScanInfectors = scanInfectors_2;
+	}
+	else if (pLanes->nLanes == 4)
+	{
+		pLanes->pfScan = scanLanes_4;
+		pLanes->pfSpread = spreadPass_4;
+		pLanes->pfGather = gatherPass_4;
+		pLanes->pfScanInfectors = scanInfectors_4;
+	}
+	else
+	{
+		pLanes->pfScan = scanLanes_8;
+		pLanes->pfSpread = spreadPass_8;
+		pLanes->pfGather = gatherPass_8;
+		pLanes->pfScanInfectors = scanInfectors_8;
+	}
+	for (l = 0; l < pLanes->nLanes; l++)
+	{
+		if (!initWorkspace(&pLanes->aWork[l], pParams, pHosts, pKernel))
+		{
+			freeLanes(pLanes);
+			return 0;
+		}
+		pLanes->aWork[l].pLanes = pLanes;
+		pLanes->aWork[l].nLane = l;
+		pLanes->aIt[l] = _NOT_SET;
+	}
+	return 1;
+}
+
+/*
+	replicate nIt is finished, with its output in pOut and its R0 sums in pThisR0: write it
+	out, add it to the run's R0 sums, and checkpoint if it is time to
+*/
+int retireReplicate(t_Params *pParams, FILE *fOut, t_TextBuf *pOut, t_R0Stats *pThisR0, t_R0Stats *pR0Stats, int nIt, int nShardFirstIt, int nEndIt, int *pbConverged)
+{
+	int		retVal;
+	double	dR0, dHalfWidth;
+
+	retVal = 1;
+	if (fwrite(pOut->pText, 1, pOut->nLen, fOut) != pOut->nLen)
+	{
+		fprintf(stderr, "retireReplicate(): Couldn't write to %s\n", pParams->sOutFile);
+		retVal = 0;
+	}
+	pOut->nLen = 0;
+	mergeR0Stats(pR0Stats, pThisR0);
+	if (pParams->dConvergeTol > 0.0)
+	{
+		*pbConverged = r0Converged(pR0Stats, pParams);
+		dR0 = r0Estimate(pR0Stats, &dHalfWidth);
+		echoToScreen(pParams, "R0 after %d replicates: %.4f +/- %.4f\n", pR0Stats->nReplicates, dR0, dHalfWidth);
+	}
+	if (retVal && pParams->nCheckpointEvery > 0
+		&& ((nIt + 1 - nShardFirstIt) % pParams->nCheckpointEvery == 0 || nIt + 1 == nEndIt || *pbConverged))
+	{
+		retVal = writeCheckpoint(pParams, fOut, nIt + 1, pR0Stats);
+	}
+	return retVal;
+}
+
+/*
+	lockstep batch: run replicates *pnIt onwards, up to nEndIt or convergence, a lane at a time;
+	a lane whose replicate finishes starts the next straight away, and finished replicates
+	are written out in order, so everything is as runEpidemics() does one by one
+*/
+int runLanes(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, FILE *fOut, t_R0Stats *pR0Stats,
+			int nShardFirstIt, int nEndIt, int *pnIt, int *pbConverged, t_RunStats *pStats)
+{
+	t_Lanes		*pLanes;
+	t_LaneSlot	*aSlots, *pSlot;
+	t_TextBuf	sTmp;
+	int			retVal, l, nSlots, nNext, nRetire;
+
+	nSlots = _LANE_WINDOW * pParams->nLanes;
+	pLanes = malloc(sizeof(t_Lanes));
+	aSlots = calloc(nSlots, sizeof(t_LaneSlot));
+	if (!pLanes || !aSlots)
+	{
+		fprintf(stderr, "runLanes(): Out of memory\n");
+		free(pLanes);
+		free(aSlots);
+		return 0;
+	}
+	retVal = initLanes(pLanes, pParams, pHosts, pKernel);
+	nNext = nRetire = *pnIt;
+	while (retVal)
+	{
+		/* write out whatever has finished in order */
+		pSlot = &aSlots[nRetire % nSlots];
+		while (retVal && !*pbConverged && nRetire < nEndIt && pSlot->bDone)
+		{
+			if (pStats)
+			{
+				pStats->nEvents += pSlot->nSteps;
+				pStats->nReplicates++;
+			}
+			retVal = retireReplicate(pParams, fOut, &pSlot->sOut, &pSlot->sR0Stats, pR0Stats, nRetire, nShardFirstIt, nEndIt, pbConverged);
+			pSlot->bDone = 0;
+			nRetire++;
+			pSlot = &aSlots[nRetire % nSlots];
+		}
+		if (!retVal || *pbConverged || nRetire == nEndIt)
+		{
+			break;
+		}
+		/* idle lanes start the next replicates, so long as there is somewhere to put them */
+		for (l = 0; retVal && l < pLanes->nLanes; l++)
+		{
+			if (pLanes->aIt[l] == _NOT_SET && nNext < nEndIt && nNext < nRetire + nSlots)
+			{
+				retVal = startLane(pLanes, l, nNext, pParams, pHosts, pKernel);
+				nNext++;
+			}
+		}
+		if (retVal)
+		{
+			retVal = stepLanes(pLanes, pParams, pHosts, pKernel);
+		}
+		for (l = 0; retVal && l < pLanes->nLanes; l++)
+		{
+			if (pLanes->aEvent[l] == LANE_DONE)
+			{
+				pSlot = &aSlots[pLanes->aIt[l] % nSlots];
+				dumpEpidemic(pParams, pHosts, &pLanes->aWork[l], pLanes->aIt[l], pParams->dMaxTime, pLanes->aIt[l] == nShardFirstIt);
+				/* the slot takes the output, and the lane its empty buffer */
+				sTmp = pSlot->sOut;
+				pSlot->sOut = pLanes->aWork[l].sOut;
+				pLanes->aWork[l].sOut = sTmp;
+				memset(&pSlot->sR0Stats, 0, sizeof(t_R0Stats));
+				addR0Replicate(&pSlot->sR0Stats, pParams, &pLanes->aWork[l]);
+				pSlot->nSteps = pLanes->aSteps[l];
+				pSlot->bDone = 1;
+				pLanes->aIt[l] = _NOT_SET;
+			}
+		}
+	}
+	*pnIt = nRetire;
+	for (l = 0; l < nSlots; l++)
+	{
+		free(aSlots[l].sOut.pText);
+	}
+	free(aSlots);
+	freeLanes(pLanes);
+	free(pLanes);
+	return retVal;
+}
+
+/*
+	actually run the epidemics (pStats may be NULL if timings aren't wanted)
+*/
+int runEpidemics(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel, t_RunStats *pStats)
+{
+	FILE			*fOut;
+	int				retVal, i, nSteps, nFirstIt, nShardFirstIt, nEndIt;
+	t_Workspace		sWork;
+	t_R0Stats		sR0Stats, sThisR0;
+	double			dStartTime, dR0, dHalfWidth;
+	int				bConverged;
+
+	retVal = 0;
+	dStartTime = wallClockSeconds();
+	if (pStats)
+	{
+		memset(pStats, 0, sizeof(t_RunStats));
+	}
+	shardRange(pParams, &nShardFirstIt, &nEndIt);
+	fOut = openOutputFile(pParams, &nFirstIt, &sR0Stats);
+	if (fOut)
+	{
+		i = nFirstIt;
+		/* checked before each replicate, so a resumed run which had already converged does no more */
+		bConverged = r0Converged(&sR0Stats, pParams);
+		if (pParams->nLanes > 1)
+		{
+			retVal = runLanes(pParams, pHosts, pKernel, fOut, &sR0Stats, nShardFirstIt, nEndIt, &i, &bConverged, pStats);
+		}
+		else if (initWorkspace(&sWork, pParams, pHosts, pKernel))
+		{
+			retVal = 1;
+			/* only this thread may look up a tiled kernel, so its blocks are done one after another */
+			if (sWork.nBlocks > 0 && !pKernel->pTiles)
+			{
+				sWork.pTeam = teamCreate(pParams->nEventThreads > 0 ? pParams->nEventThreads : numProcessors());
+				if (!pParams->bQuiet)
+				{
+					fprintf(stdout, "runEpidemics(): each event split into %d blocks on %d thread(s)\n", sWork.nBlocks, teamSize(sWork.pTeam));
+				}
+			}
+			while (retVal && i < nEndIt && !bConverged)
+			{
+				retVal = runReplicate(pParams, pHosts, pKernel, &sWork, i, &nSteps);
+				if (pStats)
+				{
+					pStats->nEvents += nSteps;
+					pStats->nReplicates++;
+				}
+				if (retVal)
+				{
+					dumpEpidemic(pParams, pHosts, &sWork, i, pParams->dMaxTime, i == nShardFirstIt);
+					memset(&sThisR0, 0, sizeof(t_R0Stats));
+					addR0Replicate(&sThisR0, pParams, &sWork);
+					retVal = retireReplicate(pParams, fOut, &sWork.sOut, &sThisR0, &sR0Stats, i, nShardFirstIt, nEndIt, &bConverged);
+				}
+				/* add one to iteration number */
+				i++;
+			}
+			teamDestroy(sWork.pTeam);
+			freeWorkspace(&sWork);
+		}
+		if (pKernel->pTiles && !pParams->bQuiet)
+		{
+			reportTileCache(pParams, pKernel->pTiles);
+		}
+		if (retVal && pParams->dConvergeTol > 0.0)
+		{
+			dR0 = r0Estimate(&sR0Stats, &dHalfWidth);
+			fprintf(stdout, "R0 = %.4f +/- %.4f from %d replicates (%s)\n", dR0, dHalfWidth, i, bConverged ? "converged" : "reached numIts");
+			/* rZero_Function.R expects numIts lines of output */
+			if (i < pParams->nNumIts)
+			{
+				pParams->nNumIts = i;
+				retVal = dumpParametersToCSV(pParams);
+			}
+		}
+		fclose(fOut);
+	}
+	if (pStats)
+	{
+		pStats->dSeconds = wallClockSeconds() - dStartTime;
+	}
+	return retVal;
+}
+
+void freeKernel(t_Kernel *pKernel)
+{
+	freeTileCache(pKernel->pTiles);		/* stops its threads before the memory they read into goes */
+	if (pKernel->pEdit)
+	{
+		/* but not the base landscape's kernel */
+		free(pKernel->pEdit->aBaseHost);
+		free(pKernel->pEdit->aAddedKernel);
+		free(pKernel->pEdit);
+	}
+	freeKernelMemory(&pKernel->sMemory);
+	free(pKernel->aHostCell);
+	free(pKernel->aCellStart);
+	free(pKernel->aCellHosts);
+	free(pKernel->aCellGX);
+	free(pKernel->aCellGY);
+	free(pKernel->aFarKernel);
+	free(pKernel->aRowSum);
+	memset(pKernel, 0, sizeof(t_Kernel));
+}
+
+void freeMemory(t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	freeKernel(pKernel);
+	if (pHosts->nAlloc && pHosts->aHosts)
+	{
+		free(pHosts->aHosts);
+	}
+	if (pHosts->aByType)
+	{
+		free(pHosts->aByType);
+	}
+	if (pHosts->aOrigID)
+	{
+		free(pHosts->aOrigID);
+	}
+	if (pHosts->aSortedID)
+	{
+		free(pHosts->aSortedID);
+	}
+}
+
+/*
+	batch mode: several landscapes in one process
+
+	(landscape, replicate) pairs are handed out to a pool of threads; while
+	some threads simulate, another loads the hosts and builds the kernel for
+	the next landscape, as long as the memory held by loaded landscapes plus
+	that needed by the largest so far is within the budget. Replicates finish
+	in any order, so each one's output is held until all earlier ones for the
+	same landscape have been written, and every file is exactly as a separate
+	run on that landscape would give
+*/
+enum
+{
+	BATCH_WAITING = 0,
+	BATCH_LOADING = 1,
+	BATCH_READY = 2,
+	BATCH_DONE = 3
+} batchState;
+
+typedef struct {
+	t_Params	sParams;		/* the run's parameters, with this landscape's files */
+	t_Hosts		sHosts;
+	t_Kernel	sKernel;
+	int			eState;
+	double		dMB;			/* memory held while loaded */
+	int			nNextIt;		/* next replicate to hand out */
+	int			nNextWrite;		/* next replicate to write */
+	t_TextBuf	*aDone;			/* output of finished replicates waiting for earlier ones */
+	char		*aFinished;
+	FILE		*fOut;
+} t_BatchLandscape;
+
+typedef struct {
+	t_BatchLandscape	*aLS;
+	int					nLS;
+	int					nNextLoad;		/* next landscape to load */
+	int					nLoading;		/* at most one at a time, so the budget can't be overshot */
+	double				dMBInUse;
+	double				dMBLargest;		/* guess at what the next landscape will need */
+	double				dMBBudget;
+	int					bFailed;
+	long long			nEvents;
+	t_Mutex				sLock;
+	t_Cond				sChanged;		/* signalled whenever there might be new work */
+} t_Batch;
+
+/*
+	add one file name to a growing list
+*/
+int addFileToList(char ***paFiles, int *pnFiles, const char *sFile)
+{
+	char	**aFiles;
+
+	aFiles = realloc(*paFiles, sizeof(char*) * (*pnFiles + 1));
+	if (!aFiles)
+	{
+		return 0;
+	}
+	*paFiles = aFiles;
+	aFiles[*pnFiles] = strdup(sFile);
+	if (!aFiles[*pnFiles])
+	{
+		return 0;
+	}
+	(*pnFiles)++;
+	return 1;
+}
+
+int compareFileNames(const void *pOne, const void *pTwo)
+{
+	return strcmp(*(char**)pOne, *(char**)pTwo);
+}
+
+/*
+	add all files matching a pattern containing * or ?, in alphabetical order
+*/
+int addMatchingFiles(char ***paFiles, int *pnFiles, const char *sPattern)
+{
+	int		nFirst, retVal;
+#ifdef _WIN32
+	WIN32_FIND_DATAA	sFind;
+	HANDLE				hFind;
+	char				sFile[_MAX_STR_LEN];
+	const char			*pDelim;
+	int					nDirLen;
+
+	pDelim = strrchr(sPattern, C_DIR_DELIMITER);
+	nDirLen = pDelim ? (int)(pDelim - sPattern + 1) : 0;
+	nFirst = *pnFiles;
+	retVal = 1;
+	hFind = FindFirstFileA(sPattern, &sFind);
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if (!(sFind.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			{
+				sprintf(sFile, "%.*s%s", nDirLen, sPattern, sFind.cFileName);
+				retVal = addFileToList(paFiles, pnFiles, sFile);
+			}
+		} while (retVal && FindNextFileA(hFind, &sFind));
+		FindClose(hFind);
+	}
+#else
+	glob_t	sGlob;
+	size_t	i;
+
+	nFirst = *pnFiles;
+	retVal = 1;
+	if (glob(sPattern, 0, NULL, &sGlob) == 0)
+	{
+		for (i = 0; retVal && i < sGlob.gl_pathc; i++)
+		{
+			retVal = addFileToList(paFiles, pnFiles, sGlob.gl_pathv[i]);
+		}
+		globfree(&sGlob);
+	}
+#endif
+	if (retVal && *pnFiles == nFirst)
+	{
+		fprintf(stderr, "addMatchingFiles(): Nothing matches %s\n", sPattern);
+		retVal = 0;
+	}
+	qsort(*paFiles + nFirst, *pnFiles - nFirst, sizeof(char*), compareFileNames);
+	return retVal;
+}
+
+/*
+	split a comma separated list of host files, expanding any wildcards
+*/
+int expandFileList(const char *sList, char ***paFiles, int *pnFiles)
+{
+	char	sItem[_MAX_STR_LEN];
+	const char	*pStart, *pEnd;
+	int		nLen, retVal;
+
+	*paFiles = NULL;
+	*pnFiles = 0;
+	retVal = 1;
+	pStart = sList;
+	while (retVal && *pStart)
+	{
+		pEnd = strchr(pStart, ',');
+		if (!pEnd)
+		{
+			pEnd = pStart + strlen(pStart);
+		}
+		nLen = (int)(pEnd - pStart);
+		if (nLen > 0)
+		{
+			sprintf(sItem, "%.*s", nLen, pStart);
+			if (strpbrk(sItem, "*?"))
+			{
+				retVal = addMatchingFiles(paFiles, pnFiles, sItem);
+			}
+			else
+			{
+				retVal = addFileToList(paFiles, pnFiles, sItem);
+			}
+		}
+		pStart = *pEnd ? pEnd + 1 : pEnd;
+	}
+	return retVal && *pnFiles > 0;
+}
+
+/*
+	output for a landscape goes in the same directory as outFile, named after
+	the host file as create_LS.R does (e.g. Inputs\ls_3_xy.csv -> Outputs\ls_3_epidemics.csv)
+*/
+void batchOutFileName(char *sBatchOut, const char *sOutFile, const char *sXYFile)
+{
+	const char	*pDir, *pBase, *pExt, *pOutExt;
+	int			nBaseLen;
+
+	pDir = strrchr(sOutFile, C_DIR_DELIMITER);
+	pBase = strrchr(sXYFile, C_DIR_DELIMITER);
+	pBase = pBase ? pBase + 1 : sXYFile;
+	pExt = strrchr(pBase, '.');
+	nBaseLen = pExt ? (int)(pExt - pBase) : (int)strlen(pBase);
+	if (nBaseLen > 3 && strncmp(pBase + nBaseLen - 3, "_xy", 3) == 0)
+	{
+		nBaseLen -= 3;
+	}
+	pOutExt = strrchr(pDir ? pDir : sOutFile, '.');
+	sprintf(sBatchOut, "%.*s%.*s_epidemics%s", pDir ? (int)(pDir - sOutFile + 1) : 0, sOutFile,
+		nBaseLen, pBase, pOutExt ? pOutExt : ".csv");
+}
+
+/*
+	free everything held by a landscape (called with the lock held)
+*/
+void batchRelease(t_Batch *pBatch, t_BatchLandscape *pLS)
+{
+	int		i;
+
+	if (pLS->fOut)
+	{
+		if (fclose(pLS->fOut) != 0)
+		{
+			fprintf(stderr, "batchRelease(): Couldn't write %s\n", pLS->sParams.sOutFile);
+			pBatch->bFailed = 1;
+		}
+		pLS->fOut = NULL;
+	}
+	if (pLS->aDone)
+	{
+		for (i = 0; i < pLS->sParams.nNumIts; i++)
+		{
+			free(pLS->aDone[i].pText);
+		}
+		free(pLS->aDone);
+		pLS->aDone = NULL;
+	}
+	free(pLS->aFinished);
+	pLS->aFinished = NULL;
+	freeMemory(&pLS->sHosts, &pLS->sKernel);
+	memset(&pLS->sHosts, 0, sizeof(t_Hosts));
+	memset(&pLS->sKernel, 0, sizeof(t_Kernel));
+	if (pLS->eState == BATCH_READY)
+	{
+		pBatch->dMBInUse -= pLS->dMB;
+	}
+	pLS->eState = BATCH_DONE;
+}
+
+/*
+	write out any replicates which are next in line (called with the lock held)
+*/
+void batchWriteDone(t_Batch *pBatch, t_BatchLandscape *pLS)
+{
+	t_TextBuf	*pText;
+
+	while (pLS->nNextWrite < pLS->sParams.nNumIts && pLS->aFinished[pLS->nNextWrite])
+	{
+		pText = &pLS->aDone[pLS->nNextWrite];
+		if (fwrite(pText->pText, 1, pText->nLen, pLS->fOut) != pText->nLen)
+		{
+			fprintf(stderr, "batchWriteDone(): Couldn't write to %s\n", pLS->sParams.sOutFile);
+			pBatch->bFailed = 1;
+		}
+		free(pText->pText);
+		memset(pText, 0, sizeof(t_TextBuf));
+		pLS->nNextWrite++;
+	}
+	if (pLS->nNextWrite == pLS->sParams.nNumIts)
+	{
+		batchRelease(pBatch, pLS);
+		fprintf(stdout, "Finished %s\n", pLS->sParams.sOutFile);
+	}
+}
+
+/*
+	read hosts, build the kernel and open the output for one landscape (without the lock)
+*/
+int batchLoad(t_BatchLandscape *pLS)
+{
+	int		nNumIts;
+
+	nNumIts = pLS->sParams.nNumIts;
+	if (!loadHosts(&pLS->sParams, &pLS->sHosts) || !calcKernel(&pLS->sParams, &pLS->sHosts, &pLS->sKernel))
+	{
+		fprintf(stderr, "batchLoad(): Couldn't set up %s\n", pLS->sParams.sXYFile);
+		return 0;
+	}
+	pLS->dMB = kernelMB(&pLS->sKernel, &pLS->sHosts)
+		+ sizeof(t_SingleHost) * (double)pLS->sHosts.nHosts / (1024.0 * 1024.0);
+	pLS->aDone = calloc(nNumIts, sizeof(t_TextBuf));
+	pLS->aFinished = calloc(nNumIts, 1);
+	pLS->fOut = fopen(pLS->sParams.sOutFile, "wb");
+	if (!pLS->aDone || !pLS->aFinished || !pLS->fOut)
+	{
+		fprintf(stderr, "batchLoad(): Couldn't open %s\n", pLS->sParams.sOutFile);
+		return 0;
+	}
+	return dumpParametersToCSV(&pLS->sParams);
+}
+
+/*
+	one thread of the pool: keeps taking the next thing to do until there is nothing left
+*/
+void batchWorker(void *pCtx, int nItem, int nThread)
+{
+	t_Batch				*pBatch;
+	t_BatchLandscape	*pLS, *pWorkLS;
+	t_Workspace			sWork;
+	int					i, nActive, nResident, bLoad, nIt, nSteps, retVal;
+
+	pBatch = (t_Batch*)pCtx;
+	memset(&sWork, 0, sizeof(t_Workspace));
+	pWorkLS = NULL;
+	mutexLock(&pBatch->sLock);
+	for (;;)
+	{
+		/*
+			choose: replicates from the earliest landscape with any left, but load
+			the next landscape first if at most one has replicates left to hand out
+			and there is room for it (or nothing else is loaded)
+		*/
+		pLS = NULL;
+		bLoad = 0;
+		nActive = nResident = 0;
+		for (i = 0; i < pBatch->nLS; i++)
+		{
+			if (pBatch->aLS[i].eState == BATCH_READY)
+			{
+				nResident++;
+			}
+			if (pBatch->aLS[i].eState == BATCH_LOADING
+				|| (pBatch->aLS[i].eState == BATCH_READY && pBatch->aLS[i].nNextIt < pBatch->aLS[i].sParams.nNumIts))
+			{
+				nActive++;
+				if (pLS == NULL && pBatch->aLS[i].eState == BATCH_READY)
+				{
+					pLS = &pBatch->aLS[i];
+				}
+			}
+		}
+		if (pBatch->nNextLoad < pBatch->nLS
+			&& pBatch->nLoading == 0
+			&& (nResident == 0 || pBatch->dMBInUse + pBatch->dMBLargest <= pBatch->dMBBudget)
+			&& (pLS == NULL || nActive < 2))
+		{
+			pLS = &pBatch->aLS[pBatch->nNextLoad++];
+			pLS->eState = BATCH_LOADING;
+			pBatch->nLoading++;
+			bLoad = 1;
+		}
+		if (pBatch->bFailed || (pLS == NULL && nActive == 0 && pBatch->nNextLoad == pBatch->nLS))
+		{
+			break;
+		}
+		if (pLS == NULL)
+		{
+			condWait(&pBatch->sChanged, &pBatch->sLock);
+			continue;
+		}
+		if (bLoad)
+		{
+			mutexUnlock(&pBatch->sLock);
+			retVal = batchLoad(pLS);
+			mutexLock(&pBatch->sLock);
+			pBatch->nLoading--;
+			if (retVal)
+			{
+				pLS->eState = BATCH_READY;
+				pBatch->dMBInUse += pLS->dMB;
+				if (pLS->dMB > pBatch->dMBLargest)
+				{
+					pBatch->dMBLargest = pLS->dMB;
+				}
+				fprintf(stdout, "Loaded %s (%d hosts, %.0f MB)\n", pLS->sParams.sXYFile, pLS->sHosts.nHosts, pLS->dMB);
+			}
+			else
+			{
+				pBatch->bFailed = 1;
+			}
+			condBroadcast(&pBatch->sChanged);
+			continue;
+		}
+		/* run a replicate */
+		nIt = pLS->nNextIt++;
+		mutexUnlock(&pBatch->sLock);
+		retVal = 1;
+		if (pWorkLS != pLS)
+		{
+			freeWorkspace(&sWork);
+			retVal = initWorkspace(&sWork, &pLS->sParams, &pLS->sHosts, &pLS->sKernel);
+			pWorkLS = pLS;
+		}
+		nSteps = 0;
+		if (retVal)
+		{
+			retVal = runReplicate(&pLS->sParams, &pLS->sHosts, &pLS->sKernel, &sWork, nIt, &nSteps);
+			dumpEpidemic(&pLS->sParams, &pLS->sHosts, &sWork, nIt, pLS->sParams.dMaxTime, nIt == 0);
+		}
+		mutexLock(&pBatch->sLock);
+		if (retVal)
+		{
+			/* hand the text over, and write it if everything before it is done */
+			pLS->aDone[nIt] = sWork.sOut;
+			memset(&sWork.sOut, 0, sizeof(t_TextBuf));
+			pLS->aFinished[nIt] = 1;
+			pBatch->nEvents += nSteps;
+			batchWriteDone(pBatch, pLS);
+			if (pLS->eState == BATCH_DONE)
+			{
+				pWorkLS = NULL;
+			}
+		}
+		else
+		{
+			pBatch->bFailed = 1;
+		}
+		condBroadcast(&pBatch->sChanged);
+	}
+	condBroadcast(&pBatch->sChanged);
+	mutexUnlock(&pBatch->sLock);
+	freeWorkspace(&sWork);
+}
+
+/*
+	run every landscape in pParams->sBatchXYFiles
+*/
+int runBatch(t_Params *pParams)
+{
+	t_Batch		sBatch;
+	char		**aFiles;
+	int			i, j, nFiles, nThreads, retVal;
+	double		dStartTime;
+
+	dStartTime = wallClockSeconds();
+	if (!expandFileList(pParams->sBatchXYFiles, &aFiles, &nFiles))
+	{
+		fprintf(stderr, "runBatch(): Couldn't make list of host files from %s\n", pParams->sBatchXYFiles);
+		return 0;
+	}
+	memset(&sBatch, 0, sizeof(t_Batch));
+	sBatch.dMBBudget = pParams->dBatchMemoryMB;
+	sBatch.aLS = calloc(nFiles, sizeof(t_BatchLandscape));
+	retVal = (sBatch.aLS != NULL);
+	for (i = 0; retVal && i < nFiles; i++)
+	{
+		t_Params	*pLSParams;
+		char		sOutFile[_MAX_STR_LEN * 2 + 32];
+		char		*p;
+
+		pLSParams = &sBatch.aLS[i].sParams;
+		memcpy(pLSParams, pParams, sizeof(t_Params));
+		batchOutFileName(sOutFile, pParams->sOutFile, aFiles[i]);
+		if (strlen(aFiles[i]) >= _MAX_STR_LEN || strlen(sOutFile) + 16 >= _MAX_STR_LEN)
+		{
+			fprintf(stderr, "runBatch(): File name too long for %s\n", aFiles[i]);
+			retVal = 0;
+			break;
+		}
+		strcpy(pLSParams->sXYFile, aFiles[i]);
+		strcpy(pLSParams->sOutFile, sOutFile);
+		for (j = 0; j < i; j++)
+		{
+			if (strcmp(sBatch.aLS[j].sParams.sOutFile, sOutFile) == 0)
+			{
+				fprintf(stderr, "runBatch(): %s and %s would both write %s\n", aFiles[j], aFiles[i], sOutFile);
+				retVal = 0;
+			}
+		}
+		if ((p = strrchr(sOutFile, '.')) != NULL)
+		{
+			*p = '\0';
+		}
+		sprintf(pLSParams->sParamDumpFile, "%s_param.csv", sOutFile);
+		/* threads would talk over each other */
+		pLSParams->bQuiet = 1;
+		sBatch.nLS++;
+	}
+	nThreads = pParams->nThreads > 0 ? pParams->nThreads : numProcessors();
+	if (retVal)
+	{
+		fprintf(stdout, "runBatch(): %d landscapes on %d threads\n", sBatch.nLS, nThreads);
+		mutexInit(&sBatch.sLock);
+		condInit(&sBatch.sChanged);
+		retVal = runInParallel(nThreads, nThreads, batchWorker, &sBatch);
+		condDestroy(&sBatch.sChanged);
+		mutexDestroy(&sBatch.sLock);
+		retVal = retVal && !sBatch.bFailed;
+	}
+	/* anything left over after a failure */
+	for (i = 0; i < sBatch.nLS; i++)
+	{
+		if (sBatch.aLS[i].eState != BATCH_DONE)
+		{
+			batchRelease(&sBatch, &sBatch.aLS[i]);
+			retVal = 0;
+		}
+	}
+	if (retVal)
+	{
+		fprintf(stdout, "runBatch(): %lld events in %.1f seconds\n", sBatch.nEvents, wallClockSeconds() - dStartTime);
+	}
+	free(sBatch.aLS);
+	for (i = 0; i < nFiles; i++)
+	{
+		free(aFiles[i]);
+	}
+	free(aFiles);
+	return retVal;
+}
+
+/*
+	read a set of edits to a landscape: a header line, then one edit per line, as
+		add,x,y,type		a new host
+		remove,hostID		take a host out
+		type,hostID,type	change a host's type
+	where hostID is the host's ID in the base landscape's xyFile (its line in the file,
+	counting the first host as 0, as in dumpHostStatus output)
+*/
+int readHostEdits(const char *sFile, t_HostEdit **paEdits, int *pnEdits)
+{
+	FILE		*fIn;
+	char		sLine[_MAX_STR_LEN];
+	char		*aTok[5], *p, *pEnd;
+	t_HostEdit	*aEdits, *pEdit;
+	int			nAlloc, nLine, nTok, retVal;
+
+	*paEdits = NULL;
+	*pnEdits = 0;
+	fIn = fopen(sFile, "rb");
+	if (!fIn)
+	{
+		fprintf(stderr, "readHostEdits(): Couldn't open %s\n", sFile);
+		return 0;
+	}
+	retVal = 1;
+	aEdits = NULL;
+	nAlloc = 0;
+	nLine = 0;
+	while (retVal && fgets(sLine, sizeof(sLine), fIn))
+	{
+		nLine++;
+		nTok = 0;
+		p = strtok(sLine, ", \t\r\n");
+		while (p && nTok < 5)
+		{
+			aTok[nTok++] = p;
+			p = strtok(NULL, ", \t\r\n");
+		}
+		/* the header, or a blank line */
+		if (nLine == 1 || nTok == 0)
+		{
+			continue;
+		}
+		if (*pnEdits == nAlloc)
+		{
+			nAlloc = nAlloc ? 2 * nAlloc : 64;
+			pEdit = realloc(aEdits, sizeof(t_HostEdit) * nAlloc);
+			if (!pEdit)
+			{
+				fprintf(stderr, "readHostEdits(): Out of memory\n");
+				retVal = 0;
+				break;
+			}
+			aEdits = pEdit;
+		}
+		pEdit = &aEdits[*pnEdits];
+		memset(pEdit, 0, sizeof(t_HostEdit));
+		pEnd = "";
+		if (strcmp(aTok[0], "add") == 0 && nTok == 4)
+		{
+			pEdit->eEdit = EDIT_ADD;
+			pEdit->dX = strtod(aTok[1], &pEnd);
+			retVal = (*pEnd == '\0');
+			pEdit->dY = strtod(aTok[2], &pEnd);
+			retVal = retVal && (*pEnd == '\0');
+			pEdit->eType = (int)strtol(aTok[3], &pEnd, 10);
+		}
+		else if (strcmp(aTok[0], "remove") == 0 && nTok == 2)
+		{
+			pEdit->eEdit = EDIT_REMOVE;
+			pEdit->nHostID = (int)strtol(aTok[1], &pEnd, 10);
+		}
+		else if (strcmp(aTok[0], "type") == 0 && nTok == 3)
+		{
+			pEdit->eEdit = EDIT_RETYPE;
+			pEdit->nHostID = (int)strtol(aTok[1], &pEnd, 10);
+			retVal = (*pEnd == '\0');
+			pEdit->eType = (int)strtol(aTok[2], &pEnd, 10);
+		}
+		else
+		{
+			retVal = 0;
+		}
+		retVal = retVal && (*pEnd == '\0')
+			&& (pEdit->eEdit == EDIT_REMOVE || pEdit->eType == TYPE_I || pEdit->eType == TYPE_II);
+		if (!retVal)
+		{
+			fprintf(stderr, "readHostEdits(): Line %d of %s isn't add,x,y,type or remove,hostID or type,hostID,type\n", nLine, sFile);
+		}
+		else
+		{
+			(*pnEdits)++;
+		}
+	}
+	fclose(fIn);
+	if (!retVal)
+	{
+		free(aEdits);
+		aEdits = NULL;
+		*pnEdits = 0;
+	}
+	*paEdits = aEdits;
+	return retVal;
+}
+
+/*
+	the landscape made by applying aEdits[] to pBase: the hosts kept come first, in the
+	order they were in in pBase (so still sorted, if they were), then the ones added; each
+	has the ID it had in pBase's xyFile, and added ones IDs after those in the order they
+	were added. Also where each host was in pBase (_NOT_SET if added)
+*/
+int editHosts(t_Hosts *pBase, t_HostEdit *aEdits, int nEdits, t_Hosts *pHosts, int **paBaseHost, int *pnKept)
+{
+	int		*aNewHost;	/* where each host in pBase ends up (_NOT_SET if removed) */
+	int		i, k, n, nAdded, nKept, retVal;
+
+	memset(pHosts, 0, sizeof(t_Hosts));
+	*paBaseHost = NULL;
+	aNewHost = calloc(pBase->nHosts, sizeof(int));
+	if (!aNewHost)
+	{
+		fprintf(stderr, "editHosts(): Out of memory\n");
+		return 0;
+	}
+	/* removals first, so hosts can be changed in any order */
+	retVal = 1;
+	nAdded = 0;
+	for (n = 0; retVal && n < nEdits; n++)
+	{
+		if (aEdits[n].eEdit == EDIT_ADD)
+		{
+			nAdded++;
+			continue;
+		}
+		retVal = (aEdits[n].nHostID >= 0 && aEdits[n].nHostID < pBase->nHosts);
+		if (!retVal)
+		{
+			fprintf(stderr, "editHosts(): There is no host %d (hosts are 0 to %d)\n", aEdits[n].nHostID, pBase->nHosts - 1);
+			break;
+		}
+		i = pBase->aSortedID ? pBase->aSortedID[aEdits[n].nHostID] : aEdits[n].nHostID;
+		if (aEdits[n].eEdit == EDIT_REMOVE && aNewHost[i] == _NOT_SET)
+		{
+			fprintf(stderr, "editHosts(): Host %d is removed twice\n", aEdits[n].nHostID);
+			retVal = 0;
+		}
+		else if (aEdits[n].eEdit == EDIT_REMOVE)
+		{
+			aNewHost[i] = _NOT_SET;
+		}
+	}
+	nKept = 0;
+	for (i = 0; i < pBase->nHosts; i++)
+	{
+		nKept += (aNewHost[i] != _NOT_SET);
+	}
+	pHosts->nHosts = nKept + nAdded;
+	if (retVal && pHosts->nHosts == 0)
+	{
+		fprintf(stderr, "editHosts(): No hosts are left\n");
+		retVal = 0;
+	}
+	if (retVal)
+	{
+		pHosts->aHosts = malloc(sizeof(t_SingleHost) * pHosts->nHosts);
+		pHosts->nAlloc = pHosts->nHosts;
+		pHosts->aOrigID = malloc(sizeof(int) * pHosts->nHosts);
+		pHosts->aSortedID = malloc(sizeof(int) * pHosts->nHosts);
+		*paBaseHost = malloc(sizeof(int) * pHosts->nHosts);
+		retVal = (pHosts->aHosts && pHosts->aOrigID && pHosts->aSortedID && *paBaseHost);
+		if (!retVal)
+		{
+			fprintf(stderr, "editHosts(): Out of memory\n");
+		}
+	}
+	if (retVal)
+	{
+		k = 0;
+		for (i = 0; i < pBase->nHosts; i++)
+		{
+			if (aNewHost[i] != _NOT_SET)
+			{
+				aNewHost[i] = k;
+				pHosts->aHosts[k] = pBase->aHosts[i];
+				pHosts->aOrigID[k] = pBase->aOrigID ? pBase->aOrigID[i] : i;
+				(*paBaseHost)[k] = i;
+				k++;
+			}
+		}
+		for (n = 0; retVal && n < nEdits; n++)
+		{
+			if (aEdits[n].eEdit == EDIT_ADD)
+			{
+				pHosts->aHosts[k].dX = aEdits[n].dX;
+				pHosts->aHosts[k].dY = aEdits[n].dY;
+				pHosts->aHosts[k].eType = aEdits[n].eType;
+				pHosts->aOrigID[k] = pBase->nHosts + k - nKept;
+				(*paBaseHost)[k] = _NOT_SET;
+				k++;
+			}
+			else if (aEdits[n].eEdit == EDIT_RETYPE)
+			{
+				i = pBase->aSortedID ? pBase->aSortedID[aEdits[n].nHostID] : aEdits[n].nHostID;
+				if (aNewHost[i] == _NOT_SET)
+				{
+					fprintf(stderr, "editHosts(): Host %d is removed, so can't change type\n", aEdits[n].nHostID);
+					retVal = 0;
+				}
+				else
+				{
+					pHosts->aHosts[aNewHost[i]].eType = aEdits[n].eType;
+				}
+			}
+		}
+		/* the edited landscape's host file would be pBase's less those removed, then those added */
+		k = 0;
+		for (n = 0; n < pBase->nHosts; n++)
+		{
+			i = pBase->aSortedID ? pBase->aSortedID[n] : n;
+			if (aNewHost[i] != _NOT_SET)
+			{
+				pHosts->aSortedID[k++] = aNewHost[i];
+			}
+		}
+		for (i = nKept; i < pHosts->nHosts; i++)
+		{
+			pHosts->aSortedID[k++] = i;
+		}
+	}
+	free(aNewHost);
+	*pnKept = nKept;
+	return retVal && indexHostTypes(pHosts);
+}
+
+/*
+	kernel of an edited landscape from its base landscape's: only that between the added
+	hosts and every host is worked out, the rest being looked up in pBase (see getKernel()).
+	A grid kernel, the infective engine's alias tables and the dense kernel lanes > 1 read
+	directly are built afresh instead
+*/
+int editKernel(t_Params *pParams, t_Hosts *pBaseHosts, t_Kernel *pBase, t_Hosts *pHosts, int *aBaseHost, int nKept, t_Kernel *pKernel)
+{
+	t_KernelEdit	*pEdit;
+	double			dx, dy;
+	int				i, j, nAdded, bNear;
+
+	memset(pKernel, 0, sizeof(t_Kernel));
+	if (pBase->nGrid > 0 || pParams->eEngine == ENGINE_INFECTIVES || pParams->nLanes > 1)
+	{
+		echoToScreen(pParams, "Building the kernel of the edited landscape afresh\n");
+		return calcKernel(pParams, pHosts, pKernel);
+	}
+	pKernel->eStore = STORE_EDITED;
+	pKernel->pSpec = pBase->pSpec;
+	pKernel->dNorm = pBase->dNorm;
+	pKernel->pEdit = pEdit = calloc(1, sizeof(t_KernelEdit));
+	nAdded = pHosts->nHosts - nKept;
+	if (pEdit)
+	{
+		pEdit->pBase = pBase;
+		pEdit->pBaseHosts = pBaseHosts;
+		pEdit->aBaseHost = aBaseHost;
+		pEdit->nKept = nKept;
+		pEdit->aAddedKernel = malloc(sizeof(double) * (nAdded > 0 ? (size_t)nAdded * pHosts->nHosts : 1));
+	}
+	if (!pEdit || !pEdit->aAddedKernel)
+	{
+		fprintf(stderr, "editKernel(): Out of memory\n");
+		return 0;
+	}
+	for (i = nKept; i < pHosts->nHosts; i++)
+	{
+		for (j = 0; j < pHosts->nHosts; j++)
+		{
+			dx = pHosts->aHosts[i].dX - pHosts->aHosts[j].dX;
+			dy = pHosts->aHosts[i].dY - pHosts->aHosts[j].dY;
+			/* truncated as the rest of a sparse kernel is */
+			bNear = (pBase->eStore != STORE_SPARSE || dx * dx + dy * dy <= pBase->dCutoff * pBase->dCutoff);
+			pEdit->aAddedKernel[(size_t)(i - nKept) * pHosts->nHosts + j] = bNear ? pKernel->pSpec->pfPair(i, j, pKernel, pHosts, pParams) : 0.0;
+		}
+	}
+	return 1;
+}
+
+/*
+	set up pHosts and pKernel as the landscape made by applying aEdits[] to pBaseHosts,
+	whose kernel is pBaseKernel, without working out the kernel between hosts they share
+	again; the base landscape must be kept until these are freed (with freeMemory())
+*/
+int applyHostEdits(t_Params *pParams, t_Hosts *pBaseHosts, t_Kernel *pBaseKernel, t_HostEdit *aEdits, int nEdits, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int		*aBaseHost;
+	int		nKept, retVal;
+
+	memset(pKernel, 0, sizeof(t_Kernel));
+	retVal = editHosts(pBaseHosts, aEdits, nEdits, pHosts, &aBaseHost, &nKept)
+		&& editKernel(pParams, pBaseHosts, pBaseKernel, pHosts, aBaseHost, nKept, pKernel);
+	/* only kept if the kernel is looked up through it */
+	if (!pKernel->pEdit)
+	{
+		free(aBaseHost);
+	}
+	return retVal;
+}
+
+/*
+	run each set of edits in pParams->sEditFiles on the landscape in pBaseHosts, whose
+	kernel is pBaseKernel, one after another, each writing its own outFile (named as in
+	batch mode)
+*/
+int runEdits(t_Params *pParams, t_Hosts *pBaseHosts, t_Kernel *pBaseKernel)
+{
+	t_Params	sParams;
+	t_Hosts		sHosts;
+	t_Kernel	sKernel;
+	t_HostEdit	*aEdits;
+	char		**aFiles;
+	char		sOutFile[_MAX_STR_LEN * 2 + 32];
+	char		*p;
+	int			i, nFiles, nEdits, retVal;
+	double		dStartTime;
+
+	if (!expandFileList(pParams->sEditFiles, &aFiles, &nFiles))
+	{
+		fprintf(stderr, "runEdits(): Couldn't make list of edit files from %s\n", pParams->sEditFiles);
+		return 0;
+	}
+	retVal = 1;
+	for (i = 0; retVal && i < nFiles; i++)
+	{
+		dStartTime = wallClockSeconds();
+		memcpy(&sParams, pParams, sizeof(t_Params));
+		batchOutFileName(sOutFile, pParams->sOutFile, aFiles[i]);
+		if (strlen(aFiles[i]) >= _MAX_STR_LEN || strlen(sOutFile) + 16 >= _MAX_STR_LEN)
+		{
+			fprintf(stderr, "runEdits(): File name too long for %s\n", aFiles[i]);
+			retVal = 0;
+			break;
+		}
+		strcpy(sParams.sEditFile, aFiles[i]);
+		strcpy(sParams.sOutFile, sOutFile);
+		if ((p = strrchr(sOutFile, '.')) != NULL)
+		{
+			*p = '\0';
+		}
+		sprintf(sParams.sParamDumpFile, "%s_param.csv", sOutFile);
+		sprintf(sParams.sCheckpointFile, "%s_checkpoint.bin", sOutFile);
+		sParams.sKernelFile[0] = '\0';		/* that's the base landscape's */
+		memset(&sHosts, 0, sizeof(t_Hosts));
+		aEdits = NULL;
+		retVal = readHostEdits(aFiles[i], &aEdits, &nEdits)
+			&& applyHostEdits(&sParams, pBaseHosts, pBaseKernel, aEdits, nEdits, &sHosts, &sKernel);
+		if (retVal)
+		{
+			fprintf(stdout, "runEdits(): %s, %d edits giving %d hosts, set up in %.3f seconds\n", aFiles[i], nEdits, sHosts.nHosts,
+				wallClockSeconds() - dStartTime);
+			retVal = dumpParametersToCSV(&sParams) && runEpidemics(&sParams, &sHosts, &sKernel, NULL);
+		}
+		if (retVal)
+		{
+			fprintf(stdout, "runEdits(): Finished %s in %.1f seconds\n", sParams.sOutFile, wallClockSeconds() - dStartTime);
+		}
+		freeMemory(&sHosts, &sKernel);
+		free(aEdits);
+	}
+	for (i = 0; i < nFiles; i++)
+	{
+		free(aFiles[i]);
+	}
+	free(aFiles);
+	return retVal;
+}
+
+#ifndef _EPIDEMICSIM_NO_MAIN	/* defined when other programs build on top of this file (e.g. EpidemicBench.c) */
+/*
+	main routine
+*/
+int main(int argc, char **argv)
+{
+	t_Params	sParams;
+	t_Hosts		sHosts;
+	t_Kernel	sKernel;
+	int			retVal;
+
+	memset(&sParams, 0, sizeof(t_Params));
+	memset(&sHosts, 0, sizeof(t_Hosts));
+	memset(&sKernel, 0, sizeof(t_Kernel));
+#if 0
+	if (!setParams(&sParams))
+	{
+		fprintf(stderr, "Error in setParams()\nExiting\n");
+	}
+#endif
+	if (!(retVal = readParams(&sParams, argc, argv)))
+	{
+		fprintf(stderr, "Error in readParams()\nExiting\n");
+	}
+	if (retVal)
+	{
+		threadsPinWorkers(sParams.bNumaPlacement);
+	}
+	if (retVal && sParams.nSeed == 0)
+	{
+		/* replicates are seeded from this, which is a combination of time and procID */
+		sParams.nSeed = (int)(seedRandom(0) & 0x7fffffff);
+	}
+	if (retVal && sParams.sBatchXYFiles[0])
+	{
+		if (!(retVal = runBatch(&sParams)))
+		{
+			fprintf(stderr, "Error in runBatch()\nExiting\n");
+		}
+		return retVal ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (retVal && !(retVal = loadHosts(&sParams, &sHosts)))
+	{
+		fprintf(stderr, "Error in loadHosts()\nExiting\n");
+	}
+	if (retVal && !(retVal = calcKernel(&sParams, &sHosts, &sKernel)))
+	{
+		fprintf(stderr, "Error in calcKernel()\nExiting\n");
+	}
+	if (retVal && sParams.sEditFiles[0])
+	{
+		if (!(retVal = runEdits(&sParams, &sHosts, &sKernel)))
+		{
+			fprintf(stderr, "Error in runEdits()\nExiting\n");
+		}
+	}
+	else if (retVal && !(retVal = runEpidemics(&sParams, &sHosts, &sKernel, NULL)))
+	{
+		fprintf(stderr, "Error in runEpidemics()\nExiting\n");
+	}
+	/* free all memory from dynamically allocated structures */
+	freeMemory(&sHosts, &sKernel);
+
+	if (retVal == 0)
+		return(EXIT_FAILURE);
+	return(EXIT_SUCCESS);
+}
+#endif
@@ -0,0 +1,166 @@
+/*
+	Loops over pairs of hosts, specialised for one dispersal kernel
+
+	This is included by EpidemicSim.c once for each kernel in the registry (see
+	aKernelSpecs[]), so deliberately has no include guard. Before including it define
+		KERNEL_NAME					suffix for the generated functions
+		KERNEL_EVAL(d2,a,c,norm)	the kernel at squared distance d2, for dispA=a, dispC=c,
+									and norm from the kernel's own normalising function
+	both of which are undefined again at the end. KERNEL_EVAL() should (void) cast any
+	argument its kernel doesn't use, or the variables passed in are set but not used.
+
+	The kernel is then inlined into each loop, rather than called through the
+	registry for every pair of hosts.
+*/
+
+#ifndef KERNEL_FN
+#define	KERNEL_PASTE(f,n)	f##_##n
+#define	KERNEL_EXPAND(f,n)	KERNEL_PASTE(f,n)
+#define	KERNEL_FN(f)		KERNEL_EXPAND(f,KERNEL_NAME)
+#endif
+
+double KERNEL_FN(evalKernel)(double d2, double dA, double dC, double dNorm)
+{
+	return KERNEL_EVAL(d2, dA, dC, dNorm);
+}
+
+/*
+	exact kernel between two hosts, the same as the full matrix has in it
+*/
+double KERNEL_FN(pairKernel)(int hostOne, int hostTwo, t_Kernel *pKernel, t_Hosts *pHosts, t_Params *pParams)
+{
+	double	dx, dy;
+
+	if (hostOne == hostTwo)
+	{
+		return 0.0;
+	}
+	dx = pHosts->aHosts[hostOne].dX - pHosts->aHosts[hostTwo].dX;
+	dy = pHosts->aHosts[hostOne].dY - pHosts->aHosts[hostTwo].dY;
+	return KERNEL_EVAL(dx * dx + dy * dy, pParams->dA, pParams->dC, pKernel->dNorm);
+}
+
+/*
+	fill in the full kernel between distinct hosts (calcKernel() sets the diagonal)
+
+	note copies top triangle to the bottom rather than recalculating
+*/
+void KERNEL_FN(buildKernel)(t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int				i, j, nHosts;
+	double			dA, dC, dNorm, dx, dy, k;
+	double			*aKernel;
+	t_SingleHost	*aHosts;
+
+	/* copied out, as the compiler can't tell writes to aKernel[] leave them alone */
+	dA = pParams->dA;
+	dC = pParams->dC;
+	dNorm = pKernel->dNorm;
+	aKernel = pKernel->aKernel;
+	aHosts = pHosts->aHosts;
+	nHosts = pHosts->nHosts;
+	for (i = 0; i < nHosts; i++)
+	{
+		for (j = 0; j < i; j++)
+		{
+			dx = aHosts[i].dX - aHosts[j].dX;
+			dy = aHosts[i].dY - aHosts[j].dY;
+			k = KERNEL_EVAL(dx * dx + dy * dy, dA, dC, dNorm);
+			aKernel[posFromHostIDs(i, j, nHosts)] = k;
+			aKernel[posFromHostIDs(j, i, nHosts)] = k;
+		}
+	}
+}
+
+/*
+	kernel from thisHost to every host (zero onto itself)
+*/
+void KERNEL_FN(kernelRow)(int thisHost, double *aRow, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int				j, nHosts;
+	double			dA, dC, dNorm, dX, dY, dx, dy;
+	t_SingleHost	*aHosts;
+
+	dA = pParams->dA;
+	dC = pParams->dC;
+	dNorm = pKernel->dNorm;
+	aHosts = pHosts->aHosts;
+	nHosts = pHosts->nHosts;
+	dX = aHosts[thisHost].dX;
+	dY = aHosts[thisHost].dY;
+	for (j = 0; j < nHosts; j++)
+	{
+		dx = dX - aHosts[j].dX;
+		dy = dY - aHosts[j].dY;
+		aRow[j] = KERNEL_EVAL(dx * dx + dy * dy, dA, dC, dNorm);
+	}
+	aRow[thisHost] = 0.0;
+}
+
+/*
+	grid kernel: add thisHost's force of infection (times thisTheta, which can be negative)
+	to the susceptible hosts in near cell nCell, and the change to *pTotal (dInfectRate, or
+	a block's share of it); see spreadGridForce()
+*/
+void KERNEL_FN(spreadNearCell)(int nCell, int thisHost, double thisTheta, double *pTotal, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int				k, i;
+	double			thisRho, thisExtra, dOldRate;
+	t_HostStatus	*aHostStatus;
+
+	aHostStatus = pWork->aHostStatus;
+	for (k = pKernel->aCellStart[nCell]; k < pKernel->aCellStart[nCell + 1]; k++)
+	{
+		i = pKernel->aCellHosts[k];
+		if (aHostStatus[i].eStatus == SUSCEPTIBLE)
+		{
+			thisRho = pParams->dRhoOne;
+			if (pHosts->aHosts[i].eType == TYPE_II)
+			{
+				thisRho = pParams->dRhoTwo;
+			}
+			thisExtra = thisTheta * thisRho * KERNEL_FN(pairKernel)(i, thisHost, pKernel, pHosts, pParams);
+			dOldRate = aHostStatus[i].dRate;
+			aHostStatus[i].dRate += thisExtra;
+			if (aHostStatus[i].dRate < 0.0)
+			{
+				aHostStatus[i].dRate = 0.0;
+			}
+			pWork->aCellRate[nCell] += aHostStatus[i].dRate - dOldRate;
+			*pTotal += thisExtra;
+		}
+	}
+}
+
+/*
+	grid kernel: susceptible thisHost (with susceptibility thisRho) feels the force of
+	infection from the infected hosts in near cell nCell; see gatherGridForce()
+*/
+void KERNEL_FN(gatherNearCell)(int nCell, int thisHost, double thisRho, t_Workspace *pWork, t_Params *pParams, t_Hosts *pHosts, t_Kernel *pKernel)
+{
+	int				k, j, thisCell;
+	double			thisTheta, thisExtra;
+	t_HostStatus	*aHostStatus;
+
+	aHostStatus = pWork->aHostStatus;
+	thisCell = pKernel->aHostCell[thisHost];
+	for (k = pKernel->aCellStart[nCell]; k < pKernel->aCellStart[nCell + 1]; k++)
+	{
+		j = pKernel->aCellHosts[k];
+		if (aHostStatus[j].eStatus == INFECTED && aHostStatus[j].nGen < pParams->nMaxGen)
+		{
+			thisTheta = pParams->dThetaOne;
+			if (pHosts->aHosts[j].eType == TYPE_II)
+			{
+				thisTheta = pParams->dThetaTwo;
+			}
+			thisExtra = thisTheta * thisRho * KERNEL_FN(pairKernel)(j, thisHost, pKernel, pHosts, pParams);
+			aHostStatus[thisHost].dRate += thisExtra;
+			pWork->aCellRate[thisCell] += thisExtra;
+			pWork->dInfectRate += thisExtra;
+		}
+	}
+}
+
+#undef KERNEL_NAME
+#undef KERNEL_EVAL
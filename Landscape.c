@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "Landscape.h"
+
+/* allow Visual Studio to compile ANSI C containing strcpy */
+#pragma warning(disable : 4996)
+
+#define	_LS_MAX_STR_LEN		1024
+#define	_LS_PI				3.1415926535897932384626433
+
+/*
+	uniform number on (0,1), so it is always safe to take logs
+*/
+double	lsUniform(mt_state *pRNG)
+{
+	return genrand_real3_r(pRNG);
+}
+
+/*
+	standard normal deviate (polar Box-Muller, discarding the second value
+	so that nothing is cached outside the generator state)
+*/
+double	lsNormal(mt_state *pRNG)
+{
+	double	u, v, s;
+
+	do
+	{
+		u = 2.0 * lsUniform(pRNG) - 1.0;
+		v = 2.0 * lsUniform(pRNG) - 1.0;
+		s = u*u + v*v;
+	} while (s >= 1.0 || s == 0.0);
+	return u * sqrt(-2.0 * log(s) / s);
+}
+
+/*
+	Poisson deviate
+
+	multiplication of uniforms for small means, otherwise the PTRS
+	transformed rejection method of Hormann (1993), since cluster sizes
+	for big landscapes have means in the tens of thousands
+*/
+int		lsPoisson(mt_state *pRNG, double dMean)
+{
+	int		k;
+	double	dL, dP;
+	double	dSqrtLam, dLogLam, a, b, dInvAlpha, dVr, u, v, us;
+
+	if (dMean <= 0.0)
+	{
+		return 0;
+	}
+	if (dMean < 10.0)
+	{
+		dL = exp(-dMean);
+		k = 0;
+		dP = lsUniform(pRNG);
+		while (dP > dL)
+		{
+			k++;
+			dP *= lsUniform(pRNG);
+		}
+		return k;
+	}
+	dSqrtLam = sqrt(dMean);
+	dLogLam = log(dMean);
+	b = 0.931 + 2.53 * dSqrtLam;
+	a = -0.059 + 0.02483 * b;
+	dInvAlpha = 1.1239 + 1.1328 / (b - 3.4);
+	dVr = 0.9277 - 3.6224 / (b - 2.0);
+	for (;;)
+	{
+		u = lsUniform(pRNG) - 0.5;
+		v = lsUniform(pRNG);
+		us = 0.5 - fabs(u);
+		k = (int)floor((2.0 * a / us + b) * u + dMean + 0.43);
+		if (us >= 0.07 && v <= dVr)
+		{
+			return k;
+		}
+		if (k < 0 || (us < 0.013 && v > us))
+		{
+			continue;
+		}
+		if (log(v) + log(dInvAlpha) - log(a / (us*us) + b) <= -dMean + k*dLogLam - lgamma(k + 1.0))
+		{
+			return k;
+		}
+	}
+}
+
+/*
+	draw cluster numbers, widths and scale factor in the same way as create_LS.R
+*/
+void	drawLandscapeSpec(t_LSSpec *pSpec, int nNumOne, int nNumTwo, mt_state *pRNG)
+{
+	pSpec->nNumOne = nNumOne;
+	pSpec->nNumTwo = nNumTwo;
+	pSpec->nClustersOne = 1 + (int)ceil(9.0 * lsUniform(pRNG));
+	pSpec->nClustersTwo = 1 + (int)ceil(9.0 * lsUniform(pRNG));
+	pSpec->dWidthOne = 0.025 + 0.175 * lsUniform(pRNG);
+	pSpec->dWidthTwo = 0.025 + 0.175 * lsUniform(pRNG);
+	if (lsUniform(pRNG) < 0.5)
+	{
+		pSpec->dScale = 0.1 + 0.9 * lsUniform(pRNG);
+	}
+	else
+	{
+		pSpec->dScale = 1.0 + 4.0 * lsUniform(pRNG);
+	}
+	pSpec->dXMax = 1.0;
+	pSpec->dYMax = 1.0;
+}
+
+/*
+	lay down the hosts of one type, starting at aPoints[0]
+*/
+static int	makePoints(t_LSSpec *pSpec, int nPoints, int nClusters, double dWidth, int eType, t_LSPoint *aPoints, mt_state *pRNG)
+{
+	int		*aSizes;
+	int		i, j, nSum, thisIDX, bGoodClusters;
+	double	dCentreX, dCentreY, dSD;
+
+	if (nPoints <= 0)
+	{
+		return 1;
+	}
+	if (nClusters < 1)
+	{
+		nClusters = 1;
+	}
+	aSizes = malloc(sizeof(int) * nClusters);
+	if (!aSizes)
+	{
+		fprintf(stderr, "makePoints(): Out of memory\n");
+		return 0;
+	}
+	/* cluster sizes are Poisson, with the last one soaking up the remainder */
+	bGoodClusters = 0;
+	while (!bGoodClusters)
+	{
+		nSum = 0;
+		for (i = 0; i < nClusters - 1; i++)
+		{
+			aSizes[i] = lsPoisson(pRNG, (double)nPoints / nClusters);
+			nSum += aSizes[i];
+		}
+		if (nSum < nPoints)
+		{
+			aSizes[nClusters - 1] = nPoints - nSum;
+			bGoodClusters = 1;
+		}
+	}
+	dSD = dWidth * pSpec->dScale;
+	thisIDX = 0;
+	for (i = 0; i < nClusters; i++)
+	{
+		dCentreX = pSpec->dXMax * pSpec->dScale * lsUniform(pRNG);
+		dCentreY = pSpec->dYMax * pSpec->dScale * lsUniform(pRNG);
+		for (j = 0; j < aSizes[i]; j++)
+		{
+			aPoints[thisIDX].dX = dCentreX + dSD * lsNormal(pRNG);
+			aPoints[thisIDX].dY = dCentreY + dSD * lsNormal(pRNG);
+			aPoints[thisIDX].eType = eType;
+			thisIDX++;
+		}
+	}
+	free(aSizes);
+	return 1;
+}
+
+/*
+	make a complete two-type landscape: type 1 hosts first, then type 2
+*/
+int		makeLandscape(t_LSSpec *pSpec, t_Landscape *pLS, mt_state *pRNG)
+{
+	int		retVal;
+
+	pLS->nPoints = pSpec->nNumOne + pSpec->nNumTwo;
+	pLS->aPoints = malloc(sizeof(t_LSPoint) * (pLS->nPoints > 0 ? pLS->nPoints : 1));
+	if (!pLS->aPoints)
+	{
+		fprintf(stderr, "makeLandscape(): Out of memory\n");
+		pLS->nPoints = 0;
+		return 0;
+	}
+	retVal = makePoints(pSpec, pSpec->nNumOne, pSpec->nClustersOne, pSpec->dWidthOne, 1, pLS->aPoints, pRNG);
+	if (retVal)
+	{
+		retVal = makePoints(pSpec, pSpec->nNumTwo, pSpec->nClustersTwo, pSpec->dWidthTwo, 2, pLS->aPoints + pSpec->nNumOne, pRNG);
+	}
+	if (!retVal)
+	{
+		freeLandscape(pLS);
+	}
+	return retVal;
+}
+
+void	freeLandscape(t_Landscape *pLS)
+{
+	if (pLS->aPoints)
+	{
+		free(pLS->aPoints);
+	}
+	pLS->aPoints = NULL;
+	pLS->nPoints = 0;
+}
+
+/*
+	write out <stub>_xy.csv and <stub>_meta.csv in the same format as create_LS.R
+	(the meta file additionally records the scale factor)
+*/
+int		writeLandscapeCSV(t_LSSpec *pSpec, t_Landscape *pLS, char *szStub)
+{
+	char	sFile[_LS_MAX_STR_LEN];
+	FILE	*fOut;
+	int		i;
+
+	sprintf(sFile, "%s_meta.csv", szStub);
+	fOut = fopen(sFile, "wb");
+	if (!fOut)
+	{
+		fprintf(stderr, "writeLandscapeCSV(): Could not open %s\n", sFile);
+		return 0;
+	}
+	fprintf(fOut, "N1,c1,w1,N2,c2,w2,scale\n");
+	fprintf(fOut, "%d,%d,%.15g,%d,%d,%.15g,%.15g\n",
+		pSpec->nNumOne, pSpec->nClustersOne, pSpec->dWidthOne,
+		pSpec->nNumTwo, pSpec->nClustersTwo, pSpec->dWidthTwo,
+		pSpec->dScale);
+	fclose(fOut);
+
+	sprintf(sFile, "%s_xy.csv", szStub);
+	fOut = fopen(sFile, "wb");
+	if (!fOut)
+	{
+		fprintf(stderr, "writeLandscapeCSV(): Could not open %s\n", sFile);
+		return 0;
+	}
+	fprintf(fOut, "x,y,t\n");
+	for (i = 0; i < pLS->nPoints; i++)
+	{
+		fprintf(fOut, "%.15g,%.15g,%d\n", pLS->aPoints[i].dX, pLS->aPoints[i].dY, pLS->aPoints[i].eType);
+	}
+	fclose(fOut);
+	return 1;
+}
+
+/*
+	write out <stub>_ORing_<ij>.csv, the density of type j hosts at distance r from a type i host
+
+	create_LS.R gets this from the derivative of a spline fitted to the
+	uncorrected K function (spatstat::Kcross); here the derivative of the
+	pair count is instead smoothed directly with a Gaussian over bins.
+	Radii and normalisation (n-1 for pairs of the same type) match create_LS.R.
+*/
+int		writeORingCSV(t_Landscape *pLS, char *szStub, int nR, double dSmoothBins)
+{
+	char	sFile[_LS_MAX_STR_LEN];
+	FILE	*fOut;
+	double	*aCounts, *pCounts;
+	double	dMinX, dMaxX, dMinY, dMaxY, dRMax, dStep, d, dx, dy;
+	double	dR, dCentre, dW, dSum, dWeight, dDensity, dNorm;
+	int		aNum[3];
+	int		i, j, k, m, nFrom, nTo, nWindow, retVal;
+
+	if (pLS->nPoints < 2 || nR < 2)
+	{
+		fprintf(stderr, "writeORingCSV(): Need at least two hosts and two radii\n");
+		return 0;
+	}
+	aNum[1] = aNum[2] = 0;
+	dMinX = dMaxX = pLS->aPoints[0].dX;
+	dMinY = dMaxY = pLS->aPoints[0].dY;
+	for (i = 0; i < pLS->nPoints; i++)
+	{
+		aNum[pLS->aPoints[i].eType]++;
+		dMinX = (pLS->aPoints[i].dX < dMinX) ? pLS->aPoints[i].dX : dMinX;
+		dMaxX = (pLS->aPoints[i].dX > dMaxX) ? pLS->aPoints[i].dX : dMaxX;
+		dMinY = (pLS->aPoints[i].dY < dMinY) ? pLS->aPoints[i].dY : dMinY;
+		dMaxY = (pLS->aPoints[i].dY > dMaxY) ? pLS->aPoints[i].dY : dMaxY;
+	}
+	dRMax = sqrt((dMaxX - dMinX)*(dMaxX - dMinX) + (dMaxY - dMinY)*(dMaxY - dMinY));
+	dStep = dRMax / (nR - 1);
+	if (dStep <= 0.0)
+	{
+		fprintf(stderr, "writeORingCSV(): All hosts are at the same location\n");
+		return 0;
+	}
+	/* histogram of (ordered) pair distances for each of 11, 12, 21, 22; bin k is (r[k-1],r[k]] */
+	aCounts = calloc(4 * nR, sizeof(double));
+	if (!aCounts)
+	{
+		fprintf(stderr, "writeORingCSV(): Out of memory\n");
+		return 0;
+	}
+	for (i = 0; i < pLS->nPoints; i++)
+	{
+		for (j = i + 1; j < pLS->nPoints; j++)
+		{
+			dx = pLS->aPoints[i].dX - pLS->aPoints[j].dX;
+			dy = pLS->aPoints[i].dY - pLS->aPoints[j].dY;
+			d = sqrt(dx*dx + dy*dy);
+			k = (int)ceil(d / dStep);
+			if (k < 1)
+			{
+				k = 1;
+			}
+			if (k < nR)
+			{
+				aCounts[nR * (2 * (pLS->aPoints[i].eType - 1) + pLS->aPoints[j].eType - 1) + k] += 1.0;
+				aCounts[nR * (2 * (pLS->aPoints[j].eType - 1) + pLS->aPoints[i].eType - 1) + k] += 1.0;
+			}
+		}
+	}
+	retVal = 1;
+	nWindow = (int)ceil(4.0 * dSmoothBins) + 1;
+	for (nFrom = 1; retVal && nFrom <= 2; nFrom++)
+	{
+		for (nTo = 1; retVal && nTo <= 2; nTo++)
+		{
+			pCounts = aCounts + nR * (2 * (nFrom - 1) + nTo - 1);
+			dNorm = (nFrom == nTo) ? (aNum[nFrom] - 1) : aNum[nFrom];
+			sprintf(sFile, "%s_ORing_%d%d.csv", szStub, nFrom, nTo);
+			fOut = fopen(sFile, "wb");
+			if (!fOut)
+			{
+				fprintf(stderr, "writeORingCSV(): Could not open %s\n", sFile);
+				retVal = 0;
+				break;
+			}
+			fprintf(fOut, "r,oRing,oRing2PiR\n");
+			for (k = 0; k < nR; k++)
+			{
+				dR = k * dStep;
+				dDensity = 0.0;
+				if (k > 0 && dNorm > 0.0)
+				{
+					/* Gaussian smooth of pair counts per unit distance, renormalised at the edges */
+					dSum = dWeight = 0.0;
+					for (m = k - nWindow; m <= k + nWindow; m++)
+					{
+						if (m >= 1 && m < nR)
+						{
+							dCentre = (m - 0.5) * dStep;
+							dW = (dSmoothBins > 0.0) ? exp(-0.5 * pow((dR - dCentre) / (dSmoothBins * dStep), 2)) : (m == k);
+							dSum += dW * pCounts[m];
+							dWeight += dW;
+						}
+					}
+					if (dWeight > 0.0)
+					{
+						dDensity = dSum / (dWeight * dStep * dNorm);
+					}
+				}
+				/* dDensity is 2*pi*r*O(r) */
+				fprintf(fOut, "%.15g,%.15g,%.15g\n", dR, (k > 0) ? dDensity / (2.0 * _LS_PI * dR) : 0.0, dDensity);
+			}
+			fclose(fOut);
+		}
+	}
+	free(aCounts);
+	return retVal;
+}
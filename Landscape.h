@@ -0,0 +1,45 @@
+#ifndef _LANDSCAPE_H_
+#define _LANDSCAPE_H_
+
+/*
+	Clustered landscape generation (C port of makePoints() in create_LS.R)
+*/
+
+#include "mt19937ar.h"
+
+#define	_LS_ORING_POINTS	513		/* number of radii (spatstat's default) */
+#define	_LS_ORING_SMOOTH	3.0		/* s.d. of smoothing applied to pair distance density (in bins) */
+
+typedef struct {
+	double	dX;
+	double	dY;
+	int		eType;			/* 1 or 2, as in the _xy.csv files */
+} t_LSPoint;
+
+typedef struct {
+	int		nNumOne;		/* Number of type 1 hosts */
+	int		nClustersOne;	/* Number of clusters they are placed in */
+	double	dWidthOne;		/* Standard deviation of each cluster (before scaling) */
+	int		nNumTwo;		/* Same again for type 2 hosts */
+	int		nClustersTwo;
+	double	dWidthTwo;
+	double	dScale;			/* Scale factor applied to the entire landscape */
+	double	dXMax;			/* Cluster centres are uniform on [0,dXMax*dScale]x[0,dYMax*dScale] */
+	double	dYMax;
+} t_LSSpec;
+
+typedef struct {
+	t_LSPoint	*aPoints;	/* type 1 hosts first, then type 2 */
+	int			nPoints;
+} t_Landscape;
+
+double	lsUniform(mt_state *pRNG);
+double	lsNormal(mt_state *pRNG);
+int		lsPoisson(mt_state *pRNG, double dMean);
+void	drawLandscapeSpec(t_LSSpec *pSpec, int nNumOne, int nNumTwo, mt_state *pRNG);
+int		makeLandscape(t_LSSpec *pSpec, t_Landscape *pLS, mt_state *pRNG);
+void	freeLandscape(t_Landscape *pLS);
+int		writeLandscapeCSV(t_LSSpec *pSpec, t_Landscape *pLS, char *szStub);
+int		writeORingCSV(t_Landscape *pLS, char *szStub, int nR, double dSmoothBins);
+
+#endif /* _LANDSCAPE_H_ */
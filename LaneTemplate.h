@@ -0,0 +1,181 @@
+/*
+	Passes over the hosts for a lockstep batch, specialised for one number of lanes
+
+	This is included by EpidemicSim.c once for each number of lanes allowed (see
+	initLanes()), so deliberately has no include guard. Before including it define
+		LANE_WIDTH		number of lanes
+	which is undefined again at the end.
+
+	With the number of lanes fixed the loops over them have a known length, so each
+	lane's running total stays in a register, and the compiler can unroll them or
+	use SIMD instructions. Every lane is worked on in every pass: one with nothing
+	to do multiplies by zero, which changes nothing.
+*/
+
+#ifndef LANE_FN
+#define	LANE_PASTE(f,n)		f##_##n
+#define	LANE_EXPAND(f,n)	LANE_PASTE(f,n)
+#define	LANE_FN(f)			LANE_EXPAND(f,LANE_WIDTH)
+/* unrolling the loops over the lanes is most of the gain, and gcc -O2 won't otherwise */
+#ifdef __GNUC__
+#define	LANE_LOOP			_Pragma("GCC unroll 8")
+#else
+#define	LANE_LOOP
+#endif
+#endif
+
+/*
+	first host in each lane where the running total of aRate reaches aTarget (as the
+	search in runReplicate()); aHost[l] must be _NOT_SET for each lane to search
+*/
+void LANE_FN(scanLanes)(t_Lanes *pLanes, int nHosts, double *aTarget, int *aHost)
+{
+	int		i, l, nLeft;
+	double	aSum[LANE_WIDTH];
+	double	*aRate;
+
+	nLeft = 0;
+	for (l = 0; l < LANE_WIDTH; l++)
+	{
+		aSum[l] = 0.0;
+		nLeft += (aHost[l] == _NOT_SET);
+	}
+	for (i = 0; nLeft > 0 && i < nHosts; i++)
+	{
+		aRate = pLanes->aRate + (size_t)i * LANE_WIDTH;
+		LANE_LOOP
+		for (l = 0; l < LANE_WIDTH; l++)
+		{
+			aSum[l] += aRate[l];
+		}
+		LANE_LOOP
+		for (l = 0; l < LANE_WIDTH; l++)
+		{
+			if (aHost[l] == _NOT_SET && aSum[l] > aTarget[l])
+			{
+				aHost[l] = i;
+				nLeft--;
+			}
+		}
+	}
+	/* should rounding run a search off the end, it stops at the last host */
+	for (l = 0; l < LANE_WIDTH; l++)
+	{
+		if (aHost[l] == _NOT_SET)
+		{
+			aHost[l] = nHosts - 1;
+		}
+	}
+}
+
+/*
+	force of infection on the susceptible hosts changes by aTheta[l] times the kernel row
+	aRow[l] (as the loops in infectHost() and recoverHost()), and aTotal[l] with it
+*/
+void LANE_FN(spreadPass)(t_Lanes *pLanes, int nHosts, double *aTheta, double **aRow, double *aTotal)
+{
+	int		i, l;
+	double	thisExtra, dNew;
+	double	aSum[LANE_WIDTH], aMult[LANE_WIDTH];
+	double	*aRate, *aRhoSus;
+
+	for (l = 0; l < LANE_WIDTH; l++)
+	{
+		aSum[l] = aTotal[l];
+		aMult[l] = aTheta[l];
+	}
+	for (i = 0; i < nHosts; i++)
+	{
+		aRate = pLanes->aRate + (size_t)i * LANE_WIDTH;
+		aRhoSus = pLanes->aRhoSus + (size_t)i * LANE_WIDTH;
+		LANE_LOOP
+		for (l = 0; l < LANE_WIDTH; l++)
+		{
+			thisExtra = aMult[l] * aRhoSus[l] * aRow[l][i];
+			dNew = aRate[l] + thisExtra;
+			aRate[l] = (dNew < 0.0) ? 0.0 : dNew;
+			aSum[l] += thisExtra;
+		}
+	}
+	for (l = 0; l < LANE_WIDTH; l++)
+	{
+		aTotal[l] = aSum[l];
+	}
+}
+
+/*
+	SIS: a host with susceptibility aRho[l] feels the force of infection from every
+	infected host through the kernel row aRow[l] (as in recoverHost()), adding it to
+	aHostRate[l] and aTotal[l]
+*/
+void LANE_FN(gatherPass)(t_Lanes *pLanes, int nHosts, double *aRho, double **aRow, double *aHostRate, double *aTotal)
+{
+	int		j, l;
+	double	thisExtra;
+	double	aSum[LANE_WIDTH], aNew[LANE_WIDTH], aMult[LANE_WIDTH];
+	double	*aThetaInf;
+
+	for (l = 0; l < LANE_WIDTH; l++)
+	{
+		aSum[l] = aTotal[l];
+		aNew[l] = aHostRate[l];
+		aMult[l] = aRho[l];
+	}
+	for (j = 0; j < nHosts; j++)
+	{
+		aThetaInf = pLanes->aThetaInf + (size_t)j * LANE_WIDTH;
+		LANE_LOOP
+		for (l = 0; l < LANE_WIDTH; l++)
+		{
+			thisExtra = aThetaInf[l] * aMult[l] * aRow[l][j];
+			aNew[l] += thisExtra;
+			aSum[l] += thisExtra;
+		}
+	}
+	for (l = 0; l < LANE_WIDTH; l++)
+	{
+		aTotal[l] = aSum[l];
+		aHostRate[l] = aNew[l];
+	}
+}
+
+/*
+	host in each lane whose force of infection on a host with susceptibility aRho[l] (through
+	the kernel row aRow[l]) takes the running total past aTarget[l], as pickByRate() does over
+	the infected hosts; aHost[l] must be _NOT_SET for each lane to search, and is left so
+	should rounding run the search off the end
+*/
+void LANE_FN(scanInfectors)(t_Lanes *pLanes, int nHosts, double *aRho, double **aRow, double *aTarget, int *aHost)
+{
+	int		j, l, nLeft;
+	double	aSum[LANE_WIDTH], aMult[LANE_WIDTH];
+	double	*aThetaInf;
+
+	nLeft = 0;
+	for (l = 0; l < LANE_WIDTH; l++)
+	{
+		aSum[l] = 0.0;
+		aMult[l] = aRho[l];
+		nLeft += (aHost[l] == _NOT_SET);
+	}
+	for (j = 0; nLeft > 0 && j < nHosts; j++)
+	{
+		aThetaInf = pLanes->aThetaInf + (size_t)j * LANE_WIDTH;
+		LANE_LOOP
+		for (l = 0; l < LANE_WIDTH; l++)
+		{
+			aSum[l] += aThetaInf[l] * aMult[l] * aRow[l][j];
+		}
+		LANE_LOOP
+		for (l = 0; l < LANE_WIDTH; l++)
+		{
+			if (aHost[l] == _NOT_SET && aSum[l] > aTarget[l])
+			{
+				aHost[l] = j;
+				nLeft--;
+			}
+		}
+	}
+}
+
+#undef LANE_WIDTH
@@ -0,0 +1,280 @@
+/*
+	Merge the output of a sharded EpidemicSim run
+
+	EpidemicSim.exe run with shardCount=K and shardIndex=0..K-1 (and the same
+	seed) writes <outFile stub>_shard<k>.csv and <outFile stub>_shard<k>_param.csv.
+	This puts them back together as outFile and <outFile stub>_param.csv,
+	exactly as a single run with the same seed would have written them, and
+	checks nothing is missing or duplicated on the way.
+
+	Compile MergeShards.exe from MergeShards.c, Config.c, Threads.c and mt19937ar.c
+	(EpidemicSim.c is included directly, below).
+
+	Options are given on the command line as key=value, e.g.
+		MergeShards.exe outFile=Outputs\ls_1_epidemics.csv shardCount=4
+*/
+
+#define _EPIDEMICSIM_NO_MAIN
+#include "EpidemicSim.c"
+
+typedef struct {
+	char	*pLine;
+	size_t	nAlloc;
+} t_LineBuffer;
+
+/*
+	read one line (including any '\n') of arbitrary length; returns its length, or 0 at the end of the file
+*/
+size_t	readLine(FILE *fIn, t_LineBuffer *pBuf)
+{
+	size_t	nLen;
+	char	*pNew;
+
+	nLen = 0;
+	for (;;)
+	{
+		if (nLen + 2 > pBuf->nAlloc)
+		{
+			pNew = realloc(pBuf->pLine, 2 * pBuf->nAlloc + _MAX_STR_LEN);
+			if (!pNew)
+			{
+				fprintf(stderr, "readLine(): Out of memory\n");
+				return 0;
+			}
+			pBuf->pLine = pNew;
+			pBuf->nAlloc = 2 * pBuf->nAlloc + _MAX_STR_LEN;
+		}
+		if (!fgets(pBuf->pLine + nLen, (int)(pBuf->nAlloc - nLen), fIn))
+		{
+			break;
+		}
+		nLen += strlen(pBuf->pLine + nLen);
+		if (nLen > 0 && pBuf->pLine[nLen - 1] == '\n')
+		{
+			break;
+		}
+	}
+	return nLen;
+}
+
+/*
+	name of the parameter dump that goes with sOutFile (as made in readParamsFromConfig())
+*/
+void	paramFileName(char *sParamFile, const char *sOutFile)
+{
+	const char	*pExt;
+
+	pExt = strrchr(sOutFile, '.');
+	if (!pExt)
+	{
+		pExt = sOutFile + strlen(sOutFile);
+	}
+	sprintf(sParamFile, "%.*s_param.csv", (int)(pExt - sOutFile), sOutFile);
+}
+
+/*
+	the parameter dumps of all the shards must be identical (they all record the total numIts)
+
+	the first is copied to the merged parameter file, and numIts taken from it
+*/
+int		mergeParamFiles(char *sOutFile, int nShards, int *pNumIts)
+{
+	char			sShardFile[_MAX_STR_LEN + 16], sParamFile[_MAX_STR_LEN + 32];
+	char			sFirst[2][_MAX_STR_LEN * 4], sThis[_MAX_STR_LEN * 4];
+	char			*pName, *pValue;
+	FILE			*fIn, *fOut;
+	int				k, l, nCol;
+
+	for (k = 0; k < nShards; k++)
+	{
+		shardFileName(sShardFile, sOutFile, k);
+		paramFileName(sParamFile, sShardFile);
+		fIn = fopen(sParamFile, "rb");
+		if (!fIn)
+		{
+			fprintf(stderr, "mergeParamFiles(): Couldn't open %s\n", sParamFile);
+			return 0;
+		}
+		for (l = 0; l < 2; l++)
+		{
+			if (!fgets(sThis, sizeof(sThis), fIn))
+			{
+				sThis[0] = '\0';
+			}
+			if (k == 0)
+			{
+				strcpy(sFirst[l], sThis);
+			}
+			else if (strcmp(sFirst[l], sThis) != 0)
+			{
+				fprintf(stderr, "mergeParamFiles(): %s doesn't match the first shard\n", sParamFile);
+				fclose(fIn);
+				return 0;
+			}
+		}
+		fclose(fIn);
+	}
+	/* find numIts by column name */
+	*pNumIts = _NOT_SET;
+	pName = sFirst[0];
+	pValue = sFirst[1];
+	for (nCol = 0; pName && pValue && *pNumIts == _NOT_SET; nCol++)
+	{
+		if (strncmp(pName, "numIts,", 7) == 0)
+		{
+			*pNumIts = atoi(pValue);
+		}
+		pName = strchr(pName, ',');
+		pValue = strchr(pValue, ',');
+		if (pName && pValue)
+		{
+			pName++;
+			pValue++;
+		}
+	}
+	if (*pNumIts == _NOT_SET)
+	{
+		fprintf(stderr, "mergeParamFiles(): No numIts in parameter files\n");
+		return 0;
+	}
+	paramFileName(sParamFile, sOutFile);
+	fOut = fopen(sParamFile, "wb");
+	if (!fOut)
+	{
+		fprintf(stderr, "mergeParamFiles(): Couldn't open %s\n", sParamFile);
+		return 0;
+	}
+	fputs(sFirst[0], fOut);
+	fputs(sFirst[1], fOut);
+	fclose(fOut);
+	return 1;
+}
+
+/*
+	concatenate the shards, keeping only the first header
+
+	replicates must carry on from one line to the next (each line's <it> is
+	the same as, or one more than, the last), and there must be numIts of them
+*/
+int		mergeEpidemicFiles(char *sOutFile, int nShards, int nNumIts)
+{
+	char			sShardFile[_MAX_STR_LEN + 16];
+	FILE			*fIn, *fOut;
+	t_LineBuffer	sLine, sHeader;
+	size_t			nLen;
+	int				k, nIt, nLastIt, nLineNum, retVal;
+
+	memset(&sLine, 0, sizeof(t_LineBuffer));
+	memset(&sHeader, 0, sizeof(t_LineBuffer));
+	fOut = fopen(sOutFile, "wb");
+	if (!fOut)
+	{
+		fprintf(stderr, "mergeEpidemicFiles(): Couldn't open %s\n", sOutFile);
+		return 0;
+	}
+	retVal = 1;
+	nLastIt = -1;
+	for (k = 0; retVal && k < nShards; k++)
+	{
+		shardFileName(sShardFile, sOutFile, k);
+		fIn = fopen(sShardFile, "rb");
+		if (!fIn)
+		{
+			fprintf(stderr, "mergeEpidemicFiles(): Couldn't open %s\n", sShardFile);
+			retVal = 0;
+			break;
+		}
+		nLineNum = 0;
+		while (retVal && (nLen = readLine(fIn, &sLine)) > 0)
+		{
+			nLineNum++;
+			if (nLineNum == 1)
+			{
+				/* every shard which did any replicates starts with the same header */
+				if (sHeader.pLine == NULL)
+				{
+					sHeader.pLine = strdup(sLine.pLine);
+					fputs(sLine.pLine, fOut);
+				}
+				else if (strcmp(sHeader.pLine, sLine.pLine) != 0)
+				{
+					fprintf(stderr, "mergeEpidemicFiles(): %s has a different header\n", sShardFile);
+					retVal = 0;
+				}
+				continue;
+			}
+			if (sscanf(sLine.pLine, "%d", &nIt) != 1 || (nIt != nLastIt && nIt != nLastIt + 1))
+			{
+				fprintf(stderr, "mergeEpidemicFiles(): %s line %d: expected replicate %d or %d\n", sShardFile, nLineNum, nLastIt, nLastIt + 1);
+				retVal = 0;
+			}
+			else
+			{
+				nLastIt = nIt;
+				fwrite(sLine.pLine, 1, nLen, fOut);
+			}
+		}
+		fclose(fIn);
+	}
+	if (retVal && nLastIt + 1 != nNumIts)
+	{
+		fprintf(stderr, "mergeEpidemicFiles(): found %d replicates but numIts is %d\n", nLastIt + 1, nNumIts);
+		retVal = 0;
+	}
+	if (fclose(fOut) != 0)
+	{
+		retVal = 0;
+	}
+	if (!retVal)
+	{
+		remove(sOutFile);
+	}
+	free(sLine.pLine);
+	free(sHeader.pLine);
+	return retVal;
+}
+
+int main(int argc, char **argv)
+{
+	t_Config	sCfg;
+	char		sOutFile[_MAX_STR_LEN];
+	int			nShards, nNumIts, retVal;
+
+	/* command line only, there is no cfg file */
+	if (!loadConfig(&sCfg, argc, argv, NULL))
+	{
+		return(EXIT_FAILURE);
+	}
+	nShards = 0;
+	retVal = cfgGetString(&sCfg, "outFile", sOutFile) && cfgGetInt(&sCfg, "shardCount", &nShards);
+	if (retVal && cfgCheckUnused(&sCfg) > 0)
+	{
+		fprintf(stderr, "Unknown key(s) on command line\n");
+		retVal = 0;
+	}
+	if (retVal && cfgBadValues(&sCfg) > 0)
+	{
+		fprintf(stderr, "%d value(s) couldn't be read\n", cfgBadValues(&sCfg));
+		retVal = 0;
+	}
+	freeConfig(&sCfg);
+	if (!retVal || nShards < 1)
+	{
+		fprintf(stderr, "Usage: %s outFile=<outFile as given to EpidemicSim> shardCount=<number of shards>\n", argv[0]);
+		return(EXIT_FAILURE);
+	}
+	if (!(retVal = mergeParamFiles(sOutFile, nShards, &nNumIts)))
+	{
+		fprintf(stderr, "Error in mergeParamFiles()\nExiting\n");
+	}
+	if (retVal && !(retVal = mergeEpidemicFiles(sOutFile, nShards, nNumIts)))
+	{
+		fprintf(stderr, "Error in mergeEpidemicFiles()\nExiting\n");
+	}
+	if (retVal)
+	{
+		fprintf(stdout, "Merged %d replicates from %d shards into %s\n", nNumIts, nShards, sOutFile);
+		return(EXIT_SUCCESS);
+	}
+	return(EXIT_FAILURE);
+}
@@ -0,0 +1,623 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define	_GNU_SOURCE		/* for sched_setaffinity() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Threads.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sched.h>
+#endif
+
+#define	_MAX_NUMA_NODES	64			/* nodes beyond this are left out */
+
+/* thread entry point plus its argument (lets one signature serve both platforms) */
+typedef struct {
+	t_ThreadFunc	pFunc;
+	void			*pArg;
+} t_ThreadStart;
+
+/* shared state for runInParallel() */
+typedef struct {
+	t_ItemFunc	pFunc;
+	void		*pCtx;
+	int			nItems;
+	int			nNext;
+	t_Mutex		sLock;
+} t_ParallelFor;
+
+typedef struct {
+	t_ParallelFor	*pShared;
+	int				nThread;
+} t_ParallelWorker;
+
+/* NUMA nodes worker threads are pinned to in turn (see threadsPinWorkers()), 0 if they aren't */
+static int					nPinNodes = 0;
+static unsigned long long	nPinMask = 0;
+
+int		numProcessors()
+{
+#ifdef _WIN32
+	SYSTEM_INFO	sInfo;
+
+	GetSystemInfo(&sInfo);
+	return (int)sInfo.dwNumberOfProcessors;
+#else
+	long	n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? (int)n : 1;
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI threadTrampoline(LPVOID pArg)
+#else
+static void *threadTrampoline(void *pArg)
+#endif
+{
+	t_ThreadStart	sStart;
+
+	sStart = *(t_ThreadStart*)pArg;
+	free(pArg);
+	sStart.pFunc(sStart.pArg);
+	return 0;
+}
+
+int		threadStart(t_Thread *pThread, t_ThreadFunc pFunc, void *pArg)
+{
+	t_ThreadStart	*pStart;
+
+	pStart = malloc(sizeof(t_ThreadStart));
+	if (!pStart)
+	{
+		return 0;
+	}
+	pStart->pFunc = pFunc;
+	pStart->pArg = pArg;
+#ifdef _WIN32
+	*pThread = CreateThread(NULL, 0, threadTrampoline, pStart, 0, NULL);
+	if (*pThread == NULL)
+#else
+	if (pthread_create(pThread, NULL, threadTrampoline, pStart) != 0)
+#endif
+	{
+		free(pStart);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+	number of NUMA nodes (1 if that can't be found out), and in *pMask (if not NULL) a
+	bit for each node's number
+*/
+int		numaNodes(unsigned long long *pMask)
+{
+	unsigned long long	nMask;
+	int					n, nNodes;
+
+	nMask = 0;
+	nNodes = 0;
+#ifdef _WIN32
+	{
+		ULONG	nHighest;
+
+		if (GetNumaHighestNodeNumber(&nHighest))
+		{
+			for (n = 0; n <= (int)nHighest && n < _MAX_NUMA_NODES; n++)
+			{
+				nMask |= 1ULL << n;
+				nNodes++;
+			}
+		}
+	}
+#elif defined(__linux__)
+	{
+		char	sPath[64];
+
+		/* node numbers can have gaps, so look for each one */
+		for (n = 0; n < _MAX_NUMA_NODES; n++)
+		{
+			sprintf(sPath, "/sys/devices/system/node/node%d", n);
+			if (access(sPath, F_OK) == 0)
+			{
+				nMask |= 1ULL << n;
+				nNodes++;
+			}
+		}
+	}
+#endif
+	if (nNodes == 0)
+	{
+		nMask = 1;
+		nNodes = 1;
+	}
+	if (pMask)
+	{
+		*pMask = nMask;
+	}
+	return nNodes;
+}
+
+/*
+	pin the calling thread to the processors of the nIndex-th of the nodes in nMask
+	(counting round again if there are fewer); returns 0 if it couldn't be
+*/
+static int	pinToNode(int nIndex, int nNodes, unsigned long long nMask)
+{
+	int		nNode;
+
+	nIndex %= nNodes;
+	for (nNode = 0; nNode < _MAX_NUMA_NODES; nNode++)
+	{
+		if ((nMask >> nNode) & 1)
+		{
+			if (nIndex == 0)
+			{
+				break;
+			}
+			nIndex--;
+		}
+	}
+#ifdef _WIN32
+	{
+		ULONGLONG	nCPUs;
+
+		return GetNumaNodeProcessorMask((UCHAR)nNode, &nCPUs) && nCPUs
+			&& SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)nCPUs) != 0;
+	}
+#elif defined(__linux__)
+	{
+		FILE		*fIn;
+		char		sPath[64], sList[4096], *p;
+		cpu_set_t	sCPUs;
+		long		nFirst, nLast, i;
+		int			nCPUs;
+
+		/* processors on the node are listed as ranges, e.g. 0-15,32-47 */
+		sprintf(sPath, "/sys/devices/system/node/node%d/cpulist", nNode);
+		fIn = fopen(sPath, "r");
+		if (!fIn)
+		{
+			return 0;
+		}
+		p = fgets(sList, sizeof(sList), fIn);
+		fclose(fIn);
+		if (!p)
+		{
+			return 0;
+		}
+		CPU_ZERO(&sCPUs);
+		nCPUs = 0;
+		while (*p >= '0' && *p <= '9')
+		{
+			nFirst = nLast = strtol(p, &p, 10);
+			if (*p == '-')
+			{
+				nLast = strtol(p + 1, &p, 10);
+			}
+			for (i = nFirst; i <= nLast && i < CPU_SETSIZE; i++)
+			{
+				CPU_SET(i, &sCPUs);
+				nCPUs++;
+			}
+			if (*p == ',')
+			{
+				p++;
+			}
+		}
+		return nCPUs > 0 && sched_setaffinity(0, sizeof(cpu_set_t), &sCPUs) == 0;
+	}
+#else
+	(void)nNode;
+	return 0;
+#endif
+}
+
+/*
+	whether the workers runInParallel() and teamCreate() start are each pinned to a NUMA
+	node, taking the nodes in turn (so their share of memory spread over the nodes is read
+	from the same place each time); returns the number of nodes they will be spread over,
+	which is 0 if they won't be pinned, as there is no point with only one
+*/
+int		threadsPinWorkers(int bPin)
+{
+	nPinNodes = bPin ? numaNodes(&nPinMask) : 0;
+	if (nPinNodes < 2)
+	{
+		nPinNodes = 0;
+	}
+	return nPinNodes;
+}
+
+void	threadJoin(t_Thread *pThread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(*pThread, INFINITE);
+	CloseHandle(*pThread);
+#else
+	pthread_join(*pThread, NULL);
+#endif
+}
+
+void	mutexInit(t_Mutex *pMutex)
+{
+#ifdef _WIN32
+	InitializeCriticalSection(pMutex);
+#else
+	pthread_mutex_init(pMutex, NULL);
+#endif
+}
+
+void	mutexLock(t_Mutex *pMutex)
+{
+#ifdef _WIN32
+	EnterCriticalSection(pMutex);
+#else
+	pthread_mutex_lock(pMutex);
+#endif
+}
+
+void	mutexUnlock(t_Mutex *pMutex)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(pMutex);
+#else
+	pthread_mutex_unlock(pMutex);
+#endif
+}
+
+void	mutexDestroy(t_Mutex *pMutex)
+{
+#ifdef _WIN32
+	DeleteCriticalSection(pMutex);
+#else
+	pthread_mutex_destroy(pMutex);
+#endif
+}
+
+void	condInit(t_Cond *pCond)
+{
+#ifdef _WIN32
+	InitializeConditionVariable(pCond);
+#else
+	pthread_cond_init(pCond, NULL);
+#endif
+}
+
+/* pMutex must be locked, and is again on return */
+void	condWait(t_Cond *pCond, t_Mutex *pMutex)
+{
+#ifdef _WIN32
+	SleepConditionVariableCS(pCond, pMutex, INFINITE);
+#else
+	pthread_cond_wait(pCond, pMutex);
+#endif
+}
+
+void	condBroadcast(t_Cond *pCond)
+{
+#ifdef _WIN32
+	WakeAllConditionVariable(pCond);
+#else
+	pthread_cond_broadcast(pCond);
+#endif
+}
+
+void	condDestroy(t_Cond *pCond)
+{
+#ifdef _WIN32
+	(void)pCond;	/* nothing to free */
+#else
+	pthread_cond_destroy(pCond);
+#endif
+}
+
+static void	parallelWorker(void *pArg)
+{
+	t_ParallelWorker	*pWorker;
+	t_ParallelFor		*pShared;
+	int					nItem;
+
+	pWorker = (t_ParallelWorker*)pArg;
+	pShared = pWorker->pShared;
+	if (nPinNodes > 0)
+	{
+		pinToNode(pWorker->nThread, nPinNodes, nPinMask);
+	}
+	for (;;)
+	{
+		mutexLock(&pShared->sLock);
+		nItem = pShared->nNext++;
+		mutexUnlock(&pShared->sLock);
+		if (nItem >= pShared->nItems)
+		{
+			break;
+		}
+		pShared->pFunc(pShared->pCtx, nItem, pWorker->nThread);
+	}
+}
+
+/*
+	call pFunc for items 0..nItems-1, handing them out in order to nThreads threads
+	(nThreads <= 1 just runs everything on the calling thread)
+*/
+int		runInParallel(int nThreads, int nItems, t_ItemFunc pFunc, void *pCtx)
+{
+	t_ParallelFor		sShared;
+	t_ParallelWorker	*aWorkers;
+	t_Thread			*aThreads;
+	int					i, nStarted, retVal;
+
+	if (nThreads > nItems)
+	{
+		nThreads = nItems;
+	}
+	if (nThreads <= 1)
+	{
+		for (i = 0; i < nItems; i++)
+		{
+			pFunc(pCtx, i, 0);
+		}
+		return 1;
+	}
+	retVal = 0;
+	sShared.pFunc = pFunc;
+	sShared.pCtx = pCtx;
+	sShared.nItems = nItems;
+	sShared.nNext = 0;
+	mutexInit(&sShared.sLock);
+	aWorkers = malloc(sizeof(t_ParallelWorker) * nThreads);
+	aThreads = malloc(sizeof(t_Thread) * nThreads);
+	if (aWorkers && aThreads)
+	{
+		nStarted = 0;
+		for (i = 0; i < nThreads; i++)
+		{
+			aWorkers[i].pShared = &sShared;
+			aWorkers[i].nThread = i;
+			if (threadStart(&aThreads[nStarted], parallelWorker, &aWorkers[i]))
+			{
+				nStarted++;
+			}
+		}
+		/* if no threads could be started at all, fall back on doing the work here */
+		if (nStarted == 0)
+		{
+			parallelWorker(&aWorkers[0]);
+		}
+		for (i = 0; i < nStarted; i++)
+		{
+			threadJoin(&aThreads[i]);
+		}
+		retVal = 1;
+	}
+	else
+	{
+		fprintf(stderr, "runInParallel(): Out of memory\n");
+	}
+	if (aWorkers)
+	{
+		free(aWorkers);
+	}
+	if (aThreads)
+	{
+		free(aThreads);
+	}
+	mutexDestroy(&sShared.sLock);
+	return retVal;
+}
+
+/*
+	persistent team of threads for many small jobs in a row (see teamRun()), where starting
+	threads for each one would cost more than the job itself
+
+	between jobs workers poll for the next one for a while, then sleep until woken
+*/
+#define	_TEAM_SPINS		4000		/* polls before a waiting thread sleeps (or yields) */
+
+struct t_Team {
+	int				nThreads;		/* including the one calling teamRun() */
+	t_Thread		*aThreads;
+	t_TeamFunc		pFunc;			/* current job */
+	void			*pCtx;
+	int				bQuit;
+	volatile long	nGeneration;	/* bumped to start each job */
+	volatile long	nDone;			/* workers finished with the current job */
+	volatile long	nSleeping;		/* workers waiting on sWake */
+	t_Mutex			sLock;
+	t_Cond			sWake;
+};
+
+typedef struct {
+	t_Team	*pTeam;
+	int		nThread;
+} t_TeamWorker;
+
+static long	atomicGet(volatile long *pValue)
+{
+#ifdef _WIN32
+	return InterlockedCompareExchange(pValue, 0, 0);
+#else
+	return __atomic_load_n(pValue, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void	atomicSet(volatile long *pValue, long nValue)
+{
+#ifdef _WIN32
+	InterlockedExchange(pValue, nValue);
+#else
+	__atomic_store_n(pValue, nValue, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void	atomicAdd(volatile long *pValue, long nAdd)
+{
+#ifdef _WIN32
+	InterlockedExchangeAdd(pValue, nAdd);
+#else
+	__atomic_fetch_add(pValue, nAdd, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void	threadYield()
+{
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+static void	teamWorker(void *pArg)
+{
+	t_TeamWorker	*pWorker;
+	t_Team			*pTeam;
+	long			nSeen;
+	int				nSpins;
+
+	pWorker = (t_TeamWorker*)pArg;
+	pTeam = pWorker->pTeam;
+	nSeen = 0;
+	if (nPinNodes > 0)
+	{
+		pinToNode(pWorker->nThread, nPinNodes, nPinMask);
+	}
+	for (;;)
+	{
+		for (nSpins = 0; atomicGet(&pTeam->nGeneration) == nSeen; nSpins++)
+		{
+			if (nSpins >= _TEAM_SPINS)
+			{
+				/* teamRun() only wakes sleepers it can see, so count in before looking again */
+				mutexLock(&pTeam->sLock);
+				atomicAdd(&pTeam->nSleeping, 1);
+				while (atomicGet(&pTeam->nGeneration) == nSeen)
+				{
+					condWait(&pTeam->sWake, &pTeam->sLock);
+				}
+				atomicAdd(&pTeam->nSleeping, -1);
+				mutexUnlock(&pTeam->sLock);
+			}
+		}
+		nSeen = atomicGet(&pTeam->nGeneration);
+		if (pTeam->bQuit)
+		{
+			break;
+		}
+		pTeam->pFunc(pTeam->pCtx, pWorker->nThread, pTeam->nThreads);
+		atomicAdd(&pTeam->nDone, 1);
+	}
+	free(pWorker);
+}
+
+static void	teamStartJob(t_Team *pTeam)
+{
+	atomicAdd(&pTeam->nGeneration, 1);
+	if (atomicGet(&pTeam->nSleeping) > 0)
+	{
+		mutexLock(&pTeam->sLock);
+		condBroadcast(&pTeam->sWake);
+		mutexUnlock(&pTeam->sLock);
+	}
+}
+
+/*
+	start nThreads - 1 workers (the caller of teamRun() is the last); returns NULL if
+	none could be started, so the caller can carry on with one thread
+*/
+t_Team	*teamCreate(int nThreads)
+{
+	t_Team			*pTeam;
+	t_TeamWorker	*pWorker;
+	int				i;
+
+	if (nThreads < 2)
+	{
+		return NULL;
+	}
+	pTeam = calloc(1, sizeof(t_Team));
+	if (!pTeam || !(pTeam->aThreads = malloc(sizeof(t_Thread) * nThreads)))
+	{
+		fprintf(stderr, "teamCreate(): Out of memory\n");
+		free(pTeam);
+		return NULL;
+	}
+	mutexInit(&pTeam->sLock);
+	condInit(&pTeam->sWake);
+	pTeam->nThreads = 1;
+	for (i = 1; i < nThreads; i++)
+	{
+		pWorker = malloc(sizeof(t_TeamWorker));
+		if (!pWorker)
+		{
+			break;
+		}
+		pWorker->pTeam = pTeam;
+		pWorker->nThread = i;
+		if (!threadStart(&pTeam->aThreads[i], teamWorker, pWorker))
+		{
+			free(pWorker);
+			break;
+		}
+		pTeam->nThreads++;
+	}
+	if (pTeam->nThreads < 2)
+	{
+		teamDestroy(pTeam);
+		return NULL;
+	}
+	return pTeam;
+}
+
+int		teamSize(t_Team *pTeam)
+{
+	return pTeam ? pTeam->nThreads : 1;
+}
+
+/*
+	call pFunc(pCtx, nThread, nThreads) on every thread in the team, this one being thread 0,
+	and return when they have all finished
+*/
+void	teamRun(t_Team *pTeam, t_TeamFunc pFunc, void *pCtx)
+{
+	int		nSpins;
+
+	pTeam->pFunc = pFunc;
+	pTeam->pCtx = pCtx;
+	atomicSet(&pTeam->nDone, 0);
+	teamStartJob(pTeam);
+	pFunc(pCtx, 0, pTeam->nThreads);
+	for (nSpins = 0; atomicGet(&pTeam->nDone) < pTeam->nThreads - 1; nSpins++)
+	{
+		if (nSpins >= _TEAM_SPINS)
+		{
+			threadYield();
+		}
+	}
+}
+
+void	teamDestroy(t_Team *pTeam)
+{
+	int		i;
+
+	if (!pTeam)
+	{
+		return;
+	}
+	pTeam->bQuit = 1;
+	teamStartJob(pTeam);
+	for (i = 1; i < pTeam->nThreads; i++)
+	{
+		threadJoin(&pTeam->aThreads[i]);
+	}
+	condDestroy(&pTeam->sWake);
+	mutexDestroy(&pTeam->sLock);
+	free(pTeam->aThreads);
+	free(pTeam);
+}
@@ -0,0 +1,44 @@
+#ifndef _THREADS_H_
+#define _THREADS_H_
+
+/*
+	minimal portable threading (Win32 threads or pthreads)
+*/
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE				t_Thread;
+typedef CRITICAL_SECTION	t_Mutex;
+typedef CONDITION_VARIABLE	t_Cond;
+#else
+#include <pthread.h>
+typedef pthread_t			t_Thread;
+typedef pthread_mutex_t		t_Mutex;
+typedef pthread_cond_t		t_Cond;
+#endif
+
+typedef void (*t_ThreadFunc)(void *pArg);
+typedef void (*t_ItemFunc)(void *pCtx, int nItem, int nThread);
+typedef void (*t_TeamFunc)(void *pCtx, int nThread, int nThreads);
+typedef struct t_Team t_Team;
+
+int		numProcessors();
+int		numaNodes(unsigned long long *pMask);
+int		threadsPinWorkers(int bPin);
+int		threadStart(t_Thread *pThread, t_ThreadFunc pFunc, void *pArg);
+void	threadJoin(t_Thread *pThread);
+void	mutexInit(t_Mutex *pMutex);
+void	mutexLock(t_Mutex *pMutex);
+void	mutexUnlock(t_Mutex *pMutex);
+void	mutexDestroy(t_Mutex *pMutex);
+void	condInit(t_Cond *pCond);
+void	condWait(t_Cond *pCond, t_Mutex *pMutex);
+void	condBroadcast(t_Cond *pCond);
+void	condDestroy(t_Cond *pCond);
+int		runInParallel(int nThreads, int nItems, t_ItemFunc pFunc, void *pCtx);
+t_Team	*teamCreate(int nThreads);
+int		teamSize(t_Team *pTeam);
+void	teamRun(t_Team *pTeam, t_TeamFunc pFunc, void *pCtx);
+void	teamDestroy(t_Team *pTeam);
+
+#endif /* _THREADS_H_ */